@@ -8,16 +8,43 @@
  *
  * CREATED:	    11/06/2017
  *
- * LAST EDITED:	    01/01/2018
+ * LAST EDITED:	    10/18/2026
  ***/
 
 #ifndef __ET_BITREE_H_
 #define __ET_BITREE_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#ifdef CONFIG_JOURNAL
+#   include <stdatomic.h>
+#endif
+
 /******************************************************************************
  * MACRO DEFINITIONS
  ***/
 
+/* Trees with more nodes than this are copied in parallel by bitree_clone() and
+ * bitree_map(), if there is more than one processor.
+ */
+#ifndef BITREE_CLONE_THRESHOLD
+#   define BITREE_CLONE_THRESHOLD	65536
+#endif
+
+/* With CONFIG_DESTROY_BATCH, the most payloads passed to a destroy_batch
+ * function at once.
+ */
+#ifndef BITREE_DESTROY_BATCH
+#   define BITREE_DESTROY_BATCH		256
+#endif
+
+/* The number of walks or descents bitree_walk_many() and
+ * bitree_descend_many() interleave, unless told otherwise; at most 64.
+ */
+#ifndef BITREE_INTERLEAVE
+#   define BITREE_INTERLEAVE		16
+#endif
+
 /* Macro definitions for basic manipulation of the tree */
 #define bitree_isempty(tree)	((tree)->size == 0)
 #define bitree_isleaf(tree)	((tree)->left == NULL && (tree)->right == NULL)
@@ -27,6 +54,12 @@
 #define bitree_root(tree)	((tree)->root)
 #define bitree_parent(tree)	((tree)->parent)
 #define bitree_data(tree)	((tree)->data)
+#ifdef CONFIG_ORDER_STATISTICS
+#   define bitree_count(tree)	((tree)->count)
+#endif
+#ifdef CONFIG_SUBTREE_AGGREGATE
+#   define bitree_summary(tree)	((tree)->summary)
+#endif
 
 /* These macros expand to function definitions which can be used to traverse
  * the tree in a standard way and perform arbitrary operations on each node.
@@ -86,11 +119,111 @@
       name##_helper(node, i);				\
   }
 
+/* This macro expands to a preorder walk of the subtree at `top', like
+ * bitree_walk() with BITREE_PREORDER, but with `action' inlined in place of
+ * the visitor. `action' can read `node' and `ctx', and set `visit' to
+ * BITREE_SKIP_CHILDREN or BITREE_STOP. The function returns 1 if the walk was
+ * stopped, and 0 otherwise.
+ *
+ * Example of use:
+ *
+ * DEFINE_PREORDER_WALK(find_negative, {
+ *   if (*(int *)node->data < 0) {
+ *     *(bitree **)ctx = node;
+ *     visit = BITREE_STOP;
+ *   }
+ * });
+ */
+#define DEFINE_PREORDER_WALK(name, action)				\
+  int name(bitree * top, void * ctx) {					\
+    bitree * node = top;						\
+    while (node != NULL) {						\
+      enum bitree_visit visit = BITREE_CONTINUE;			\
+      action;								\
+      if (visit == BITREE_STOP)						\
+	return 1;							\
+      if (visit == BITREE_CONTINUE && node->left != NULL) {		\
+	node = node->left;						\
+      } else if (visit == BITREE_CONTINUE && node->right != NULL) {	\
+	node = node->right;						\
+      } else {								\
+	while (node != top && (node->parent->right == NULL		\
+			       || node->parent->right == node))		\
+	  node = node->parent;						\
+	node = node == top ? NULL : node->parent->right;		\
+      }									\
+    }									\
+    return 0;								\
+  }
+
 /******************************************************************************
  * TYPE DEFINITIONS
  ***/
 
-/* The whole binary tree is contained within this struct */
+/* The two children of a node */
+enum bitree_side {
+  BITREE_LEFT,
+  BITREE_RIGHT
+};
+
+/* The orders in which a tree may be visited, for the functions that take one */
+enum bitree_order {
+  BITREE_PREORDER,
+  BITREE_INORDER,
+  BITREE_POSTORDER,
+  BITREE_LEVELORDER
+};
+
+/* What a visitor passed to bitree_walk() asks the walk to do next */
+enum bitree_visit {
+  BITREE_CONTINUE,
+  BITREE_SKIP_CHILDREN,
+  BITREE_STOP
+};
+
+#ifdef CONFIG_SUBTREE_AGGREGATE
+/* An aggregate is a monoid over the payloads of a tree: `value' extracts a
+ * number from the payload of a single node, and `combine' is an associative
+ * operation on two such numbers. For example, a sum uses addition, and a
+ * maximum uses fmax(3). Combining with the `identity' must have no effect.
+ */
+struct bitree_aggregate {
+  double (*value)(const void * data);
+  double (*combine)(double one, double two);
+  double identity;
+};
+#endif
+
+/* Nodes which were allocated together, e.g. by bitree_ins_batch(), share one
+ * block of memory. The block is freed when the last of its nodes is removed.
+ */
+struct bitree_block;
+
+/* A subtree which is being removed by bitree_rem_step() */
+struct bitree_rem_handle;
+
+#ifdef CONFIG_JOURNAL
+/* The journal attached to a tree by bitree_journal_attach(), or built by
+ * bitree_journal_replay().
+ */
+struct bitree_journal;
+
+/* A ring buffer which a journal can be written to, see bitree_journal_ring().
+ * `head' and `tail' count the bytes written and read since it was created, so
+ * one thread may write to it while another reads from it.
+ */
+struct bitree_ring {
+  unsigned char * buffer;
+  size_t capacity;
+  atomic_size_t head;
+  atomic_size_t tail;
+};
+#endif
+
+/* The whole binary tree is contained within this struct. The fields after
+ * `block' depend on the CONFIG_* features, so the library and everything that
+ * includes this header must be compiled with the same ones.
+ */
 typedef struct _Node_ {
 
   struct _Node_ * root;
@@ -102,8 +235,72 @@ typedef struct _Node_ {
   void (*destroy)(void *);
   void * data;
 
+  /* Height of the subtree rooted at this node. Only the rotation functions
+   * and the ordered layer in bitree_avl.c keep this up to date; every other
+   * operation leaves it at 1.
+   */
+  int height;
+
+  /* The block this node was allocated in, or NULL if it has its own. */
+  struct bitree_block * block;
+
+#ifdef CONFIG_ORDER_STATISTICS
+  /* Number of nodes in the subtree rooted at this node. */
+  int count;
+#endif
+
+#ifdef CONFIG_SUBTREE_AGGREGATE
+  /* The aggregate registered with the tree, if any, and its value over the
+   * subtree rooted at this node.
+   */
+  const struct bitree_aggregate * aggregate;
+  double summary;
+#endif
+
+#ifdef CONFIG_DESTROY_BATCH
+  /* If not NULL, used instead of `destroy' to free payloads in bulk. */
+  void (*destroy_batch)(void **, size_t);
+#endif
+
+#ifdef CONFIG_MERKLE_HASH
+  /* The payload hash function registered with the tree, if any, and the
+   * hash of the subtree rooted at this node, which is only valid if
+   * `hashed' is nonzero.
+   */
+  size_t (*hash_data)(const void *);
+  size_t hash;
+  int hashed;
+#endif
+
+#ifdef CONFIG_JOURNAL
+  /* The journal attached to the tree, if any, and the ID of this node in
+   * it.
+   */
+  struct bitree_journal * journal;
+  uint64_t id;
+#endif
+
 } bitree;
 
+/* One insertion in a call to bitree_ins_batch(): a new node with data `data'
+ * goes on the `side' of `parent'.
+ */
+struct bitree_ins_op {
+  bitree * parent;
+  enum bitree_side side;
+  void * data;
+};
+
+/* A position in a pre-, in- or post-order traversal of the subtree rooted at
+ * `top'. `next' is the node bitree_cursor_next() returns next, or NULL once
+ * the traversal is over.
+ */
+struct bitree_cursor {
+  bitree * top;
+  bitree * next;
+  enum bitree_order order;
+};
+
 /******************************************************************************
  * API FUNCTION PROTOTYPES
  ***/
@@ -125,11 +322,58 @@ extern int bitree_insl(bitree * parent, void * data);
  */
 extern int bitree_insr(bitree * parent, void * data);
 
+/* Apply the `n' insertions in `ops' to the tree containing `tree', in order.
+ * The new nodes are allocated in a single block, and the size of the tree is
+ * updated once. Each insertion is checked as bitree_insl() and bitree_insr()
+ * would, and an insertion into a child already filled earlier in the batch
+ * also fails. If `status' is not NULL, status[i] is set to 0 if ops[i] is
+ * valid and -1 otherwise. Unless every insertion is valid, none of them are
+ * applied, and the tree is left as it was.
+ */
+extern int bitree_ins_batch(bitree * tree, const struct bitree_ins_op * ops,
+			    size_t n, int * status);
+
 /* Remove `node' and all of its subnodes from the tree. Attempting to remove a
  * node twice will cause a segfault, so don't do that.
  */
 extern void bitree_rem(bitree * node);
 
+#ifdef CONFIG_ORDER_STATISTICS
+/* Like bitree_rem(), but the subtree is only detached from the tree here, and
+ * the size of the tree updated. The nodes are freed, and the destroy function
+ * called on their data, later, by a background thread, so the destroy
+ * function must be safe to call from another thread. bitree_reclaim_flush()
+ * waits for every removed subtree to be freed, and stops the thread. It
+ * should be called before the program exits.
+ *
+ * Incremental removal, for callers that can't use another thread. The subtree
+ * is detached and the size of the tree updated by bitree_rem_begin(). After
+ * that, each call to bitree_rem_step() frees at most `budget' nodes, and
+ * returns 1 while some of the subtree remains. Once it returns 0, the handle
+ * is no longer valid.
+ *
+ * All four need CONFIG_ORDER_STATISTICS: it is the cached subtree counts that
+ * let the subtree be detached in O(h), without counting it on the caller's
+ * thread.
+ */
+extern void bitree_rem_async(bitree * node);
+extern void bitree_reclaim_flush(void);
+extern struct bitree_rem_handle * bitree_rem_begin(bitree * node);
+extern int bitree_rem_step(struct bitree_rem_handle * handle, size_t budget);
+#endif /* CONFIG_ORDER_STATISTICS */
+
+/* Remove every node of the subtree at `*tree' for which pred(data, ctx) is
+ * zero, together with its subtree, in a single postorder walk. The nodes are
+ * freed, and the destroy function called on their data, as the walk goes, but
+ * the size of the tree is updated only once, at the end. Since a node is
+ * tested after its children, the predicate is also called on the descendants
+ * of a node which is then removed. If `*tree' itself is removed, it is set to
+ * NULL. Returns the number of nodes removed, or -1 on error.
+ */
+extern int bitree_retain(bitree ** tree,
+			 int (*pred)(const void * data, void * ctx),
+			 void * ctx);
+
 /* These functions return the next node struct in a tree traversal, assuming
  * the algorithm specified (or NULL if there is no more). They can be used in
  * loop structures, for flow control, or to develop complex and efficient
@@ -148,6 +392,102 @@ extern bitree * bitree_npostorder(bitree * node);
 extern bitree * bitree_ninorder(bitree * node);
 extern bitree * bitree_nlevelorder(bitree * node);
 
+/* Visit each node of the subtree rooted at `tree' in the order given, calling
+ * visit(node, ctx). The visitor returns BITREE_CONTINUE to carry on,
+ * BITREE_STOP to end the walk, or BITREE_SKIP_CHILDREN to carry on without
+ * visiting the children of `node' that have not been visited yet. That is
+ * both of them in preorder and level order, the right child in inorder, and
+ * neither in postorder. Unlike the functions above, the walk never leaves the
+ * subtree, and the preorder, inorder and postorder walks need no memory; the
+ * level order walk allocates a queue. Returns 1 if the walk was stopped, 0 if
+ * it finished, and -1 on error.
+ */
+extern int bitree_walk(bitree * tree, enum bitree_order order,
+		       enum bitree_visit (*visit)(bitree * node, void * ctx),
+		       void * ctx);
+
+/* Return the first node of the subtree rooted at `tree', in the order given,
+ * for which pred(data, ctx) is nonzero, or NULL if there is none.
+ */
+extern bitree * bitree_find_if(bitree * tree, enum bitree_order order,
+			       int (*pred)(const void * data, void * ctx),
+			       void * ctx);
+
+/* Start a traversal of the subtree rooted at `top'. Each call to
+ * bitree_cursor_next() then returns the next node of the subtree, in the order
+ * given, and NULL after the last one. Unlike the bitree_n*order() functions,
+ * which wrap around the whole tree, a cursor never leaves the subtree, so a
+ * full traversal is O(m), m is the size of the subtree, however large the
+ * tree is. The cursor needs no memory of its own, so it can live on the
+ * stack. Level order is not supported, since it needs a queue; use
+ * bitree_walk() instead. The shape of the subtree must not change during the
+ * traversal.
+ *
+ * Example of usage:
+ *
+ * struct bitree_cursor cursor;
+ * bitree_cursor_init(&cursor, subtree, BITREE_INORDER);
+ * for (bitree * node; (node = bitree_cursor_next(&cursor)) != NULL;)
+ *   (*(int *)(node->data))++;
+ */
+extern int bitree_cursor_init(struct bitree_cursor * cursor, bitree * top,
+			      enum bitree_order order);
+extern bitree * bitree_cursor_next(struct bitree_cursor * cursor);
+
+/* Fill `out' with up to `n' of the next nodes of the traversal, as if by as
+ * many calls to bitree_cursor_next(), and return how many were stored; fewer
+ * than `n' only once the traversal is over. Fetching the nodes in batches
+ * lets the caller work on them in chunks, e.g. prefetching their payloads
+ * before using them.
+ */
+extern size_t bitree_next_batch(struct bitree_cursor * cursor, bitree ** out,
+				size_t n);
+
+/* Walk each of the `n' subtrees rooted at trees[i], as bitree_walk() does,
+ * calling visit(node, ctxs[i]) (or visit(node, NULL), if `ctxs' is NULL),
+ * with BITREE_STOP ending only the walk it was returned in. Rather than one
+ * after the other, `group' walks (0 for BITREE_INTERLEAVE) take turns, each
+ * prefetching its next node before handing over to the next one, so that
+ * their cache misses overlap. Level order is not supported. trees[i] may be
+ * NULL. Returns 0 on success, and -1 otherwise.
+ */
+extern int bitree_walk_many(bitree ** trees, size_t n, enum bitree_order order,
+			    enum bitree_visit (*visit)(bitree * node,
+						       void * ctx),
+			    void ** ctxs, size_t group);
+
+/* Descend from each of the `n' nodes trees[i], `group' descents at a time,
+ * interleaved as in bitree_walk_many(). At each node, steer(data, ctxs[i])
+ * returns a negative number to go left, a positive number to go right, and
+ * 0 to end the descent there. found[i] is set to that node, or to NULL if
+ * the descent fell off the tree. Returns 0 on success, and -1 otherwise.
+ */
+extern int bitree_descend_many(bitree ** trees, size_t n,
+			       int (*steer)(const void * data, void * ctx),
+			       void ** ctxs, bitree ** found, size_t group);
+
+/* If the payload of `node' has been modified in place, this function must be
+ * called afterwards to update the cached fields (e.g. subtree aggregates) of
+ * `node' and its ancestors.
+ */
+extern void bitree_update(bitree * node);
+
+/* Copy the subtree rooted at `tree' into a new tree of the same shape, in a
+ * single pass and a single block of memory. The payload of each copy is
+ * copy(data); if `copy' is NULL, the payloads are shared, which is only
+ * allowed for trees without a destroy or destroy_batch function. Subtrees of
+ * more than BITREE_CLONE_THRESHOLD nodes are copied by several threads at
+ * once.
+ */
+extern bitree * bitree_clone(bitree * tree, void * (*copy)(const void *));
+
+/* Like bitree_clone(), but the payload of each copy is map(data), which may be
+ * of another type, and the new tree uses `destroy' to free it. Nothing that
+ * depends on the payload, such as an aggregate, is carried over.
+ */
+extern bitree * bitree_map(bitree * tree, void * (*map)(const void *),
+			   void (*destroy)(void *));
+
 /* This merging function is greedy, and uses any means possible to merge the
  * two trees it is passed. There is generally two cases which affect the
  * behaviour of this function:
@@ -170,6 +510,8 @@ extern bitree * bitree_nlevelorder(bitree * node);
  * failure of the function. The two trees cannot be on the same tree. In
  * addition, if tree1->destroy does not point to the same function as
  * tree2->destroy, or if both are not NULL, the function will return an error.
+ * The same goes for the aggregates and destroy_batch functions registered
+ * with the two trees.
  */
 extern int bitree_merge(bitree * tree1, bitree * tree2, void * data);
 
@@ -181,6 +523,187 @@ extern int bitree_height(bitree * tree);
  */
 extern int bitree_distance(bitree * tree);
 
+/* Rotate the subtree at `node' to the left (right), so that its right (left)
+ * child takes its place, and return the node that now occupies the position
+ * `node' used to. The in-order sequence of the tree is unchanged.
+ *
+ * The root of a tree never moves: when `node' is the root, the payloads of
+ * `node' and its child are exchanged instead, and `node' is returned. This
+ * keeps `root' and `size' valid in every node without touching any of them.
+ */
+extern bitree * bitree_rotl(bitree * node);
+extern bitree * bitree_rotr(bitree * node);
+
+#ifdef CONFIG_ORDER_STATISTICS
+/* Order statistics. When the library is compiled with CONFIG_ORDER_STATISTICS,
+ * every node caches the number of nodes in its subtree (see bitree_count()),
+ * which bitree_insl(), bitree_insr(), bitree_rem(), bitree_merge() and the
+ * rotations keep up to date. Insertion and removal then cost O(h) rather than
+ * O(1), since the count of every ancestor changes.
+ */
+
+/* Return the `k'th (zero-based) node of the subtree rooted at `tree', in the
+ * order given. Level order is not supported.
+ */
+extern bitree * bitree_select(bitree * tree, int k, enum bitree_order order);
+
+/* Return the zero-based position of `node' in the in-order sequence of its
+ * tree.
+ */
+extern int bitree_rank(bitree * node);
+
+/* Return a node of the subtree rooted at `tree', chosen uniformly at random
+ * with the generator whose state is at `state'. The caller seeds the state
+ * with any value; each thread should have its own.
+ */
+extern bitree * bitree_sample(bitree * tree, uint64_t * state);
+#endif /* CONFIG_ORDER_STATISTICS */
+
+#ifdef CONFIG_SUBTREE_AGGREGATE
+/* Subtree aggregates. When the library is compiled with
+ * CONFIG_SUBTREE_AGGREGATE, an aggregate may be registered with a tree, after
+ * which every node caches the aggregate over its subtree (see
+ * bitree_summary()). It is kept up to date along the parent chain by
+ * bitree_insl(), bitree_insr(), bitree_rem(), bitree_merge(), bitree_update()
+ * and the rotations, at a cost of O(h) each.
+ *
+ * Register `aggregate' with the tree containing `tree' (or unregister the
+ * current one, if it is NULL). This is best done straight after
+ * bitree_create(), but on a larger tree it computes every summary in one pass.
+ * Nodes inserted later inherit the aggregate from their parent. The struct
+ * must outlive the tree.
+ */
+extern int bitree_set_aggregate(bitree * tree,
+				const struct bitree_aggregate * aggregate);
+#endif /* CONFIG_SUBTREE_AGGREGATE */
+
+#ifdef CONFIG_DESTROY_BATCH
+/* Batched destruction. When the library is compiled with CONFIG_DESTROY_BATCH,
+ * a destroy_batch function may be registered with a tree. Every function that
+ * removes nodes then collects their payloads, and passes them to it up to
+ * BITREE_DESTROY_BATCH at a time, instead of calling the destroy function on
+ * each. This allows the payloads to be freed with a bulk-free interface.
+ *
+ * Register `destroy_batch' with the tree containing `tree' (or unregister it,
+ * if it is NULL). Like the aggregate, this is best done straight after
+ * bitree_create(), and nodes inserted later inherit it from their parent.
+ */
+extern int bitree_set_destroy_batch(bitree * tree,
+				    void (*destroy_batch)(void **, size_t));
+#endif /* CONFIG_DESTROY_BATCH */
+
+#ifdef CONFIG_MERKLE_HASH
+/* Subtree hashes. When the library is compiled with CONFIG_MERKLE_HASH, a
+ * payload hash function may be registered with a tree, after which the hash
+ * of each subtree combines the hash of its root's payload with the hashes of
+ * its two subtrees. Every change to the tree (including bitree_update() and
+ * the rotations) marks the hashes above it stale, and they are only computed
+ * again when they are next needed, so comparing a tree against a copy of
+ * itself costs time proportional to what has changed since the last
+ * comparison.
+ *
+ * Register `hash' with the tree containing `tree' (or unregister it, if it is
+ * NULL). Nodes inserted later inherit it from their parent. Payloads which
+ * are equal must hash equally.
+ */
+extern int bitree_set_hash(bitree * tree, size_t (*hash)(const void *));
+
+/* Return the hash of the subtree rooted at `tree'.
+ */
+extern size_t bitree_hash(bitree * tree);
+
+/* Return 1 if the subtrees rooted at `one' and `two' have the same shape and
+ * payloads which hash equally, 0 if not, or -1 if they do not have the same
+ * hash function. Subtrees whose hashes match are taken to be equal without
+ * looking at the payloads, so unequal subtrees are only reported equal if
+ * their hashes collide.
+ */
+extern int bitree_equal(bitree * one, bitree * two);
+
+/* Call report(node1, node2, ctx) for each position at which the subtrees
+ * rooted at `one' and `two' differ: either a node exists in only one of them
+ * (the other is NULL), and its whole subtree is reported at once, or the
+ * payloads of both nodes hash differently. Subtrees with matching hashes are
+ * skipped. Returns the number of differences, or -1 on error.
+ */
+extern int bitree_diff(bitree * one, bitree * two,
+		       void (*report)(bitree * one, bitree * two, void * ctx),
+		       void * ctx);
+#endif /* CONFIG_MERKLE_HASH */
+
+#ifdef CONFIG_JOURNAL
+/* Mutation journals. When the library is compiled with CONFIG_JOURNAL, a
+ * journal may be attached to a tree, after which every change made to it by
+ * bitree_insl(), bitree_insr(), bitree_ins_batch(), the removal functions,
+ * bitree_retain(), bitree_merge(), bitree_update() and the rotations is
+ * appended to it as a record. Each node is given an ID, which records refer
+ * to it by, and payloads are serialized into the records. Replaying the
+ * records onto a replica with bitree_journal_replay() makes the same changes
+ * to it, so keeping a replica up to date costs O(changes), not O(n).
+ *
+ * Each record is a header of two uint32_t (the kind of change, and the size
+ * of the payload that follows the header) and two uint64_t (node IDs), in the
+ * byte order of the machine which wrote it. Payloads which the keyed layers in
+ * bitree_avl.h and bitree_splay.h move between nodes are recorded as changes
+ * to both nodes, so those trees can be replicated too.
+ *
+ * Attach a journal to the tree containing `tree'. Records are passed to
+ * write(sink, record, size), which returns 0 on success, and -1 otherwise.
+ * serialize(data, buffer, size) writes `data' to `buffer' if it fits in
+ * `size' bytes, and returns the number of bytes it needs either way. The
+ * journal starts with records that build the tree as it is now, so that a
+ * replica can be built from scratch. Returns -1 if the tree already has a
+ * journal, or if the first records can't be written.
+ */
+extern int bitree_journal_attach(bitree * tree,
+				 int (*write)(void * sink, const void * record,
+					      size_t size),
+				 void * sink,
+				 size_t (*serialize)(const void * data,
+						     void * buffer,
+						     size_t size));
+
+/* Detach the journal from the tree containing `tree', and free it. The
+ * journal is also freed when the tree is destroyed. Returns -1 if any record
+ * could not be written since the journal was attached, and 0 otherwise. A tree
+ * whose journal has failed should be sent to its replicas in full again.
+ */
+extern int bitree_journal_detach(bitree * tree);
+
+/* Sinks for bitree_journal_attach(). bitree_journal_fd() writes to the file
+ * descriptor pointed to by `fd'. bitree_journal_ring() writes to a struct
+ * bitree_ring, and fails if the whole record doesn't fit; records are never
+ * split, so the reader may read them in any size of chunk.
+ */
+extern int bitree_journal_fd(void * fd, const void * record, size_t size);
+extern int bitree_journal_ring(void * ring, const void * record, size_t size);
+
+/* Set up `ring' to use the `capacity' bytes at `buffer', and read up to `size'
+ * bytes from it into `buffer'. bitree_ring_read() returns the number of bytes
+ * read.
+ */
+extern int bitree_ring_init(struct bitree_ring * ring, void * buffer,
+			    size_t capacity);
+extern size_t bitree_ring_read(struct bitree_ring * ring, void * buffer,
+			       size_t size);
+
+/* Apply the records in the `size' bytes at `records' to the replica at
+ * `*tree', which is NULL until the first record creates it. `*tree' is kept
+ * pointing at the root of the replica, and set to NULL if the replica is
+ * removed. deserialize(buffer, size) returns a new payload, or NULL, and
+ * `destroy' is the destroy function for the replica. A record which is cut off
+ * at the end of `records' is left for the next call, and `*used' is set to the
+ * number of bytes consumed. A replica must only be changed by this function.
+ * Returns 0 on success, and -1 if a record can't be applied, in which case
+ * `*used' is the offset of that record.
+ */
+extern int bitree_journal_replay(bitree ** tree, const void * records,
+				 size_t size,
+				 void * (*deserialize)(const void * buffer,
+						       size_t size),
+				 void (*destroy)(void *), size_t * used);
+#endif /* CONFIG_JOURNAL */
+
 #endif /* __ET_BITREE_H_ */
 
 /*****************************************************************************/
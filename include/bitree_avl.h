@@ -0,0 +1,61 @@
+/******************************************************************************
+ * NAME:	    bitree_avl.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the public interface for the ordered
+ *		    (AVL) layer in bitree_avl.c. The layer is built on the
+ *		    plain bitree struct, so any of the functions in bitree.h
+ *		    can be used on a keyed tree, so long as the positional
+ *		    insertion functions are not used to break the ordering.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_AVL_H_
+#define __ET_BITREE_AVL_H_
+
+#include "bitree.h"
+
+/******************************************************************************
+ * API FUNCTION PROTOTYPES
+ ***/
+
+/* All of these functions take a comparison function, which behaves like the
+ * one given to qsort(3): it returns a negative number, zero, or a positive
+ * number if the first key is less than, equal to, or greater than the second.
+ * The same function must be used for every call on a given tree.
+ *
+ * A keyed tree is created with bitree_create(), which supplies the first key.
+ * After that, walking the tree with bitree_ninorder(), starting at the
+ * leftmost node, visits the keys in sorted order.
+ *
+ * Rebalancing may exchange the payloads of two nodes, so a node pointer that
+ * was returned by bitree_avl_find() is only valid until the next call to
+ * bitree_avl_insert() or bitree_avl_erase() on the same tree.
+ */
+
+/* Insert `data' into the tree that contains `tree'. Duplicate keys are not
+ * allowed.
+ */
+extern int bitree_avl_insert(bitree * tree, void * data,
+			     int (*compare)(const void *, const void *));
+
+/* Find the node whose key compares equal to `key', searching the subtree
+ * rooted at `tree'.
+ */
+extern bitree * bitree_avl_find(bitree * tree, const void * key,
+				int (*compare)(const void *, const void *));
+
+/* Remove the node whose key compares equal to `key' from the tree at `*tree',
+ * calling the destroy function on its data. If this removes the last node in
+ * the tree, the tree is destroyed and `*tree' is set to NULL.
+ */
+extern int bitree_avl_erase(bitree ** tree, const void * key,
+			    int (*compare)(const void *, const void *));
+
+#endif /* __ET_BITREE_AVL_H_ */
+
+/*****************************************************************************/
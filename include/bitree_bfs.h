@@ -0,0 +1,55 @@
+/******************************************************************************
+ * NAME:	    bitree_bfs.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the public interface for the parallel
+ *		    breadth-first traversal in bitree_bfs.c. A tree is visited
+ *		    one level at a time: the nodes of a level are shared out
+ *		    between several threads, and every thread waits for the
+ *		    others to finish before any of them starts on the next.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_BFS_H_
+#define __ET_BITREE_BFS_H_
+
+#include <stddef.h>
+
+#include "bitree.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* Levels with fewer nodes than this per thread are given to fewer threads */
+#ifndef BITREE_BFS_GRAIN
+#   define BITREE_BFS_GRAIN	1024
+#endif
+
+/******************************************************************************
+ * API FUNCTION PROTOTYPES
+ ***/
+
+/* Visit the subtree rooted at `tree' level by level, with `threads' threads
+ * (0 for one per CPU), the calling thread among them. action(node, depth,
+ * ctx) is called on every node of a level, by several threads at once, and
+ * once it has returned for all of them, level(depth, nodes, size, ctx) is
+ * called by one thread with the `size' nodes of the level, from left to
+ * right. If it returns nonzero, the traversal stops there. Either function
+ * may be NULL. The depth of `tree' is 0. Unlike DEFINE_LEVELORDER_TRAVERSAL,
+ * each node is reached once, from the level above. Returns 1 if the
+ * traversal was stopped, 0 if it finished, and -1 on error.
+ */
+extern int bitree_bfs(bitree * tree, int threads,
+		      void (*action)(bitree * node, int depth, void * ctx),
+		      int (*level)(int depth, bitree ** nodes, size_t size,
+				   void * ctx),
+		      void * ctx);
+
+#endif /* __ET_BITREE_BFS_H_ */
+
+/*****************************************************************************/
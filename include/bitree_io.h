@@ -0,0 +1,95 @@
+/******************************************************************************
+ * NAME:	    bitree_io.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the public interface for saving trees
+ *		    to a file and loading them back, in bitree_io.c. A tree is
+ *		    saved as independent chunks, each holding a subtree, which
+ *		    are serialized in parallel and written while the next ones
+ *		    are being serialized. Loading builds the tree from each
+ *		    chunk as soon as it has been read, while the following
+ *		    chunks are still being read.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_IO_H_
+#define __ET_BITREE_IO_H_
+
+#include <stddef.h>
+
+#include "bitree.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* Flags for struct bitree_io_options */
+#define BITREE_IO_DIRECT	0x1 /* Bypass the page cache, with O_DIRECT */
+#define BITREE_IO_NO_URING	0x2 /* Use pwrite()/pread(), not io_uring */
+
+/* The defaults used for the fields of struct bitree_io_options which are 0 */
+#define BITREE_IO_CHUNK_NODES	65536
+#define BITREE_IO_DEPTH		16
+
+/* The alignment of chunks in the file, and of buffers for O_DIRECT */
+#define BITREE_IO_BLOCK		4096
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* Tuning for bitree_save() and bitree_load(). `threads' is the number of
+ * threads which serialize chunks (0 for one per CPU; loading doesn't use it),
+ * `chunk_nodes' the number of nodes a chunk holds, roughly (it is between
+ * that and twice that, except for the chunk holding the root), and `depth'
+ * the most reads or writes in flight at once. `flags' is a combination of
+ * the BITREE_IO_ flags above.
+ *
+ * io_uring is only used when the library is compiled with CONFIG_IO_URING on
+ * Linux, and the kernel allows it; otherwise, and with BITREE_IO_NO_URING,
+ * one thread calls pwrite() or pread() for each chunk in turn. The file is
+ * opened with O_DIRECT if BITREE_IO_DIRECT is given and the filesystem
+ * supports it. Chunks are padded to BITREE_IO_BLOCK bytes either way.
+ */
+struct bitree_io_options {
+  int threads;
+  size_t chunk_nodes;
+  int depth;
+  int flags;
+};
+
+/******************************************************************************
+ * API FUNCTION PROTOTYPES
+ ***/
+
+/* Save the subtree rooted at `tree' to the file at `path', which is created
+ * or truncated. Payloads are written with serialize(data, buffer, size), as
+ * in bitree_journal_attach(), which is called from several threads at once.
+ * The tree must not change until the function returns. `options' may be NULL
+ * for the defaults. The file is synced before returning, and only becomes
+ * loadable once everything else has been written. Returns 0 on success, and
+ * -1 otherwise.
+ */
+extern int bitree_save(bitree * tree, const char * path,
+		       size_t (*serialize)(const void * data, void * buffer,
+					   size_t size),
+		       const struct bitree_io_options * options);
+
+/* Load a tree saved by bitree_save(). deserialize(buffer, size) returns a new
+ * payload, or NULL, and `destroy' is the destroy function of the new tree.
+ * Files are read in the byte order of the machine which wrote them. Returns
+ * the root of the tree, or NULL on failure.
+ */
+extern bitree * bitree_load(const char * path,
+			    void * (*deserialize)(const void * buffer,
+						  size_t size),
+			    void (*destroy)(void *),
+			    const struct bitree_io_options * options);
+
+#endif /* __ET_BITREE_IO_H_ */
+
+/*****************************************************************************/
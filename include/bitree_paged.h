@@ -0,0 +1,140 @@
+/******************************************************************************
+ * NAME:	    bitree_paged.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the public interface for the paged
+ *		    trees in bitree_paged.c. A paged tree is stored in a file,
+ *		    in fixed-size pages of nodes, and only a bounded number of
+ *		    pages is held in memory at once, in a buffer pool. It suits
+ *		    trees which are larger than memory.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_PAGED_H_
+#define __ET_BITREE_PAGED_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitree.h"
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* A node, as the number of its slot in the file. 0 is never a node, and is
+ * used where a bitree would have a NULL pointer.
+ */
+typedef uint64_t bitree_pref;
+
+/* Counters for the buffer pool, since the tree was opened. A hit is a page
+ * which was found in the pool; a miss had to be read from the file, and a
+ * write is a page written back to it.
+ */
+struct bitree_paged_stats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t writes;
+};
+
+/* A paged tree, open in this process. */
+typedef struct bitree_paged bitree_paged;
+
+/******************************************************************************
+ * API FUNCTION PROTOTYPES
+ ***/
+
+/* Create (or truncate) the file at `path', holding an empty tree whose
+ * payloads are `payload_size' bytes each, in pages of `page_size' bytes. The
+ * buffer pool holds `frames' pages; that is all the memory the tree uses,
+ * apart from a table of one pointer per page of the file. Returns NULL on
+ * failure.
+ */
+extern bitree_paged * bitree_paged_create(const char * path, size_t page_size,
+					  size_t payload_size, size_t frames);
+
+/* Open a tree created by bitree_paged_create(), with a buffer pool of
+ * `frames' pages. Returns NULL on failure.
+ */
+extern bitree_paged * bitree_paged_open(const char * path, size_t frames);
+
+/* Write the pages which have changed, and the header, back to the file.
+ * bitree_paged_close() does the same, then frees everything and sets `*tree'
+ * to NULL. Both return 0 on success, and -1 if anything could not be written.
+ */
+extern int bitree_paged_flush(bitree_paged * tree);
+extern int bitree_paged_close(bitree_paged ** tree);
+
+/* Copy the subtree rooted at `tree' into `paged', which must be empty. Each
+ * payload is written to its slot with serialize(data, buffer, size), as in
+ * bitree_journal_attach(); it fails if the payload needs more than the
+ * payload size of `paged'. Returns 0 on success, and -1 otherwise.
+ */
+extern int bitree_paged_store(bitree_paged * paged, bitree * tree,
+			      size_t (*serialize)(const void * data,
+						  void * buffer, size_t size));
+
+/* Insert a node holding a copy of the payload at `data' to the left (right)
+ * of `node', which must not already have a left (right) child. If the tree is
+ * empty, `node' must be 0, and the new node becomes the root. A new node is
+ * put in the page of its parent if it has room, so that subtrees stay
+ * together; otherwise, in the page most recently started or freed from. If
+ * nodes are inserted in preorder, as bitree_paged_store() does, most of the
+ * steps of a traversal then stay within a page. Returns the new node, or 0 on
+ * failure.
+ */
+extern bitree_pref bitree_paged_insl(bitree_paged * tree, bitree_pref node,
+				     const void * data);
+extern bitree_pref bitree_paged_insr(bitree_paged * tree, bitree_pref node,
+				     const void * data);
+
+/* Remove the subtree rooted at `node'. Its slots are reused by later
+ * insertions. Returns 0 on success, and -1 otherwise.
+ */
+extern int bitree_paged_rem(bitree_paged * tree, bitree_pref node);
+
+/* Return the root of the tree (0 if it is empty), or its number of nodes.
+ */
+extern bitree_pref bitree_paged_root(bitree_paged * tree);
+extern uint64_t bitree_paged_size(bitree_paged * tree);
+
+/* Return the parent, left child or right child of `node', or 0 if it has
+ * none, or if its page could not be read.
+ */
+extern bitree_pref bitree_paged_parent(bitree_paged * tree, bitree_pref node);
+extern bitree_pref bitree_paged_left(bitree_paged * tree, bitree_pref node);
+extern bitree_pref bitree_paged_right(bitree_paged * tree, bitree_pref node);
+
+/* Pin the page of `node' in the pool, and return a pointer to its payload,
+ * or NULL on failure. The pointer is valid until the matching call to
+ * bitree_paged_unpin(), which must be passed a nonzero `dirty' if the payload
+ * was modified. A page is never evicted while it is pinned, so a caller can't
+ * pin more nodes from different pages than there are frames in the pool.
+ */
+extern void * bitree_paged_pin(bitree_paged * tree, bitree_pref node);
+extern void bitree_paged_unpin(bitree_paged * tree, bitree_pref node,
+			       int dirty);
+
+/* Visit the subtree rooted at `node' in the order given, with the same
+ * visitor protocol as bitree_walk(). Returns 1 if the walk was stopped, 0 if
+ * it finished, and -1 on error, including a page which could not be read.
+ */
+extern int bitree_paged_walk(bitree_paged * tree, bitree_pref node,
+			     enum bitree_order order,
+			     enum bitree_visit (*visit)(bitree_paged * tree,
+							bitree_pref node,
+							void * ctx),
+			     void * ctx);
+
+/* Copy the counters of the buffer pool into `stats'.
+ */
+extern void bitree_paged_stats(bitree_paged * tree,
+			       struct bitree_paged_stats * stats);
+
+#endif /* __ET_BITREE_PAGED_H_ */
+
+/*****************************************************************************/
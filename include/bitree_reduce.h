@@ -0,0 +1,84 @@
+/******************************************************************************
+ * NAME:	    bitree_reduce.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the public interface for the numeric
+ *		    reductions in bitree_reduce.c. The payloads of a tree are
+ *		    gathered into a contiguous array of doubles, which kernels
+ *		    for the sum, minimum, maximum and a range count then reduce
+ *		    with the widest vector instructions the CPU has. A fused
+ *		    reduction does both a block at a time, without the array.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_REDUCE_H_
+#define __ET_BITREE_REDUCE_H_
+
+#include <stddef.h>
+
+#include "bitree.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* The number of payloads bitree_reduce() gathers before reducing them */
+#define BITREE_REDUCE_BLOCK	512
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* The result of bitree_reduce(): the number of nodes, the sum, minimum and
+ * maximum of their values, and how many of the values are in [lo, hi).
+ */
+struct bitree_reduction {
+  size_t count;
+  double sum;
+  double min;
+  double max;
+  size_t in_range;
+};
+
+/******************************************************************************
+ * API FUNCTION PROTOTYPES
+ ***/
+
+/* Store extractor(data) for each node of the subtree rooted at `tree' in
+ * `out_values', in the order given. `out_values' must have room for every
+ * node of the subtree; bitree_size(tree) is always enough. Returns the number
+ * of values stored, or 0 on error.
+ */
+extern size_t bitree_flatten(bitree * tree, enum bitree_order order,
+			     double * out_values,
+			     double (*extractor)(const void * data));
+
+/* Reduce the `n' doubles at `values'. The minimum of no values is INFINITY,
+ * and the maximum -INFINITY; NaNs are skipped by both. The sum is NaN if any
+ * value is. bitree_reduce_count_if() counts the values v with lo <= v < hi.
+ * On x86-64, each is built for AVX-512, AVX2 and the baseline, and the one
+ * the CPU supports is picked when the program is loaded.
+ */
+extern double bitree_reduce_sum(const double * values, size_t n);
+extern double bitree_reduce_min(const double * values, size_t n);
+extern double bitree_reduce_max(const double * values, size_t n);
+extern size_t bitree_reduce_count_if(const double * values, size_t n,
+				     double lo, double hi);
+
+/* Compute all of the reductions above over extractor(data) for each node of
+ * the subtree rooted at `tree', in the order given, gathering the values
+ * BITREE_REDUCE_BLOCK at a time on the stack rather than into an array of
+ * the whole tree. Returns 0 on success, and -1 on error.
+ */
+extern int bitree_reduce(bitree * tree, enum bitree_order order,
+			 double (*extractor)(const void * data),
+			 double lo, double hi,
+			 struct bitree_reduction * result);
+
+#endif /* __ET_BITREE_REDUCE_H_ */
+
+/*****************************************************************************/
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * NAME:	    bitree_shm.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the public interface for the shared
+ *		    memory trees in bitree_shm.c. A shared tree lives in a
+ *		    region of shared memory, and its nodes refer to each other
+ *		    by their offsets into the region instead of by address, so
+ *		    any number of processes can map the region wherever they
+ *		    like and read the tree in place. One writer changes it,
+ *		    and readers detect its changes with a sequence lock.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_SHM_H_
+#define __ET_BITREE_SHM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitree.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+#define bitree_shm_fd(shm)	((shm)->fd)
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* The offset of a node from the start of the region. 0 is never a node, and
+ * is used where a bitree would have a NULL pointer.
+ */
+typedef uint64_t bitree_shm_ref;
+
+/* A node, as stored in the region. The payload is stored in the node itself,
+ * as the bytes written by the serialize function it was stored with.
+ */
+struct bitree_snode {
+  bitree_shm_ref parent;
+  bitree_shm_ref left;
+  bitree_shm_ref right;
+  uint64_t size;
+  unsigned char data[];
+};
+
+/* A process's handle to a region. Only the handle returned by
+ * bitree_shm_create() may change the tree; the others map it read-only.
+ */
+typedef struct bitree_shm {
+  unsigned char * base;
+  size_t capacity;
+  int fd;
+  int writable;
+} bitree_shm;
+
+/******************************************************************************
+ * API FUNCTION PROTOTYPES
+ ***/
+
+/* Create a region of `capacity' bytes holding an empty tree, and map it for
+ * writing. If `name' is NULL, the region is anonymous, and is shared by
+ * passing its file descriptor (bitree_shm_fd()) to the readers, e.g. across
+ * fork() or over a UNIX socket. Otherwise, it is created with shm_open(),
+ * and the caller should shm_unlink() it once the readers have opened it.
+ * Returns NULL on failure, or if a region called `name' already exists.
+ */
+extern bitree_shm * bitree_shm_create(const char * name, size_t capacity);
+
+/* Map the region called `name' (bitree_shm_open()), or the region behind the
+ * file descriptor `fd' (bitree_shm_map()), for reading. bitree_shm_map()
+ * duplicates `fd', so the caller may close its own copy. Returns NULL on
+ * failure, or if the region does not hold a shared tree.
+ */
+extern bitree_shm * bitree_shm_open(const char * name);
+extern bitree_shm * bitree_shm_map(int fd);
+
+/* Unmap the region, free the handle, and set `*shm' to NULL. The region
+ * itself lasts until every process has closed it (and, for a named region,
+ * until it is unlinked).
+ */
+extern void bitree_shm_close(bitree_shm ** shm);
+
+/* The writer's functions. Each one appears atomic to the readers. They fail
+ * with errno set to ENOSPC when the region is full, EPERM when called
+ * through a read-only handle, and EINVAL when given a node which is not in
+ * the tree, such as one already removed. Only one thread in one process may
+ * call them at a time.
+ *
+ * Replace the tree in the region with a copy of the subtree rooted at `tree'
+ * (or with an empty tree, if `tree' is NULL). Payloads are copied with
+ * serialize(data, buffer, size), as in bitree_journal_attach(): it writes
+ * `data' to `buffer' if it fits in `size' bytes, and returns the number of
+ * bytes it needs either way. The region is compacted as a side effect. If
+ * the copy fails, the region is left holding an empty tree. Returns 0 on
+ * success, and -1 otherwise.
+ */
+extern int bitree_shm_store(bitree_shm * shm, bitree * tree,
+			    size_t (*serialize)(const void * data,
+						void * buffer, size_t size));
+
+/* Insert a node holding a copy of the `size' bytes at `data' to the left
+ * (right) of `node', which must not already have a left (right) child. If the
+ * tree is empty, `node' must be 0, and the new node becomes the root. Returns
+ * the new node, or 0 on failure.
+ */
+extern bitree_shm_ref bitree_shm_insl(bitree_shm * shm, bitree_shm_ref node,
+				      const void * data, size_t size);
+extern bitree_shm_ref bitree_shm_insr(bitree_shm * shm, bitree_shm_ref node,
+				      const void * data, size_t size);
+
+/* Remove the subtree rooted at `node'. Its space is reused by later
+ * insertions. Returns 0 on success, and -1 otherwise.
+ */
+extern int bitree_shm_rem(bitree_shm * shm, bitree_shm_ref node);
+
+/* The readers' functions. A reader brackets what it reads between
+ * bitree_shm_read_begin() and bitree_shm_read_retry(); if the latter returns
+ * nonzero, the writer changed the tree in the meantime, and everything read
+ * since bitree_shm_read_begin() must be discarded and read again. Readers
+ * never block the writer, and never write to the region.
+ *
+ * Example of usage:
+ *
+ * unsigned seq;
+ * do {
+ *   seq = bitree_shm_read_begin(shm);
+ *   sum = 0;
+ *   for (bitree_shm_ref node = bitree_shm_root(shm); node != 0;
+ *        node = bitree_shm_left(shm, node))
+ *     sum += *(const int *)bitree_shm_data(shm, node, NULL);
+ * } while (bitree_shm_read_retry(shm, seq));
+ */
+extern unsigned bitree_shm_read_begin(bitree_shm * shm);
+extern int bitree_shm_read_retry(bitree_shm * shm, unsigned seq);
+
+/* Return the root of the tree (0 if it is empty), or its number of nodes.
+ */
+extern bitree_shm_ref bitree_shm_root(bitree_shm * shm);
+extern int bitree_shm_size(bitree_shm * shm);
+
+/* Return the parent, left child or right child of `node', or 0 if it has
+ * none. These functions also return 0 if `node' is not a valid offset, which
+ * a reader racing with the writer may come across, so they never read outside
+ * the region.
+ */
+extern bitree_shm_ref bitree_shm_parent(bitree_shm * shm, bitree_shm_ref node);
+extern bitree_shm_ref bitree_shm_left(bitree_shm * shm, bitree_shm_ref node);
+extern bitree_shm_ref bitree_shm_right(bitree_shm * shm, bitree_shm_ref node);
+
+/* Return a pointer to the payload of `node', in the region (so it is only
+ * valid until the region is closed), and set `*size' to its size, if `size'
+ * is not NULL. Returns NULL if `node' is not a valid offset.
+ */
+extern const void * bitree_shm_data(bitree_shm * shm, bitree_shm_ref node,
+				    size_t * size);
+
+/* Visit the subtree rooted at `node' in the order given, with the same
+ * visitor protocol as bitree_walk(). The walk is a read section of its own:
+ * it returns 1 if it was stopped, 0 if it finished, and -1 on error. If the
+ * writer changed the tree during the walk, it returns -1 with errno set to
+ * EAGAIN as soon as it notices, and the caller should retry it.
+ */
+extern int bitree_shm_walk(bitree_shm * shm, bitree_shm_ref node,
+			   enum bitree_order order,
+			   enum bitree_visit (*visit)(bitree_shm * shm,
+						      bitree_shm_ref node,
+						      void * ctx),
+			   void * ctx);
+
+#endif /* __ET_BITREE_SHM_H_ */
+
+/*****************************************************************************/
@@ -0,0 +1,64 @@
+/******************************************************************************
+ * NAME:	    bitree_splay.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the public interface for the splay mode
+ *		    of keyed trees in bitree_splay.c. A splay tree keeps its
+ *		    keys in the same in-order sequence as the ordered layer in
+ *		    bitree_avl.h, but instead of staying balanced, an access
+ *		    which has to go much deeper than a balanced tree would
+ *		    semi-splays the key it touched towards the root. Keys which
+ *		    are accessed often stay near the top of the tree, and
+ *		    shallow accesses don't change it at all.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_SPLAY_H_
+#define __ET_BITREE_SPLAY_H_
+
+#include "bitree.h"
+
+/******************************************************************************
+ * API FUNCTION PROTOTYPES
+ ***/
+
+/* The comparison functions have the same meaning as those in bitree_avl.h.
+ * Splaying never rotates the root node, so a payload stays in the same node
+ * while it is looked up or inserted, and the node pointers returned remain
+ * valid until the key is erased. As in bitree_avl_erase(), erasing a key may
+ * move the payloads of its neighbours between nodes.
+ */
+
+/* Semi-splay `node' towards the root of its tree, stopping below the root
+ * node, and return `node'. Each zig-zig step only moves it up one level, so
+ * a deep node reaches the top over several accesses.
+ */
+extern bitree * bitree_splay(bitree * node);
+
+/* Search the tree containing `tree' for `key', and return the node holding it,
+ * or NULL. If the search went deeper than one and a half times log2 of the
+ * size of the tree, the last node visited is splayed.
+ */
+extern bitree * bitree_splay_find(bitree * tree, const void * key,
+				  int (*compare)(const void *, const void *));
+
+/* Insert `data' into the tree containing `tree', and splay it if it was
+ * inserted too deep, as above. Duplicate keys are not allowed.
+ */
+extern int bitree_splay_insert(bitree * tree, void * data,
+			       int (*compare)(const void *, const void *));
+
+/* Remove `key' from the tree at `*tree', calling the destroy function on its
+ * data, and splay its parent if it is too deep. If this removes the last node
+ * in the tree, the tree is destroyed and `*tree' is set to NULL.
+ */
+extern int bitree_splay_erase(bitree ** tree, const void * key,
+			      int (*compare)(const void *, const void *));
+
+#endif /* __ET_BITREE_SPLAY_H_ */
+
+/*****************************************************************************/
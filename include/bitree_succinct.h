@@ -0,0 +1,121 @@
+/******************************************************************************
+ * NAME:	    bitree_succinct.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the public interface for the succinct
+ *		    trees in bitree_succinct.c. A succinct tree is a read-only
+ *		    copy of a bitree, frozen into a bitmap of about two bits
+ *		    per node which encodes its shape, and a dense array of
+ *		    payloads. It can be navigated in (nearly) constant time
+ *		    per step, with no pointers at all.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_SUCCINCT_H_
+#define __ET_BITREE_SUCCINCT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitree.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+#define bitree_succinct_size(tree)	((tree)->size)
+#define bitree_succinct_height(tree)	((tree)->height)
+#define bitree_succinct_root(tree)	((tree)->size > 0 ? 1 : 0)
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* A node, as its position in a level order traversal of the tree, starting
+ * at 1 for the root. 0 is never a node, and is used where a bitree would have
+ * a NULL pointer.
+ */
+typedef uint64_t bitree_sref;
+
+/* A frozen tree. `bits' holds the shape: bit 0 is set for the root, and node
+ * k has bits 2k - 1 and 2k, which are set if it has a left or right child,
+ * respectively. `ranks' and `samples' are the directories which answer rank
+ * and select queries on it. Node k's payload is the `payload_size' bytes at
+ * `data' + (k - 1) * `payload_size'.
+ */
+typedef struct bitree_succinct {
+  uint64_t * bits;
+  size_t nbits;
+  uint64_t * ranks;
+  uint64_t * samples;
+  size_t size;
+  int height;
+  size_t payload_size;
+  unsigned char * data;
+} bitree_succinct;
+
+/******************************************************************************
+ * API FUNCTION PROTOTYPES
+ ***/
+
+/* Freeze a copy of the subtree rooted at `tree'. Each payload is written to
+ * the payload array with serialize(data, buffer, size), as in
+ * bitree_journal_attach(); it fails if the payload needs more than
+ * `payload_size' bytes. If `payload_size' is 0, serialize may be NULL, and
+ * only the shape is kept. `tree' may be changed or destroyed afterwards.
+ * Returns NULL on failure.
+ */
+extern bitree_succinct * bitree_freeze_succinct(bitree * tree,
+						size_t payload_size,
+						size_t (*serialize)
+						(const void * data,
+						 void * buffer, size_t size));
+
+/* Free the tree, and set `*tree' to NULL.
+ */
+extern void bitree_succinct_destroy(bitree_succinct ** tree);
+
+/* Return the parent, left child or right child of `node', or 0 if it has
+ * none, or if `node' is not a node of the tree.
+ */
+extern bitree_sref bitree_succinct_parent(const bitree_succinct * tree,
+					  bitree_sref node);
+extern bitree_sref bitree_succinct_left(const bitree_succinct * tree,
+					bitree_sref node);
+extern bitree_sref bitree_succinct_right(const bitree_succinct * tree,
+					 bitree_sref node);
+
+/* Return a pointer to the payload of `node', or NULL if `node' is not a node
+ * of the tree, or the tree has no payloads.
+ */
+extern const void * bitree_succinct_data(const bitree_succinct * tree,
+					 bitree_sref node);
+
+/* Return the distance of `node' from the root, or -1 if it is not a node of
+ * the tree.
+ */
+extern int bitree_succinct_depth(const bitree_succinct * tree,
+				 bitree_sref node);
+
+/* Return the number of bytes of memory used by the tree, payloads included.
+ */
+extern size_t bitree_succinct_bytes(const bitree_succinct * tree);
+
+/* Visit the subtree rooted at `node' in the order given, with the same
+ * visitor protocol as bitree_walk(). Returns 1 if the walk was stopped, 0 if
+ * it finished, and -1 on error.
+ */
+extern int bitree_succinct_walk(const bitree_succinct * tree, bitree_sref node,
+				enum bitree_order order,
+				enum bitree_visit (*visit)
+				(const bitree_succinct * tree,
+				 bitree_sref node, void * ctx),
+				void * ctx);
+
+#endif /* __ET_BITREE_SUCCINCT_H_ */
+
+/*****************************************************************************/
@@ -0,0 +1,163 @@
+/******************************************************************************
+ * NAME:	    bitree_version.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the public interface for the persistent
+ *		    (copy-on-write) trees in bitree_version.c. A version is an
+ *		    immutable binary tree. Modifying it returns a new version,
+ *		    which copies only the nodes on the path from the root to
+ *		    the change and shares every other node with the old one.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_VERSION_H_
+#define __ET_BITREE_VERSION_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+#define bitree_version_root(version)	((version)->root)
+#define bitree_version_size(version)	((version)->size)
+#define bitree_pnode_left(node)		((node)->left)
+#define bitree_pnode_right(node)	((node)->right)
+#define bitree_pnode_count(node)	((node)->count)
+#define bitree_pnode_data(node)		((node)->payload->data)
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* A payload may be shared by nodes in many versions. The destroy function is
+ * called on it when the last of them is released.
+ */
+struct bitree_payload {
+  atomic_int refs;
+  void * data;
+};
+
+/* Since a node may belong to any number of versions, it has no `parent',
+ * `root' or `size' like the nodes of a bitree. A node is never modified after
+ * it is created, except for its reference count, so any thread may read a
+ * version it holds while other threads derive new versions from it.
+ */
+struct bitree_pnode {
+  atomic_int refs;
+  struct bitree_pnode * left;
+  struct bitree_pnode * right;
+  struct bitree_payload * payload;
+
+  /* Number of nodes in the subtree rooted at this node. */
+  int count;
+
+  /* Used by the intern table, for interned versions. */
+  size_t hash;
+  struct bitree_pnode * next;
+};
+
+/* The table through which the versions of an interned tree share nodes. It is
+ * freed when the last of them is released.
+ */
+struct bitree_intern;
+
+/* A handle to one version of a tree. `root' is NULL if the version is empty.
+ */
+typedef struct bitree_version {
+  atomic_int refs;
+  struct bitree_pnode * root;
+  int size;
+  void (*destroy)(void *);
+  struct bitree_intern * intern;
+} bitree_version;
+
+/******************************************************************************
+ * API FUNCTION PROTOTYPES
+ ***/
+
+/* Nodes are addressed by their path from the root: a string of 'l' and 'r'
+ * characters, one for each step down the tree. The empty string (or NULL) is
+ * the root. None of these functions modify the version they are passed, and
+ * the versions they return must be released with bitree_version_release().
+ * They return NULL on failure, in which case the caller still owns `data'.
+ */
+
+/* Create a version with a single node, holding `data'.
+ */
+extern bitree_version * bitree_version_create(void (*destroy)(void *),
+					      void * data);
+
+/* Return a version in which the node at `path' has a new left (right) child
+ * holding `data'. The child must be empty.
+ */
+extern bitree_version * bitree_version_insl(bitree_version * version,
+					    const char * path, void * data);
+extern bitree_version * bitree_version_insr(bitree_version * version,
+					    const char * path, void * data);
+
+/* Return a version without the subtree at `path'. Removing the root returns an
+ * empty version. The payloads are not destroyed until every version that
+ * contains them has been released.
+ */
+extern bitree_version * bitree_version_rem(bitree_version * version,
+					   const char * path);
+
+/* Return a version in which `version2' is attached to the node at `path' in
+ * `version1'. As in bitree_merge(), if `path' is the root and it has two
+ * children, a new root holding `data' is created, with the two trees as its
+ * left and right children. Otherwise, the tree is attached to the first empty
+ * child of the node at `path'. Both versions must use the same destroy
+ * function, and the same intern table, if any. Since nothing is copied, this
+ * is O(d), d is the length of `path'.
+ */
+extern bitree_version * bitree_version_merge(bitree_version * version1,
+					     const char * path,
+					     bitree_version * version2,
+					     void * data);
+
+/* Return a version equal to `version' in which identical subtrees are stored
+ * once (hash-consing). Two subtrees are identical if their payloads compare
+ * equal with `equal' and their children are identical. `hash' must return the
+ * same value for payloads that compare equal. Every version derived from the
+ * result is interned in the same table: an operation that would create a
+ * node identical to an existing one shares it instead, and in that case, the
+ * `data' passed to it is destroyed once the operation has succeeded. The
+ * table is locked while `equal' is called, so neither function may call any
+ * of the functions in this file.
+ *
+ * Reads are unaffected, except that two paths may lead to the same node.
+ */
+extern bitree_version * bitree_version_intern(bitree_version * version,
+					      size_t (*hash)(const void *),
+					      int (*equal)(const void *,
+							   const void *));
+
+/* Return the number of distinct nodes in the intern table of `version', which
+ * is shared by every version derived from the same call to
+ * bitree_version_intern(), or 0 if `version' is not interned.
+ */
+extern size_t bitree_version_interned(bitree_version * version);
+
+/* Return the node at `path', or NULL if there is none.
+ */
+extern struct bitree_pnode * bitree_version_find(bitree_version * version,
+						 const char * path);
+
+/* Take another reference to `version', e.g. for a reader on another thread.
+ */
+extern bitree_version * bitree_version_retain(bitree_version * version);
+
+/* Drop a reference to `*version', and set it to NULL. The nodes which are not
+ * shared with any other version are freed.
+ */
+extern void bitree_version_release(bitree_version ** version);
+
+#endif /* __ET_BITREE_VERSION_H_ */
+
+/*****************************************************************************/
@@ -0,0 +1,1323 @@
+/******************************************************************************
+ * NAME:	    bench.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains benchmarks for the library. They are
+ *		    built with `make bench', and print their results to STDOUT.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bitree.h"
+#include "bitree_avl.h"
+#include "bitree_bfs.h"
+#include "bitree_io.h"
+#include "bitree_paged.h"
+#include "bitree_reduce.h"
+#include "bitree_splay.h"
+#include "bitree_succinct.h"
+#include "bitree_version.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+#define KEYS		(1 << 16)
+#define LOOKUPS		(1 << 21)
+#define ZIPF_EXPONENT	0.99
+
+/* The interning benchmark uses a complete tree of this depth, with payloads
+ * drawn from a small alphabet, as a stand-in for generated trees.
+ */
+#define INTERN_DEPTH	16
+#define INTERN_SYMBOLS	2
+
+/* The paged benchmark keeps the pool at PAGED_FRAMES pages, and grows the
+ * tree from half the size of the pool to PAGED_SCALE times its size.
+ */
+#define PAGED_PAGE	4096
+#define PAGED_PAYLOAD	64
+#define PAGED_FRAMES	256
+#define PAGED_SCALE	32
+#define PAGED_DESCENTS	(1 << 18)
+
+/* The succinct benchmark freezes a random tree of SUCCINCT_NODES integers */
+#define SUCCINCT_NODES		(1 << 20)
+#define SUCCINCT_DESCENTS	(1 << 20)
+
+/* The save/load benchmark uses a random tree of IO_NODES payloads of IO_PAYLOAD
+ * bytes each.
+ */
+#define IO_NODES	(1 << 20)
+#define IO_PAYLOAD	60
+
+/* The cursor benchmark walks a random tree of CURSOR_NODES integers in order,
+ * fetching CURSOR_BATCH nodes at a time from bitree_next_batch().
+ */
+#define CURSOR_NODES	(1 << 20)
+#define CURSOR_BATCH	64
+
+/* The reduction benchmark flattens a random tree of REDUCE_NODES integers,
+ * and reduces the array REDUCE_PASSES times.
+ */
+#define REDUCE_NODES	(1 << 20)
+#define REDUCE_PASSES	16
+
+/* The interleaving benchmark grows FOREST_TREES random trees of FOREST_NODES
+ * integers together, so that the nodes of each are spread over the heap, and
+ * runs FOREST_ROUNDS random descents of each.
+ */
+#define FOREST_TREES	8192
+#define FOREST_NODES	127
+#define FOREST_ROUNDS	8
+
+/* The breadth-first benchmark visits a random tree of BFS_NODES integers */
+#define BFS_NODES	(1 << 18)
+
+/* Visits every node of a tree in level order, by descending from the root
+ * once per level.
+ */
+DEFINE_LEVELORDER_TRAVERSAL(levelorder_touch, {*(int *)node->data += 1;});
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static void bench_splay(void);
+static void bench_intern(void);
+static void bench_paged(void);
+static int paged_build(bitree_paged * tree, bitree_pref parent, int right,
+		       uint64_t index, uint64_t size);
+static enum bitree_visit paged_touch(bitree_paged * tree, bitree_pref node,
+				     void * sum);
+static void bench_succinct(void);
+static enum bitree_visit pointer_touch(bitree * node, void * sum);
+static enum bitree_visit succinct_touch(const bitree_succinct * tree,
+					bitree_sref node, void * sum);
+static size_t serialize_int(const void * data, void * buffer, size_t size);
+static void bench_io(void);
+static void bench_cursor(void);
+static void bench_reduce(void);
+static void bench_interleave(void);
+static int steer_random(const void * data, void * ctx);
+static void bench_bfs(void);
+static enum bitree_visit level_touch(bitree * node, void * ctx);
+static void bfs_touch(bitree * node, int depth, void * ctx);
+static double int_value(const void * data);
+static size_t serialize_padded(const void * data, void * buffer,
+			       size_t size);
+static void * deserialize_padded(const void * buffer, size_t size);
+static bitree * random_tree(int * values, int size);
+static int random_forest(bitree ** trees, int count, int * values, int size);
+static double lookup_ns(bitree ** trees, int avl, const int * keys,
+			const int * sequence);
+
+static uint64_t next_random(void);
+static void shuffle(int * array, int size);
+static int compare_int(const void * one, const void * two);
+static size_t hash_int(const void * data);
+static int equal_int(const void * one, const void * two);
+static double elapsed_ns(const struct timespec * start);
+
+/******************************************************************************
+ * STATIC VARIABLES
+ ***/
+
+static uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+
+/******************************************************************************
+ * MAIN
+ ***/
+
+int main(int argc, char * argv[])
+{
+  bench_splay();
+  bench_intern();
+  bench_paged();
+  bench_succinct();
+  bench_io();
+  bench_cursor();
+  bench_reduce();
+  bench_interleave();
+  bench_bfs();
+  return 0;
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bench_splay
+ *
+ * DESCRIPTION:	    Compares lookups in a splay tree against lookups in a
+ *		    balanced (AVL) tree holding the same keys, when the keys
+ *		    are drawn from a Zipfian distribution, and again when they
+ *		    are drawn uniformly.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void bench_splay(void)
+{
+  int * keys = malloc(KEYS * sizeof(int));
+  int * rank = malloc(KEYS * sizeof(int));
+  int * zipf = malloc(LOOKUPS * sizeof(int));
+  int * uniform = malloc(LOOKUPS * sizeof(int));
+  double * cdf = malloc(KEYS * sizeof(double));
+  if (keys == NULL || rank == NULL || zipf == NULL || uniform == NULL
+      || cdf == NULL)
+    goto exit;
+
+  /* Key i has popularity rank rank[i], so the hot keys are scattered
+   * throughout the key space rather than clustered at one end of it.
+   */
+  for (int i = 0; i < KEYS; i++)
+    keys[i] = rank[i] = i;
+  shuffle(keys, KEYS);
+  shuffle(rank, KEYS);
+
+  double total = 0;
+  for (int i = 0; i < KEYS; i++)
+    cdf[i] = (total += 1.0 / pow(i + 1, ZIPF_EXPONENT));
+  for (int i = 0; i < LOOKUPS; i++) {
+    double draw = (next_random() >> 11) * 0x1.0p-53 * total;
+    int low = 0, high = KEYS - 1;
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (cdf[middle] < draw)
+	low = middle + 1;
+      else
+	high = middle;
+    }
+    zipf[i] = rank[low];
+    uniform[i] = next_random() % KEYS;
+  }
+
+  bitree * trees[2] = {
+    bitree_create(NULL, &keys[0]),
+    bitree_create(NULL, &keys[0])
+  };
+  if (trees[0] == NULL || trees[1] == NULL)
+    goto exit_trees;
+  for (int i = 1; i < KEYS; i++) {
+    if (bitree_avl_insert(trees[0], &keys[i], compare_int)
+	|| bitree_splay_insert(trees[1], &keys[i], compare_int))
+      goto exit_trees;
+  }
+
+  /* Timed one after the other, rather than as arguments to printf(), whose
+   * order of evaluation is unspecified.
+   */
+  double times[4];
+  times[0] = lookup_ns(trees, 1, keys, zipf);
+  times[1] = lookup_ns(trees, 0, keys, zipf);
+  times[2] = lookup_ns(trees, 1, keys, uniform);
+  times[3] = lookup_ns(trees, 0, keys, uniform);
+
+  printf("Keyed lookups (%d keys, %d lookups):\n", KEYS, LOOKUPS);
+  printf("  %-24s %10s %10s\n", "distribution", "avl", "splay");
+  printf("  zipf (s = %.2f)%9s %7.1f ns %7.1f ns\n", ZIPF_EXPONENT, "",
+	 times[0], times[1]);
+  printf("  %-24s %7.1f ns %7.1f ns\n", "uniform", times[2], times[3]);
+
+ exit_trees:
+  bitree_destroy(&trees[0]);
+  bitree_destroy(&trees[1]);
+ exit:
+  free(keys);
+  free(rank);
+  free(zipf);
+  free(uniform);
+  free(cdf);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bench_intern
+ *
+ * DESCRIPTION:	    Builds a persistent tree with many identical subtrees, and
+ *		    compares the number of nodes it uses before and after it
+ *		    is interned.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void bench_intern(void)
+{
+  int nodes = (1 << INTERN_DEPTH) - 1;
+  int * symbols = malloc(nodes * sizeof(int));
+  bitree_version * plain = NULL, * interned = NULL;
+  if (symbols == NULL)
+    goto exit;
+  for (int i = 0; i < nodes; i++)
+    symbols[i] = next_random() % INTERN_SYMBOLS;
+
+  /* Node i (counting from 1, in level order) is reached by following the
+   * bits of i after the leading one: 0 for left, 1 for right.
+   */
+  if ((plain = bitree_version_create(NULL, &symbols[0])) == NULL)
+    goto exit;
+  for (int i = 2; i <= nodes; i++) {
+    char path[INTERN_DEPTH + 1];
+    int depth = 0;
+    for (int bit = 30 - __builtin_clz(i); bit > 0; bit--)
+      path[depth++] = (i >> bit) & 1 ? 'r' : 'l';
+    path[depth] = '\0';
+
+    bitree_version * next = i & 1
+      ? bitree_version_insr(plain, path, &symbols[i - 1])
+      : bitree_version_insl(plain, path, &symbols[i - 1]);
+    bitree_version_release(&plain);
+    if ((plain = next) == NULL)
+      goto exit;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  interned = bitree_version_intern(plain, hash_int, equal_int);
+  double ns = elapsed_ns(&start);
+  if (interned == NULL)
+    goto exit;
+
+  size_t distinct = bitree_version_interned(interned);
+  printf("Interning (depth %d, %d symbols):\n", INTERN_DEPTH, INTERN_SYMBOLS);
+  printf("  %-24s %10d nodes %8zu KiB\n", "plain", nodes,
+	 nodes * sizeof(struct bitree_pnode) / 1024);
+  printf("  %-24s %10zu nodes %8zu KiB (%.1f%% fewer, %.1f ms)\n",
+	 "interned", distinct, distinct * sizeof(struct bitree_pnode) / 1024,
+	 100.0 * (nodes - distinct) / nodes, ns / 1e6);
+
+ exit:
+  bitree_version_release(&plain);
+  bitree_version_release(&interned);
+  free(symbols);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bench_paged
+ *
+ * DESCRIPTION:	    Measures random root-to-leaf descents, and full preorder
+ *		    walks, of paged trees which grow from half the size of the
+ *		    buffer pool to many times its size, and reports the hit
+ *		    rate of the pool along with the throughput.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    The file stays in the page cache of the OS, so a miss costs
+ *		    a copy from the kernel rather than a disk read; the hit
+ *		    rate is the figure that carries over to larger trees.
+ ***/
+static void bench_paged(void)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/bitree-bench-%ld.pages", (long)getpid());
+
+  /* A slot holds three links and the payload */
+  uint64_t slots = (PAGED_PAGE - 16) / (3 * sizeof(bitree_pref) + PAGED_PAYLOAD);
+  printf("Paged trees (%d KiB pool, %d-byte payloads, %d descents):\n",
+	 PAGED_FRAMES * PAGED_PAGE / 1024, PAGED_PAYLOAD, PAGED_DESCENTS);
+  printf("  %-10s %9s %10s %12s %10s %12s\n", "nodes", "x pool", "hit rate",
+	 "descent", "hit rate", "walk");
+
+  for (int half = 1; half <= 2 * PAGED_SCALE; half *= 2) {
+    uint64_t size = half * PAGED_FRAMES * slots / 2;
+    bitree_paged * tree = bitree_paged_create(path, PAGED_PAGE, PAGED_PAYLOAD,
+					      PAGED_FRAMES);
+    if (tree == NULL || paged_build(tree, 0, 0, 0, size))
+      goto exit;
+
+    struct bitree_paged_stats before, after;
+    struct timespec start;
+    uint64_t sum = 0;
+    bitree_paged_stats(tree, &before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < PAGED_DESCENTS; i++) {
+      uint64_t bits = next_random();
+      for (bitree_pref node = bitree_paged_root(tree); node != 0;
+	   bits >>= 1) {
+	paged_touch(tree, node, &sum);
+	node = bits & 1 ? bitree_paged_right(tree, node)
+	  : bitree_paged_left(tree, node);
+      }
+    }
+    double descent = elapsed_ns(&start) / PAGED_DESCENTS;
+    bitree_paged_stats(tree, &after);
+    double descent_hits = (double)(after.hits - before.hits)
+      / (after.hits - before.hits + after.misses - before.misses);
+
+    before = after;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (bitree_paged_walk(tree, bitree_paged_root(tree), BITREE_PREORDER,
+			  paged_touch, &sum))
+      goto exit;
+    double walk = elapsed_ns(&start) / size;
+    bitree_paged_stats(tree, &after);
+    double walk_hits = (double)(after.hits - before.hits)
+      / (after.hits - before.hits + after.misses - before.misses);
+
+    printf("  %-10lu %8.1fx %9.1f%% %9.1f ns %9.1f%% %7.1f ns/n\n",
+	   (unsigned long)size, half / 2.0, 100 * descent_hits, descent,
+	   100 * walk_hits, walk);
+  exit:
+    bitree_paged_close(&tree);
+    unlink(path);
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    bench_succinct
+ *
+ * DESCRIPTION:	    Compares the memory used by a random tree of integers
+ *		    against its succinct copy, and the time taken by random
+ *		    root-to-leaf descents and full preorder walks of each.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void bench_succinct(void)
+{
+  int * values = malloc(SUCCINCT_NODES * sizeof(int));
+  bitree * tree = NULL;
+  bitree_succinct * frozen = NULL;
+  if (values == NULL)
+    goto exit;
+
+  if ((tree = random_tree(values, SUCCINCT_NODES)) == NULL)
+    goto exit;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  frozen = bitree_freeze_succinct(tree, sizeof(int), serialize_int);
+  double freeze = elapsed_ns(&start);
+  if (frozen == NULL)
+    goto exit;
+
+  /* Both trees see the same descents */
+  uint64_t sum = 0, state = random_state;
+  double descents[2], walks[2];
+  for (int succinct = 0; succinct < 2; succinct++) {
+    random_state = state;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < SUCCINCT_DESCENTS; i++) {
+      uint64_t bits = next_random();
+      if (succinct) {
+	for (bitree_sref node = bitree_succinct_root(frozen); node != 0;
+	     bits >>= 1) {
+	  succinct_touch(frozen, node, &sum);
+	  node = bits & 1 ? bitree_succinct_right(frozen, node)
+	    : bitree_succinct_left(frozen, node);
+	}
+      } else {
+	for (bitree * node = tree; node != NULL; bits >>= 1) {
+	  pointer_touch(node, &sum);
+	  node = bits & 1 ? node->right : node->left;
+	}
+      }
+    }
+    descents[succinct] = elapsed_ns(&start) / SUCCINCT_DESCENTS;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (succinct ? bitree_succinct_walk(frozen, 1, BITREE_PREORDER,
+					succinct_touch, &sum)
+	: bitree_walk(tree, BITREE_PREORDER, pointer_touch, &sum))
+      goto exit;
+    walks[succinct] = elapsed_ns(&start) / SUCCINCT_NODES;
+  }
+
+  printf("Succinct trees (%d nodes, height %d, frozen in %.1f ms):\n",
+	 SUCCINCT_NODES, bitree_succinct_height(frozen), freeze / 1e6);
+  printf("  %-10s %12s %12s %12s\n", "", "bytes/node", "descent", "walk");
+  printf("  %-10s %12.1f %9.1f ns %7.1f ns/n\n", "bitree",
+	 (double)sizeof(bitree) + sizeof(int), descents[0], walks[0]);
+  printf("  %-10s %12.2f %9.1f ns %7.1f ns/n\n", "succinct",
+	 (double)bitree_succinct_bytes(frozen) / SUCCINCT_NODES, descents[1],
+	 walks[1]);
+
+ exit:
+  bitree_succinct_destroy(&frozen);
+  bitree_destroy(&tree);
+  free(values);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bench_io
+ *
+ * DESCRIPTION:	    Measures bitree_save() and bitree_load() of a random tree,
+ *		    with one serializing thread and pwrite(), then with one
+ *		    thread per CPU, with each backend, and with O_DIRECT.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Saving ends with fsync(), so its time includes the disk;
+ *		    loading reads from the page cache unless O_DIRECT is used.
+ ***/
+static void bench_io(void)
+{
+  static const struct {
+    const char * name;
+    struct bitree_io_options options;
+  } configs[] = {
+    {"1 thread, pwrite", {.threads = 1, .flags = BITREE_IO_NO_URING}},
+    {"N threads, pwrite", {.flags = BITREE_IO_NO_URING}},
+    {"N threads, io_uring", {0}},
+    {"N threads, O_DIRECT", {.flags = BITREE_IO_DIRECT}},
+  };
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/bitree-bench-%ld.tree", (long)getpid());
+  int * values = malloc(IO_NODES * sizeof(int));
+  bitree * tree = NULL;
+  if (values == NULL || (tree = random_tree(values, IO_NODES)) == NULL)
+    goto exit;
+
+  double megabytes = (double)IO_NODES * (IO_PAYLOAD + 5) / (1 << 20);
+  printf("Save/load (%d nodes, %.0f MiB, %ld CPUs):\n", IO_NODES, megabytes,
+	 sysconf(_SC_NPROCESSORS_ONLN));
+  printf("  %-22s %10s %12s %10s\n", "", "save", "", "load");
+  for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (bitree_save(tree, path, serialize_padded, &configs[i].options))
+      goto exit;
+    double save = elapsed_ns(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bitree * loaded = bitree_load(path, deserialize_padded, free,
+				  &configs[i].options);
+    double load = elapsed_ns(&start);
+    if (loaded == NULL)
+      goto exit;
+    bitree_destroy(&loaded);
+
+    printf("  %-22s %7.1f ms %7.0f MB/s %7.1f ms\n", configs[i].name,
+	   save / 1e6, megabytes / (save / 1e9), load / 1e6);
+  }
+
+ exit:
+  bitree_destroy(&tree);
+  free(values);
+  unlink(path);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bench_cursor
+ *
+ * DESCRIPTION:	    Compares an inorder walk of a random tree of integers
+ *		    which takes one node at a time from bitree_cursor_next()
+ *		    against one which takes batches from bitree_next_batch().
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    The batched walk prefetches the payloads of a batch before
+ *		    reading any of them.
+ ***/
+static void bench_cursor(void)
+{
+  int * values = malloc(CURSOR_NODES * sizeof(int));
+  bitree * tree = NULL;
+  if (values == NULL)
+    goto exit;
+
+  if ((tree = random_tree(values, CURSOR_NODES)) == NULL)
+    goto exit;
+
+  struct bitree_cursor cursor;
+  struct timespec start;
+  uint64_t sums[2] = {0};
+  double times[2];
+
+  bitree_cursor_init(&cursor, tree, BITREE_INORDER);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (bitree * node; (node = bitree_cursor_next(&cursor)) != NULL;)
+    sums[0] += *(const int *)node->data;
+  times[0] = elapsed_ns(&start) / CURSOR_NODES;
+
+  bitree * batch[CURSOR_BATCH];
+  size_t count;
+  bitree_cursor_init(&cursor, tree, BITREE_INORDER);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while ((count = bitree_next_batch(&cursor, batch, CURSOR_BATCH)) > 0) {
+    for (size_t i = 0; i < count; i++)
+      __builtin_prefetch(batch[i]->data);
+    for (size_t i = 0; i < count; i++)
+      sums[1] += *(const int *)batch[i]->data;
+  }
+  times[1] = elapsed_ns(&start) / CURSOR_NODES;
+
+  if (sums[0] != sums[1])
+    goto exit;
+
+  printf("Inorder walks with a cursor (%d nodes):\n", CURSOR_NODES);
+  printf("  %-24s %7.1f ns/n\n", "bitree_cursor_next", times[0]);
+  printf("  %-18s (%3d) %7.1f ns/n\n", "bitree_next_batch", CURSOR_BATCH,
+	 times[1]);
+
+ exit:
+  bitree_destroy(&tree);
+  free(values);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bench_reduce
+ *
+ * DESCRIPTION:	    Compares summing the payloads of a random tree of integers
+ *		    with bitree_walk() against flattening it and running the
+ *		    reduction kernels, and against bitree_reduce(). The kernels
+ *		    are also timed alone, against plain loops over the array.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void bench_reduce(void)
+{
+  int * values = malloc(REDUCE_NODES * sizeof(int));
+  double * flat = malloc(REDUCE_NODES * sizeof(double));
+  bitree * tree = NULL;
+  if (values == NULL || flat == NULL)
+    goto exit;
+
+  if ((tree = random_tree(values, REDUCE_NODES)) == NULL)
+    goto exit;
+
+  struct timespec start;
+  struct bitree_reduction result;
+  uint64_t walked = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (bitree_walk(tree, BITREE_INORDER, pointer_touch, &walked))
+    goto exit;
+  double walk = elapsed_ns(&start) / REDUCE_NODES;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (bitree_flatten(tree, BITREE_INORDER, flat, int_value) != REDUCE_NODES)
+    goto exit;
+  double flatten = elapsed_ns(&start) / REDUCE_NODES;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (bitree_reduce(tree, BITREE_INORDER, int_value, 0, REDUCE_NODES / 2,
+		    &result) || result.sum != walked)
+    goto exit;
+  double fused = elapsed_ns(&start) / REDUCE_NODES;
+
+  /* Each kernel against the loop a caller would write */
+  const char * names[] = { "sum", "min", "max", "count_if" };
+  double kernels[4], loops[4], sink = 0;
+  for (int k = 0; k < 4; k++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int pass = 0; pass < REDUCE_PASSES; pass++) {
+      switch (k) {
+      case 0: sink += bitree_reduce_sum(flat, REDUCE_NODES); break;
+      case 1: sink += bitree_reduce_min(flat, REDUCE_NODES); break;
+      case 2: sink += bitree_reduce_max(flat, REDUCE_NODES); break;
+      default:
+	sink += bitree_reduce_count_if(flat, REDUCE_NODES, 0,
+				       REDUCE_NODES / 2);
+      }
+    }
+    kernels[k] = elapsed_ns(&start) / REDUCE_PASSES / REDUCE_NODES;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int pass = 0; pass < REDUCE_PASSES; pass++) {
+      double value = k == 1 ? INFINITY : k == 2 ? -INFINITY : 0;
+      for (size_t i = 0; i < REDUCE_NODES; i++) {
+	switch (k) {
+	case 0: value += flat[i]; break;
+	case 1: value = flat[i] < value ? flat[i] : value; break;
+	case 2: value = flat[i] > value ? flat[i] : value; break;
+	default: value += flat[i] >= 0 && flat[i] < REDUCE_NODES / 2;
+	}
+      }
+      sink += value;
+    }
+    loops[k] = elapsed_ns(&start) / REDUCE_PASSES / REDUCE_NODES;
+  }
+
+  printf("Reductions (%d nodes, checksum %g):\n", REDUCE_NODES, sink);
+  printf("  %-24s %7.2f ns/n\n", "bitree_walk (sum)", walk);
+  printf("  %-24s %7.2f ns/n\n", "bitree_flatten", flatten);
+  printf("  %-24s %7.2f ns/n\n", "bitree_reduce (all)", fused);
+  printf("  %-10s %12s %12s\n", "", "kernel", "loop");
+  for (int k = 0; k < 4; k++)
+    printf("  %-10s %7.3f ns/n %7.3f ns/n\n", names[k], kernels[k],
+	   loops[k]);
+
+ exit:
+  bitree_destroy(&tree);
+  free(flat);
+  free(values);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bench_interleave
+ *
+ * DESCRIPTION:	    Compares random root-to-leaf descents of many small trees,
+ *		    and preorder walks of all of them, done one tree after the
+ *		    other, against bitree_descend_many() and
+ *		    bitree_walk_many() with several group sizes.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void bench_interleave(void)
+{
+  const size_t groups[] = { 1, 4, 8, 16, 32 };
+  const int descents = FOREST_TREES * FOREST_ROUNDS;
+  const int nodes = FOREST_TREES * FOREST_NODES;
+  int * values = malloc(nodes * sizeof(int));
+  bitree ** trees = calloc(FOREST_TREES, sizeof(bitree *));
+  bitree ** starts = malloc(descents * sizeof(bitree *));
+  bitree ** found = malloc(descents * sizeof(bitree *));
+  uint64_t (*states)[2] = malloc(descents * sizeof(*states));
+  void ** ctxs = malloc(descents * sizeof(void *));
+  if (values == NULL || trees == NULL || starts == NULL || found == NULL
+      || states == NULL || ctxs == NULL
+      || random_forest(trees, FOREST_TREES, values, FOREST_NODES))
+    goto exit;
+
+  for (int i = 0; i < descents; i++)
+    starts[i] = trees[i % FOREST_TREES];
+
+  /* Every run sees the same descents: states[i] is {bits, sum} */
+  struct timespec start;
+  uint64_t seed = random_state, expected = 0;
+  double sequential[2] = {0}, interleaved[2][5];
+  for (int run = -1; run < 5; run++) {
+    random_state = seed;
+    for (int i = 0; i < descents; i++) {
+      states[i][0] = next_random();
+      states[i][1] = 0;
+      ctxs[i] = states[i];
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (run < 0) {
+      for (int i = 0; i < descents; i++) {
+	bitree * node = starts[i];
+	while (node != NULL)
+	  node = steer_random(node->data, ctxs[i]) < 0 ? node->left
+	    : node->right;
+      }
+    } else if (bitree_descend_many(starts, descents, steer_random, ctxs,
+				   found, groups[run])) {
+      goto exit;
+    }
+    double time = elapsed_ns(&start) / descents;
+
+    uint64_t sum = 0;
+    for (int i = 0; i < descents; i++)
+      sum += states[i][1];
+    if (run < 0) {
+      sequential[0] = time;
+      expected = sum;
+    } else if (sum != expected) {
+      goto exit;
+    } else {
+      interleaved[0][run] = time;
+    }
+  }
+
+  uint64_t walked = 0;
+  for (int i = 0; i < FOREST_TREES; i++)
+    ctxs[i] = &walked;
+  for (int run = -1; run < 5; run++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (run < 0) {
+      for (int i = 0; i < FOREST_TREES; i++)
+	bitree_walk(trees[i], BITREE_PREORDER, pointer_touch, &walked);
+    } else if (bitree_walk_many(trees, FOREST_TREES, BITREE_PREORDER,
+				pointer_touch, ctxs, groups[run])) {
+      goto exit;
+    }
+    double time = elapsed_ns(&start) / nodes;
+    if (run < 0)
+      sequential[1] = time;
+    else
+      interleaved[1][run] = time;
+  }
+
+  printf("Interleaved traversals (%d trees of %d nodes, checksum %llu):\n",
+	 FOREST_TREES, FOREST_NODES, (unsigned long long)walked);
+  printf("  %-18s %14s %14s\n", "", "descents", "preorder walks");
+  printf("  %-18s %8.1f ns/d %9.1f ns/n\n", "one at a time", sequential[0],
+	 sequential[1]);
+  for (int run = 0; run < 5; run++)
+    printf("  %-12s (%3zu) %8.1f ns/d %9.1f ns/n\n", "interleaved",
+	   groups[run], interleaved[0][run], interleaved[1][run]);
+
+ exit:
+  if (trees != NULL)
+    for (int i = 0; i < FOREST_TREES; i++)
+      bitree_destroy(&trees[i]);
+  free(ctxs);
+  free(states);
+  free(found);
+  free(starts);
+  free(trees);
+  free(values);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bench_bfs
+ *
+ * DESCRIPTION:	    Compares the ways of visiting a random tree in level
+ *		    order: DEFINE_LEVELORDER_TRAVERSAL, bitree_walk(), and
+ *		    bitree_bfs() with one thread and with one per CPU.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Each visit adds 1 to the payload, so the sum of the
+ *		    payloads afterwards checks that every node was visited
+ *		    once per pass.
+ ***/
+static void bench_bfs(void)
+{
+  int * values = malloc(BFS_NODES * sizeof(int));
+  bitree * tree = NULL;
+  if (values == NULL)
+    goto exit;
+
+  if ((tree = random_tree(values, BFS_NODES)) == NULL)
+    goto exit;
+
+  const char * names[] = {
+    "macro", "bitree_walk", "bitree_bfs (1 thread)", "bitree_bfs (N threads)"
+  };
+  double times[4];
+  struct timespec start;
+  for (int run = 0; run < 4; run++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    switch (run) {
+    case 0: levelorder_touch(tree); break;
+    case 1:
+      if (bitree_walk(tree, BITREE_LEVELORDER, level_touch, NULL))
+	goto exit;
+      break;
+    default:
+      if (bitree_bfs(tree, run == 2 ? 1 : 0, bfs_touch, NULL, NULL))
+	goto exit;
+    }
+    times[run] = elapsed_ns(&start) / BFS_NODES;
+  }
+
+  /* Each payload started out as its index, and was visited four times */
+  uint64_t sum = 0;
+  for (int i = 0; i < BFS_NODES; i++)
+    sum += values[i] - i;
+  if (sum != 4ULL * BFS_NODES)
+    goto exit;
+
+  printf("Level order visits (%d nodes, height %d, %ld CPUs):\n", BFS_NODES,
+	 bitree_height(tree), sysconf(_SC_NPROCESSORS_ONLN));
+  for (int run = 0; run < 4; run++)
+    printf("  %-24s %7.1f ns/n\n", names[run], times[run]);
+
+ exit:
+  bitree_destroy(&tree);
+  free(values);
+}
+
+/******************************************************************************
+ * FUNCTION:	    lookup_ns
+ *
+ * DESCRIPTION:	    Looks up every key in `sequence', and returns the mean time
+ *		    taken per lookup.
+ *
+ * ARGUMENTS:	    trees: (bitree **) -- the AVL tree, then the splay tree.
+ *		    avl: (int) -- nonzero to use the AVL tree.
+ *		    keys: (const int *) -- the keys in the trees.
+ *		    sequence: (const int *) -- LOOKUPS indices into `keys'.
+ *
+ * RETURN:	    double -- nanoseconds per lookup.
+ *
+ * NOTES:	    none.
+ ***/
+static double lookup_ns(bitree ** trees, int avl, const int * keys,
+			const int * sequence)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < LOOKUPS; i++) {
+    bitree * node = avl
+      ? bitree_avl_find(trees[0], &keys[sequence[i]], compare_int)
+      : bitree_splay_find(trees[1], &keys[sequence[i]], compare_int);
+    if (node == NULL)
+      fprintf(stderr, "lookup of %d failed\n", keys[sequence[i]]);
+  }
+  return elapsed_ns(&start) / LOOKUPS;
+}
+
+/******************************************************************************
+ * FUNCTION:	    paged_build
+ *
+ * DESCRIPTION:	    Inserts the complete tree of `size' nodes below `parent',
+ *		    in preorder, as bitree_paged_store() would.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    parent: (bitree_pref) -- where to insert it, or 0.
+ *		    right: (int) -- nonzero to insert it on the right.
+ *		    index: (uint64_t) -- position of its root, in level order.
+ *		    size: (uint64_t) -- number of nodes in the whole tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int paged_build(bitree_paged * tree, bitree_pref parent, int right,
+		       uint64_t index, uint64_t size)
+{
+  unsigned char payload[PAGED_PAYLOAD] = {0};
+  if (index >= size)
+    return 0;
+
+  payload[0] = index;
+  bitree_pref node = right ? bitree_paged_insr(tree, parent, payload)
+    : bitree_paged_insl(tree, parent, payload);
+  if (node == 0)
+    return -1;
+  return paged_build(tree, node, 0, 2 * index + 1, size)
+    || paged_build(tree, node, 1, 2 * index + 2, size) ? -1 : 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    paged_touch
+ *
+ * DESCRIPTION:	    Reads the payload of a node of a paged tree, as a search
+ *		    would to compare keys.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the node.
+ *		    sum: (void *) -- a uint64_t to add the payload to.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_CONTINUE.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit paged_touch(bitree_paged * tree, bitree_pref node,
+				     void * sum)
+{
+  unsigned char * payload = bitree_paged_pin(tree, node);
+  if (payload != NULL) {
+    *(uint64_t *)sum += payload[0];
+    bitree_paged_unpin(tree, node, 0);
+  }
+  return BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    pointer_touch
+ *
+ * DESCRIPTION:	    Reads the payload of a node, as a search would to compare
+ *		    keys.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    sum: (void *) -- a uint64_t to add the payload to.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_CONTINUE.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit pointer_touch(bitree * node, void * sum)
+{
+  *(uint64_t *)sum += *(const int *)node->data;
+  return BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    succinct_touch
+ *
+ * DESCRIPTION:	    Reads the payload of a node of a succinct tree, as a
+ *		    search would to compare keys.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    node: (bitree_sref) -- the node.
+ *		    sum: (void *) -- a uint64_t to add the payload to.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_CONTINUE.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit succinct_touch(const bitree_succinct * tree,
+					bitree_sref node, void * sum)
+{
+  *(uint64_t *)sum += *(const int *)bitree_succinct_data(tree, node);
+  return BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    serialize_int
+ *
+ * DESCRIPTION:	    Serialize function which copies an integer payload.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *		    buffer: (void *) -- where to write it.
+ *		    size: (size_t) -- size of `buffer'.
+ *
+ * RETURN:	    size_t -- sizeof(int).
+ *
+ * NOTES:	    none.
+ ***/
+static size_t serialize_int(const void * data, void * buffer, size_t size)
+{
+  if (size >= sizeof(int))
+    *(int *)buffer = *(const int *)data;
+  return sizeof(int);
+}
+
+/******************************************************************************
+ * FUNCTION:	    serialize_padded
+ *
+ * DESCRIPTION:	    Serialize function which writes an integer payload padded
+ *		    to IO_PAYLOAD bytes.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *		    buffer: (void *) -- where to write it.
+ *		    size: (size_t) -- size of `buffer'.
+ *
+ * RETURN:	    size_t -- IO_PAYLOAD.
+ *
+ * NOTES:	    none.
+ ***/
+static size_t serialize_padded(const void * data, void * buffer, size_t size)
+{
+  if (size >= IO_PAYLOAD) {
+    memset(buffer, 0, IO_PAYLOAD);
+    memcpy(buffer, data, sizeof(int));
+  }
+  return IO_PAYLOAD;
+}
+
+/******************************************************************************
+ * FUNCTION:	    deserialize_padded
+ *
+ * DESCRIPTION:	    Makes an integer payload from what serialize_padded()
+ *		    wrote.
+ *
+ * ARGUMENTS:	    buffer: (const void *) -- the serialized payload.
+ *		    size: (size_t) -- its size.
+ *
+ * RETURN:	    void * -- the payload, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static void * deserialize_padded(const void * buffer, size_t size)
+{
+  int * value = size == IO_PAYLOAD ? malloc(sizeof(int)) : NULL;
+  if (value != NULL)
+    memcpy(value, buffer, sizeof(int));
+  return value;
+}
+
+/******************************************************************************
+ * FUNCTION:	    steer_random
+ *
+ * DESCRIPTION:	    Steers a descent by the bits of a random number and the
+ *		    payloads it passes, which it adds up. Like a search, it
+ *		    can't choose a child before reading the payload.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *		    ctx: (void *) -- a uint64_t[2]: the bits left, and the sum.
+ *
+ * RETURN:	    int -- -1 to go left, or 1 to go right.
+ *
+ * NOTES:	    none.
+ ***/
+static int steer_random(const void * data, void * ctx)
+{
+  uint64_t * state = (uint64_t *)ctx;
+  int value = *(const int *)data;
+  int way = (state[0] ^ value) & 1 ? 1 : -1;
+  state[1] += value;
+  state[0] >>= 1;
+  return way;
+}
+
+/******************************************************************************
+ * FUNCTION:	    level_touch
+ *
+ * DESCRIPTION:	    Visitor for bitree_walk() which adds 1 to an integer
+ *		    payload.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    ctx: (void *) -- unused.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_CONTINUE.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit level_touch(bitree * node, void * ctx)
+{
+  *(int *)node->data += 1;
+  return BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bfs_touch
+ *
+ * DESCRIPTION:	    Action for bitree_bfs() which adds 1 to an integer
+ *		    payload.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    depth: (int) -- unused.
+ *		    ctx: (void *) -- unused.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void bfs_touch(bitree * node, int depth, void * ctx)
+{
+  *(int *)node->data += 1;
+}
+
+/******************************************************************************
+ * FUNCTION:	    int_value
+ *
+ * DESCRIPTION:	    Value extractor for reductions over integer payloads.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *
+ * RETURN:	    double -- the integer.
+ *
+ * NOTES:	    none.
+ ***/
+static double int_value(const void * data)
+{
+  return *(const int *)data;
+}
+
+/******************************************************************************
+ * FUNCTION:	    random_tree
+ *
+ * DESCRIPTION:	    Builds a tree of random shape, with each node inserted
+ *		    where a random descent from the root falls off.
+ *
+ * ARGUMENTS:	    values: (int *) -- `size' integers, which are set to 0 to
+ *			`size' - 1 and used as the payloads.
+ *		    size: (int) -- the number of nodes.
+ *
+ * RETURN:	    bitree * -- the tree, whose payloads are not freed with it,
+ *		    or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static bitree * random_tree(int * values, int size)
+{
+  for (int i = 0; i < size; i++)
+    values[i] = i;
+  bitree * tree = bitree_create(NULL, &values[0]);
+  if (tree == NULL)
+    return NULL;
+
+  for (int i = 1; i < size; i++) {
+    bitree * node = tree;
+    uint64_t bits = next_random();
+    while (1) {
+      bitree * next = bits & 1 ? node->right : node->left;
+      if (next == NULL)
+	break;
+      node = next;
+      if ((bits >>= 1) == 0)
+	bits = next_random();
+    }
+    if (bits & 1 ? bitree_insr(node, &values[i])
+	: bitree_insl(node, &values[i])) {
+      bitree_destroy(&tree);
+      return NULL;
+    }
+  }
+  return tree;
+}
+
+/******************************************************************************
+ * FUNCTION:	    random_forest
+ *
+ * DESCRIPTION:	    Grows several random trees at once, adding a node to each
+ *		    in turn, so that consecutive nodes of a tree are not next
+ *		    to each other in memory.
+ *
+ * ARGUMENTS:	    trees: (bitree **) -- where to store the roots, NULL.
+ *		    count: (int) -- the number of trees.
+ *		    values: (int *) -- room for count * size payloads.
+ *		    size: (int) -- the number of nodes of each tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise. The trees are left for
+ *		    the caller to destroy either way.
+ *
+ * NOTES:	    none.
+ ***/
+static int random_forest(bitree ** trees, int count, int * values, int size)
+{
+  for (int i = 0; i < count * size; i++) {
+    values[i] = i;
+    bitree ** tree = &trees[i % count];
+    if (*tree == NULL) {
+      if ((*tree = bitree_create(NULL, &values[i])) == NULL)
+	return -1;
+      continue;
+    }
+
+    bitree * node = *tree;
+    uint64_t bits = next_random();
+    while (1) {
+      bitree * next = bits & 1 ? node->right : node->left;
+      if (next == NULL)
+	break;
+      node = next;
+      if ((bits >>= 1) == 0)
+	bits = next_random();
+    }
+    if (bits & 1 ? bitree_insr(node, &values[i])
+	: bitree_insl(node, &values[i]))
+      return -1;
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    next_random
+ *
+ * DESCRIPTION:	    A xorshift64* generator, so that every run of the
+ *		    benchmarks uses the same inputs.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    uint64_t -- the next pseudo-random number.
+ *
+ * NOTES:	    none.
+ ***/
+static uint64_t next_random(void)
+{
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return random_state * 0x2545f4914f6cdd1dULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    shuffle
+ *
+ * DESCRIPTION:	    Fisher-Yates shuffle of an array of integers.
+ *
+ * ARGUMENTS:	    array: (int *) -- the array.
+ *		    size: (int) -- the number of elements in `array'.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void shuffle(int * array, int size)
+{
+  for (int i = size - 1; i > 0; i--) {
+    int j = next_random() % (i + 1);
+    int temp = array[i];
+    array[i] = array[j];
+    array[j] = temp;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    compare_int
+ *
+ * DESCRIPTION:	    Comparison function for keyed trees of integers.
+ *
+ * ARGUMENTS:	    one: (const void *) -- the first key.
+ *		    two: (const void *) -- the second key.
+ *
+ * RETURN:	    int -- less than, equal to, or greater than zero.
+ *
+ * NOTES:	    none.
+ ***/
+static int compare_int(const void * one, const void * two)
+{
+  return *(const int *)one - *(const int *)two;
+}
+
+/******************************************************************************
+ * FUNCTION:	    hash_int
+ *
+ * DESCRIPTION:	    Hash function for interned trees of integers.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *
+ * RETURN:	    size_t -- the hash.
+ *
+ * NOTES:	    none.
+ ***/
+static size_t hash_int(const void * data)
+{
+  return *(const int *)data;
+}
+
+/******************************************************************************
+ * FUNCTION:	    equal_int
+ *
+ * DESCRIPTION:	    Equality function for interned trees of integers.
+ *
+ * ARGUMENTS:	    one: (const void *) -- the first payload.
+ *		    two: (const void *) -- the second payload.
+ *
+ * RETURN:	    int -- nonzero if the payloads are equal.
+ *
+ * NOTES:	    none.
+ ***/
+static int equal_int(const void * one, const void * two)
+{
+  return *(const int *)one == *(const int *)two;
+}
+
+/******************************************************************************
+ * FUNCTION:	    elapsed_ns
+ *
+ * DESCRIPTION:	    Returns the time elapsed since `start'.
+ *
+ * ARGUMENTS:	    start: (const struct timespec *) -- the start time.
+ *
+ * RETURN:	    double -- elapsed time in nanoseconds.
+ *
+ * NOTES:	    none.
+ ***/
+static double elapsed_ns(const struct timespec * start)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+/*****************************************************************************/
@@ -11,17 +11,248 @@
  *
  * CREATED:	    11/06/2017
  *
- * LAST EDITED:	    01/02/2018
+ * LAST EDITED:	    10/18/2026
  ***/
 
 /******************************************************************************
  * INCLUDES
  ***/
 
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "bitree.h"
+#include "bitree_internal.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* Invariant checks on the links of a single node. These are only compiled in
+ * when CONFIG_DEBUG is defined.
+ */
+#ifdef CONFIG_DEBUG
+#   define check_node(node)	check_node_links(node)
+#else
+#   define check_node(node)
+#endif
+
+/* The most walks or descents interleaved at once */
+#define INTERLEAVE_MAX	64
+
+#ifdef CONFIG_ORDER_STATISTICS
+#   define node_count(node)	((node) == NULL ? 0 : (node)->count)
+#endif
+
+#if defined(CONFIG_ORDER_STATISTICS) || defined(CONFIG_SUBTREE_AGGREGATE)
+#   define CACHED_FIELDS
+#endif
+
+/* The slot that `key' hashes to in an open-addressed table of `slots' slots,
+ * a power of two.
+ */
+#define index_home(key, slots)						\
+  ((size_t)((key) * 0x9e3779b97f4a7c15ULL) & ((slots) - 1))
+
+/* The hash of an empty subtree, and the function that mixes the hashes of a
+ * payload and its subtrees together.
+ */
+#ifdef CONFIG_MERKLE_HASH
+#   define EMPTY_HASH		((size_t)0x6a09e667f3bcc908ULL)
+#   define combine_hash(seed, value)					\
+  ((seed) ^ ((value) + (size_t)0x9e3779b97f4a7c15ULL + ((seed) << 6)	\
+	     + ((seed) >> 2)))
+#   define invalidate_path(node)	invalidate_hash(node)
+#else
+#   define invalidate_path(node)
+#endif
+
+/* The hooks through which changes to a tree are recorded in its journal, if
+ * it has one.
+ */
+#ifdef CONFIG_JOURNAL
+#   define JOURNAL_HEADER	sizeof(struct journal_header)
+#   define journal_insert(node, op)	journal_record(node, op)
+#   define journal_remove(node)		journal_record(node, JOURNAL_REM)
+#   define journal_update(node)		journal_record(node, JOURNAL_UPDATE)
+#   define journal_rotate(node, op)	journal_record(node, op)
+#   define journal_forget(node)		forget_node(node)
+#   define journal_forget_tree(node)	forget_subtree(node)
+#   define journal_release(node)	free_journal((node)->journal)
+#else
+#   define journal_insert(node, op)
+#   define journal_remove(node)
+#   define journal_update(node)
+#   define journal_rotate(node, op)
+#   define journal_forget(node)
+#   define journal_forget_tree(node)
+#   define journal_release(node)
+#endif
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* A block of nodes allocated together. `refs' counts the nodes in `nodes'
+ * which have not been freed yet. It is atomic because the reclaimer thread
+ * may free some nodes of a block while others are still in use.
+ */
+struct bitree_block {
+  atomic_int refs;
+  bitree nodes[];
+};
+
+/* Payloads collected during a removal. With CONFIG_DESTROY_BATCH, payloads
+ * of trees with a destroy_batch function are passed to it BITREE_DESTROY_BATCH
+ * at a time. Otherwise, every payload is destroyed as soon as it is released.
+ */
+struct destroy_buffer {
+#ifdef CONFIG_DESTROY_BATCH
+  void (*destroy_batch)(void **, size_t);
+  size_t n;
+  void * data[BITREE_DESTROY_BATCH];
+#else
+  char unused;
+#endif
+};
+
+/* The state of bitree_retain(): the predicate, the payloads of the nodes
+ * removed so far and their number, and the root of the subtree, which is set
+ * to NULL if it is removed.
+ */
+struct retain {
+  int (*pred)(const void * data, void * ctx);
+  void * ctx;
+  struct destroy_buffer buffer;
+  int removed;
+  bitree ** tree;
+};
+
+#ifdef CACHED_FIELDS
+/* An ancestor of the nodes inserted by bitree_ins_batch(), in a table keyed
+ * by its address, and how many of its children in the table have yet to be
+ * refreshed. Once it has been refreshed, `pending' is -1.
+ */
+struct batch_entry {
+  bitree * node;
+  int pending;
+};
+#endif
+
+/* The context that bitree_find_if() passes to bitree_walk() */
+struct find_if_spec {
+  int (*pred)(const void * data, void * ctx);
+  void * ctx;
+  bitree * found;
+};
+
+#ifdef CONFIG_JOURNAL
+/* The kinds of record in a journal. JOURNAL_NEWROOT gives the new root created
+ * by the JOURNAL_MERGE which always follows it.
+ */
+enum journal_op {
+  JOURNAL_ROOT,
+  JOURNAL_INSL,
+  JOURNAL_INSR,
+  JOURNAL_REM,
+  JOURNAL_NEWROOT,
+  JOURNAL_MERGE,
+  JOURNAL_UPDATE,
+  JOURNAL_ROTL,
+  JOURNAL_ROTR
+};
+
+/* The header of a record, which is followed by `size' bytes of payload. `id'
+ * is the node the record is about, and `other' is its parent for the
+ * insertions, and the node merged onto for JOURNAL_MERGE.
+ */
+struct journal_header {
+  uint32_t op;
+  uint32_t size;
+  uint64_t id;
+  uint64_t other;
+};
+
+/* A journal which has a `write' function records changes. One which doesn't
+ * belongs to a replica, and keeps `index', an open-addressed hash table of
+ * the replica's nodes by ID, so that replayed records can find them. `buffer'
+ * holds the record being written.
+ */
+struct bitree_journal {
+  int (*write)(void *, const void *, size_t);
+  void * sink;
+  size_t (*serialize)(const void *, void *, size_t);
+  uint64_t next_id;
+  int failed;
+
+  unsigned char * buffer;
+  size_t capacity;
+
+  bitree ** index;
+  size_t slots;
+  size_t count;
+};
+#endif /* CONFIG_JOURNAL */
+
+/* A walk or descent interleaved by bitree_walk_many() or
+ * bitree_descend_many(): `node' is the next node it reaches, of the subtree
+ * rooted at `top', which is trees[`index']. `loaded' is set once the node has
+ * been read, and its payload prefetched.
+ */
+struct interleave_slot {
+  bitree * node;
+  bitree * top;
+  size_t index;
+  int loaded;
+};
+
+/* A subtree being removed by bitree_rem_step(). `node' is where the next
+ * step starts looking for a leaf.
+ */
+#ifdef CONFIG_ORDER_STATISTICS
+struct bitree_rem_handle {
+  bitree * node;
+};
+
+/* The background thread used by bitree_rem_async(). Detached subtrees are
+ * queued in `queue', linked through the `parent' pointers of their roots.
+ */
+struct reclaimer {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_t thread;
+  bitree * queue;
+  int running;
+  int stop;
+};
+#endif
+
+/* Everything that is common to the nodes made by one call to clone_tree() */
+struct clone_spec {
+  bitree * root;
+  int * size;
+  struct bitree_block * block;
+  void * (*map)(const void *);
+  void (*destroy)(void *);
+  int clone;
+};
+
+/* A subtree to be copied by another thread */
+struct clone_job {
+  const struct clone_spec * spec;
+  bitree * source;
+  bitree * parent;
+  bitree * nodes;
+  int splits;
+  int failed;
+};
 
 /******************************************************************************
  * STATIC FUNCTION PROTOTYPES
@@ -34,12 +265,137 @@ static bitree * ninorder_helper(bitree * node, bitree * original);
 static bitree * nlevelorder_helper(bitree * node, bitree * old,
 				   int dist, int goal);
 
+/* Used by bitree_walk() and the cursors */
+static bitree * preorder_next(bitree * node, bitree * top, int descend);
+static bitree * inorder_first(bitree * node);
+static bitree * inorder_next(bitree * node, bitree * top, int descend);
+static bitree * postorder_first(bitree * node);
+static bitree * postorder_next(bitree * node, bitree * top);
+
+/* Used by bitree_walk_many() and bitree_descend_many() */
+static void start_slot(struct interleave_slot * slot, bitree * node,
+		       bitree * top, size_t index);
+static size_t interleave_group(size_t group);
+static bitree * walk_first(bitree * top, enum bitree_order order);
+
+/* Used by bitree_walk() and bitree_find_if() */
+static int walk_preorder(bitree * tree,
+			 enum bitree_visit (*visit)(bitree *, void *),
+			 void * ctx);
+static int walk_inorder(bitree * tree,
+			enum bitree_visit (*visit)(bitree *, void *),
+			void * ctx);
+static int walk_postorder(bitree * tree,
+			  enum bitree_visit (*visit)(bitree *, void *),
+			  void * ctx);
+static int walk_levelorder(bitree * tree,
+			   enum bitree_visit (*visit)(bitree *, void *),
+			   void * ctx);
+static enum bitree_visit find_if_visit(bitree * node, void * spec);
+
 /* Used by bitree_merge to update tree parameters */
 static int update_size(bitree * node, int * size, bitree * root);
 
+/* Used by bitree_clone() and bitree_map() */
+static bitree * clone_tree(bitree * tree, void * (*map)(const void *),
+			   void (*destroy)(void *), int clone);
+static int clone_subtree(const struct clone_spec * spec, bitree * source,
+			 bitree * parent, bitree * nodes, int splits,
+			 int * failed);
+static void * clone_thread(void * job);
+static int subtree_size(bitree * node);
+
 /* Used by bitree_distance() */
 static int distance_helper(bitree * node, int distance);
 
+/* Used by bitree_rotl() and bitree_rotr(), whose records already move the
+ * payloads of a replica.
+ */
+static void swap_data(bitree * one, bitree * two);
+
+#ifdef CONFIG_ORDER_STATISTICS
+/* Used by bitree_sample() */
+static uint64_t next_random(uint64_t * state);
+#endif
+
+/* Used by bitree_rem() */
+static void rem_helper(bitree * node, struct destroy_buffer * buffer);
+static int retain_helper(bitree * node, struct retain * retain);
+static void free_node(bitree * node);
+static void release_data(bitree * node, struct destroy_buffer * buffer);
+static void flush_data(struct destroy_buffer * buffer);
+
+/* Used by bitree_rem_async(), bitree_rem_begin() and bitree_rem_step() */
+#ifdef CONFIG_ORDER_STATISTICS
+static void detach(bitree * node);
+static void * reclaim_thread(void * arg);
+#endif
+static void reclaim(bitree * node, struct destroy_buffer * buffer);
+static void reclaim_node(bitree * node, struct destroy_buffer * buffer);
+
+/* Keep the cached per-node fields (e.g. `count') consistent with the shape of
+ * the tree.
+ */
+static void update_cache(bitree * node);
+static void update_path(bitree * node);
+static void update_batch(const struct bitree_ins_op * ops, size_t n);
+#ifdef CACHED_FIELDS
+static struct batch_entry * batch_slot(struct batch_entry * table,
+				       size_t slots, bitree * node);
+static struct batch_entry * batch_grow(struct batch_entry * table,
+				       size_t slots);
+#endif
+#ifdef CONFIG_SUBTREE_AGGREGATE
+static void set_aggregate(bitree * node,
+			  const struct bitree_aggregate * aggregate);
+#endif
+#ifdef CONFIG_JOURNAL
+/* Used to record changes in a journal, and to replay them */
+static void journal_record(bitree * node, enum journal_op op);
+static void journal_merge(bitree * tree2, bitree * newroot);
+static void journal_emit(struct bitree_journal * journal, enum journal_op op,
+			 uint64_t id, uint64_t other, const void * data);
+static struct bitree_journal * new_journal(void);
+static void free_journal(struct bitree_journal * journal);
+static int replay_record(bitree ** tree, const struct journal_header * header,
+			 const unsigned char * payload,
+			 const struct journal_header * next,
+			 const unsigned char * next_payload,
+			 void * (*deserialize)(const void *, size_t),
+			 void (*destroy)(void *));
+static bitree * find_node(struct bitree_journal * journal, uint64_t id);
+static int reserve_id(struct bitree_journal * journal, uint64_t id, size_t n);
+static int index_node(bitree * node, uint64_t id);
+static void forget_node(bitree * node);
+static void forget_subtree(bitree * node);
+#endif
+#ifdef CONFIG_MERKLE_HASH
+static void invalidate_hash(bitree * node);
+static size_t node_hash(bitree * node);
+static int diff_helper(bitree * one, bitree * two,
+		       void (*report)(bitree *, bitree *, void *), void * ctx);
+#endif
+
+#ifdef CONFIG_DEBUG
+static void check_node_links(bitree * node);
+#endif
+
+/******************************************************************************
+ * STATIC VARIABLES
+ ***/
+
+#ifdef CONFIG_ORDER_STATISTICS
+static struct reclaimer reclaimer = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .wake = PTHREAD_COND_INITIALIZER,
+};
+
+/* Held for the whole of bitree_reclaim_flush(), so that only one caller at a
+ * time stops the reclaimer.
+ */
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 /******************************************************************************
  * API FUNCTIONS
  ***/
@@ -74,7 +430,27 @@ bitree * bitree_create(void (*destroy)(void *), void * data)
   
     .size = malloc(sizeof(int)),
     .destroy = destroy,
-    .data = data
+    .data = data,
+    .height = 1,
+    .block = NULL,
+#ifdef CONFIG_ORDER_STATISTICS
+    .count = 1,
+#endif
+#ifdef CONFIG_SUBTREE_AGGREGATE
+    .aggregate = NULL,
+#endif
+#ifdef CONFIG_DESTROY_BATCH
+    .destroy_batch = NULL,
+#endif
+#ifdef CONFIG_MERKLE_HASH
+    .hash_data = NULL,
+    .hash = 0,
+    .hashed = 0,
+#endif
+#ifdef CONFIG_JOURNAL
+    .journal = NULL,
+    .id = 0,
+#endif
   };
 
   if (tree->size == NULL) {
@@ -117,7 +493,9 @@ void bitree_destroy(bitree ** tree)
  *
  * RETURN:	    int -- 0 on success, -1 on failure.
  *
- * NOTES:	    Theta(1)
+ * NOTES:	    Theta(1), or O(h) with CONFIG_ORDER_STATISTICS or
+ *		    CONFIG_SUBTREE_AGGREGATE, where h is the height of the
+ *		    tree.
  ***/
 int bitree_insl(bitree * parent, void * data)
 {
@@ -138,11 +516,34 @@ int bitree_insl(bitree * parent, void * data)
     .right = NULL,
     .size = parent->size,
     .destroy = parent->destroy,
-    .data = data
+    .data = data,
+    .height = 1,
+    .block = NULL,
+#ifdef CONFIG_ORDER_STATISTICS
+    .count = 1,
+#endif
+#ifdef CONFIG_SUBTREE_AGGREGATE
+    .aggregate = parent->aggregate,
+#endif
+#ifdef CONFIG_DESTROY_BATCH
+    .destroy_batch = parent->destroy_batch,
+#endif
+#ifdef CONFIG_MERKLE_HASH
+    .hash_data = parent->hash_data,
+    .hash = 0,
+    .hashed = 0,
+#endif
+#ifdef CONFIG_JOURNAL
+    .journal = parent->journal,
+    .id = 0,
+#endif
   };
+  update_cache(new);
 
   parent->left = new;
   *(parent->size) += 1;
+  update_path(parent);
+  journal_insert(new, JOURNAL_INSL);
   return 0;
 }
 
@@ -157,7 +558,9 @@ int bitree_insl(bitree * parent, void * data)
  *
  * RETURN:	    int -- 0 on success, -1 on failure.
  *
- * NOTES:	    Theta(1)
+ * NOTES:	    Theta(1), or O(h) with CONFIG_ORDER_STATISTICS or
+ *		    CONFIG_SUBTREE_AGGREGATE, where h is the height of the
+ *		    tree.
  ***/
 int bitree_insr(bitree * parent, void * data)
 {
@@ -176,11 +579,143 @@ int bitree_insr(bitree * parent, void * data)
     .right = NULL,
     .size = parent->size,
     .destroy = parent->destroy,
-    .data = data
+    .data = data,
+    .height = 1,
+    .block = NULL,
+#ifdef CONFIG_ORDER_STATISTICS
+    .count = 1,
+#endif
+#ifdef CONFIG_SUBTREE_AGGREGATE
+    .aggregate = parent->aggregate,
+#endif
+#ifdef CONFIG_DESTROY_BATCH
+    .destroy_batch = parent->destroy_batch,
+#endif
+#ifdef CONFIG_MERKLE_HASH
+    .hash_data = parent->hash_data,
+    .hash = 0,
+    .hashed = 0,
+#endif
+#ifdef CONFIG_JOURNAL
+    .journal = parent->journal,
+    .id = 0,
+#endif
   };
+  update_cache(new);
 
   parent->right = new;
   *(parent->size) += 1;
+  update_path(parent);
+  journal_insert(new, JOURNAL_INSR);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_ins_batch
+ *
+ * DESCRIPTION:	    Applies a batch of insertions to the tree containing
+ *		    `tree'. Each new node is linked in as soon as it is
+ *		    checked, so that later insertions into the same child fail.
+ *		    If any insertion fails, the links made so far are undone.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
+ *		    ops: (const struct bitree_ins_op *) -- the insertions.
+ *		    n: (size_t) -- the number of insertions in `ops'.
+ *		    status: (int *) -- array of `n' results, or NULL.
+ *
+ * RETURN:	    int -- 0 if every insertion was applied, -1 if none were.
+ *
+ * NOTES:	    Theta(n), or O(n + m) expected with CONFIG_ORDER_STATISTICS
+ *		    or CONFIG_SUBTREE_AGGREGATE, where m is the number of
+ *		    distinct ancestors of the new nodes, each of which is
+ *		    refreshed once.
+ ***/
+int bitree_ins_batch(bitree * tree, const struct bitree_ins_op * ops,
+		     size_t n, int * status)
+{
+  if (tree == NULL || (ops == NULL && n > 0))
+    return -1;
+  if (n == 0)
+    return 0;
+
+  struct bitree_block * block = malloc(sizeof(struct bitree_block)
+				       + n * sizeof(bitree));
+  if (block == NULL)
+    return -1;
+  atomic_init(&block->refs, n);
+
+  int result = 0;
+  for (size_t i = 0; i < n; i++) {
+    bitree * parent = ops[i].parent;
+    bitree ** child = NULL;
+    if (parent != NULL && parent->root == tree->root)
+      child = ops[i].side == BITREE_LEFT ? &parent->left : &parent->right;
+
+    /* The same checks as bitree_insl() and bitree_insr() */
+    if (child == NULL || *child != NULL || ops[i].data == NULL) {
+      result = -1;
+      if (status != NULL)
+	status[i] = -1;
+      continue;
+    }
+
+    bitree * new = &block->nodes[i];
+    *new = (bitree){
+      .root = parent->root,
+      .parent = parent,
+      .left = NULL,
+      .right = NULL,
+      .size = parent->size,
+      .destroy = parent->destroy,
+      .data = ops[i].data,
+      .height = 1,
+      .block = block,
+#ifdef CONFIG_ORDER_STATISTICS
+      .count = 1,
+#endif
+#ifdef CONFIG_SUBTREE_AGGREGATE
+      .aggregate = parent->aggregate,
+#endif
+#ifdef CONFIG_DESTROY_BATCH
+      .destroy_batch = parent->destroy_batch,
+#endif
+#ifdef CONFIG_MERKLE_HASH
+      .hash_data = parent->hash_data,
+      .hash = 0,
+      .hashed = 0,
+#endif
+#ifdef CONFIG_JOURNAL
+      .journal = parent->journal,
+      .id = 0,
+#endif
+    };
+    *child = new;
+    if (status != NULL)
+      status[i] = 0;
+  }
+
+  /* Undo the links, in reverse, so that the tree is as it was */
+  if (result) {
+    for (size_t i = n; i-- > 0;) {
+      bitree * parent = ops[i].parent;
+      if (parent == NULL || parent->root != tree->root)
+	continue;
+      if (parent->left == &block->nodes[i])
+	parent->left = NULL;
+      else if (parent->right == &block->nodes[i])
+	parent->right = NULL;
+    }
+    free(block);
+    return -1;
+  }
+
+  *(tree->size) += n;
+  for (size_t i = 0; i < n; i++)
+    update_cache(&block->nodes[i]);
+  update_batch(ops, n);
+  for (size_t i = 0; i < n; i++)
+    journal_insert(&block->nodes[i], ops[i].side == BITREE_LEFT
+		   ? JOURNAL_INSL : JOURNAL_INSR);
   return 0;
 }
 
@@ -201,463 +736,3504 @@ void bitree_rem(bitree * node)
   if (node == NULL)
     return;
 
-  bitree_rem(node->left);
-  bitree_rem(node->right);
-
-  if (node->root == node) {
-    free(node->size);    
-  } else {
-    *(node->size) -= 1;
-    if (node->parent->left == node)
-      node->parent->left = NULL;
-    else
-      node->parent->right = NULL;
-  }
-
-  if (node->destroy != NULL)
-    node->destroy(node->data);
-  free(node);
+  journal_remove(node);
+  bitree * parent = node->parent;
+  struct destroy_buffer buffer = {0};
+  rem_helper(node, &buffer);
+  flush_data(&buffer);
+  update_path(parent);
 }
 
+#ifdef CONFIG_DESTROY_BATCH
 /******************************************************************************
- * FUNCTION:	    bitree_merge
+ * FUNCTION:	    bitree_set_destroy_batch
  *
- * DESCRIPTION:	    Merges two bitrees, without splicing them into each other.
- *		    This implementation is unordered, so we make no attempt
- *		    to balance the tree when merging.
+ * DESCRIPTION:	    Registers `destroy_batch' with every node of the tree
+ *		    containing `tree'.
  *
- * ARGUMENTS:	    tree1: (bitree *) -- the host tree
- *		    tree2: (bitree *) -- the tree to splice in
- *		    data: (void *) -- this param is used only when a new node
- *			needs to be created in order to merge the trees.
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
+ *		    destroy_batch: (void (*)(void **, size_t)) -- the function,
+ *			or NULL to go back to the destroy function.
  *
- * RETURN:	    int -- 0 on success, -1 otherwise.
+ * RETURN:	    int -- 0 on success, -1 on failure.
  *
- * NOTES:	    O(m + n), Omega(n); m = *(tree1->size), n = *(tree2->size)
+ * NOTES:	    Theta(n)
  ***/
-int bitree_merge(bitree * tree1, bitree * tree2, void * data)
+int bitree_set_destroy_batch(bitree * tree,
+			     void (*destroy_batch)(void **, size_t))
 {
-  /* Test for bad inputs */
-  if (tree1 == NULL
-      || tree2 == NULL
-      || tree2->root != tree2
-      || tree1->root == tree2->root
-      || tree1->destroy != tree2->destroy)
-    return -1;
-
-  /* Test for case 1 */
-  if (tree1->root == tree1
-      && tree1->left != NULL
-      && tree1->right != NULL
-      && data) {
-
-    bitree * newroot = bitree_create(tree1->destroy, data);
-    if (newroot == NULL)
-      return -1;
-    *(newroot->size) += *(tree1->size) + *(tree2->size);
-
-    newroot->left = tree1;
-    tree1->parent = newroot;
-
-    newroot->right = tree2;
-    tree2->parent = newroot;
-
-    free(tree1->size);
-    free(tree2->size);
-
-    /* Recursively update `size' and `root' */
-    update_size(newroot, newroot->size, newroot);
-  }
-  /* Test for case 2 & case 3 */
-  else if (tree1->left == NULL || tree1->right == NULL) {
-
-    if (tree1->left == NULL)
-      tree1->left = tree2;
-    else
-      tree1->right = tree2;
-
-    tree2->parent = tree1;
-    *(tree1->root->size) += *(tree2->size);
-    free(tree2->size);
-
-    /* Recursively update `size' and `root' */
-    update_size(tree2, tree1->root->size, tree1->root);
-
-  } else {
+  if (tree == NULL)
     return -1;
-  }
 
+  bitree * node = tree->root;
+  do {
+    node->destroy_batch = destroy_batch;
+  } while ((node = bitree_npreorder(node)) != tree->root);
   return 0;
 }
+#endif /* CONFIG_DESTROY_BATCH */
 
+#ifdef CONFIG_MERKLE_HASH
 /******************************************************************************
- * FUNCTION:	    bitree_npreorder
+ * FUNCTION:	    bitree_set_hash
  *
- * DESCRIPTION:	    This function returns the next node that would be operated
- *		    on if the tree were being traversed with a preorder
- *		    algorithm. See the documentation for an example of how this
- *		    function could be used.
+ * DESCRIPTION:	    Registers `hash' with every node of the tree containing
+ *		    `tree', and marks every subtree hash stale.
  *
- * ARGUMENTS:	    node: (bitree *) -- the current node.
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
+ *		    hash: (size_t (*)(const void *)) -- the payload hash
+ *			function, or NULL.
  *
- * RETURN:	    bitree * -- pointer to the next node, or NULL if there was
- *		    a problem.
+ * RETURN:	    int -- 0 on success, -1 on failure.
  *
- * NOTES:	    Omega(1), O(log(n))
- *		    THIS IS NOT A TRAVERSAL FUNCTION. It does not 'traverse'
- *		    the tree in a traditional sense. See the documentation in
- *		    the header file.
+ * NOTES:	    Theta(n)
  ***/
-bitree * bitree_npreorder(bitree * node)
+int bitree_set_hash(bitree * tree, size_t (*hash)(const void *))
 {
-  if (node == NULL || *(node->size) == 1)
-    return node;
+  if (tree == NULL)
+    return -1;
 
-  if (node->left != NULL)
-    return node->left;
-  if (node->right != NULL)
-    return node->right;
-  return npreorder_helper(node->parent, node);
+  bitree * node = tree->root;
+  do {
+    node->hash_data = hash;
+    node->hashed = 0;
+  } while ((node = bitree_npreorder(node)) != tree->root);
+  return 0;
 }
 
 /******************************************************************************
- * FUNCTION:	    bitree_npostorder
+ * FUNCTION:	    bitree_hash
  *
- * DESCRIPTION:	    This function returns the next node that would be operated
- *		    on if the tree were being traversed with a postorder
- *		    algorithm. See the documentation for an example of how this
- *		    function could be used.
+ * DESCRIPTION:	    Returns the hash of the subtree rooted at `tree',
+ *		    recomputing the stale hashes in it first.
  *
- * ARGUMENTS:	    node: (bitree *) -- the current node.
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
  *
- * RETURN:	    bitree * -- pointer to the next node, or NULL if there was
- *		    a problem.
+ * RETURN:	    size_t -- the hash, or 0 if there is no hash function.
  *
- * NOTES:	    Omega(1), O(log(n))
- *		    THIS IS NOT A TRAVERSAL FUNCTION. It does not 'traverse'
- *		    the tree in a traditional sense. See the documentation in
- *		    the header file.
- *		    Post-Order traversals begin at the leftmost node. The user
- *		    should keep this in mind when using this function.
+ * NOTES:	    O(s), s is the number of stale nodes in the subtree.
  ***/
-bitree * bitree_npostorder(bitree * node)
+size_t bitree_hash(bitree * tree)
 {
-  if (node == NULL || *(node->size) == 1)
-    return node;
-  if (node == node->root)
-    return npostorder_helper(node->left, node);
-  return npostorder_helper(node->parent, node);
+  if (tree == NULL || tree->hash_data == NULL)
+    return 0;
+  return node_hash(tree);
 }
 
 /******************************************************************************
- * FUNCTION:	    bitree_ninorder
+ * FUNCTION:	    bitree_equal
  *
- * DESCRIPTION:	    This function returns the next node that would be operated
- *		    on if the tree were being traversed with a inorder
- *		    algorithm. See the documentation for an example of how this
- *		    function could be used.
+ * DESCRIPTION:	    Compares two subtrees by their hashes.
  *
- * ARGUMENTS:	    node: (bitree *) -- the current node.
+ * ARGUMENTS:	    one: (bitree *) -- the first subtree.
+ *		    two: (bitree *) -- the second subtree.
  *
- * RETURN:	    bitree * -- pointer to the next node, or NULL if there was
- *		    a problem.
+ * RETURN:	    int -- 1 if they are equal, 0 if not, and -1 on error.
  *
- * NOTES:	    Omega(1), O(log(n))
- *		    THIS IS NOT A TRAVERSAL FUNCTION. It does not 'traverse'
- *		    the tree in a traditional sense. See the documentation in
- *		    the header file.
- *		    In-Order traversals begin at the leftmost node. The user
- *		    should keep this in mind when using this function.
+ * NOTES:	    O(s), s is the number of stale nodes in both subtrees.
  ***/
-bitree * bitree_ninorder(bitree * node)
+int bitree_equal(bitree * one, bitree * two)
 {
-  if (node == NULL || *(node->size) == 1)
-    return node;
-  if (node->root == node)
-    return ninorder_helper(node->right, node);
-  if (node->right != NULL)
-    return ninorder_helper(node->right, node);
-  return ninorder_helper(node->parent, node);
+  if (one == NULL || two == NULL || one->hash_data == NULL
+      || one->hash_data != two->hash_data)
+    return -1;
+  return node_hash(one) == node_hash(two);
 }
 
 /******************************************************************************
- * FUNCTION:	    bitree_nlevelorder
+ * FUNCTION:	    bitree_diff
  *
- * DESCRIPTION:	    This function returns the next node that would be operated
- *		    on if the tree were being traversed with a level-order (or
- *		    breadth-first) traversal. See the documentation for an
- *		    example of how this function could be used.
+ * DESCRIPTION:	    Reports the positions at which two subtrees differ, by
+ *		    descending only into the pairs of subtrees whose hashes
+ *		    differ.
  *
- * ARGUMENTS:	    node: (bitree *) -- the current node.
+ * ARGUMENTS:	    one: (bitree *) -- the first subtree.
+ *		    two: (bitree *) -- the second subtree.
+ *		    report: (void (*)(bitree *, bitree *, void *)) -- called
+ *			for each difference.
+ *		    ctx: (void *) -- passed to `report'.
  *
- * RETURN:	    bitree * -- pointer to the next node, or NULL if there was
- *		    a problem.
+ * RETURN:	    int -- the number of differences reported, or -1 on error.
  *
- * NOTES:	    Omega(1), O(log(n))
- *		    THIS IS NOT A TRAVERSAL FUNCTION. It does not 'traverse'
- *		    the tree in a traditional sense. See the documentation in
- *		    the header file.
+ * NOTES:	    O(s + d*h), s is the number of stale nodes in both
+ *		    subtrees, d is the number of differences, and h is the
+ *		    height of the subtrees.
  ***/
-bitree * bitree_nlevelorder(bitree * node)
+int bitree_diff(bitree * one, bitree * two,
+		void (*report)(bitree * one, bitree * two, void * ctx),
+		void * ctx)
 {
-  if (node == NULL)
-    return NULL;
-  if (*(node->size) == 1)
-    return node;
-  if (node == node->root)
-    return node->left;
-  int dist = bitree_distance(node);
-  return nlevelorder_helper(node->parent, node, dist - 1, dist);
+  if (report == NULL || bitree_equal(one, two) == -1)
+    return -1;
+  return diff_helper(one, two, report, ctx);
 }
+#endif /* CONFIG_MERKLE_HASH */
 
+#ifdef CONFIG_JOURNAL
 /******************************************************************************
- * FUNCTION:	    bitree_height
+ * FUNCTION:	    bitree_journal_attach
  *
- * DESCRIPTION:	    This function calculates the height of the tree.
+ * DESCRIPTION:	    Attaches a new journal to the tree containing `tree', and
+ *		    records the tree as it is, in preorder, so that the first
+ *		    record creates the root and each of the others inserts a
+ *		    node under one already created.
  *
- * ARGUMENTS:	    tree: (bitree *) -- the tree.
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
+ *		    write: (int (*)(void *, const void *, size_t)) -- the sink.
+ *		    sink: (void *) -- passed to `write'.
+ *		    serialize: (size_t (*)(const void *, void *, size_t)) --
+ *			writes a payload to a buffer.
  *
- * RETURN:	    int -- the height of the tree, or -1 if an error has
- *		    occurred.
+ * RETURN:	    int -- 0 on success, -1 on failure.
  *
- * NOTES:	    O(log(n))
+ * NOTES:	    Theta(n)
  ***/
-int bitree_height(bitree * tree)
+int bitree_journal_attach(bitree * tree,
+			  int (*write)(void * sink, const void * record,
+				       size_t size),
+			  void * sink,
+			  size_t (*serialize)(const void * data, void * buffer,
+					      size_t size))
 {
-  if (tree == NULL)
-    return 0;
+  if (tree == NULL || write == NULL || serialize == NULL
+      || tree->journal != NULL)
+    return -1;
 
-  int left = bitree_height(tree->left);
-  int right = bitree_height(tree->right);
+  struct bitree_journal * journal = new_journal();
+  if (journal == NULL)
+    return -1;
+  journal->write = write;
+  journal->sink = sink;
+  journal->serialize = serialize;
 
-  if (left > right)
-    return left + 1;
-  return right + 1;
+  struct bitree_cursor cursor;
+  bitree_cursor_init(&cursor, tree->root, BITREE_PREORDER);
+  for (bitree * node; (node = bitree_cursor_next(&cursor)) != NULL;) {
+    node->journal = journal;
+    if (node == node->root) {
+      node->id = journal->next_id++;
+      journal_emit(journal, JOURNAL_ROOT, node->id, 0, node->data);
+    } else {
+      journal_record(node, node->parent->left == node
+		     ? JOURNAL_INSL : JOURNAL_INSR);
+    }
+  }
+
+  if (journal->failed) {
+    bitree_journal_detach(tree);
+    return -1;
+  }
+  return 0;
 }
 
 /******************************************************************************
- * FUNCTION:	    bitree_distance
+ * FUNCTION:	    bitree_journal_detach
  *
- * DESCRIPTION:	    Calculate the distance from the root node.
+ * DESCRIPTION:	    Detaches the journal from the tree containing `tree', and
+ *		    frees it.
  *
- * ARGUMENTS:	    tree: (bitree *) -- the node to calculate the distance of.
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
  *
- * RETURN:	    int -- the distance from the root node, or -1 if an error
- *		    has occurred.
+ * RETURN:	    int -- 0 on success, -1 if there was no journal, or if it
+ *		    failed to write a record.
  *
- * NOTES:	    O(log(n))
+ * NOTES:	    Theta(n)
  ***/
-int bitree_distance(bitree * tree)
+int bitree_journal_detach(bitree * tree)
 {
-  if (tree == NULL)
+  if (tree == NULL || tree->journal == NULL)
     return -1;
-  return distance_helper(tree, 0);
+
+  struct bitree_journal * journal = tree->journal;
+  int failed = journal->failed;
+  struct bitree_cursor cursor;
+  bitree_cursor_init(&cursor, tree->root, BITREE_PREORDER);
+  for (bitree * node; (node = bitree_cursor_next(&cursor)) != NULL;)
+    node->journal = NULL;
+  free_journal(journal);
+  return failed ? -1 : 0;
 }
 
 /******************************************************************************
- * STATIC FUNCTIONS
+ * FUNCTION:	    bitree_journal_fd
+ *
+ * DESCRIPTION:	    Sink for bitree_journal_attach() which writes records to a
+ *		    file descriptor.
+ *
+ * ARGUMENTS:	    fd: (void *) -- pointer to the file descriptor (int).
+ *		    record: (const void *) -- the record.
+ *		    size: (size_t) -- the size of the record.
+ *
+ * RETURN:	    int -- 0 on success, -1 on failure.
+ *
+ * NOTES:	    none.
  ***/
+int bitree_journal_fd(void * fd, const void * record, size_t size)
+{
+  const unsigned char * bytes = record;
+  while (size > 0) {
+    ssize_t written = write(*(int *)fd, bytes, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written < 0)
+      return -1;
+    bytes += written;
+    size -= written;
+  }
+  return 0;
+}
 
 /******************************************************************************
- * FUNCTION:	    npreorder_helper
+ * FUNCTION:	    bitree_journal_ring
  *
- * DESCRIPTION:	    This is a helper function for bitree_npreorder(). If the
- *		    next node in traversal is not immediately accesible from
- *		    the current node, this function will find it.
+ * DESCRIPTION:	    Sink for bitree_journal_attach() which writes records to a
+ *		    ring buffer.
  *
- * ARGUMENTS:	    node: (bitree *) -- on the first call, this pointer usually
- *			contains the value of original->parent.
- *		    original: (bitree *) -- pointer to the first node passed.
+ * ARGUMENTS:	    ring: (void *) -- the struct bitree_ring.
+ *		    record: (const void *) -- the record.
+ *		    size: (size_t) -- the size of the record.
  *
- * RETURN:	    bitree * -- pointer to the next node in preorder traversal.
+ * RETURN:	    int -- 0 on success, -1 if the record doesn't fit.
  *
- * NOTES:	    none.
+ * NOTES:	    O(size)
  ***/
-static bitree * npreorder_helper(bitree * node, bitree * original)
+int bitree_journal_ring(void * ring, const void * record, size_t size)
 {
-  /* Assumptions (given from bitree_npreorder):
-   * original is not NULL
-   * there is more than one node in the tree.
-   * original->left is NULL
-   * original->right is NULL
-   */
-  if (node == NULL)
-    return original;
-  if (node->left == original && node->right == NULL)
-    return npreorder_helper(node->parent, node);
-  else if (node->left == original && node->right != NULL)
-    return node->right;
+  struct bitree_ring * buffer = ring;
+  size_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+  if (buffer->capacity - (head - tail) < size)
+    return -1;
 
-  return npreorder_helper(node->parent, node);;
+  size_t offset = head % buffer->capacity;
+  size_t first = buffer->capacity - offset < size
+    ? buffer->capacity - offset : size;
+  memcpy(buffer->buffer + offset, record, first);
+  memcpy(buffer->buffer, (const unsigned char *)record + first, size - first);
+  atomic_store_explicit(&buffer->head, head + size, memory_order_release);
+  return 0;
 }
 
 /******************************************************************************
- * FUNCTION:	    npostorder_helper
+ * FUNCTION:	    bitree_ring_init
  *
- * DESCRIPTION:	    This is a helper function for bitree_npostorder(). If the
- *		    next node in traversal is not immediately accesible from
- *		    the current node, this function will find it.
+ * DESCRIPTION:	    Sets up an empty ring buffer.
  *
- * ARGUMENTS:	    node: (bitree *) -- on the first call, this pointer usually
- *			contains the value of original->parent.
- *		    original: (bitree *) -- pointer to the first node passed.
+ * ARGUMENTS:	    ring: (struct bitree_ring *) -- the ring.
+ *		    buffer: (void *) -- its memory.
+ *		    capacity: (size_t) -- the size of `buffer'.
  *
- * RETURN:	    bitree * -- pointer to the next node in postorder traversal
+ * RETURN:	    int -- 0 on success, -1 on failure.
  *
- * NOTES:	    none.
+ * NOTES:	    Theta(1)
  ***/
-static bitree * npostorder_helper(bitree * node, bitree * original)
+int bitree_ring_init(struct bitree_ring * ring, void * buffer, size_t capacity)
+{
+  if (ring == NULL || buffer == NULL || capacity == 0)
+    return -1;
+
+  ring->buffer = buffer;
+  ring->capacity = capacity;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_ring_read
+ *
+ * DESCRIPTION:	    Reads as much as is available from a ring buffer, up to
+ *		    `size' bytes.
+ *
+ * ARGUMENTS:	    ring: (struct bitree_ring *) -- the ring.
+ *		    buffer: (void *) -- where to copy the bytes to.
+ *		    size: (size_t) -- the size of `buffer'.
+ *
+ * RETURN:	    size_t -- the number of bytes read.
+ *
+ * NOTES:	    O(size)
+ ***/
+size_t bitree_ring_read(struct bitree_ring * ring, void * buffer, size_t size)
+{
+  if (ring == NULL || buffer == NULL)
+    return 0;
+
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (size > head - tail)
+    size = head - tail;
+
+  size_t offset = tail % ring->capacity;
+  size_t first = ring->capacity - offset < size ? ring->capacity - offset : size;
+  memcpy(buffer, ring->buffer + offset, first);
+  memcpy((unsigned char *)buffer + first, ring->buffer, size - first);
+  atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+  return size;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_journal_replay
+ *
+ * DESCRIPTION:	    Applies the complete records in `records' to a replica.
+ *
+ * ARGUMENTS:	    tree: (bitree **) -- the root of the replica, or NULL.
+ *		    records: (const void *) -- the records.
+ *		    size: (size_t) -- the size of `records'.
+ *		    deserialize: (void * (*)(const void *, size_t)) -- makes a
+ *			payload from its serialized form.
+ *		    destroy: (void (*)(void *)) -- the destroy function.
+ *		    used: (size_t *) -- set to the number of bytes consumed.
+ *
+ * RETURN:	    int -- 0 on success, -1 on failure.
+ *
+ * NOTES:	    O(r), r is the number of records, plus the cost of the
+ *		    removals they make.
+ ***/
+int bitree_journal_replay(bitree ** tree, const void * records, size_t size,
+			  void * (*deserialize)(const void * buffer,
+						size_t size),
+			  void (*destroy)(void *), size_t * used)
+{
+  if (tree == NULL || (records == NULL && size > 0) || deserialize == NULL
+      || used == NULL)
+    return -1;
+
+  const unsigned char * bytes = records;
+  size_t offset = 0;
+  *used = 0;
+  while (size - offset >= JOURNAL_HEADER) {
+    struct journal_header header, next = {0};
+    memcpy(&header, bytes + offset, JOURNAL_HEADER);
+    size_t length = JOURNAL_HEADER + header.size;
+    if (size - offset < length)
+      break;
+
+    /* A new root is applied together with the merge that follows it */
+    const unsigned char * next_payload = NULL;
+    if (header.op == JOURNAL_NEWROOT) {
+      size_t rest = size - offset - length;
+      if (rest < JOURNAL_HEADER)
+	break;
+      memcpy(&next, bytes + offset + length, JOURNAL_HEADER);
+      if (rest < JOURNAL_HEADER + next.size)
+	break;
+      next_payload = bytes + offset + length + JOURNAL_HEADER;
+    }
+
+    if (replay_record(tree, &header, bytes + offset + JOURNAL_HEADER, &next,
+		      next_payload, deserialize, destroy))
+      return -1;
+    offset += length;
+    if (next_payload != NULL)
+      offset += JOURNAL_HEADER + next.size;
+    *used = offset;
+  }
+  return 0;
+}
+#endif /* CONFIG_JOURNAL */
+
+#ifdef CONFIG_ORDER_STATISTICS
+/******************************************************************************
+ * FUNCTION:	    bitree_rem_async
+ *
+ * DESCRIPTION:	    Detaches the subtree rooted at `node' from its tree, and
+ *		    queues it to be freed by a background thread. The size
+ *		    and cached fields of the tree are updated before this
+ *		    function returns.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to remove.
+ *
+ * RETURN:	    void
+ *
+ * NOTES:	    O(h), using the cached count of the subtree, or O(n) on a
+ *		    replica, whose index is updated here rather than on the
+ *		    reclaimer thread. The destroy functions run later, on the
+ *		    reclaimer thread.
+ ***/
+void bitree_rem_async(bitree * node)
 {
   if (node == NULL)
-    return original;
+    return;
 
-  /* We're recursing downwards */
-  if (node->parent == original) {
-    if (bitree_isleaf(node))
-      return node;
-    if (node->left != NULL)
-      return npostorder_helper(node->left, node);
-    if (node->right != NULL)
-      return npostorder_helper(node->right, node);
+  journal_remove(node);
+  detach(node);
+  pthread_mutex_lock(&reclaimer.lock);
+  /* While bitree_reclaim_flush() is stopping the thread, or if it can't be
+   * started, the subtree is freed here instead.
+   */
+  if (!reclaimer.running && !reclaimer.stop
+      && pthread_create(&reclaimer.thread, NULL, reclaim_thread, NULL) == 0)
+    reclaimer.running = 1;
+  if (!reclaimer.running || reclaimer.stop) {
+    pthread_mutex_unlock(&reclaimer.lock);
+    struct destroy_buffer buffer = {0};
+    reclaim(node, &buffer);
+    flush_data(&buffer);
+    return;
   }
-  /* We're recursing upwards */
-  else if (original->parent == node) {
-    if (node->right == original)
-      return node;
-    else if (node->right != NULL)
-      return npostorder_helper(node->right, node);
+
+  node->parent = reclaimer.queue;
+  reclaimer.queue = node;
+  pthread_cond_signal(&reclaimer.wake);
+  pthread_mutex_unlock(&reclaimer.lock);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_reclaim_flush
+ *
+ * DESCRIPTION:	    Waits until every subtree passed to bitree_rem_async() has
+ *		    been freed, then stops the reclaimer thread.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    void
+ *
+ * NOTES:	    O(n), n is the number of nodes still queued.
+ ***/
+void bitree_reclaim_flush(void)
+{
+  pthread_mutex_lock(&flush_lock);
+  pthread_mutex_lock(&reclaimer.lock);
+  if (!reclaimer.running) {
+    pthread_mutex_unlock(&reclaimer.lock);
+    pthread_mutex_unlock(&flush_lock);
+    return;
   }
 
-  return NULL;
+  reclaimer.stop = 1;
+  pthread_cond_signal(&reclaimer.wake);
+  pthread_mutex_unlock(&reclaimer.lock);
+
+  pthread_join(reclaimer.thread, NULL);
+
+  pthread_mutex_lock(&reclaimer.lock);
+  reclaimer.running = 0;
+  reclaimer.stop = 0;
+  pthread_mutex_unlock(&reclaimer.lock);
+  pthread_mutex_unlock(&flush_lock);
 }
 
 /******************************************************************************
- * FUNCTION:	    ninorder_helper
+ * FUNCTION:	    bitree_rem_begin
  *
- * DESCRIPTION:	    This is a helper function for bitree_ninorder(). If the
- *		    next node in traversal is not immediately accesible from
- *		    the current node, this function will find it.
+ * DESCRIPTION:	    Detaches the subtree rooted at `node' from its tree, so
+ *		    that it can be freed a few nodes at a time with
+ *		    bitree_rem_step(). The size and cached fields of the tree
+ *		    are updated before this function returns.
  *
- * ARGUMENTS:	    node: (bitree *) -- on the first call, this pointer usually
- *			contains the value of original->parent.
- *		    original: (bitree *) -- pointer to the first node passed.
+ * ARGUMENTS:	    node: (bitree *) -- the node to remove.
  *
- * RETURN:	    bitree * -- pointer to the next node in inorder traversal.
+ * RETURN:	    struct bitree_rem_handle * -- the handle for
+ *		    bitree_rem_step(), or NULL if `node' is NULL, or if there
+ *		    was no memory for it. In that case, the subtree has already
+ *		    been removed.
  *
- * NOTES:	    none.
+ * NOTES:	    O(h), using the cached count of the subtree, or O(n) on a
+ *		    replica, whose index must forget the subtree.
  ***/
-static bitree * ninorder_helper(bitree * node, bitree * original)
+struct bitree_rem_handle * bitree_rem_begin(bitree * node)
 {
   if (node == NULL)
-    return original;
+    return NULL;
 
-  /* Recursing down the left tree */
-  if (original->left == node) {
-    if (node->left == NULL)
-      return node;
-    return ninorder_helper(node->left, node);
+  journal_remove(node);
+  detach(node);
+  struct bitree_rem_handle * handle = malloc(sizeof(struct bitree_rem_handle));
+  if (handle == NULL) {
+    struct destroy_buffer buffer = {0};
+    reclaim(node, &buffer);
+    flush_data(&buffer);
+    return NULL;
   }
-  /* Recursing down the right tree */
-  else if (original->right == node) {
-    if (node->left != NULL)
-      return ninorder_helper(node->left, node);
-    return node;
+
+  handle->node = node;
+  return handle;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_rem_step
+ *
+ * DESCRIPTION:	    Frees up to `budget' nodes of a subtree detached by
+ *		    bitree_rem_begin(). Each step frees a leaf, and then
+ *		    continues from its parent, so no stack is needed between
+ *		    calls.
+ *
+ * ARGUMENTS:	    handle: (struct bitree_rem_handle *) -- the handle.
+ *		    budget: (size_t) -- the most nodes to free.
+ *
+ * RETURN:	    int -- 1 if some of the subtree remains, 0 if all of it has
+ *		    been freed. In that case, the handle is freed too.
+ *
+ * NOTES:	    O(budget + h). Freeing a whole subtree is Theta(n) in
+ *		    total.
+ ***/
+int bitree_rem_step(struct bitree_rem_handle * handle, size_t budget)
+{
+  if (handle == NULL)
+    return 0;
+
+  bitree * node = handle->node;
+  struct destroy_buffer buffer = {0};
+  for (; budget > 0 && node != NULL; budget--) {
+    while (!bitree_isleaf(node))
+      node = node->left != NULL ? node->left : node->right;
+
+    bitree * parent = node->parent;
+    if (parent != NULL) {
+      if (parent->left == node)
+	parent->left = NULL;
+      else
+	parent->right = NULL;
+    }
+    reclaim_node(node, &buffer);
+    node = parent;
   }
-  /* Recursing upwards */
-  else if (original->parent == node && node->root->right != original) {
-    if (node->left == original)
-      return node;
-    if (node->right == original)
-      return ninorder_helper(node->parent, node);
+  flush_data(&buffer);
+
+  if (node == NULL) {
+    free(handle);
+    return 0;
   }
 
-  return ninorder_helper(node->root->left, node->root);
+  handle->node = node;
+  return 1;
 }
+#endif /* CONFIG_ORDER_STATISTICS */
 
 /******************************************************************************
- * FUNCTION:	    nlevelorder_helper
+ * FUNCTION:	    bitree_retain
  *
- * DESCRIPTION:	    Helper function for bitree_nlevelorder(). This function
- *		    implements the recursive functionality and extends the
- *		    interface presented by bitree_nlevelorder(). If the next
- *		    node is not immediately accessible from the first, this
- *		    function will find it.
+ * DESCRIPTION:	    Removes the nodes of the subtree at `*tree' whose payloads
+ *		    fail `pred', and their subtrees. The walk is in postorder,
+ *		    so that the cached fields of a node can be updated once
+ *		    its children are final. Only the nodes which lost a
+ *		    descendant are updated.
  *
- * ARGUMENTS:	    node: (bitree *) -- the current node.
- *		    old: (bitree *) -- the node we came from.
- *		    dist: (int) -- the distance of the current node from root.
- *		    goal: (int) -- the distance of the original node from root.
+ * ARGUMENTS:	    tree: (bitree **) -- root of the subtree.
+ *		    pred: (int (*)(const void *, void *)) -- the predicate.
+ *		    ctx: (void *) -- passed to the predicate.
  *
- * RETURN:	    bitree * -- Hopefully, the next node. If there's a problem,
- *		    return NULL.
+ * RETURN:	    int -- the number of nodes removed, or -1 on error.
  *
- * NOTES:	    None.
+ * NOTES:	    O(n), n is the size of the subtree, plus O(h) to update the
+ *		    ancestors of `*tree'.
  ***/
-static bitree * nlevelorder_helper(bitree * node, bitree * old,
-				   int dist, int goal)
+int bitree_retain(bitree ** tree, int (*pred)(const void * data, void * ctx),
+		  void * ctx)
 {
-  if (node == NULL || old == NULL)
-    return NULL; /* Never say never */
-  if (dist == goal)
-    return node;
+  if (tree == NULL || *tree == NULL || pred == NULL)
+    return -1;
 
-  if (old == node->left) {
-      return nlevelorder_helper(node->right ? node->right : node->parent,
-				node, node->right ? dist + 1 : dist - 1, goal);
-  } else if (old == node->right) {
-    if (node->root != node)
-      return nlevelorder_helper(node->parent, node, dist - 1, goal);
-    return nlevelorder_helper(node->left, node, dist + 1, goal + 1);
-  } else if (old == node->parent) {
-    bitree * next = node->left ? node->left : node->right;
-    return next ? nlevelorder_helper(next, node, dist + 1, goal) : node->root;
+  bitree * above = (*tree)->parent;
+  int * size = (*tree)->size, whole = (*tree)->root == *tree;
+  struct retain retain = {.pred = pred, .ctx = ctx, .tree = tree};
+  retain_helper(*tree, &retain);
+  flush_data(&retain.buffer);
+
+  /* If the whole tree was removed, reclaim() has freed its size */
+  if (!whole || *tree != NULL)
+    *size -= retain.removed;
+  if (retain.removed > 0)
+    update_path(above);
+  return retain.removed;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_walk
+ *
+ * DESCRIPTION:	    Visits the subtree rooted at `tree' in the order given,
+ *		    until the visitor asks it to stop.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    order: (enum bitree_order) -- the order.
+ *		    visit: (enum bitree_visit (*)(bitree *, void *)) -- the
+ *			visitor.
+ *		    ctx: (void *) -- passed to the visitor.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 if it finished, -1 on
+ *		    error.
+ *
+ * NOTES:	    O(n), n is the size of the subtree. O(1) extra memory,
+ *		    except in level order.
+ ***/
+int bitree_walk(bitree * tree, enum bitree_order order,
+		enum bitree_visit (*visit)(bitree * node, void * ctx),
+		void * ctx)
+{
+  if (tree == NULL || visit == NULL)
+    return -1;
+
+  switch (order) {
+  case BITREE_PREORDER:
+    return walk_preorder(tree, visit, ctx);
+  case BITREE_INORDER:
+    return walk_inorder(tree, visit, ctx);
+  case BITREE_POSTORDER:
+    return walk_postorder(tree, visit, ctx);
+  case BITREE_LEVELORDER:
+    return walk_levelorder(tree, visit, ctx);
+  default:
+    return -1;
   }
-  return NULL;
 }
 
 /******************************************************************************
- * FUNCTION:	    update_size
+ * FUNCTION:	    bitree_find_if
  *
- * DESCRIPTION:	    Called by bitree_merge to recursively update the 'size' and
- *		    'root' parameter in each node of the tree.
+ * DESCRIPTION:	    Searches the subtree rooted at `tree' for a node whose
+ *		    payload satisfies `pred'.
  *
- * ARGUMENTS:	    node: (bitree *) -- the node to update
- *		    size: (int *) -- pointer to the new size int.
- *		    root: (bitree *) -- new root for the merged tree
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    order: (enum bitree_order) -- the order to search in.
+ *		    pred: (int (*)(const void *, void *)) -- the predicate.
+ *		    ctx: (void *) -- passed to the predicate.
  *
- * RETURN:	    int -- 0 on success, -1 otherwise.
+ * RETURN:	    bitree * -- the first node found, or NULL.
  *
- * NOTES:	    none.
+ * NOTES:	    O(n), n is the size of the subtree.
  ***/
-static int update_size(bitree * node, int * size, bitree * root)
+bitree * bitree_find_if(bitree * tree, enum bitree_order order,
+			int (*pred)(const void * data, void * ctx),
+			void * ctx)
 {
-  if (node == NULL)
-    return 0;
-  node->size = size;
-  node->root = root;
-  update_size(node->left, size, root);
-  update_size(node->right, size, root);
+  if (pred == NULL)
+    return NULL;
+
+  struct find_if_spec spec = { .pred = pred, .ctx = ctx, .found = NULL };
+  if (bitree_walk(tree, order, find_if_visit, &spec) != 1)
+    return NULL;
+  return spec.found;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_cursor_init
+ *
+ * DESCRIPTION:	    Starts a traversal of the subtree rooted at `top'.
+ *
+ * ARGUMENTS:	    cursor: (struct bitree_cursor *) -- the cursor.
+ *		    top: (bitree *) -- root of the subtree.
+ *		    order: (enum bitree_order) -- the order.
+ *
+ * RETURN:	    int -- 0 on success, -1 on error or if `order' is
+ *		    BITREE_LEVELORDER.
+ *
+ * NOTES:	    O(h), h is the height of the subtree.
+ ***/
+int bitree_cursor_init(struct bitree_cursor * cursor, bitree * top,
+		       enum bitree_order order)
+{
+  if (cursor == NULL || top == NULL)
+    return -1;
+
+  switch (order) {
+  case BITREE_PREORDER:
+    cursor->next = top;
+    break;
+  case BITREE_INORDER:
+    cursor->next = inorder_first(top);
+    break;
+  case BITREE_POSTORDER:
+    cursor->next = postorder_first(top);
+    break;
+  default:
+    return -1;
+  }
+
+  cursor->top = top;
+  cursor->order = order;
   return 0;
 }
 
 /******************************************************************************
- * FUNCTION:	    distance_helper
+ * FUNCTION:	    bitree_cursor_next
  *
- * DESCRIPTION:	    Helper function for bitree_distance--does the recurstion
+ * DESCRIPTION:	    Returns the next node of a traversal, and advances the
+ *		    cursor past it.
  *
- * ARGUMENTS:	    node: (bitree *) -- the current node (during recursion)
- *		    distance: (int) -- the current distance from the root.
+ * ARGUMENTS:	    cursor: (struct bitree_cursor *) -- the cursor.
  *
- * RETURN:	    int -- (hopefully) the distance from the root node. -1 if
- *		    an error has occurred.
+ * RETURN:	    bitree * -- the next node, or NULL if the traversal is over.
  *
- * NOTES:	    none.
+ * NOTES:	    Amortized Theta(1), O(h) worst case, h is the height of the
+ *		    subtree.
  ***/
-static int distance_helper(bitree * node, int distance)
+bitree * bitree_cursor_next(struct bitree_cursor * cursor)
 {
-  if (node == NULL)
+  if (cursor == NULL || cursor->next == NULL)
+    return NULL;
+
+  bitree * node = cursor->next;
+  switch (cursor->order) {
+  case BITREE_PREORDER:
+    cursor->next = preorder_next(node, cursor->top, 1);
+    break;
+  case BITREE_INORDER:
+    cursor->next = inorder_next(node, cursor->top, 1);
+    break;
+  default:
+    cursor->next = postorder_next(node, cursor->top);
+    break;
+  }
+  return node;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_next_batch
+ *
+ * DESCRIPTION:	    Returns the next nodes of a traversal, and advances the
+ *		    cursor past them.
+ *
+ * ARGUMENTS:	    cursor: (struct bitree_cursor *) -- the cursor.
+ *		    out: (bitree **) -- where to store the nodes.
+ *		    n: (size_t) -- the most nodes to store.
+ *
+ * RETURN:	    size_t -- the number of nodes stored.
+ *
+ * NOTES:	    Amortized Theta(n). The order is looked at once per batch,
+ *		    rather than once per node.
+ ***/
+size_t bitree_next_batch(struct bitree_cursor * cursor, bitree ** out,
+			 size_t n)
+{
+  if (cursor == NULL || out == NULL)
+    return 0;
+
+  bitree * node = cursor->next;
+  bitree * top = cursor->top;
+  size_t count = 0;
+  switch (cursor->order) {
+  case BITREE_PREORDER:
+    for (; count < n && node != NULL; node = preorder_next(node, top, 1))
+      out[count++] = node;
+    break;
+  case BITREE_INORDER:
+    for (; count < n && node != NULL; node = inorder_next(node, top, 1))
+      out[count++] = node;
+    break;
+  default:
+    for (; count < n && node != NULL; node = postorder_next(node, top))
+      out[count++] = node;
+    break;
+  }
+
+  cursor->next = node;
+  return count;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_walk_many
+ *
+ * DESCRIPTION:	    Walks several subtrees, interleaving the walks so that
+ *		    the memory latency of one is hidden behind the work of the
+ *		    others.
+ *
+ * ARGUMENTS:	    trees: (bitree **) -- the roots of the subtrees.
+ *		    n: (size_t) -- the number of subtrees.
+ *		    order: (enum bitree_order) -- the order of the walks.
+ *		    visit: (enum bitree_visit (*)(bitree *, void *)) -- the
+ *			visitor.
+ *		    ctxs: (void **) -- passed to the visitor, one per walk, or
+ *			NULL.
+ *		    group: (size_t) -- the number of walks to interleave.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(N), N is the total size of the subtrees. Each turn of a
+ *		    walk does one step of it: reading a node, and prefetching
+ *		    its payload and children, or visiting it, and prefetching
+ *		    the next one. A preorder walk goes to a child or to the
+ *		    right child of an ancestor, so its steps are one miss at
+ *		    most; the first node of an inorder or postorder walk, and
+ *		    the leftmost descent to the next one, are read in a single
+ *		    turn.
+ ***/
+int bitree_walk_many(bitree ** trees, size_t n, enum bitree_order order,
+		     enum bitree_visit (*visit)(bitree * node, void * ctx),
+		     void ** ctxs, size_t group)
+{
+  if ((n > 0 && trees == NULL) || visit == NULL
+      || (order != BITREE_PREORDER && order != BITREE_INORDER
+	  && order != BITREE_POSTORDER)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct interleave_slot slots[INTERLEAVE_MAX];
+  size_t active = 0, next = 0;
+  group = interleave_group(group);
+  while (active < group && next < n) {
+    start_slot(&slots[active++], walk_first(trees[next], order), trees[next],
+	       next);
+    next++;
+  }
+
+  while (active > 0) {
+    for (size_t s = 0; s < active;) {
+      struct interleave_slot * slot = &slots[s];
+      bitree * node = slot->node;
+      if (node != NULL && !slot->loaded) {
+	__builtin_prefetch(node->data);
+	if (node->left != NULL)
+	  __builtin_prefetch(node->left);
+	if (node->right != NULL)
+	  __builtin_prefetch(node->right);
+	slot->loaded = 1;
+	s++;
+	continue;
+      }
+
+      if (node != NULL) {
+	enum bitree_visit result = visit(node, ctxs != NULL
+					 ? ctxs[slot->index] : NULL);
+	if (result == BITREE_STOP)
+	  node = NULL;
+	else if (order == BITREE_PREORDER)
+	  node = preorder_next(node, slot->top, result == BITREE_CONTINUE);
+	else if (order == BITREE_INORDER)
+	  node = inorder_next(node, slot->top, result == BITREE_CONTINUE);
+	else
+	  node = postorder_next(node, slot->top);
+
+	if (node != NULL) {
+	  __builtin_prefetch(node);
+	  slot->node = node;
+	  slot->loaded = 0;
+	  s++;
+	  continue;
+	}
+      }
+
+      /* This walk is over; start the next one in its place */
+      if (next < n) {
+	start_slot(slot, walk_first(trees[next], order), trees[next], next);
+	next++;
+	s++;
+      } else {
+	*slot = slots[--active];
+      }
+    }
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_descend_many
+ *
+ * DESCRIPTION:	    Descends from several nodes, interleaving the descents as
+ *		    bitree_walk_many() interleaves walks.
+ *
+ * ARGUMENTS:	    trees: (bitree **) -- the nodes to start from.
+ *		    n: (size_t) -- the number of descents.
+ *		    steer: (int (*)(const void *, void *)) -- chooses the
+ *			direction at each node.
+ *		    ctxs: (void **) -- passed to `steer', one per descent, or
+ *			NULL.
+ *		    found: (bitree **) -- where each descent ended.
+ *		    group: (size_t) -- the number of descents to interleave.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(N), N is the total length of the descents. Each node
+ *		    takes two turns: one to read it and prefetch its payload,
+ *		    and one to steer, and prefetch the child chosen.
+ ***/
+int bitree_descend_many(bitree ** trees, size_t n,
+			int (*steer)(const void * data, void * ctx),
+			void ** ctxs, bitree ** found, size_t group)
+{
+  if ((n > 0 && (trees == NULL || found == NULL)) || steer == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct interleave_slot slots[INTERLEAVE_MAX];
+  size_t active = 0, next = 0;
+  group = interleave_group(group);
+  while (active < group && next < n) {
+    start_slot(&slots[active++], trees[next], trees[next], next);
+    next++;
+  }
+
+  while (active > 0) {
+    for (size_t s = 0; s < active;) {
+      struct interleave_slot * slot = &slots[s];
+      bitree * node = slot->node;
+      if (node != NULL && !slot->loaded) {
+	__builtin_prefetch(node->data);
+	slot->loaded = 1;
+	s++;
+	continue;
+      }
+
+      int way = 0;
+      if (node != NULL
+	  && (way = steer(node->data, ctxs != NULL ? ctxs[slot->index]
+			  : NULL)) != 0) {
+	slot->node = way < 0 ? node->left : node->right;
+	if (slot->node != NULL)
+	  __builtin_prefetch(slot->node);
+	slot->loaded = 0;
+	s++;
+	continue;
+      }
+
+      /* This descent is over; start the next one in its place */
+      found[slot->index] = node;
+      if (next < n) {
+	start_slot(slot, trees[next], trees[next], next);
+	next++;
+	s++;
+      } else {
+	*slot = slots[--active];
+      }
+    }
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_update
+ *
+ * DESCRIPTION:	    Updates the cached fields of `node' and its ancestors after
+ *		    the payload of `node' has been modified in place.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node whose payload changed.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(h), h is the height of the tree.
+ ***/
+void bitree_update(bitree * node)
+{
+  if (node == NULL)
+    return;
+  update_path(node);
+  journal_update(node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_clone
+ *
+ * DESCRIPTION:	    Copies the subtree rooted at `tree' into a new tree.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree to copy.
+ *		    copy: (void * (*)(const void *)) -- function that copies a
+ *			payload, or NULL to share them.
+ *
+ * RETURN:	    bitree * -- the new tree, or NULL.
+ *
+ * NOTES:	    Theta(n), n is the size of the subtree
+ ***/
+bitree * bitree_clone(bitree * tree, void * (*copy)(const void *))
+{
+  if (tree == NULL)
+    return NULL;
+
+  /* Shared payloads would be freed by both trees */
+  if (copy == NULL && tree->destroy != NULL)
+    return NULL;
+#ifdef CONFIG_DESTROY_BATCH
+  if (copy == NULL && tree->destroy_batch != NULL)
+    return NULL;
+#endif
+  return clone_tree(tree, copy, tree->destroy, 1);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_map
+ *
+ * DESCRIPTION:	    Copies the shape of the subtree rooted at `tree' into a new
+ *		    tree, with payloads transformed by `map'.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree to copy.
+ *		    map: (void * (*)(const void *)) -- function that makes the
+ *			new payload from the old one.
+ *		    destroy: (void (*)(void *)) -- destroy function for the
+ *			new tree (can be NULL).
+ *
+ * RETURN:	    bitree * -- the new tree, or NULL.
+ *
+ * NOTES:	    Theta(n), n is the size of the subtree
+ ***/
+bitree * bitree_map(bitree * tree, void * (*map)(const void *),
+		    void (*destroy)(void *))
+{
+  if (tree == NULL || map == NULL)
+    return NULL;
+  return clone_tree(tree, map, destroy, 0);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_merge
+ *
+ * DESCRIPTION:	    Merges two bitrees, without splicing them into each other.
+ *		    This implementation is unordered, so we make no attempt
+ *		    to balance the tree when merging.
+ *
+ * ARGUMENTS:	    tree1: (bitree *) -- the host tree
+ *		    tree2: (bitree *) -- the tree to splice in
+ *		    data: (void *) -- this param is used only when a new node
+ *			needs to be created in order to merge the trees.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(m + n), Omega(n); m = *(tree1->size), n = *(tree2->size)
+ ***/
+int bitree_merge(bitree * tree1, bitree * tree2, void * data)
+{
+  /* Test for bad inputs */
+  if (tree1 == NULL
+      || tree2 == NULL
+      || tree2->root != tree2
+      || tree1->root == tree2->root
+      || tree1->destroy != tree2->destroy)
+    return -1;
+#ifdef CONFIG_SUBTREE_AGGREGATE
+  if (tree1->aggregate != tree2->aggregate)
+    return -1;
+#endif
+#ifdef CONFIG_DESTROY_BATCH
+  if (tree1->destroy_batch != tree2->destroy_batch)
+    return -1;
+#endif
+#ifdef CONFIG_MERKLE_HASH
+  if (tree1->hash_data != tree2->hash_data)
+    return -1;
+#endif
+#ifdef CONFIG_JOURNAL
+  if (tree2->journal != NULL)
+    return -1;
+#endif
+
+  /* Test for case 1 */
+  if (tree1->root == tree1
+      && tree1->left != NULL
+      && tree1->right != NULL
+      && data) {
+
+    bitree * newroot = bitree_create(tree1->destroy, data);
+    if (newroot == NULL)
+      return -1;
+#ifdef CONFIG_SUBTREE_AGGREGATE
+    newroot->aggregate = tree1->aggregate;
+#endif
+#ifdef CONFIG_DESTROY_BATCH
+    newroot->destroy_batch = tree1->destroy_batch;
+#endif
+#ifdef CONFIG_MERKLE_HASH
+    newroot->hash_data = tree1->hash_data;
+#endif
+#ifdef CONFIG_JOURNAL
+    newroot->journal = tree1->journal;
+#endif
+    *(newroot->size) += *(tree1->size) + *(tree2->size);
+
+    newroot->left = tree1;
+    tree1->parent = newroot;
+
+    newroot->right = tree2;
+    tree2->parent = newroot;
+
+    free(tree1->size);
+    free(tree2->size);
+
+    /* Recursively update `size' and `root' */
+    update_size(newroot, newroot->size, newroot);
+    update_cache(newroot);
+#ifdef CONFIG_JOURNAL
+    journal_merge(tree2, newroot);
+#endif
+  }
+  /* Test for case 2 & case 3 */
+  else if (tree1->left == NULL || tree1->right == NULL) {
+
+    if (tree1->left == NULL)
+      tree1->left = tree2;
+    else
+      tree1->right = tree2;
+
+    tree2->parent = tree1;
+    *(tree1->root->size) += *(tree2->size);
+    free(tree2->size);
+
+    /* Recursively update `size' and `root' */
+    update_size(tree2, tree1->root->size, tree1->root);
+    update_path(tree1);
+#ifdef CONFIG_JOURNAL
+    journal_merge(tree2, NULL);
+#endif
+
+  } else {
+    return -1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_npreorder
+ *
+ * DESCRIPTION:	    This function returns the next node that would be operated
+ *		    on if the tree were being traversed with a preorder
+ *		    algorithm. See the documentation for an example of how this
+ *		    function could be used.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *
+ * RETURN:	    bitree * -- pointer to the next node, or NULL if there was
+ *		    a problem.
+ *
+ * NOTES:	    Omega(1), O(log(n))
+ *		    THIS IS NOT A TRAVERSAL FUNCTION. It does not 'traverse'
+ *		    the tree in a traditional sense. See the documentation in
+ *		    the header file.
+ ***/
+bitree * bitree_npreorder(bitree * node)
+{
+  if (node == NULL || *(node->size) == 1)
+    return node;
+
+  if (node->left != NULL)
+    return node->left;
+  if (node->right != NULL)
+    return node->right;
+  return npreorder_helper(node->parent, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_npostorder
+ *
+ * DESCRIPTION:	    This function returns the next node that would be operated
+ *		    on if the tree were being traversed with a postorder
+ *		    algorithm. See the documentation for an example of how this
+ *		    function could be used.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *
+ * RETURN:	    bitree * -- pointer to the next node, or NULL if there was
+ *		    a problem.
+ *
+ * NOTES:	    Omega(1), O(log(n))
+ *		    THIS IS NOT A TRAVERSAL FUNCTION. It does not 'traverse'
+ *		    the tree in a traditional sense. See the documentation in
+ *		    the header file.
+ *		    Post-Order traversals begin at the leftmost node. The user
+ *		    should keep this in mind when using this function.
+ ***/
+bitree * bitree_npostorder(bitree * node)
+{
+  if (node == NULL || *(node->size) == 1)
+    return node;
+  if (node == node->root)
+    return npostorder_helper(node->left, node);
+  return npostorder_helper(node->parent, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_ninorder
+ *
+ * DESCRIPTION:	    This function returns the next node that would be operated
+ *		    on if the tree were being traversed with a inorder
+ *		    algorithm. See the documentation for an example of how this
+ *		    function could be used.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *
+ * RETURN:	    bitree * -- pointer to the next node, or NULL if there was
+ *		    a problem.
+ *
+ * NOTES:	    Omega(1), O(log(n))
+ *		    THIS IS NOT A TRAVERSAL FUNCTION. It does not 'traverse'
+ *		    the tree in a traditional sense. See the documentation in
+ *		    the header file.
+ *		    In-Order traversals begin at the leftmost node. The user
+ *		    should keep this in mind when using this function.
+ ***/
+bitree * bitree_ninorder(bitree * node)
+{
+  if (node == NULL || *(node->size) == 1)
+    return node;
+  if (node->right != NULL)
+    return ninorder_helper(node->right, node);
+  return ninorder_helper(node->parent, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_nlevelorder
+ *
+ * DESCRIPTION:	    This function returns the next node that would be operated
+ *		    on if the tree were being traversed with a level-order (or
+ *		    breadth-first) traversal. See the documentation for an
+ *		    example of how this function could be used.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *
+ * RETURN:	    bitree * -- pointer to the next node, or NULL if there was
+ *		    a problem.
+ *
+ * NOTES:	    Omega(1), O(log(n))
+ *		    THIS IS NOT A TRAVERSAL FUNCTION. It does not 'traverse'
+ *		    the tree in a traditional sense. See the documentation in
+ *		    the header file.
+ ***/
+bitree * bitree_nlevelorder(bitree * node)
+{
+  if (node == NULL)
+    return NULL;
+  if (*(node->size) == 1)
+    return node;
+  if (node == node->root)
+    return node->left;
+  int dist = bitree_distance(node);
+  return nlevelorder_helper(node->parent, node, dist - 1, dist);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_height
+ *
+ * DESCRIPTION:	    This function calculates the height of the tree.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the tree.
+ *
+ * RETURN:	    int -- the height of the tree, or -1 if an error has
+ *		    occurred.
+ *
+ * NOTES:	    O(log(n))
+ ***/
+int bitree_height(bitree * tree)
+{
+  if (tree == NULL)
+    return 0;
+
+  int left = bitree_height(tree->left);
+  int right = bitree_height(tree->right);
+
+  if (left > right)
+    return left + 1;
+  return right + 1;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_distance
+ *
+ * DESCRIPTION:	    Calculate the distance from the root node.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the node to calculate the distance of.
+ *
+ * RETURN:	    int -- the distance from the root node, or -1 if an error
+ *		    has occurred.
+ *
+ * NOTES:	    O(log(n))
+ ***/
+int bitree_distance(bitree * tree)
+{
+  if (tree == NULL)
+    return -1;
+  return distance_helper(tree, 0);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_rotl
+ *
+ * DESCRIPTION:	    Rotates the subtree at `node' to the left, so that its
+ *		    right child takes its place. If `node' is the root of the
+ *		    tree, the payloads of the two nodes are exchanged instead
+ *		    of moving the root, so that `root' and `size' stay valid in
+ *		    every node of the tree.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to rotate.
+ *
+ * RETURN:	    bitree * -- the node which now occupies the position that
+ *		    `node' occupied, or NULL if `node' has no right child.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree * bitree_rotl(bitree * node)
+{
+  if (node == NULL || node->right == NULL)
+    return NULL;
+
+  journal_rotate(node, JOURNAL_ROTL);
+  bitree * pivot = node->right;
+  check_node(node);
+  check_node(pivot);
+
+  if (node->root == node) {
+    swap_data(node, pivot);
+    node->right = pivot->right;
+    if (node->right != NULL)
+      node->right->parent = node;
+    pivot->right = pivot->left;
+    pivot->left = node->left;
+    if (pivot->left != NULL)
+      pivot->left->parent = pivot;
+    node->left = pivot;
+
+    bitree_update_height(pivot);
+    bitree_update_height(node);
+    update_cache(pivot);
+    update_cache(node);
+    check_node(pivot);
+    check_node(node);
+    return node;
+  }
+
+  node->right = pivot->left;
+  if (node->right != NULL)
+    node->right->parent = node;
+
+  pivot->parent = node->parent;
+  if (node->parent->left == node)
+    node->parent->left = pivot;
+  else
+    node->parent->right = pivot;
+
+  pivot->left = node;
+  node->parent = pivot;
+
+  bitree_update_height(node);
+  bitree_update_height(pivot);
+  update_cache(node);
+  update_cache(pivot);
+  invalidate_path(pivot->parent);
+  check_node(node);
+  check_node(pivot);
+  check_node(pivot->parent);
+  return pivot;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_rotr
+ *
+ * DESCRIPTION:	    The mirror image of bitree_rotl(). Rotates the subtree at
+ *		    `node' to the right, so that its left child takes its
+ *		    place.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to rotate.
+ *
+ * RETURN:	    bitree * -- the node which now occupies the position that
+ *		    `node' occupied, or NULL if `node' has no left child.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree * bitree_rotr(bitree * node)
+{
+  if (node == NULL || node->left == NULL)
+    return NULL;
+
+  journal_rotate(node, JOURNAL_ROTR);
+  bitree * pivot = node->left;
+  check_node(node);
+  check_node(pivot);
+
+  if (node->root == node) {
+    swap_data(node, pivot);
+    node->left = pivot->left;
+    if (node->left != NULL)
+      node->left->parent = node;
+    pivot->left = pivot->right;
+    pivot->right = node->right;
+    if (pivot->right != NULL)
+      pivot->right->parent = pivot;
+    node->right = pivot;
+
+    bitree_update_height(pivot);
+    bitree_update_height(node);
+    update_cache(pivot);
+    update_cache(node);
+    check_node(pivot);
+    check_node(node);
+    return node;
+  }
+
+  node->left = pivot->right;
+  if (node->left != NULL)
+    node->left->parent = node;
+
+  pivot->parent = node->parent;
+  if (node->parent->left == node)
+    node->parent->left = pivot;
+  else
+    node->parent->right = pivot;
+
+  pivot->right = node;
+  node->parent = pivot;
+
+  bitree_update_height(node);
+  bitree_update_height(pivot);
+  update_cache(node);
+  update_cache(pivot);
+  invalidate_path(pivot->parent);
+  check_node(node);
+  check_node(pivot);
+  check_node(pivot->parent);
+  return pivot;
+}
+
+#ifdef CONFIG_ORDER_STATISTICS
+/******************************************************************************
+ * FUNCTION:	    bitree_select
+ *
+ * DESCRIPTION:	    Finds the `k'th node of the subtree rooted at `tree', in the
+ *		    order given, by descending from `tree' and using the subtree
+ *		    counts to decide which way to go.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    k: (int) -- the zero-based index of the node to find.
+ *		    order: (enum bitree_order) -- BITREE_PREORDER,
+ *			BITREE_INORDER or BITREE_POSTORDER.
+ *
+ * RETURN:	    bitree * -- the node, or NULL if `k' is out of range or the
+ *		    order is not supported.
+ *
+ * NOTES:	    O(h), h is the height of the subtree.
+ ***/
+bitree * bitree_select(bitree * tree, int k, enum bitree_order order)
+{
+  if (tree == NULL || k < 0 || k >= tree->count)
+    return NULL;
+
+  while (1) {
+    int left = node_count(tree->left);
+    switch (order) {
+    case BITREE_PREORDER:
+      if (k == 0)
+	return tree;
+      k -= 1;
+      if (k < left) {
+	tree = tree->left;
+      } else {
+	k -= left;
+	tree = tree->right;
+      }
+      break;
+
+    case BITREE_INORDER:
+      if (k == left)
+	return tree;
+      if (k < left) {
+	tree = tree->left;
+      } else {
+	k -= left + 1;
+	tree = tree->right;
+      }
+      break;
+
+    case BITREE_POSTORDER:
+      if (k == tree->count - 1)
+	return tree;
+      if (k < left) {
+	tree = tree->left;
+      } else {
+	k -= left;
+	tree = tree->right;
+      }
+      break;
+
+    default:
+      return NULL;
+    }
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_rank
+ *
+ * DESCRIPTION:	    Calculates the position of `node' in the in-order sequence
+ *		    of its tree. This is the inverse of bitree_select() on the
+ *		    root with BITREE_INORDER.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *
+ * RETURN:	    int -- the zero-based rank of `node', or -1 if `node' is
+ *		    NULL.
+ *
+ * NOTES:	    O(h), h is the height of the tree.
+ ***/
+int bitree_rank(bitree * node)
+{
+  if (node == NULL)
+    return -1;
+
+  int rank = node_count(node->left);
+  for (; node->parent != NULL; node = node->parent) {
+    if (node->parent->right == node)
+      rank += node_count(node->parent->left) + 1;
+  }
+
+  return rank;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_sample
+ *
+ * DESCRIPTION:	    Chooses a node of the subtree rooted at `tree' uniformly at
+ *		    random. Draws from the generator which fall in the partial
+ *		    block of 2^64 mod n values at the bottom of its range are
+ *		    rejected, so that every position is equally likely.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    state: (uint64_t *) -- the state of the generator, which is
+ *			advanced. Any value is a valid seed.
+ *
+ * RETURN:	    bitree * -- the node, or NULL if `tree' or `state' is NULL.
+ *
+ * NOTES:	    O(h), h is the height of the subtree. Fewer than two draws
+ *		    are needed on average, whatever the size of the subtree.
+ ***/
+bitree * bitree_sample(bitree * tree, uint64_t * state)
+{
+  if (tree == NULL || state == NULL)
+    return NULL;
+
+  uint64_t n = (uint64_t)tree->count;
+  uint64_t threshold = -n % n;
+  uint64_t draw;
+  do {
+    draw = next_random(state);
+  } while (draw < threshold);
+  return bitree_select(tree, (int)(draw % n), BITREE_INORDER);
+}
+#endif /* CONFIG_ORDER_STATISTICS */
+
+#ifdef CONFIG_SUBTREE_AGGREGATE
+/******************************************************************************
+ * FUNCTION:	    bitree_set_aggregate
+ *
+ * DESCRIPTION:	    Registers `aggregate' with every node of the tree
+ *		    containing `tree', and computes the summary of each.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
+ *		    aggregate: (const struct bitree_aggregate *) -- the
+ *			aggregate, or NULL to remove the current one.
+ *
+ * RETURN:	    int -- 0 on success, -1 on failure.
+ *
+ * NOTES:	    Theta(n)
+ ***/
+int bitree_set_aggregate(bitree * tree,
+			 const struct bitree_aggregate * aggregate)
+{
+  if (tree == NULL)
+    return -1;
+  if (aggregate != NULL
+      && (aggregate->value == NULL || aggregate->combine == NULL))
+    return -1;
+
+  set_aggregate(tree->root, aggregate);
+  return 0;
+}
+#endif /* CONFIG_SUBTREE_AGGREGATE */
+
+/******************************************************************************
+ * INTERNAL FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_update_height
+ *
+ * DESCRIPTION:	    Recalculates the height of `node' from its children.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to update.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+void bitree_update_height(bitree * node)
+{
+  int left = node_height(node->left);
+  int right = node_height(node->right);
+  node->height = (left > right ? left : right) + 1;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_swap_data
+ *
+ * DESCRIPTION:	    Exchanges the payloads of two nodes, and records both
+ *		    of them in the journal, so that a replica does the same.
+ *
+ * ARGUMENTS:	    one: (bitree *) -- the first node.
+ *		    two: (bitree *) -- the second node.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1), or O(s) with a journal, s is the size of the
+ *		    serialized payloads.
+ ***/
+void bitree_swap_data(bitree * one, bitree * two)
+{
+  swap_data(one, two);
+  journal_update(one);
+  journal_update(two);
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    npreorder_helper
+ *
+ * DESCRIPTION:	    This is a helper function for bitree_npreorder(). If the
+ *		    next node in traversal is not immediately accesible from
+ *		    the current node, this function will find it.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- on the first call, this pointer usually
+ *			contains the value of original->parent.
+ *		    original: (bitree *) -- pointer to the first node passed.
+ *
+ * RETURN:	    bitree * -- pointer to the next node in preorder traversal.
+ *
+ * NOTES:	    none.
+ ***/
+static bitree * npreorder_helper(bitree * node, bitree * original)
+{
+  /* Assumptions (given from bitree_npreorder):
+   * original is not NULL
+   * there is more than one node in the tree.
+   * original->left is NULL
+   * original->right is NULL
+   */
+  if (node == NULL)
+    return original;
+  if (node->left == original && node->right == NULL)
+    return npreorder_helper(node->parent, node);
+  else if (node->left == original && node->right != NULL)
+    return node->right;
+
+  return npreorder_helper(node->parent, node);;
+}
+
+/******************************************************************************
+ * FUNCTION:	    npostorder_helper
+ *
+ * DESCRIPTION:	    This is a helper function for bitree_npostorder(). If the
+ *		    next node in traversal is not immediately accesible from
+ *		    the current node, this function will find it.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- on the first call, this pointer usually
+ *			contains the value of original->parent.
+ *		    original: (bitree *) -- pointer to the first node passed.
+ *
+ * RETURN:	    bitree * -- pointer to the next node in postorder traversal
+ *
+ * NOTES:	    none.
+ ***/
+static bitree * npostorder_helper(bitree * node, bitree * original)
+{
+  if (node == NULL)
+    return original;
+
+  /* We're recursing downwards */
+  if (node->parent == original) {
+    if (bitree_isleaf(node))
+      return node;
+    if (node->left != NULL)
+      return npostorder_helper(node->left, node);
+    if (node->right != NULL)
+      return npostorder_helper(node->right, node);
+  }
+  /* We're recursing upwards */
+  else if (original->parent == node) {
+    if (node->right == original)
+      return node;
+    else if (node->right != NULL)
+      return npostorder_helper(node->right, node);
+  }
+
+  return NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    ninorder_helper
+ *
+ * DESCRIPTION:	    This is a helper function for bitree_ninorder(). If the
+ *		    next node in traversal is not immediately accesible from
+ *		    the current node, this function will find it.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- on the first call, this pointer usually
+ *			contains the value of original->parent.
+ *		    original: (bitree *) -- pointer to the first node passed.
+ *
+ * RETURN:	    bitree * -- pointer to the next node in inorder traversal.
+ *
+ * NOTES:	    none.
+ ***/
+static bitree * ninorder_helper(bitree * node, bitree * original)
+{
+  /* Climbed past the root: wrap around to the leftmost node of the tree */
+  if (node == NULL) {
+    node = original->root;
+    while (node->left != NULL)
+      node = node->left;
+    return node;
+  }
+
+  /* Recursing down the right tree */
+  if (original->right == node) {
+    while (node->left != NULL)
+      node = node->left;
+    return node;
+  }
+
+  /* Recursing upwards */
+  if (node->left == original)
+    return node;
+  return ninorder_helper(node->parent, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    nlevelorder_helper
+ *
+ * DESCRIPTION:	    Helper function for bitree_nlevelorder(). This function
+ *		    implements the recursive functionality and extends the
+ *		    interface presented by bitree_nlevelorder(). If the next
+ *		    node is not immediately accessible from the first, this
+ *		    function will find it.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    old: (bitree *) -- the node we came from.
+ *		    dist: (int) -- the distance of the current node from root.
+ *		    goal: (int) -- the distance of the original node from root.
+ *
+ * RETURN:	    bitree * -- Hopefully, the next node. If there's a problem,
+ *		    return NULL.
+ *
+ * NOTES:	    None.
+ ***/
+static bitree * nlevelorder_helper(bitree * node, bitree * old,
+				   int dist, int goal)
+{
+  if (node == NULL || old == NULL)
+    return NULL; /* Never say never */
+  if (dist == goal)
+    return node;
+
+  if (old == node->left) {
+      return nlevelorder_helper(node->right ? node->right : node->parent,
+				node, node->right ? dist + 1 : dist - 1, goal);
+  } else if (old == node->right) {
+    if (node->root != node)
+      return nlevelorder_helper(node->parent, node, dist - 1, goal);
+    return nlevelorder_helper(node->left, node, dist + 1, goal + 1);
+  } else if (old == node->parent) {
+    bitree * next = node->left ? node->left : node->right;
+    return next ? nlevelorder_helper(next, node, dist + 1, goal) : node->root;
+  }
+  return NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    rem_helper
+ *
+ * DESCRIPTION:	    Does the recursion for bitree_rem(). Each node is unlinked
+ *		    from its parent and freed after its children.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to remove.
+ *		    buffer: (struct destroy_buffer *) -- collects the payloads.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(n), n is the size of the subtree
+ ***/
+static void rem_helper(bitree * node, struct destroy_buffer * buffer)
+{
+  if (node == NULL)
+    return;
+
+  rem_helper(node->left, buffer);
+  rem_helper(node->right, buffer);
+
+  journal_forget(node);
+  if (node->root == node) {
+    free(node->size);
+    journal_release(node);
+  } else {
+    *(node->size) -= 1;
+    if (node->parent->left == node)
+      node->parent->left = NULL;
+    else
+      node->parent->right = NULL;
+  }
+
+  release_data(node, buffer);
+  free_node(node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    retain_helper
+ *
+ * DESCRIPTION:	    Does the recursion for bitree_retain(). The children of a
+ *		    node are done first, and if either of them changed, the
+ *		    cached fields of the node are updated before the predicate
+ *		    decides whether to remove it.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    retain: (struct retain *) -- the state of the removal.
+ *
+ * RETURN:	    int -- nonzero if `node' was removed, or its cached fields
+ *		    were updated, so that its parent's must be too.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+static int retain_helper(bitree * node, struct retain * retain)
+{
+  if (node == NULL)
+    return 0;
+
+  int changed = retain_helper(node->left, retain);
+  changed |= retain_helper(node->right, retain);
+  if (changed)
+    update_cache(node);
+  if (retain->pred(node->data, retain->ctx))
+    return changed;
+
+  retain->removed += subtree_size(node);
+  bitree * parent = node->parent;
+  if (parent != NULL) {
+    if (parent->left == node)
+      parent->left = NULL;
+    else
+      parent->right = NULL;
+  }
+  if (node == *retain->tree)
+    *retain->tree = NULL;
+  journal_remove(node);
+  journal_forget_tree(node);
+  reclaim(node, &retain->buffer);
+  return 1;
+}
+
+/******************************************************************************
+ * FUNCTION:	    free_node
+ *
+ * DESCRIPTION:	    Releases the memory of a single node. Nodes which were
+ *		    allocated in a block release their reference to it instead,
+ *		    and the last one frees the block.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to free.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void free_node(bitree * node)
+{
+  if (node->block == NULL)
+    free(node);
+  else if (atomic_fetch_sub_explicit(&node->block->refs, 1,
+				     memory_order_acq_rel) == 1)
+    free(node->block);
+}
+
+/******************************************************************************
+ * FUNCTION:	    preorder_next
+ *
+ * DESCRIPTION:	    Returns the node after `node' in a preorder traversal of
+ *		    the subtree rooted at `top'. Once a node and its subtree
+ *		    are done, this climbs until it finds an ancestor with a
+ *		    right subtree it hasn't entered yet, or reaches `top'.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    top: (bitree *) -- root of the subtree.
+ *		    descend: (int) -- zero to skip the subtree of `node'.
+ *
+ * RETURN:	    bitree * -- the next node, or NULL after the last one.
+ *
+ * NOTES:	    Amortized Theta(1) over a traversal.
+ ***/
+static bitree * preorder_next(bitree * node, bitree * top, int descend)
+{
+  if (descend && node->left != NULL)
+    return node->left;
+  if (descend && node->right != NULL)
+    return node->right;
+
+  while (node != top && (node->parent->right == NULL
+			 || node->parent->right == node))
+    node = node->parent;
+  return node == top ? NULL : node->parent->right;
+}
+
+/******************************************************************************
+ * FUNCTION:	    inorder_first
+ *
+ * DESCRIPTION:	    Returns the first node of the subtree at `node' in inorder.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- root of the subtree.
+ *
+ * RETURN:	    bitree * -- the leftmost node of the subtree.
+ *
+ * NOTES:	    O(h), h is the height of the subtree.
+ ***/
+static bitree * inorder_first(bitree * node)
+{
+  while (node->left != NULL)
+    node = node->left;
+  return node;
+}
+
+/******************************************************************************
+ * FUNCTION:	    inorder_next
+ *
+ * DESCRIPTION:	    Returns the node after `node' in an inorder traversal of
+ *		    the subtree rooted at `top'.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    top: (bitree *) -- root of the subtree.
+ *		    descend: (int) -- zero to skip the right subtree of `node'.
+ *
+ * RETURN:	    bitree * -- the next node, or NULL after the last one.
+ *
+ * NOTES:	    Amortized Theta(1) over a traversal.
+ ***/
+static bitree * inorder_next(bitree * node, bitree * top, int descend)
+{
+  if (descend && node->right != NULL)
+    return inorder_first(node->right);
+
+  /* The next node is the first ancestor whose left subtree this is */
+  while (node != top && node->parent->right == node)
+    node = node->parent;
+  return node == top ? NULL : node->parent;
+}
+
+/******************************************************************************
+ * FUNCTION:	    postorder_first
+ *
+ * DESCRIPTION:	    Returns the first node of the subtree at `node' in
+ *		    postorder.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- root of the subtree.
+ *
+ * RETURN:	    bitree * -- the first leaf reached by going left where
+ *		    possible, and right otherwise.
+ *
+ * NOTES:	    O(h), h is the height of the subtree.
+ ***/
+static bitree * postorder_first(bitree * node)
+{
+  while (!bitree_isleaf(node))
+    node = node->left != NULL ? node->left : node->right;
+  return node;
+}
+
+/******************************************************************************
+ * FUNCTION:	    postorder_next
+ *
+ * DESCRIPTION:	    Returns the node after `node' in a postorder traversal of
+ *		    the subtree rooted at `top'.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    top: (bitree *) -- root of the subtree.
+ *
+ * RETURN:	    bitree * -- the next node, or NULL after the last one.
+ *
+ * NOTES:	    Amortized Theta(1) over a traversal.
+ ***/
+static bitree * postorder_next(bitree * node, bitree * top)
+{
+  if (node == top)
+    return NULL;
+
+  bitree * parent = node->parent;
+  if (parent->left == node && parent->right != NULL)
+    return postorder_first(parent->right);
+  return parent;
+}
+
+/******************************************************************************
+ * FUNCTION:	    start_slot
+ *
+ * DESCRIPTION:	    Starts a walk or descent in a slot of bitree_walk_many()
+ *		    or bitree_descend_many(), and prefetches its first node.
+ *
+ * ARGUMENTS:	    slot: (struct interleave_slot *) -- the slot.
+ *		    node: (bitree *) -- the first node, or NULL.
+ *		    top: (bitree *) -- the root of the subtree, or NULL.
+ *		    index: (size_t) -- the number of the walk or descent.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void start_slot(struct interleave_slot * slot, bitree * node,
+		       bitree * top, size_t index)
+{
+  slot->node = node;
+  slot->top = top;
+  slot->index = index;
+  slot->loaded = 0;
+  if (node != NULL)
+    __builtin_prefetch(node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    interleave_group
+ *
+ * DESCRIPTION:	    Returns the number of walks or descents to interleave.
+ *
+ * ARGUMENTS:	    group: (size_t) -- the number asked for, or 0.
+ *
+ * RETURN:	    size_t -- `group', or BITREE_INTERLEAVE if it is 0, at
+ *		    most INTERLEAVE_MAX.
+ *
+ * NOTES:	    none.
+ ***/
+static size_t interleave_group(size_t group)
+{
+  if (group == 0)
+    group = BITREE_INTERLEAVE;
+  return group < INTERLEAVE_MAX ? group : INTERLEAVE_MAX;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_first
+ *
+ * DESCRIPTION:	    Returns the first node of a walk of a subtree.
+ *
+ * ARGUMENTS:	    top: (bitree *) -- the root of the subtree, or NULL.
+ *		    order: (enum bitree_order) -- the order of the walk, one
+ *			of preorder, inorder or postorder.
+ *
+ * RETURN:	    bitree * -- the first node, or NULL if `top' is NULL.
+ *
+ * NOTES:	    O(h), h is the height of the subtree.
+ ***/
+static bitree * walk_first(bitree * top, enum bitree_order order)
+{
+  if (top == NULL || order == BITREE_PREORDER)
+    return top;
+  return order == BITREE_INORDER ? inorder_first(top) : postorder_first(top);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_preorder
+ *
+ * DESCRIPTION:	    Does the work of bitree_walk() in preorder.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    visit: (enum bitree_visit (*)(bitree *, void *)) -- the
+ *			visitor.
+ *		    ctx: (void *) -- passed to the visitor.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 otherwise.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+static int walk_preorder(bitree * tree,
+			 enum bitree_visit (*visit)(bitree *, void *),
+			 void * ctx)
+{
+  for (bitree * node = tree; node != NULL;) {
+    enum bitree_visit result = visit(node, ctx);
+    if (result == BITREE_STOP)
+      return 1;
+    node = preorder_next(node, tree, result == BITREE_CONTINUE);
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_inorder
+ *
+ * DESCRIPTION:	    Does the work of bitree_walk() in inorder.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    visit: (enum bitree_visit (*)(bitree *, void *)) -- the
+ *			visitor.
+ *		    ctx: (void *) -- passed to the visitor.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 otherwise.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+static int walk_inorder(bitree * tree,
+			enum bitree_visit (*visit)(bitree *, void *),
+			void * ctx)
+{
+  for (bitree * node = inorder_first(tree); node != NULL;) {
+    enum bitree_visit result = visit(node, ctx);
+    if (result == BITREE_STOP)
+      return 1;
+    node = inorder_next(node, tree, result == BITREE_CONTINUE);
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_postorder
+ *
+ * DESCRIPTION:	    Does the work of bitree_walk() in postorder.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    visit: (enum bitree_visit (*)(bitree *, void *)) -- the
+ *			visitor.
+ *		    ctx: (void *) -- passed to the visitor.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 otherwise.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+static int walk_postorder(bitree * tree,
+			  enum bitree_visit (*visit)(bitree *, void *),
+			  void * ctx)
+{
+  for (bitree * node = postorder_first(tree); node != NULL;
+       node = postorder_next(node, tree))
+    if (visit(node, ctx) == BITREE_STOP)
+      return 1;
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_levelorder
+ *
+ * DESCRIPTION:	    Does the work of bitree_walk() in level order, with a
+ *		    queue that grows as needed.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    visit: (enum bitree_visit (*)(bitree *, void *)) -- the
+ *			visitor.
+ *		    ctx: (void *) -- passed to the visitor.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 if it finished, -1 if
+ *		    memory could not be allocated.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+static int walk_levelorder(bitree * tree,
+			   enum bitree_visit (*visit)(bitree *, void *),
+			   void * ctx)
+{
+  size_t capacity = 64, head = 0, tail = 0;
+  bitree ** queue = malloc(capacity * sizeof(bitree *));
+  if (queue == NULL)
+    return -1;
+
+  int result = 0;
+  queue[tail++] = tree;
+  while (head < tail) {
+    bitree * node = queue[head++];
+    enum bitree_visit next = visit(node, ctx);
+    if (next == BITREE_STOP) {
+      result = 1;
+      break;
+    } else if (next == BITREE_SKIP_CHILDREN) {
+      continue;
+    }
+
+    /* Make room for two more, moving the live part to the front first */
+    if (tail + 2 > capacity) {
+      if (head > 0) {
+	for (size_t i = head; i < tail; i++)
+	  queue[i - head] = queue[i];
+	tail -= head;
+	head = 0;
+      }
+      if (tail + 2 > capacity) {
+	bitree ** grown = realloc(queue, 2 * capacity * sizeof(bitree *));
+	if (grown == NULL) {
+	  result = -1;
+	  break;
+	}
+	queue = grown;
+	capacity *= 2;
+      }
+    }
+
+    if (node->left != NULL)
+      queue[tail++] = node->left;
+    if (node->right != NULL)
+      queue[tail++] = node->right;
+  }
+
+  free(queue);
+  return result;
+}
+
+/******************************************************************************
+ * FUNCTION:	    find_if_visit
+ *
+ * DESCRIPTION:	    The visitor used by bitree_find_if().
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    spec: (void *) -- the struct find_if_spec.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_STOP if `node' matches, and
+ *		    BITREE_CONTINUE otherwise.
+ *
+ * NOTES:	    Theta(1), plus the predicate.
+ ***/
+static enum bitree_visit find_if_visit(bitree * node, void * spec)
+{
+  struct find_if_spec * find = spec;
+  if (!find->pred(node->data, find->ctx))
+    return BITREE_CONTINUE;
+
+  find->found = node;
+  return BITREE_STOP;
+}
+
+/******************************************************************************
+ * FUNCTION:	    update_size
+ *
+ * DESCRIPTION:	    Called by bitree_merge to recursively update the 'size' and
+ *		    'root' parameter in each node of the tree.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to update
+ *		    size: (int *) -- pointer to the new size int.
+ *		    root: (bitree *) -- new root for the merged tree
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int update_size(bitree * node, int * size, bitree * root)
+{
+  if (node == NULL)
+    return 0;
+  node->size = size;
+  node->root = root;
+  update_size(node->left, size, root);
+  update_size(node->right, size, root);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    clone_tree
+ *
+ * DESCRIPTION:	    Does the work of bitree_clone() and bitree_map(). The new
+ *		    nodes are laid out in preorder in a single block. If any
+ *		    payload cannot be made, every one that was is destroyed,
+ *		    and the block is freed.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree to copy.
+ *		    map: (void * (*)(const void *)) -- makes each new payload,
+ *			or NULL to share them.
+ *		    destroy: (void (*)(void *)) -- destroy function for the
+ *			new tree.
+ *		    clone: (int) -- nonzero if the payloads are equivalent, so
+ *			that the cached fields which depend on them can be
+ *			copied too.
+ *
+ * RETURN:	    bitree * -- the new tree, or NULL.
+ *
+ * NOTES:	    Theta(n), n is the size of the subtree
+ ***/
+static bitree * clone_tree(bitree * tree, void * (*map)(const void *),
+			   void (*destroy)(void *), int clone)
+{
+  int size = tree->root == tree ? *(tree->size) : subtree_size(tree);
+  struct bitree_block * block = malloc(sizeof(struct bitree_block)
+				       + size * sizeof(bitree));
+  int * psize = malloc(sizeof(int));
+  if (block == NULL || psize == NULL) {
+    free(block);
+    free(psize);
+    return NULL;
+  }
+
+  /* Each split hands one subtree to another thread, so `splits' levels of
+   * them keep 2^splits processors busy.
+   */
+  int splits = 0;
+  if (size > BITREE_CLONE_THRESHOLD) {
+    for (long cpus = sysconf(_SC_NPROCESSORS_ONLN); cpus > 1; cpus /= 2)
+      splits++;
+  }
+
+  struct clone_spec spec = {
+    .root = &block->nodes[0],
+    .size = psize,
+    .block = block,
+    .map = map,
+    .destroy = destroy,
+    .clone = clone
+  };
+  int failed = 0;
+  clone_subtree(&spec, tree, NULL, block->nodes, splits, &failed);
+  if (failed) {
+    for (int i = 0; i < size; i++)
+      if (destroy != NULL && block->nodes[i].data != NULL)
+	destroy(block->nodes[i].data);
+    free(block);
+    free(psize);
+    return NULL;
+  }
+
+  atomic_init(&block->refs, size);
+  *psize = size;
+  return spec.root;
+}
+
+/******************************************************************************
+ * FUNCTION:	    clone_subtree
+ *
+ * DESCRIPTION:	    Copies the subtree rooted at `source' into `nodes', in
+ *		    preorder. While `splits' is positive, a node with two
+ *		    children hands its left subtree to a new thread, and copies
+ *		    the right itself. Only then does the size of the left
+ *		    subtree need to be known in advance.
+ *
+ * ARGUMENTS:	    spec: (const struct clone_spec *) -- the new tree.
+ *		    source: (bitree *) -- the node to copy.
+ *		    parent: (bitree *) -- the parent of the copy.
+ *		    nodes: (bitree *) -- where the copies go.
+ *		    splits: (int) -- how many more times to split the work.
+ *		    failed: (int *) -- set to 1 if any payload could not be
+ *			made.
+ *
+ * RETURN:	    int -- the number of nodes copied.
+ *
+ * NOTES:	    Theta(n), n is the size of the subtree
+ ***/
+static int clone_subtree(const struct clone_spec * spec, bitree * source,
+			 bitree * parent, bitree * nodes, int splits,
+			 int * failed)
+{
+  bitree * copy = nodes;
+  *copy = *source;
+  copy->root = spec->root;
+  copy->parent = parent;
+  copy->left = NULL;
+  copy->right = NULL;
+  copy->size = spec->size;
+  copy->destroy = spec->destroy;
+  copy->data = spec->map != NULL ? spec->map(source->data) : source->data;
+  copy->block = spec->block;
+#ifdef CONFIG_SUBTREE_AGGREGATE
+  if (!spec->clone)
+    copy->aggregate = NULL;
+#endif
+#ifdef CONFIG_DESTROY_BATCH
+  if (!spec->clone)
+    copy->destroy_batch = NULL;
+#endif
+#ifdef CONFIG_MERKLE_HASH
+  if (!spec->clone) {
+    copy->hash_data = NULL;
+    copy->hashed = 0;
+  }
+#endif
+#ifdef CONFIG_JOURNAL
+  copy->journal = NULL;
+  copy->id = 0;
+#endif
+  if (copy->data == NULL)
+    *failed = 1;
+
+  struct clone_job job = {
+    .spec = spec,
+    .source = source->left,
+    .parent = copy,
+    .nodes = nodes + 1,
+    .splits = splits - 1,
+    .failed = 0
+  };
+  pthread_t thread;
+  int spawned = 0;
+  int used = 1;
+
+  if (source->left != NULL) {
+    copy->left = nodes + used;
+    if (splits > 0 && source->right != NULL)
+      spawned = !pthread_create(&thread, NULL, clone_thread, &job);
+    if (spawned)
+      used += subtree_size(source->left);
+    else
+      used += clone_subtree(spec, source->left, copy, nodes + used, splits,
+			    failed);
+  }
+
+  if (source->right != NULL) {
+    copy->right = nodes + used;
+    used += clone_subtree(spec, source->right, copy, nodes + used,
+			  spawned ? splits - 1 : splits, failed);
+  }
+
+  if (spawned) {
+    pthread_join(thread, NULL);
+    *failed |= job.failed;
+  }
+
+  return used;
+}
+
+/******************************************************************************
+ * FUNCTION:	    clone_thread
+ *
+ * DESCRIPTION:	    Thread entry point for clone_subtree().
+ *
+ * ARGUMENTS:	    job: (void *) -- the struct clone_job to run.
+ *
+ * RETURN:	    void * -- NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static void * clone_thread(void * job)
+{
+  struct clone_job * clone = (struct clone_job *)job;
+  clone_subtree(clone->spec, clone->source, clone->parent, clone->nodes,
+		clone->splits, &clone->failed);
+  return NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    release_data
+ *
+ * DESCRIPTION:	    Releases the payload of a node that is being removed:
+ *		    either it is added to `buffer', or it is destroyed right
+ *		    away.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    buffer: (struct destroy_buffer *) -- the buffer.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1), amortized.
+ ***/
+static void release_data(bitree * node, struct destroy_buffer * buffer)
+{
+#ifdef CONFIG_DESTROY_BATCH
+  if (node->destroy_batch != NULL) {
+    if (buffer->n == BITREE_DESTROY_BATCH
+	|| buffer->destroy_batch != node->destroy_batch)
+      flush_data(buffer);
+    buffer->destroy_batch = node->destroy_batch;
+    buffer->data[buffer->n++] = node->data;
+    return;
+  }
+#endif
+  if (node->destroy != NULL)
+    node->destroy(node->data);
+}
+
+/******************************************************************************
+ * FUNCTION:	    flush_data
+ *
+ * DESCRIPTION:	    Passes the payloads in `buffer' to the destroy_batch
+ *		    function, and empties it.
+ *
+ * ARGUMENTS:	    buffer: (struct destroy_buffer *) -- the buffer.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(n), n is the number of payloads in the buffer.
+ ***/
+static void flush_data(struct destroy_buffer * buffer)
+{
+#ifdef CONFIG_DESTROY_BATCH
+  if (buffer->n > 0)
+    buffer->destroy_batch(buffer->data, buffer->n);
+  buffer->n = 0;
+#endif
+}
+
+#ifdef CONFIG_ORDER_STATISTICS
+/******************************************************************************
+ * FUNCTION:	    detach
+ *
+ * DESCRIPTION:	    Unlinks the subtree rooted at `node' from its parent, and
+ *		    updates the size and cached fields of the tree it leaves.
+ *		    The nodes in the subtree keep their `root' and `size', but
+ *		    only reclaim() and reclaim_node() may use them after this.
+ *		    Since those may run on the reclaimer thread, the subtree is
+ *		    also taken out of the journal here.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- root of the subtree.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(h), or O(n) if the tree is a replica whose index must
+ *		    forget the subtree.
+ ***/
+static void detach(bitree * node)
+{
+  journal_forget_tree(node);
+  bitree * parent = node->parent;
+  if (parent == NULL)
+    return;
+
+  if (parent->left == node)
+    parent->left = NULL;
+  else
+    parent->right = NULL;
+  *(node->size) -= subtree_size(node);
+  node->parent = NULL;
+  update_path(parent);
+}
+
+/******************************************************************************
+ * FUNCTION:	    reclaim_thread
+ *
+ * DESCRIPTION:	    The body of the reclaimer thread. It frees the subtrees in
+ *		    the queue until it is asked to stop, and the queue is
+ *		    empty.
+ *
+ * ARGUMENTS:	    arg: (void *) -- unused.
+ *
+ * RETURN:	    void * -- NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static void * reclaim_thread(void * arg)
+{
+  while (1) {
+    pthread_mutex_lock(&reclaimer.lock);
+    while (reclaimer.queue == NULL && !reclaimer.stop)
+      pthread_cond_wait(&reclaimer.wake, &reclaimer.lock);
+    bitree * queue = reclaimer.queue;
+    reclaimer.queue = NULL;
+    pthread_mutex_unlock(&reclaimer.lock);
+
+    if (queue == NULL)
+      return NULL;
+    struct destroy_buffer buffer = {0};
+    while (queue != NULL) {
+      bitree * next = queue->parent;
+      reclaim(queue, &buffer);
+      queue = next;
+    }
+    flush_data(&buffer);
+  }
+}
+#endif
+
+/******************************************************************************
+ * FUNCTION:	    reclaim
+ *
+ * DESCRIPTION:	    Frees a subtree that has already been detached from its
+ *		    tree. Unlike rem_helper(), it does not touch the tree the
+ *		    subtree came from, except to free its size if the subtree
+ *		    was the whole tree.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- root of the detached subtree.
+ *		    buffer: (struct destroy_buffer *) -- collects the payloads.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(n), n is the size of the subtree
+ ***/
+static void reclaim(bitree * node, struct destroy_buffer * buffer)
+{
+  if (node == NULL)
+    return;
+
+  reclaim(node->left, buffer);
+  reclaim(node->right, buffer);
+  reclaim_node(node, buffer);
+}
+
+/******************************************************************************
+ * FUNCTION:	    reclaim_node
+ *
+ * DESCRIPTION:	    Frees a single node of a detached subtree, after its
+ *		    children.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    buffer: (struct destroy_buffer *) -- collects the payloads.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void reclaim_node(bitree * node, struct destroy_buffer * buffer)
+{
+  if (node->root == node)
+    free(node->size);
+  release_data(node, buffer);
+  free_node(node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    subtree_size
+ *
+ * DESCRIPTION:	    Counts the nodes in the subtree rooted at `node'. This is
+ *		    Theta(1) when the counts are cached.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- root of the subtree.
+ *
+ * RETURN:	    int -- the number of nodes.
+ *
+ * NOTES:	    Theta(n), or Theta(1) with CONFIG_ORDER_STATISTICS.
+ ***/
+static int subtree_size(bitree * node)
+{
+#ifdef CONFIG_ORDER_STATISTICS
+  return node_count(node);
+#else
+  if (node == NULL)
+    return 0;
+  return subtree_size(node->left) + subtree_size(node->right) + 1;
+#endif
+}
+
+/******************************************************************************
+ * FUNCTION:	    swap_data
+ *
+ * DESCRIPTION:	    Exchanges the payloads of two nodes, without recording it.
+ *
+ * ARGUMENTS:	    one: (bitree *) -- the first node.
+ *		    two: (bitree *) -- the second node.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void swap_data(bitree * one, bitree * two)
+{
+  void * data = one->data;
+  one->data = two->data;
+  two->data = data;
+}
+
+/******************************************************************************
+ * FUNCTION:	    distance_helper
+ *
+ * DESCRIPTION:	    Helper function for bitree_distance--does the recurstion
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node (during recursion)
+ *		    distance: (int) -- the current distance from the root.
+ *
+ * RETURN:	    int -- (hopefully) the distance from the root node. -1 if
+ *		    an error has occurred.
+ *
+ * NOTES:	    none.
+ ***/
+static int distance_helper(bitree * node, int distance)
+{
+  if (node == NULL)
     return --distance;
   return distance_helper(node->parent, ++distance);
 }
 
+#ifdef CONFIG_ORDER_STATISTICS
+/******************************************************************************
+ * FUNCTION:	    next_random
+ *
+ * DESCRIPTION:	    Advances a SplitMix64 generator, and returns its next
+ *		    output.
+ *
+ * ARGUMENTS:	    state: (uint64_t *) -- the state of the generator.
+ *
+ * RETURN:	    uint64_t -- 64 uniformly distributed bits.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static uint64_t next_random(uint64_t * state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+#endif
+
+/******************************************************************************
+ * FUNCTION:	    update_cache
+ *
+ * DESCRIPTION:	    Recalculates the cached fields of `node' (the subtree
+ *		    count and aggregate) from its payload and those of its
+ *		    children.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to update.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void update_cache(bitree * node)
+{
+#ifdef CONFIG_ORDER_STATISTICS
+  node->count = node_count(node->left) + node_count(node->right) + 1;
+#endif
+#ifdef CONFIG_MERKLE_HASH
+  node->hashed = 0;
+#endif
+#ifdef CONFIG_SUBTREE_AGGREGATE
+  const struct bitree_aggregate * aggregate = node->aggregate;
+  if (aggregate != NULL) {
+    double summary = aggregate->value(node->data);
+    if (node->left != NULL)
+      summary = aggregate->combine(node->left->summary, summary);
+    if (node->right != NULL)
+      summary = aggregate->combine(summary, node->right->summary);
+    node->summary = summary;
+  }
+#endif
+}
+
+/******************************************************************************
+ * FUNCTION:	    update_path
+ *
+ * DESCRIPTION:	    Calls update_cache() on `node' and each of its ancestors,
+ *		    after the subtree under `node' has changed shape. Does
+ *		    nothing if there are no cached fields.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the lowest node whose subtree changed.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(h), h is the height of the tree.
+ ***/
+static void update_path(bitree * node)
+{
+#ifdef CACHED_FIELDS
+  for (; node != NULL; node = node->parent)
+    update_cache(node);
+#else
+  invalidate_path(node);
+#endif
+}
+
+/******************************************************************************
+ * FUNCTION:	    update_batch
+ *
+ * DESCRIPTION:	    Does the work of update_path() for every parent in a batch
+ *		    of insertions at once. The ancestors of the parents are
+ *		    gathered into a table, each with the number of its children
+ *		    which are also there, and then refreshed from the bottom
+ *		    up, each once its children have been. If the table can't be
+ *		    allocated, update_path() is called for each parent instead.
+ *
+ * ARGUMENTS:	    ops: (const struct bitree_ins_op *) -- the insertions, all
+ *			of which have been linked in.
+ *		    n: (size_t) -- the number of insertions.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(n + m) expected, m is the number of distinct ancestors
+ *		    of the parents.
+ ***/
+static void update_batch(const struct bitree_ins_op * ops, size_t n)
+{
+#ifdef CACHED_FIELDS
+  size_t slots = 16, used = 0;
+  while (slots < 4 * n)
+    slots *= 2;
+  struct batch_entry * table = calloc(slots, sizeof(struct batch_entry));
+  if (table == NULL)
+    goto fallback;
+
+  /* Walk up from each parent until the path joins one already gathered */
+  for (size_t i = 0; i < n; i++) {
+    int below = 0;
+    for (bitree * node = ops[i].parent; node != NULL; node = node->parent) {
+      struct batch_entry * entry = batch_slot(table, slots, node);
+      if (entry->node == node) {
+	entry->pending += below;
+	break;
+      }
+      entry->node = node;
+      entry->pending = below;
+      below = 1;
+      if (2 * ++used > slots) {
+	struct batch_entry * grown = batch_grow(table, slots);
+	if (grown == NULL) {
+	  free(table);
+	  goto fallback;
+	}
+	table = grown;
+	slots *= 2;
+      }
+    }
+  }
+
+  /* Every chain starts at an entry none of whose children are in the table,
+   * and goes up for as long as the parent has no other child left to wait
+   * for.
+   */
+  for (size_t i = 0; i < slots; i++) {
+    struct batch_entry * entry = &table[i];
+    while (entry != NULL && entry->node != NULL && entry->pending == 0) {
+      update_cache(entry->node);
+      entry->pending = -1;
+      bitree * parent = entry->node->parent;
+      entry = NULL;
+      if (parent != NULL) {
+	entry = batch_slot(table, slots, parent);
+	entry->pending--;
+      }
+    }
+  }
+  free(table);
+  return;
+
+ fallback:
+#endif
+  for (size_t i = 0; i < n; i++)
+    update_path(ops[i].parent);
+}
+
+#ifdef CACHED_FIELDS
+/******************************************************************************
+ * FUNCTION:	    batch_slot
+ *
+ * DESCRIPTION:	    Finds the entry of a node in the table of update_batch(),
+ *		    by linear probing from the slot its address hashes to.
+ *
+ * ARGUMENTS:	    table: (struct batch_entry *) -- the table.
+ *		    slots: (size_t) -- its size, a power of two.
+ *		    node: (bitree *) -- the node.
+ *
+ * RETURN:	    struct batch_entry * -- the entry of `node', or the empty
+ *		    one where it would go.
+ *
+ * NOTES:	    O(1) expected, since the table is at most half full.
+ ***/
+static struct batch_entry * batch_slot(struct batch_entry * table,
+				       size_t slots, bitree * node)
+{
+  size_t i = index_home((uintptr_t)node, slots);
+  while (table[i].node != NULL && table[i].node != node)
+    i = (i + 1) & (slots - 1);
+  return &table[i];
+}
+
+/******************************************************************************
+ * FUNCTION:	    batch_grow
+ *
+ * DESCRIPTION:	    Moves the entries of the table of update_batch() into one
+ *		    twice the size.
+ *
+ * ARGUMENTS:	    table: (struct batch_entry *) -- the table, which is freed
+ *			on success.
+ *		    slots: (size_t) -- its size.
+ *
+ * RETURN:	    struct batch_entry * -- the new table, or NULL.
+ *
+ * NOTES:	    Theta(slots)
+ ***/
+static struct batch_entry * batch_grow(struct batch_entry * table,
+				       size_t slots)
+{
+  struct batch_entry * grown = calloc(2 * slots, sizeof(struct batch_entry));
+  if (grown == NULL)
+    return NULL;
+  for (size_t i = 0; i < slots; i++)
+    if (table[i].node != NULL)
+      *batch_slot(grown, 2 * slots, table[i].node) = table[i];
+  free(table);
+  return grown;
+}
+#endif /* CACHED_FIELDS */
+
+#ifdef CONFIG_SUBTREE_AGGREGATE
+/******************************************************************************
+ * FUNCTION:	    set_aggregate
+ *
+ * DESCRIPTION:	    Does the recursion for bitree_set_aggregate(). Each node
+ *		    is updated after its children, so that their summaries are
+ *		    ready when it is.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    aggregate: (const struct bitree_aggregate *) -- the
+ *			aggregate.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(n), n is the size of the subtree
+ ***/
+static void set_aggregate(bitree * node,
+			  const struct bitree_aggregate * aggregate)
+{
+  if (node == NULL)
+    return;
+  set_aggregate(node->left, aggregate);
+  set_aggregate(node->right, aggregate);
+  node->aggregate = aggregate;
+  update_cache(node);
+}
+#endif /* CONFIG_SUBTREE_AGGREGATE */
+
+#ifdef CONFIG_MERKLE_HASH
+/******************************************************************************
+ * FUNCTION:	    invalidate_hash
+ *
+ * DESCRIPTION:	    Marks the hashes of `node' and its ancestors stale. Since
+ *		    the ancestors of a stale node are always stale, the walk
+ *		    stops at the first node which already is.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the lowest node whose subtree changed.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(h), amortized Theta(1) between two hash computations.
+ ***/
+static void invalidate_hash(bitree * node)
+{
+  for (; node != NULL && node->hashed; node = node->parent)
+    node->hashed = 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    node_hash
+ *
+ * DESCRIPTION:	    Returns the hash of the subtree at `node', combining the
+ *		    hash of its payload with those of its children. Only stale
+ *		    hashes are recomputed.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- root of the subtree, or NULL.
+ *
+ * RETURN:	    size_t -- the hash.
+ *
+ * NOTES:	    O(s), s is the number of stale nodes in the subtree.
+ ***/
+static size_t node_hash(bitree * node)
+{
+  if (node == NULL)
+    return EMPTY_HASH;
+  if (node->hashed)
+    return node->hash;
+
+  size_t hash = node->hash_data(node->data);
+  hash = combine_hash(hash, node_hash(node->left));
+  hash = combine_hash(hash, node_hash(node->right));
+  node->hash = hash;
+  node->hashed = 1;
+  return hash;
+}
+
+/******************************************************************************
+ * FUNCTION:	    diff_helper
+ *
+ * DESCRIPTION:	    Does the recursion for bitree_diff(). A pair of nodes is
+ *		    reported if only one of them exists, or if their payloads
+ *		    hash differently; in the latter case, their children are
+ *		    compared as well.
+ *
+ * ARGUMENTS:	    one: (bitree *) -- a node of the first subtree, or NULL.
+ *		    two: (bitree *) -- the node in the same position in the
+ *			second subtree, or NULL.
+ *		    report: (void (*)(bitree *, bitree *, void *)) -- called
+ *			for each difference.
+ *		    ctx: (void *) -- passed to `report'.
+ *
+ * RETURN:	    int -- the number of differences reported.
+ *
+ * NOTES:	    O(d*h), once the hashes are up to date.
+ ***/
+static int diff_helper(bitree * one, bitree * two,
+		       void (*report)(bitree *, bitree *, void *), void * ctx)
+{
+  if (node_hash(one) == node_hash(two))
+    return 0;
+  if (one == NULL || two == NULL) {
+    report(one, two, ctx);
+    return 1;
+  }
+
+  int found = 0;
+  if (one->hash_data(one->data) != two->hash_data(two->data)) {
+    report(one, two, ctx);
+    found = 1;
+  }
+  return found + diff_helper(one->left, two->left, report, ctx)
+    + diff_helper(one->right, two->right, report, ctx);
+}
+#endif /* CONFIG_MERKLE_HASH */
+
+#ifdef CONFIG_JOURNAL
+/******************************************************************************
+ * FUNCTION:	    journal_record
+ *
+ * DESCRIPTION:	    Records a change to `node' in the journal of its tree, if
+ *		    it has one which records changes. An inserted node is
+ *		    given its ID here.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    op: (enum journal_op) -- the change.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(s), s is the size of the serialized payload.
+ ***/
+static void journal_record(bitree * node, enum journal_op op)
+{
+  struct bitree_journal * journal = node->journal;
+  if (journal == NULL || journal->write == NULL)
+    return;
+
+  switch (op) {
+  case JOURNAL_INSL:
+  case JOURNAL_INSR:
+    node->id = journal->next_id++;
+    journal_emit(journal, op, node->id, node->parent->id, node->data);
+    break;
+  case JOURNAL_UPDATE:
+    journal_emit(journal, op, node->id, 0, node->data);
+    break;
+  default:
+    journal_emit(journal, op, node->id, 0, NULL);
+    break;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    journal_merge
+ *
+ * DESCRIPTION:	    Brings the nodes of `tree2', which bitree_merge() has just
+ *		    attached, into the journal of the tree, and records the
+ *		    merge: the new root, if there is one, then the root of
+ *		    `tree2', then the rest of it, in preorder.
+ *
+ * ARGUMENTS:	    tree2: (bitree *) -- the tree which was merged.
+ *		    newroot: (bitree *) -- the new root, or NULL.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(n), n is the size of `tree2'.
+ ***/
+static void journal_merge(bitree * tree2, bitree * newroot)
+{
+  struct bitree_journal * journal = tree2->parent->journal;
+  int record = journal != NULL && journal->write != NULL;
+  if (record && newroot != NULL) {
+    newroot->id = journal->next_id++;
+    journal_emit(journal, JOURNAL_NEWROOT, newroot->id, 0, newroot->data);
+  }
+
+  struct bitree_cursor cursor;
+  bitree_cursor_init(&cursor, tree2, BITREE_PREORDER);
+  for (bitree * node; (node = bitree_cursor_next(&cursor)) != NULL;) {
+    node->journal = journal;
+    if (!record) {
+      continue;
+    } else if (node == tree2) {
+      node->id = journal->next_id++;
+      journal_emit(journal, JOURNAL_MERGE, node->id,
+		   newroot != NULL ? newroot->left->id : node->parent->id,
+		   node->data);
+    } else {
+      journal_record(node, node->parent->left == node
+		     ? JOURNAL_INSL : JOURNAL_INSR);
+    }
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    journal_emit
+ *
+ * DESCRIPTION:	    Builds a record in the buffer of the journal, growing it if
+ *		    the payload doesn't fit, and writes it to the sink. If
+ *		    anything fails, the journal is marked as failed.
+ *
+ * ARGUMENTS:	    journal: (struct bitree_journal *) -- the journal.
+ *		    op: (enum journal_op) -- the kind of record.
+ *		    id: (uint64_t) -- the node the record is about.
+ *		    other: (uint64_t) -- the other node, or 0.
+ *		    data: (const void *) -- the payload to serialize, or NULL.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(s), s is the size of the serialized payload.
+ ***/
+static void journal_emit(struct bitree_journal * journal, enum journal_op op,
+			 uint64_t id, uint64_t other, const void * data)
+{
+  size_t size = 0;
+  if (data != NULL) {
+    size = journal->serialize(data, journal->buffer + JOURNAL_HEADER,
+			      journal->capacity - JOURNAL_HEADER);
+    if (size > journal->capacity - JOURNAL_HEADER) {
+      unsigned char * buffer = realloc(journal->buffer, JOURNAL_HEADER + size);
+      if (buffer == NULL) {
+	journal->failed = 1;
+	return;
+      }
+      journal->buffer = buffer;
+      journal->capacity = JOURNAL_HEADER + size;
+      journal->serialize(data, buffer + JOURNAL_HEADER, size);
+    }
+  }
+
+  struct journal_header header = {
+    .op = op,
+    .size = size,
+    .id = id,
+    .other = other,
+  };
+  memcpy(journal->buffer, &header, JOURNAL_HEADER);
+  if (journal->write(journal->sink, journal->buffer, JOURNAL_HEADER + size))
+    journal->failed = 1;
+}
+
+/******************************************************************************
+ * FUNCTION:	    new_journal
+ *
+ * DESCRIPTION:	    Allocates an empty journal.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    struct bitree_journal * -- the journal, or NULL.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static struct bitree_journal * new_journal(void)
+{
+  struct bitree_journal * journal = calloc(1, sizeof(struct bitree_journal));
+  if (journal == NULL)
+    return NULL;
+
+  /* ID 0 is never used, so that it can mean "no node" in a record */
+  journal->next_id = 1;
+  journal->capacity = JOURNAL_HEADER + 64;
+  if ((journal->buffer = malloc(journal->capacity)) == NULL) {
+    free(journal);
+    return NULL;
+  }
+  return journal;
+}
+
+/******************************************************************************
+ * FUNCTION:	    free_journal
+ *
+ * DESCRIPTION:	    Frees a journal.
+ *
+ * ARGUMENTS:	    journal: (struct bitree_journal *) -- the journal, or NULL.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void free_journal(struct bitree_journal * journal)
+{
+  if (journal == NULL)
+    return;
+  free(journal->buffer);
+  free(journal->index);
+  free(journal);
+}
+
+/******************************************************************************
+ * FUNCTION:	    replay_record
+ *
+ * DESCRIPTION:	    Applies a single record to a replica. A JOURNAL_NEWROOT
+ *		    record is applied together with the JOURNAL_MERGE after it.
+ *
+ * ARGUMENTS:	    tree: (bitree **) -- the root of the replica, or NULL.
+ *		    header: (const struct journal_header *) -- the record.
+ *		    payload: (const unsigned char *) -- its payload.
+ *		    next: (const struct journal_header *) -- the record after
+ *			a JOURNAL_NEWROOT.
+ *		    next_payload: (const unsigned char *) -- its payload.
+ *		    deserialize: (void * (*)(const void *, size_t)) -- makes a
+ *			payload from its serialized form.
+ *		    destroy: (void (*)(void *)) -- the destroy function.
+ *
+ * RETURN:	    int -- 0 on success, -1 on failure.
+ *
+ * NOTES:	    Theta(1), except for JOURNAL_REM.
+ ***/
+static int replay_record(bitree ** tree, const struct journal_header * header,
+			 const unsigned char * payload,
+			 const struct journal_header * next,
+			 const unsigned char * next_payload,
+			 void * (*deserialize)(const void *, size_t),
+			 void (*destroy)(void *))
+{
+  struct bitree_journal * journal = *tree != NULL ? (*tree)->journal : NULL;
+  if (header->op != JOURNAL_ROOT
+      && (journal == NULL || journal->write != NULL))
+    return -1;
+
+  void * data = NULL, * newdata = NULL;
+  bitree * node = NULL;
+  switch (header->op) {
+  case JOURNAL_ROOT:
+    if (*tree != NULL || (data = deserialize(payload, header->size)) == NULL
+	|| (node = bitree_create(destroy, data)) == NULL)
+      goto error_exit;
+    data = NULL;
+    if ((node->journal = new_journal()) == NULL
+	|| index_node(node, header->id)) {
+      bitree_destroy(&node);
+      return -1;
+    }
+    *tree = node;
+    return 0;
+
+  case JOURNAL_INSL:
+  case JOURNAL_INSR:
+    /* The ID is checked, and room made for it, before the replica is
+     * changed, so that indexing the new node can't fail.
+     */
+    if ((node = find_node(journal, header->other)) == NULL
+	|| reserve_id(journal, header->id, 1)
+	|| (data = deserialize(payload, header->size)) == NULL
+	|| (header->op == JOURNAL_INSL
+	    ? bitree_insl(node, data) : bitree_insr(node, data)))
+      goto error_exit;
+    return index_node(header->op == JOURNAL_INSL ? node->left : node->right,
+		      header->id);
+
+  case JOURNAL_REM:
+    if ((node = find_node(journal, header->id)) == NULL)
+      return -1;
+    if (node == node->root)
+      *tree = NULL;
+    bitree_rem(node);
+    return 0;
+
+  case JOURNAL_UPDATE:
+    if ((node = find_node(journal, header->id)) == NULL
+	|| (data = deserialize(payload, header->size)) == NULL)
+      goto error_exit;
+    if (node->destroy != NULL)
+      node->destroy(node->data);
+    node->data = data;
+    bitree_update(node);
+    return 0;
+
+  case JOURNAL_ROTL:
+  case JOURNAL_ROTR:
+    if ((node = find_node(journal, header->id)) == NULL)
+      return -1;
+    return (header->op == JOURNAL_ROTL
+	    ? bitree_rotl(node) : bitree_rotr(node)) == NULL ? -1 : 0;
+
+  case JOURNAL_NEWROOT:
+    if (next->op != JOURNAL_MERGE
+	|| (newdata = deserialize(payload, header->size)) == NULL)
+      goto error_exit;
+    /* Fall through */
+  case JOURNAL_MERGE: {
+    const struct journal_header * merge = newdata != NULL ? next : header;
+    bitree * graft = NULL;
+    /* As for the insertions, both IDs are checked first */
+    size_t ids = newdata != NULL ? 2 : 1;
+    if ((node = find_node(journal, merge->other)) == NULL
+	|| reserve_id(journal, merge->id, ids)
+	|| (newdata != NULL
+	    && (header->id == merge->id || reserve_id(journal, header->id, ids)))
+	|| (data = deserialize(newdata != NULL ? next_payload : payload,
+			       merge->size)) == NULL
+	|| (graft = bitree_create(node->destroy, data)) == NULL)
+      goto error_exit;
+    data = NULL;
+    if (bitree_merge(node, graft, newdata)) {
+      bitree_destroy(&graft);
+      goto error_exit;
+    }
+
+    *tree = node->root;
+    if (index_node(graft, merge->id))
+      return -1;
+    return newdata != NULL ? index_node(graft->parent, header->id) : 0;
+  }
+
+  default:
+    return -1;
+  }
+
+ error_exit: {
+    if (data != NULL && destroy != NULL)
+      destroy(data);
+    if (newdata != NULL && destroy != NULL)
+      destroy(newdata);
+    return -1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    find_node
+ *
+ * DESCRIPTION:	    Looks up a node of a replica by its ID.
+ *
+ * ARGUMENTS:	    journal: (struct bitree_journal *) -- the replica's journal.
+ *		    id: (uint64_t) -- the ID.
+ *
+ * RETURN:	    bitree * -- the node, or NULL.
+ *
+ * NOTES:	    Expected Theta(1)
+ ***/
+static bitree * find_node(struct bitree_journal * journal, uint64_t id)
+{
+  if (journal->slots == 0)
+    return NULL;
+
+  for (size_t i = index_home(id, journal->slots); journal->index[i] != NULL;
+       i = (i + 1) & (journal->slots - 1))
+    if (journal->index[i]->id == id)
+      return journal->index[i];
+  return NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    reserve_id
+ *
+ * DESCRIPTION:	    Checks that `id' can be given to a new node of a replica,
+ *		    and makes room in the index for `n' more nodes, doubling it
+ *		    so that it is never more than half full.
+ *
+ * ARGUMENTS:	    journal: (struct bitree_journal *) -- the replica's journal.
+ *		    id: (uint64_t) -- the ID.
+ *		    n: (size_t) -- the number of nodes about to be indexed, at
+ *			most 2.
+ *
+ * RETURN:	    int -- 0 on success, -1 on failure or if the ID is taken.
+ *
+ * NOTES:	    Amortized expected Theta(1)
+ ***/
+static int reserve_id(struct bitree_journal * journal, uint64_t id, size_t n)
+{
+  if (id == 0 || find_node(journal, id) != NULL)
+    return -1;
+  if (2 * (journal->count + n) <= journal->slots)
+    return 0;
+
+  size_t slots = journal->slots == 0 ? 64 : 2 * journal->slots;
+  bitree ** index = calloc(slots, sizeof(bitree *));
+  if (index == NULL)
+    return -1;
+  for (size_t i = 0; i < journal->slots; i++) {
+    if (journal->index[i] == NULL)
+      continue;
+    size_t j = index_home(journal->index[i]->id, slots);
+    while (index[j] != NULL)
+      j = (j + 1) & (slots - 1);
+    index[j] = journal->index[i];
+  }
+  free(journal->index);
+  journal->index = index;
+  journal->slots = slots;
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    index_node
+ *
+ * DESCRIPTION:	    Gives a node of a replica its ID, and adds it to the index.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    id: (uint64_t) -- its ID.
+ *
+ * RETURN:	    int -- 0 on success, -1 on failure or if the ID is taken.
+ *		    Neither can happen once reserve_id() has succeeded for it.
+ *
+ * NOTES:	    Amortized expected Theta(1)
+ ***/
+static int index_node(bitree * node, uint64_t id)
+{
+  struct bitree_journal * journal = node->journal;
+  if (reserve_id(journal, id, 1))
+    return -1;
+
+  node->id = id;
+  size_t i = index_home(id, journal->slots);
+  while (journal->index[i] != NULL)
+    i = (i + 1) & (journal->slots - 1);
+  journal->index[i] = node;
+  journal->count++;
+  if (id >= journal->next_id)
+    journal->next_id = id + 1;
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    forget_node
+ *
+ * DESCRIPTION:	    Removes a node which is being freed from the index of its
+ *		    replica, if it is in one. The entries after it in its probe
+ *		    sequence are moved back, so that lookups never need to
+ *		    skip over a deleted entry.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Expected Theta(1)
+ ***/
+static void forget_node(bitree * node)
+{
+  struct bitree_journal * journal = node->journal;
+  if (journal == NULL || journal->write != NULL || journal->slots == 0)
+    return;
+
+  size_t mask = journal->slots - 1, i = index_home(node->id, journal->slots);
+  while (journal->index[i] != NULL && journal->index[i] != node)
+    i = (i + 1) & mask;
+  if (journal->index[i] == NULL)
+    return;
+
+  journal->index[i] = NULL;
+  journal->count--;
+  for (size_t j = (i + 1) & mask; journal->index[j] != NULL;
+       j = (j + 1) & mask) {
+    /* The entry at j can move to i unless its home lies cyclically in
+     * (i, j], in which case a lookup for it would never pass i.
+     */
+    size_t home = index_home(journal->index[j]->id, journal->slots);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      journal->index[i] = journal->index[j];
+      journal->index[j] = NULL;
+      i = j;
+    }
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    forget_subtree
+ *
+ * DESCRIPTION:	    Takes a subtree which is about to be freed out of the
+ *		    journal of its tree, so that the nodes can then be freed
+ *		    without touching the journal. If the subtree is the whole
+ *		    tree, the journal is freed; otherwise, on a replica, each
+ *		    node is removed from the index.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- root of the subtree.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Expected Theta(n) on a replica, n is the size of the
+ *		    subtree, otherwise Theta(1).
+ ***/
+static void forget_subtree(bitree * node)
+{
+  struct bitree_journal * journal = node->journal;
+  if (journal == NULL)
+    return;
+  if (node->root == node) {
+    free_journal(journal);
+    return;
+  }
+  if (journal->write != NULL || journal->slots == 0)
+    return;
+
+  for (bitree * next = postorder_first(node); next != NULL;
+       next = postorder_next(next, node))
+    forget_node(next);
+}
+#endif /* CONFIG_JOURNAL */
+
+#ifdef CONFIG_DEBUG
+/******************************************************************************
+ * FUNCTION:	    check_node_links
+ *
+ * DESCRIPTION:	    Asserts that the links of `node' agree with those of its
+ *		    parent and children, and that they all share the same
+ *		    `root' and `size'.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to check.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void check_node_links(bitree * node)
+{
+  assert(node != NULL);
+  assert((node->parent == NULL) == (node->root == node));
+  assert(node->root->size == node->size);
+  if (node->parent != NULL)
+    assert(node->parent->left == node || node->parent->right == node);
+  if (node->left != NULL)
+    assert(node->left->parent == node && node->left->root == node->root);
+  if (node->right != NULL)
+    assert(node->right->parent == node && node->right->root == node->root);
+}
+#endif /* CONFIG_DEBUG */
+
 /*****************************************************************************/
@@ -0,0 +1,208 @@
+/******************************************************************************
+ * NAME:	    bitree_avl.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the ordered (AVL) layer on top of the
+ *		    Binary Tree in bitree.c. Keys are kept in in-order
+ *		    sequence, and the tree is rebalanced with rotations after
+ *		    every insertion and removal, so that lookups are
+ *		    O(log(n)).
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#include <stdlib.h>
+
+#include "bitree.h"
+#include "bitree_internal.h"
+#include "bitree_avl.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+#define avl_balance(node)	(node_height((node)->left)		\
+				 - node_height((node)->right))
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static void rebalance(bitree * node);
+
+/******************************************************************************
+ * API FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_avl_insert
+ *
+ * DESCRIPTION:	    Inserts `data' into the keyed tree containing `tree', then
+ *		    rebalances the path back up to the root.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
+ *		    data: (void *) -- the key to insert.
+ *		    compare: (int (*)(const void *, const void *)) -- the
+ *			comparison function for the tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 on failure or if the key is already
+ *		    in the tree.
+ *
+ * NOTES:	    O(log(n))
+ ***/
+int bitree_avl_insert(bitree * tree, void * data,
+		      int (*compare)(const void *, const void *))
+{
+  if (tree == NULL || data == NULL || compare == NULL)
+    return -1;
+
+  bitree * node = tree->root;
+  while (1) {
+    int result = compare(data, node->data);
+    if (result == 0)
+      return -1;
+
+    if (result < 0 && node->left == NULL) {
+      if (bitree_insl(node, data))
+	return -1;
+      break;
+    } else if (result > 0 && node->right == NULL) {
+      if (bitree_insr(node, data))
+	return -1;
+      break;
+    }
+
+    node = result < 0 ? node->left : node->right;
+  }
+
+  rebalance(node);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_avl_find
+ *
+ * DESCRIPTION:	    Searches the subtree rooted at `tree' for `key'.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree to search.
+ *		    key: (const void *) -- the key to look for.
+ *		    compare: (int (*)(const void *, const void *)) -- the
+ *			comparison function for the tree.
+ *
+ * RETURN:	    bitree * -- the node containing `key', or NULL.
+ *
+ * NOTES:	    O(log(n))
+ ***/
+bitree * bitree_avl_find(bitree * tree, const void * key,
+			 int (*compare)(const void *, const void *))
+{
+  if (key == NULL || compare == NULL)
+    return NULL;
+
+  while (tree != NULL) {
+    int result = compare(key, tree->data);
+    if (result == 0)
+      return tree;
+    tree = result < 0 ? tree->left : tree->right;
+  }
+
+  return NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_avl_erase
+ *
+ * DESCRIPTION:	    Removes `key' from the keyed tree at `*tree'. The payload
+ *		    to be removed is first exchanged down the tree until it
+ *		    sits in a leaf, so that bitree_rem() can remove it without
+ *		    disturbing the rest of the ordering.
+ *
+ * ARGUMENTS:	    tree: (bitree **) -- pointer to the root of the tree.
+ *		    key: (const void *) -- the key to remove.
+ *		    compare: (int (*)(const void *, const void *)) -- the
+ *			comparison function for the tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 if `key' was not found.
+ *
+ * NOTES:	    O(log(n))
+ ***/
+int bitree_avl_erase(bitree ** tree, const void * key,
+		     int (*compare)(const void *, const void *))
+{
+  if (tree == NULL || *tree == NULL)
+    return -1;
+
+  bitree * node = bitree_avl_find((*tree)->root, key, compare);
+  if (node == NULL)
+    return -1;
+
+  if (*(node->size) == 1) {
+    bitree_rem(node);
+    *tree = NULL;
+    return 0;
+  }
+
+  /* Move the payload down to a leaf, swapping with the in-order neighbour
+   * each time, so that the ordering of the other keys is preserved.
+   */
+  while (!bitree_isleaf(node)) {
+    bitree * next = NULL;
+    if (node->right != NULL) {
+      for (next = node->right; next->left != NULL; next = next->left);
+    } else {
+      for (next = node->left; next->right != NULL; next = next->right);
+    }
+    bitree_swap_data(node, next);
+    node = next;
+  }
+
+  bitree * parent = node->parent;
+  bitree_rem(node);
+  rebalance(parent);
+  return 0;
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    rebalance
+ *
+ * DESCRIPTION:	    Walks from `node' up to the root, updating heights and
+ *		    rotating wherever the AVL balance condition is violated.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the lowest node whose subtree changed.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(log(n))
+ ***/
+static void rebalance(bitree * node)
+{
+  while (node != NULL) {
+    bitree_update_height(node);
+    int balance = avl_balance(node);
+
+    if (balance > 1) {
+      if (avl_balance(node->left) < 0)
+	bitree_rotl(node->left);
+      node = bitree_rotr(node);
+    } else if (balance < -1) {
+      if (avl_balance(node->right) > 0)
+	bitree_rotr(node->right);
+      node = bitree_rotl(node);
+    }
+
+    node = node->parent;
+  }
+}
+
+/*****************************************************************************/
@@ -0,0 +1,395 @@
+/******************************************************************************
+ * NAME:	    bitree_bfs.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the parallel breadth-first traversal.
+ *		    The nodes of the current level are kept in an array, the
+ *		    frontier, which is cut into one contiguous range per
+ *		    thread. Each thread calls the action on its range, and
+ *		    appends the children to its own buffer, so no locks are
+ *		    taken until the barrier at the end of the level. There,
+ *		    the calling thread runs the level hook, and joins the
+ *		    buffers, in thread order, into the next frontier. Since
+ *		    the ranges are in order, so is the next frontier.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bitree_bfs.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* How many nodes of its range a thread prefetches ahead of the one it is
+ * visiting.
+ */
+#define PREFETCH_AHEAD	8
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* The children found by one thread in the current level */
+struct bfs_buffer {
+  bitree ** nodes;
+  size_t size;
+  size_t capacity;
+  int failed;
+};
+
+/* The state shared by the threads of a traversal. `lock', `turn', `waiting'
+ * and `generation' make up the barrier. `frontier' holds the `size' nodes of
+ * level `depth', and `spare' the room for the next level. `result' is set,
+ * and `done' with it, when the traversal is over.
+ */
+struct bfs {
+  void (*action)(bitree *, int, void *);
+  int (*level)(int, bitree **, size_t, void *);
+  void * ctx;
+  int threads;
+  struct bfs_buffer * buffers;
+
+  bitree ** frontier;
+  size_t size;
+  bitree ** spare;
+  size_t capacity;
+  int depth;
+  int done;
+  int result;
+
+  pthread_mutex_t lock;
+  pthread_cond_t turn;
+  int waiting;
+  unsigned long generation;
+};
+
+/* A thread other than the caller, and the number of its range */
+struct bfs_worker {
+  struct bfs * bfs;
+  int id;
+};
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static void * bfs_thread(void * arg);
+static void bfs_run(struct bfs * bfs, int id);
+static void bfs_expand(struct bfs * bfs, int id);
+static void bfs_advance(struct bfs * bfs);
+static void bfs_barrier(struct bfs * bfs);
+
+/******************************************************************************
+ * API FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_bfs
+ *
+ * DESCRIPTION:	    Visits a subtree level by level, with the nodes of each
+ *		    level shared out between several threads.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the root of the subtree.
+ *		    threads: (int) -- the number of threads, or 0 for one per
+ *			CPU.
+ *		    action: (void (*)(bitree *, int, void *)) -- called on
+ *			each node, or NULL.
+ *		    level: (int (*)(int, bitree **, size_t, void *)) --
+ *			called on each level, or NULL.
+ *		    ctx: (void *) -- passed to `action' and `level'.
+ *
+ * RETURN:	    int -- 1 if the traversal was stopped, 0 if it finished,
+ *		    and -1 on error.
+ *
+ * NOTES:	    O(n / t + h) per thread, n is the size of the subtree, t
+ *		    the number of threads and h its height, plus a barrier per
+ *		    level; the frontiers are joined in O(n) by the caller. If
+ *		    some of the threads can't be started, the rest carry on
+ *		    without them.
+ ***/
+int bitree_bfs(bitree * tree, int threads,
+	       void (*action)(bitree * node, int depth, void * ctx),
+	       int (*level)(int depth, bitree ** nodes, size_t size,
+			    void * ctx),
+	       void * ctx)
+{
+  if (tree == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (threads <= 0)
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1)
+    threads = 1;
+
+  struct bfs bfs = {
+    .action = action, .level = level, .ctx = ctx, .capacity = 1
+  };
+  struct bfs_worker * workers = NULL;
+  pthread_t * ids = NULL;
+  if ((bfs.buffers = calloc(threads, sizeof(struct bfs_buffer))) == NULL
+      || (bfs.frontier = malloc(sizeof(bitree *))) == NULL
+      || (bfs.spare = malloc(sizeof(bitree *))) == NULL
+      || (threads > 1
+	  && ((workers = malloc(threads * sizeof(struct bfs_worker))) == NULL
+	      || (ids = malloc(threads * sizeof(pthread_t))) == NULL))) {
+    bfs.result = -1;
+    goto exit;
+  }
+  bfs.frontier[0] = tree;
+  bfs.size = 1;
+
+  /* The workers wait on the lock until they are all started, and the number
+   * of threads taking part is known.
+   */
+  pthread_mutex_init(&bfs.lock, NULL);
+  pthread_cond_init(&bfs.turn, NULL);
+  pthread_mutex_lock(&bfs.lock);
+  int started = 0;
+  for (; started < threads - 1; started++) {
+    workers[started].bfs = &bfs;
+    workers[started].id = started + 1;
+    if (pthread_create(&ids[started], NULL, bfs_thread, &workers[started]))
+      break;
+  }
+  bfs.threads = started + 1;
+  pthread_mutex_unlock(&bfs.lock);
+
+  bfs_run(&bfs, 0);
+  for (int i = 0; i < started; i++)
+    pthread_join(ids[i], NULL);
+  pthread_cond_destroy(&bfs.turn);
+  pthread_mutex_destroy(&bfs.lock);
+
+ exit:
+  if (bfs.buffers != NULL)
+    for (int i = 0; i < threads; i++)
+      free(bfs.buffers[i].nodes);
+  free(bfs.buffers);
+  free(bfs.frontier);
+  free(bfs.spare);
+  free(workers);
+  free(ids);
+  if (bfs.result < 0)
+    errno = ENOMEM;
+  return bfs.result;
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bfs_thread
+ *
+ * DESCRIPTION:	    The start routine of the threads other than the caller.
+ *
+ * ARGUMENTS:	    arg: (void *) -- the struct bfs_worker.
+ *
+ * RETURN:	    void * -- NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static void * bfs_thread(void * arg)
+{
+  struct bfs_worker * worker = (struct bfs_worker *)arg;
+  bfs_run(worker->bfs, worker->id);
+  return NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bfs_run
+ *
+ * DESCRIPTION:	    Takes part in a traversal until it is over.
+ *
+ * ARGUMENTS:	    bfs: (struct bfs *) -- the traversal.
+ *		    id: (int) -- the number of the thread; 0 is the caller.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Every thread passes two barriers per level: one once the
+ *		    level has been visited, and one once the caller has made
+ *		    the next frontier.
+ ***/
+static void bfs_run(struct bfs * bfs, int id)
+{
+  bfs_barrier(bfs);
+  while (1) {
+    bfs_expand(bfs, id);
+    bfs_barrier(bfs);
+    if (id == 0)
+      bfs_advance(bfs);
+    bfs_barrier(bfs);
+    if (bfs->done)
+      return;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    bfs_expand
+ *
+ * DESCRIPTION:	    Calls the action on a thread's range of the frontier, and
+ *		    appends the children of its nodes to the thread's buffer.
+ *
+ * ARGUMENTS:	    bfs: (struct bfs *) -- the traversal.
+ *		    id: (int) -- the number of the thread.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    The frontier is cut into as many ranges as there are
+ *		    threads, but no range is smaller than BITREE_BFS_GRAIN
+ *		    nodes; threads left without one have nothing to do. The
+ *		    buffer's fields are only written back at the end, so that
+ *		    threads don't contend for the cache lines of the array of
+ *		    buffers.
+ ***/
+static void bfs_expand(struct bfs * bfs, int id)
+{
+  size_t ranges = (bfs->size + BITREE_BFS_GRAIN - 1) / BITREE_BFS_GRAIN;
+  if (ranges > (size_t)bfs->threads)
+    ranges = bfs->threads;
+  if ((size_t)id >= ranges)
+    return;
+
+  struct bfs_buffer * buffer = &bfs->buffers[id];
+  bitree ** frontier = bfs->frontier;
+  size_t begin = bfs->size * id / ranges;
+  size_t end = bfs->size * (id + 1) / ranges;
+  bitree ** nodes = buffer->nodes;
+  size_t size = 0, capacity = buffer->capacity;
+  for (size_t i = begin; i < end; i++) {
+    bitree * node = frontier[i];
+    if (i + PREFETCH_AHEAD < end)
+      __builtin_prefetch(frontier[i + PREFETCH_AHEAD]);
+    if (bfs->action != NULL)
+      bfs->action(node, bfs->depth, bfs->ctx);
+
+    if (size + 2 > capacity) {
+      size_t grown = capacity > 0 ? 2 * capacity : 2 * (end - begin) + 2;
+      bitree ** more = realloc(nodes, grown * sizeof(bitree *));
+      if (more == NULL) {
+	buffer->failed = 1;
+	break;
+      }
+      nodes = more;
+      capacity = grown;
+    }
+    if (node->left != NULL)
+      nodes[size++] = node->left;
+    if (node->right != NULL)
+      nodes[size++] = node->right;
+  }
+
+  buffer->nodes = nodes;
+  buffer->size = size;
+  buffer->capacity = capacity;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bfs_advance
+ *
+ * DESCRIPTION:	    Runs the level hook on the level just visited, and joins
+ *		    the threads' buffers into the frontier of the next one.
+ *
+ * ARGUMENTS:	    bfs: (struct bfs *) -- the traversal.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Called by the caller's thread alone, between barriers.
+ ***/
+static void bfs_advance(struct bfs * bfs)
+{
+  size_t total = 0;
+  int failed = 0;
+  for (int i = 0; i < bfs->threads; i++) {
+    total += bfs->buffers[i].size;
+    failed |= bfs->buffers[i].failed;
+  }
+
+  if (failed) {
+    bfs->result = -1;
+  } else if (bfs->level != NULL
+	     && bfs->level(bfs->depth, bfs->frontier, bfs->size, bfs->ctx)) {
+    bfs->result = 1;
+  } else if (total > bfs->capacity) {
+    /* The frontier and the spare swap places, so both must hold the next
+     * level. The nodes in the frontier aren't needed any more.
+     */
+    bitree ** frontier = realloc(bfs->frontier, total * sizeof(bitree *));
+    if (frontier != NULL)
+      bfs->frontier = frontier;
+    bitree ** spare = realloc(bfs->spare, total * sizeof(bitree *));
+    if (spare != NULL)
+      bfs->spare = spare;
+    if (frontier == NULL || spare == NULL)
+      bfs->result = -1;
+    else
+      bfs->capacity = total;
+  }
+  if (bfs->result != 0 || total == 0) {
+    bfs->done = 1;
+    return;
+  }
+
+  size_t size = 0;
+  for (int i = 0; i < bfs->threads; i++) {
+    struct bfs_buffer * buffer = &bfs->buffers[i];
+    if (buffer->size == 0)
+      continue;
+    memcpy(bfs->spare + size, buffer->nodes, buffer->size * sizeof(bitree *));
+    size += buffer->size;
+    buffer->size = 0;
+  }
+  bitree ** frontier = bfs->frontier;
+  bfs->frontier = bfs->spare;
+  bfs->spare = frontier;
+  bfs->size = total;
+  bfs->depth++;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bfs_barrier
+ *
+ * DESCRIPTION:	    Waits until every thread of the traversal has reached the
+ *		    barrier.
+ *
+ * ARGUMENTS:	    bfs: (struct bfs *) -- the traversal.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    pthread_barrier_t isn't available everywhere (e.g. on OS
+ *		    X), so this is built from a mutex and a condition
+ *		    variable. The lock also orders the threads' writes to the
+ *		    shared state before the barrier with their reads after it.
+ ***/
+static void bfs_barrier(struct bfs * bfs)
+{
+  pthread_mutex_lock(&bfs->lock);
+  unsigned long generation = bfs->generation;
+  if (++bfs->waiting == bfs->threads) {
+    bfs->waiting = 0;
+    bfs->generation++;
+    pthread_cond_broadcast(&bfs->turn);
+  } else {
+    while (generation == bfs->generation)
+      pthread_cond_wait(&bfs->turn, &bfs->lock);
+  }
+  pthread_mutex_unlock(&bfs->lock);
+}
+
+/*****************************************************************************/
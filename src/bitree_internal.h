@@ -0,0 +1,65 @@
+/******************************************************************************
+ * NAME:	    bitree_internal.h
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the helpers which the modules of the
+ *		    library share: those of bitree.c, and the walker used by
+ *		    the trees which link their nodes by 64-bit references. It
+ *		    is not installed with the public headers, and nothing in
+ *		    it is part of the API.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+#ifndef __ET_BITREE_INTERNAL_H_
+#define __ET_BITREE_INTERNAL_H_
+
+#include "bitree.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* The height of a possibly empty subtree */
+#define node_height(node)	((node) == NULL ? 0 : (node)->height)
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* How bitree_walk_refs() moves around a tree whose nodes are named by 64-bit
+ * references, 0 being none. Each function is passed the `walk' given to
+ * bitree_walk_refs(). stale() may be NULL; otherwise, it is checked at every
+ * step, and once it returns nonzero the walk stops and fails.
+ */
+struct bitree_walker {
+  uint64_t (*left)(void * walk, uint64_t node);
+  uint64_t (*right)(void * walk, uint64_t node);
+  uint64_t (*parent)(void * walk, uint64_t node);
+  enum bitree_visit (*visit)(void * walk, uint64_t node);
+  int (*stale)(void * walk);
+};
+
+/******************************************************************************
+ * INTERNAL FUNCTION PROTOTYPES
+ ***/
+
+/* Recalculate the height of `node' from those of its children */
+extern void bitree_update_height(bitree * node);
+
+/* Exchange the payloads of two nodes, recording both in the journal */
+extern void bitree_swap_data(bitree * one, bitree * two);
+
+/* Visit the subtree rooted at `top' in the order given, until the visitor
+ * returns BITREE_STOP. Returns 1 if the walk was stopped, 0 if it finished,
+ * and -1 on error, with errno set to EAGAIN if the tree went stale.
+ */
+extern int bitree_walk_refs(const struct bitree_walker * walker, void * walk,
+			    uint64_t top, enum bitree_order order);
+
+#endif /* __ET_BITREE_INTERNAL_H_ */
+
+/*****************************************************************************/
@@ -0,0 +1,1405 @@
+/******************************************************************************
+ * NAME:	    bitree_io.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains bitree_save() and bitree_load(). The
+ *		    tree is cut into chunks: a postorder pass cuts off each
+ *		    subtree as soon as it has gathered enough nodes which were
+ *		    not cut off already. A chunk holds the nodes of its subtree
+ *		    in preorder, and marks the children which start other
+ *		    chunks; each of those chunks records which mark of which
+ *		    chunk it hangs from. The first block of the file is the
+ *		    header, the chunks follow it, and the table of chunks
+ *		    comes last, listing them from the root down.
+ *
+ *		    Reads and writes go through a queue, which is backed by
+ *		    io_uring, or by plain pread() and pwrite() calls.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#define _GNU_SOURCE /* O_DIRECT */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(CONFIG_IO_URING) && defined(__linux__)
+#  define IO_URING
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#endif
+
+#include "bitree_io.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* "bitreeio", marks a file which holds a saved tree */
+#define IO_MAGIC	0x6269747265656f69ULL
+
+/* The flags byte which starts the record of each node */
+#define HAS_LEFT	0x1
+#define HAS_RIGHT	0x2
+#define LEFT_CHUNK	0x4 /* The left child starts another chunk */
+#define RIGHT_CHUNK	0x8
+
+/* A flags byte, and the size of the payload as a uint32_t */
+#define RECORD_HEADER	5
+
+#define NO_CHUNK	SIZE_MAX
+
+#define padded(size)	(((size) + BITREE_IO_BLOCK - 1)			\
+			 & ~(size_t)(BITREE_IO_BLOCK - 1))
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* The first block of the file */
+struct file_header {
+  uint64_t magic;
+  uint64_t nodes;
+  uint64_t chunks;
+  uint64_t table;
+};
+
+/* An entry of the table of chunks. The chunk hangs from mark `mark' of chunk
+ * `parent', counting from 0 in the order the marks appear in that chunk.
+ * `marks' is the number of marks in this chunk.
+ */
+struct chunk_entry {
+  uint64_t offset;
+  uint64_t bytes;
+  uint64_t nodes;
+  uint64_t parent;
+  uint64_t mark;
+  uint64_t marks;
+};
+
+/* A read or write of `size' bytes, of which `done' are done. `error' is the
+ * errno of a request which failed.
+ */
+struct io_request {
+  unsigned char * buffer;
+  size_t size;
+  uint64_t offset;
+  size_t done;
+  int write;
+  int error;
+};
+
+struct io_queue {
+  int fd;
+  int depth;
+  int inflight;
+
+  /* Requests done by the synchronous backend, waiting to be reaped */
+  struct io_request ** done;
+  int finished;
+
+#ifdef IO_URING
+  int ring;
+  unsigned pending;
+  unsigned char * sq_ring;
+  size_t sq_size;
+  unsigned char * cq_ring;
+  size_t cq_size;
+  struct io_uring_sqe * sqes;
+  size_t sqes_size;
+  unsigned * sq_head;
+  unsigned * sq_tail;
+  unsigned * sq_mask;
+  unsigned * sq_array;
+  unsigned * cq_head;
+  unsigned * cq_tail;
+  unsigned * cq_mask;
+  struct io_uring_cqe * cqes;
+#endif
+};
+
+/* A chunk, in memory. The request is first in the struct, so that a request
+ * reaped from the queue can be cast back to its chunk.
+ */
+struct io_chunk {
+  struct io_request request;
+  bitree * root;
+  size_t capacity;
+  int ready;
+};
+
+/* A cut, as found by its root */
+struct cut {
+  bitree * node;
+  size_t chunk;
+};
+
+/* The state of a bitree_save(). Chunks are claimed by the serializing
+ * threads in order, and passed to the writing thread through `queue'. At most
+ * `limit' of them are between being claimed and being written.
+ */
+struct save {
+  size_t (*serialize)(const void *, void *, size_t);
+  struct io_chunk * chunks;
+  struct chunk_entry * entries;
+  struct cut * cuts;
+  size_t count;
+
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  pthread_cond_t room;
+  size_t next;
+  size_t pending;
+  size_t limit;
+  size_t * queue;
+  size_t head;
+  size_t tail;
+  int active;
+  int error;
+
+  /* The end of the last chunk written */
+  uint64_t end;
+};
+
+/* A mark, once the node it belongs to has been built */
+struct mark {
+  bitree * node;
+  int right;
+};
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static int open_file(const char * path, int flags, int direct);
+static void * alloc_block(size_t size);
+static int transfer(int fd, struct io_request * request);
+
+static int io_open(struct io_queue * io, int fd, int depth, int flags);
+static void io_close(struct io_queue * io);
+static void io_submit(struct io_queue * io, struct io_request * request);
+static int io_reap(struct io_queue * io, struct io_request ** request);
+#ifdef IO_URING
+static int ring_open(struct io_queue * io);
+static void ring_close(struct io_queue * io);
+static void ring_push(struct io_queue * io, struct io_request * request);
+static int ring_pop(struct io_queue * io, struct io_request ** request,
+		    int * result);
+#endif
+
+static size_t plan_chunks(bitree * tree, size_t target, bitree *** roots);
+static int compare_cuts(const void * one, const void * two);
+static size_t find_cut(struct save * save, bitree * node);
+static int serialize_chunk(struct save * save, size_t chunk);
+static int grow_chunk(struct io_chunk * chunk, size_t size);
+static void * save_thread(void * arg);
+static int write_chunks(struct save * save, struct io_queue * io);
+static int build_chunk(const struct chunk_entry * entries, size_t chunk,
+		       const unsigned char * buffer, struct mark * marks,
+		       const size_t * first, bitree ** root,
+		       void * (*deserialize)(const void *, size_t),
+		       void (*destroy)(void *));
+
+/******************************************************************************
+ * API FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_save
+ *
+ * DESCRIPTION:	    Saves a subtree to a file.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    path: (const char *) -- the file.
+ *		    serialize: (size_t (*)(const void *, void *, size_t)) --
+ *			writes a payload into a chunk.
+ *		    options: (const struct bitree_io_options *) -- tuning, or
+ *			NULL.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(n log c), n is the size of the subtree, and c is the
+ *		    number of chunks.
+ ***/
+int bitree_save(bitree * tree, const char * path,
+		size_t (*serialize)(const void *, void *, size_t),
+		const struct bitree_io_options * options)
+{
+  if (tree == NULL || path == NULL || serialize == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct bitree_io_options defaults = {0};
+  if (options == NULL)
+    options = &defaults;
+  int threads = options->threads > 0 ? options->threads
+    : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1)
+    threads = 1;
+  size_t target = options->chunk_nodes > 0 ? options->chunk_nodes
+    : BITREE_IO_CHUNK_NODES;
+  int depth = options->depth > 0 ? options->depth : BITREE_IO_DEPTH;
+
+  struct save save = {.serialize = serialize};
+  struct io_queue io = {.fd = -1};
+  pthread_t * workers = NULL;
+  bitree ** roots = NULL;
+  unsigned char * block = NULL;
+  int fd = -1, started = 0, error = 0;
+
+  if ((save.count = plan_chunks(tree, target, &roots)) == 0
+      || (save.chunks = calloc(save.count, sizeof(struct io_chunk))) == NULL
+      || (save.entries = alloc_block(save.count
+				     * sizeof(struct chunk_entry))) == NULL
+      || (save.cuts = malloc(save.count * sizeof(struct cut))) == NULL
+      || (save.queue = malloc(save.count * sizeof(size_t))) == NULL
+      || (workers = malloc(threads * sizeof(pthread_t))) == NULL)
+    goto error_exit;
+  for (size_t i = 0; i < save.count; i++) {
+    save.chunks[i].root = save.cuts[i].node = roots[i];
+    save.cuts[i].chunk = i;
+  }
+  qsort(save.cuts, save.count, sizeof(struct cut), compare_cuts);
+
+  if ((fd = open_file(path, O_WRONLY | O_CREAT | O_TRUNC,
+		      options->flags & BITREE_IO_DIRECT)) < 0
+      || io_open(&io, fd, depth, options->flags))
+    goto error_exit;
+
+  pthread_mutex_init(&save.lock, NULL);
+  pthread_cond_init(&save.ready, NULL);
+  pthread_cond_init(&save.room, NULL);
+  save.limit = depth + threads;
+  for (; started < threads; started++) {
+    pthread_mutex_lock(&save.lock);
+    save.active++;
+    pthread_mutex_unlock(&save.lock);
+    if (pthread_create(&workers[started], NULL, save_thread, &save)) {
+      pthread_mutex_lock(&save.lock);
+      save.active--;
+      pthread_mutex_unlock(&save.lock);
+      break;
+    }
+  }
+
+  /* With no threads to serialize the chunks, nothing will be written */
+  error = started == 0 ? EAGAIN : 0;
+  if (started > 0 && write_chunks(&save, &io))
+    error = save.error;
+  for (int i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+  pthread_cond_destroy(&save.room);
+  pthread_cond_destroy(&save.ready);
+  pthread_mutex_destroy(&save.lock);
+  if (error) {
+    errno = error;
+    goto error_exit;
+  }
+
+  /* The table goes after the last chunk, and the header goes last of all */
+  uint64_t nodes = 0;
+  for (size_t i = 0; i < save.count; i++)
+    nodes += save.entries[i].nodes;
+  struct file_header header = {
+    .magic = IO_MAGIC,
+    .nodes = nodes,
+    .chunks = save.count,
+    .table = save.end,
+  };
+  struct io_request table = {
+    .buffer = (unsigned char *)save.entries,
+    .size = padded(save.count * sizeof(struct chunk_entry)),
+    .offset = header.table,
+    .write = 1,
+  };
+  if ((block = alloc_block(BITREE_IO_BLOCK)) == NULL)
+    goto error_exit;
+  memcpy(block, &header, sizeof(header));
+  struct io_request first = {
+    .buffer = block, .size = BITREE_IO_BLOCK, .offset = 0, .write = 1
+  };
+  /* Until the header is written, block 0 holds no magic number, so the chunks
+   * and the table have to reach the disk before it does.
+   */
+  if (transfer(fd, &table) || fdatasync(fd) || transfer(fd, &first)
+      || fsync(fd))
+    goto error_exit;
+
+  io_close(&io);
+  free(block);
+  free(workers);
+  free(save.queue);
+  free(save.cuts);
+  free(save.entries);
+  free(save.chunks);
+  free(roots);
+  return close(fd);
+
+ error_exit: {
+    error = errno;
+    io_close(&io);
+    if (fd >= 0)
+      close(fd);
+    free(block);
+    free(workers);
+    free(save.queue);
+    free(save.cuts);
+    free(save.entries);
+    if (save.chunks != NULL)
+      for (size_t i = 0; i < save.count; i++)
+	free(save.chunks[i].request.buffer);
+    free(save.chunks);
+    free(roots);
+    errno = error;
+    return -1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_load
+ *
+ * DESCRIPTION:	    Loads a tree saved by bitree_save().
+ *
+ * ARGUMENTS:	    path: (const char *) -- the file.
+ *		    deserialize: (void * (*)(const void *, size_t)) -- creates a
+ *			payload from its serialized form.
+ *		    destroy: (void (*)(void *)) -- destroy function of the
+ *			new tree.
+ *		    options: (const struct bitree_io_options *) -- tuning, or
+ *			NULL.
+ *
+ * RETURN:	    bitree * -- the root of the tree, or NULL.
+ *
+ * NOTES:	    O(n), n is the size of the tree, plus the cost of the
+ *		    insertions.
+ ***/
+bitree * bitree_load(const char * path,
+		     void * (*deserialize)(const void *, size_t),
+		     void (*destroy)(void *),
+		     const struct bitree_io_options * options)
+{
+  if (path == NULL || deserialize == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  struct bitree_io_options defaults = {0};
+  if (options == NULL)
+    options = &defaults;
+  int depth = options->depth > 0 ? options->depth : BITREE_IO_DEPTH;
+
+  struct io_queue io = {.fd = -1};
+  struct file_header header = {0};
+  struct chunk_entry * entries = NULL;
+  struct io_chunk * chunks = NULL;
+  struct mark * marks = NULL;
+  size_t * first = NULL;
+  unsigned char * block = NULL;
+  bitree * root = NULL;
+  size_t submitted = 0, built = 0;
+  int fd = -1, error = 0;
+  struct stat status;
+
+  if ((fd = open_file(path, O_RDONLY, options->flags & BITREE_IO_DIRECT)) < 0
+      || fstat(fd, &status) || (block = alloc_block(BITREE_IO_BLOCK)) == NULL)
+    goto error_exit;
+  struct io_request request = {.buffer = block, .size = BITREE_IO_BLOCK};
+  if (transfer(fd, &request))
+    goto error_exit;
+  memcpy(&header, block, sizeof(header));
+
+  /* Read the table, and check that every chunk is in the file, and hangs
+   * from a mark of a chunk before it, so that it can be built once they are.
+   * Each mark gets its own slot in `marks', starting at first[chunk].
+   */
+  size_t table = header.chunks * sizeof(struct chunk_entry);
+  if (header.magic != IO_MAGIC || header.chunks == 0
+      || header.chunks > (uint64_t)status.st_size / BITREE_IO_BLOCK
+      || header.table % BITREE_IO_BLOCK != 0
+      || header.table + padded(table) > (uint64_t)status.st_size) {
+    errno = EINVAL;
+    goto error_exit;
+  }
+  if ((entries = alloc_block(padded(table))) == NULL
+      || (chunks = calloc(header.chunks, sizeof(struct io_chunk))) == NULL
+      || (first = malloc(header.chunks * sizeof(size_t))) == NULL)
+    goto error_exit;
+  request = (struct io_request){
+    .buffer = (unsigned char *)entries, .size = padded(table),
+    .offset = header.table
+  };
+  if (transfer(fd, &request))
+    goto error_exit;
+
+  uint64_t nodes = 0, total = 0;
+  for (size_t i = 0; i < header.chunks; i++) {
+    const struct chunk_entry * entry = &entries[i];
+    first[i] = total;
+    nodes += entry->nodes;
+    total += entry->marks;
+    if (entry->offset % BITREE_IO_BLOCK != 0 || entry->nodes == 0
+	|| entry->offset < BITREE_IO_BLOCK || entry->offset > header.table
+	|| entry->bytes > header.table - entry->offset
+	|| (i > 0 && (entry->parent >= i
+		      || entry->mark >= entries[entry->parent].marks))
+	|| entry->marks > entry->nodes * 2) {
+      errno = EINVAL;
+      goto error_exit;
+    }
+  }
+  if (nodes != header.nodes || total != header.chunks - 1) {
+    errno = EINVAL;
+    goto error_exit;
+  }
+  if (total > 0 && (marks = malloc(total * sizeof(struct mark))) == NULL)
+    goto error_exit;
+
+  if (io_open(&io, fd, depth, options->flags))
+    goto error_exit;
+
+  /* Keep up to `depth' chunks in flight, and build them in order, each as
+   * soon as it and the chunks before it have been read.
+   */
+  while (built < header.chunks) {
+    while (!error && submitted < header.chunks && io.inflight < depth) {
+      struct io_chunk * chunk = &chunks[submitted];
+      size_t size = padded(entries[submitted].bytes);
+      if ((chunk->request.buffer = alloc_block(size)) == NULL) {
+	error = errno;
+	break;
+      }
+      chunk->request.size = size;
+      chunk->request.offset = entries[submitted].offset;
+      io_submit(&io, &chunk->request);
+      submitted++;
+    }
+    if (io.inflight == 0)
+      break;
+
+    struct io_request * done = NULL;
+    if (io_reap(&io, &done)) {
+      if (!error)
+	error = errno;
+      if (done == NULL)
+	break;
+      continue;
+    }
+    ((struct io_chunk *)done)->ready = 1;
+
+    for (; !error && built < submitted && chunks[built].ready; built++) {
+      if (build_chunk(entries, built, chunks[built].request.buffer, marks,
+		      first, &root, deserialize, destroy))
+	error = errno;
+      free(chunks[built].request.buffer);
+      chunks[built].request.buffer = NULL;
+    }
+  }
+  if (!error && built < header.chunks)
+    error = EIO;
+  if (error) {
+    errno = error;
+    goto error_exit;
+  }
+
+  io_close(&io);
+  close(fd);
+  free(block);
+  free(first);
+  free(marks);
+  free(chunks);
+  free(entries);
+  return root;
+
+ error_exit: {
+    error = errno;
+    /* Closing the queue waits for the requests still in flight */
+    io_close(&io);
+    if (fd >= 0)
+      close(fd);
+    free(block);
+    free(first);
+    free(marks);
+    if (chunks != NULL)
+      for (size_t i = 0; i < header.chunks; i++)
+	free(chunks[i].request.buffer);
+    free(chunks);
+    free(entries);
+    bitree_destroy(&root);
+    errno = error;
+    return NULL;
+  }
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    open_file
+ *
+ * DESCRIPTION:	    Opens a file, with O_DIRECT if asked to and if the
+ *		    filesystem supports it.
+ *
+ * ARGUMENTS:	    path: (const char *) -- the file.
+ *		    flags: (int) -- flags for open().
+ *		    direct: (int) -- nonzero to try O_DIRECT.
+ *
+ * RETURN:	    int -- the file descriptor, or -1.
+ *
+ * NOTES:	    none.
+ ***/
+static int open_file(const char * path, int flags, int direct)
+{
+#ifdef O_DIRECT
+  if (direct) {
+    int fd = open(path, flags | O_DIRECT, 0644);
+    if (fd >= 0 || errno != EINVAL)
+      return fd;
+  }
+#endif
+  return open(path, flags, 0644);
+}
+
+/******************************************************************************
+ * FUNCTION:	    alloc_block
+ *
+ * DESCRIPTION:	    Allocates zeroed memory aligned to BITREE_IO_BLOCK, for use
+ *		    with O_DIRECT.
+ *
+ * ARGUMENTS:	    size: (size_t) -- the size; it is rounded up to a multiple
+ *			of BITREE_IO_BLOCK.
+ *
+ * RETURN:	    void * -- the memory, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static void * alloc_block(size_t size)
+{
+  void * memory = NULL;
+  size = padded(size > 0 ? size : 1);
+  int error = posix_memalign(&memory, BITREE_IO_BLOCK, size);
+  if (error) {
+    errno = error;
+    return NULL;
+  }
+  return memset(memory, 0, size);
+}
+
+/******************************************************************************
+ * FUNCTION:	    transfer
+ *
+ * DESCRIPTION:	    Does the rest of a request, with pwrite() or pread().
+ *
+ * ARGUMENTS:	    fd: (int) -- the file.
+ *		    request: (struct io_request *) -- the request.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int transfer(int fd, struct io_request * request)
+{
+  while (request->done < request->size) {
+    ssize_t result = request->write
+      ? pwrite(fd, request->buffer + request->done,
+	       request->size - request->done, request->offset + request->done)
+      : pread(fd, request->buffer + request->done,
+	      request->size - request->done, request->offset + request->done);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0) {
+      if (result == 0)
+	errno = EIO;
+      return -1;
+    }
+    request->done += result;
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    io_open
+ *
+ * DESCRIPTION:	    Sets up a queue of requests on a file.
+ *
+ * ARGUMENTS:	    io: (struct io_queue *) -- the queue.
+ *		    fd: (int) -- the file.
+ *		    depth: (int) -- the most requests in flight at once.
+ *		    flags: (int) -- the BITREE_IO_ flags.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    io_close() may be called on the queue even if this fails.
+ ***/
+static int io_open(struct io_queue * io, int fd, int depth, int flags)
+{
+  *io = (struct io_queue){.fd = fd, .depth = depth};
+#ifdef IO_URING
+  io->ring = -1;
+  if (!(flags & BITREE_IO_NO_URING) && ring_open(io) == 0)
+    return 0;
+#endif
+  if ((io->done = malloc(depth * sizeof(struct io_request *))) == NULL)
+    return -1;
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    io_close
+ *
+ * DESCRIPTION:	    Waits for the requests in flight, and frees the queue.
+ *
+ * ARGUMENTS:	    io: (struct io_queue *) -- the queue.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void io_close(struct io_queue * io)
+{
+  struct io_request * request;
+  while (io->inflight > 0)
+    if (io_reap(io, &request) && request == NULL)
+      break;
+#ifdef IO_URING
+  ring_close(io);
+#endif
+  free(io->done);
+  io->done = NULL;
+  io->inflight = 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    io_submit
+ *
+ * DESCRIPTION:	    Starts a request. With io_uring, requests are handed to
+ *		    the kernel in batches, by io_reap().
+ *
+ * ARGUMENTS:	    io: (struct io_queue *) -- the queue, which must have fewer
+ *			than `depth' requests in flight.
+ *		    request: (struct io_request *) -- the request.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void io_submit(struct io_queue * io, struct io_request * request)
+{
+  request->done = 0;
+  request->error = 0;
+  io->inflight++;
+#ifdef IO_URING
+  if (io->ring >= 0) {
+    ring_push(io, request);
+    return;
+  }
+#endif
+  if (transfer(io->fd, request))
+    request->error = errno;
+  io->done[io->finished++] = request;
+}
+
+/******************************************************************************
+ * FUNCTION:	    io_reap
+ *
+ * DESCRIPTION:	    Waits for a request to finish.
+ *
+ * ARGUMENTS:	    io: (struct io_queue *) -- the queue, which must have a
+ *			request in flight.
+ *		    request: (struct io_request **) -- set to the request which
+ *			finished, or to NULL if the queue itself failed.
+ *
+ * RETURN:	    int -- 0 if the request succeeded, -1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int io_reap(struct io_queue * io, struct io_request ** request)
+{
+#ifdef IO_URING
+  if (io->ring >= 0) {
+    int result;
+    while (1) {
+      if (ring_pop(io, request, &result)) {
+	*request = NULL;
+	return -1;
+      }
+      if (result <= 0) {
+	io->inflight--;
+	errno = (*request)->error = result < 0 ? -result : EIO;
+	return -1;
+      }
+
+      /* A short read or write is resubmitted for the rest */
+      (*request)->done += result;
+      if ((*request)->done == (*request)->size)
+	break;
+      ring_push(io, *request);
+    }
+    io->inflight--;
+    return 0;
+  }
+#endif
+  *request = io->done[--io->finished];
+  io->inflight--;
+  if ((*request)->error) {
+    errno = (*request)->error;
+    return -1;
+  }
+  return 0;
+}
+
+#ifdef IO_URING
+/******************************************************************************
+ * FUNCTION:	    ring_open
+ *
+ * DESCRIPTION:	    Sets up an io_uring for a queue, and maps its rings.
+ *
+ * ARGUMENTS:	    io: (struct io_queue *) -- the queue.
+ *
+ * RETURN:	    int -- 0 on success, -1 if io_uring can't be used.
+ *
+ * NOTES:	    none.
+ ***/
+static int ring_open(struct io_queue * io)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  if ((io->ring = syscall(__NR_io_uring_setup, io->depth, &params)) < 0)
+    return -1;
+
+  io->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  io->cq_size = params.cq_off.cqes
+    + params.cq_entries * sizeof(struct io_uring_cqe);
+  io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  io->sq_ring = mmap(NULL, io->sq_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, io->ring, IORING_OFF_SQ_RING);
+  io->cq_ring = mmap(NULL, io->cq_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, io->ring, IORING_OFF_CQ_RING);
+  io->sqes = mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_POPULATE, io->ring, IORING_OFF_SQES);
+  if (io->sq_ring == MAP_FAILED || io->cq_ring == MAP_FAILED
+      || io->sqes == MAP_FAILED) {
+    ring_close(io);
+    return -1;
+  }
+
+  io->sq_head = (unsigned *)(io->sq_ring + params.sq_off.head);
+  io->sq_tail = (unsigned *)(io->sq_ring + params.sq_off.tail);
+  io->sq_mask = (unsigned *)(io->sq_ring + params.sq_off.ring_mask);
+  io->sq_array = (unsigned *)(io->sq_ring + params.sq_off.array);
+  io->cq_head = (unsigned *)(io->cq_ring + params.cq_off.head);
+  io->cq_tail = (unsigned *)(io->cq_ring + params.cq_off.tail);
+  io->cq_mask = (unsigned *)(io->cq_ring + params.cq_off.ring_mask);
+  io->cqes = (struct io_uring_cqe *)(io->cq_ring + params.cq_off.cqes);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    ring_close
+ *
+ * DESCRIPTION:	    Unmaps the rings of a queue, and closes its io_uring.
+ *
+ * ARGUMENTS:	    io: (struct io_queue *) -- the queue.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void ring_close(struct io_queue * io)
+{
+  if (io->ring < 0)
+    return;
+  if (io->sq_ring != NULL && io->sq_ring != MAP_FAILED)
+    munmap(io->sq_ring, io->sq_size);
+  if (io->cq_ring != NULL && io->cq_ring != MAP_FAILED)
+    munmap(io->cq_ring, io->cq_size);
+  if (io->sqes != NULL && io->sqes != MAP_FAILED)
+    munmap(io->sqes, io->sqes_size);
+  close(io->ring);
+  io->ring = -1;
+}
+
+/******************************************************************************
+ * FUNCTION:	    ring_push
+ *
+ * DESCRIPTION:	    Adds the rest of a request to the submission ring.
+ *
+ * ARGUMENTS:	    io: (struct io_queue *) -- the queue.
+ *		    request: (struct io_request *) -- the request.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    The ring has room for `depth' requests, and no more than
+ *		    that are ever in flight.
+ ***/
+static void ring_push(struct io_queue * io, struct io_request * request)
+{
+  unsigned tail = *io->sq_tail;
+  unsigned index = tail & *io->sq_mask;
+  struct io_uring_sqe * sqe = &io->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = io->fd;
+  sqe->addr = (uintptr_t)(request->buffer + request->done);
+  sqe->len = request->size - request->done;
+  sqe->off = request->offset + request->done;
+  sqe->user_data = (uintptr_t)request;
+  io->sq_array[index] = index;
+  __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  io->pending++;
+}
+
+/******************************************************************************
+ * FUNCTION:	    ring_pop
+ *
+ * DESCRIPTION:	    Submits the requests added since the last call, and waits
+ *		    for one to complete.
+ *
+ * ARGUMENTS:	    io: (struct io_queue *) -- the queue.
+ *		    request: (struct io_request **) -- set to the request.
+ *		    result: (int *) -- set to the result of the read or write.
+ *
+ * RETURN:	    int -- 0 on success, -1 if the io_uring failed.
+ *
+ * NOTES:	    none.
+ ***/
+static int ring_pop(struct io_queue * io, struct io_request ** request,
+		    int * result)
+{
+  while (1) {
+    unsigned head = *io->cq_head;
+    if (head != __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe * cqe = &io->cqes[head & *io->cq_mask];
+      *request = (struct io_request *)(uintptr_t)cqe->user_data;
+      *result = cqe->res;
+      __atomic_store_n(io->cq_head, head + 1, __ATOMIC_RELEASE);
+      return 0;
+    }
+
+    int submitted = syscall(__NR_io_uring_enter, io->ring, io->pending, 1,
+			    IORING_ENTER_GETEVENTS, NULL, 0);
+    if (submitted < 0 && errno != EINTR)
+      return -1;
+    if (submitted > 0)
+      io->pending -= submitted;
+  }
+}
+#endif /* IO_URING */
+
+/******************************************************************************
+ * FUNCTION:	    plan_chunks
+ *
+ * DESCRIPTION:	    Cuts a tree into chunks of about `target' nodes.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the tree.
+ *		    target: (size_t) -- the least number of nodes in a chunk,
+ *			other than the one holding the root.
+ *		    roots: (bitree ***) -- set to a new array of the roots of
+ *			the chunks, each before the chunks below it.
+ *
+ * RETURN:	    size_t -- the number of chunks, or 0 on failure.
+ *
+ * NOTES:	    O(n), n is the size of the tree.
+ ***/
+static size_t plan_chunks(bitree * tree, size_t target, bitree *** roots)
+{
+  /* A frame counts the nodes below its node which are not cut off yet */
+  struct frame {
+    bitree * node;
+    int stage;
+    size_t size;
+  };
+  size_t depth = 64, top = 0, capacity = 16, count = 0;
+  struct frame * stack = malloc(depth * sizeof(struct frame));
+  *roots = malloc(capacity * sizeof(bitree *));
+  if (stack == NULL || *roots == NULL)
+    goto error_exit;
+
+  stack[top++] = (struct frame){tree, 0, 1};
+  while (top > 0) {
+    struct frame * frame = &stack[top - 1];
+    bitree * child = NULL;
+    if (frame->stage < 2) {
+      child = frame->stage++ == 0 ? frame->node->left : frame->node->right;
+      if (child == NULL)
+	continue;
+      if (top == depth) {
+	struct frame * grown = realloc(stack, 2 * depth
+				       * sizeof(struct frame));
+	if (grown == NULL)
+	  goto error_exit;
+	stack = grown;
+	depth *= 2;
+      }
+      stack[top++] = (struct frame){child, 0, 1};
+      continue;
+    }
+
+    /* Done with the node: cut it off if it has gathered enough */
+    size_t size = frame->size;
+    bitree * node = frame->node;
+    if (--top == 0 || size >= target) {
+      if (count == capacity) {
+	bitree ** grown = realloc(*roots, 2 * capacity * sizeof(bitree *));
+	if (grown == NULL)
+	  goto error_exit;
+	*roots = grown;
+	capacity *= 2;
+      }
+      (*roots)[count++] = node;
+      size = 0;
+    }
+    if (top > 0)
+      stack[top - 1].size += size;
+  }
+
+  /* The cuts were made in postorder, so the root comes first in reverse */
+  for (size_t i = 0; i < count / 2; i++) {
+    bitree * swap = (*roots)[i];
+    (*roots)[i] = (*roots)[count - 1 - i];
+    (*roots)[count - 1 - i] = swap;
+  }
+  free(stack);
+  return count;
+
+ error_exit: {
+    free(stack);
+    free(*roots);
+    *roots = NULL;
+    return 0;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    compare_cuts
+ *
+ * DESCRIPTION:	    Orders cuts by the address of their roots, for bsearch().
+ *
+ * ARGUMENTS:	    one: (const void *) -- the first cut.
+ *		    two: (const void *) -- the second cut.
+ *
+ * RETURN:	    int -- less than, equal to, or greater than zero.
+ *
+ * NOTES:	    none.
+ ***/
+static int compare_cuts(const void * one, const void * two)
+{
+  uintptr_t first = (uintptr_t)((const struct cut *)one)->node;
+  uintptr_t second = (uintptr_t)((const struct cut *)two)->node;
+  return (first > second) - (first < second);
+}
+
+/******************************************************************************
+ * FUNCTION:	    find_cut
+ *
+ * DESCRIPTION:	    Finds the chunk which starts at `node'.
+ *
+ * ARGUMENTS:	    save: (struct save *) -- the state of the save.
+ *		    node: (bitree *) -- the node.
+ *
+ * RETURN:	    size_t -- the chunk, or NO_CHUNK if `node' doesn't start
+ *		    one.
+ *
+ * NOTES:	    O(log c), c is the number of chunks.
+ ***/
+static size_t find_cut(struct save * save, bitree * node)
+{
+  struct cut key = {.node = node};
+  struct cut * cut = bsearch(&key, save->cuts, save->count,
+			     sizeof(struct cut), compare_cuts);
+  return cut != NULL ? cut->chunk : NO_CHUNK;
+}
+
+/******************************************************************************
+ * FUNCTION:	    serialize_chunk
+ *
+ * DESCRIPTION:	    Serializes the nodes of a chunk into its buffer, which is
+ *		    padded to a multiple of BITREE_IO_BLOCK, and fills in its
+ *		    entry in the table. Also records which of its marks each
+ *		    chunk below it hangs from.
+ *
+ * ARGUMENTS:	    save: (struct save *) -- the state of the save.
+ *		    index: (size_t) -- the chunk.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(m log c), m is the number of nodes in the chunk, and c
+ *		    is the number of chunks.
+ ***/
+static int serialize_chunk(struct save * save, size_t index)
+{
+  struct io_chunk * chunk = &save->chunks[index];
+  struct chunk_entry * entry = &save->entries[index];
+  size_t used = 0, top = 0, depth = 64;
+  bitree ** stack = malloc(depth * sizeof(bitree *));
+  if (stack == NULL || grow_chunk(chunk, 16 * BITREE_IO_BLOCK))
+    goto error_exit;
+
+  /* The right children still to be visited are kept on the stack */
+  for (bitree * node = chunk->root; node != NULL;) {
+    size_t left = node->left != NULL ? find_cut(save, node->left) : NO_CHUNK;
+    size_t right = node->right != NULL ? find_cut(save, node->right)
+      : NO_CHUNK;
+    unsigned char flags = (node->left != NULL ? HAS_LEFT : 0)
+      | (node->right != NULL ? HAS_RIGHT : 0)
+      | (left != NO_CHUNK ? LEFT_CHUNK : 0)
+      | (right != NO_CHUNK ? RIGHT_CHUNK : 0);
+    if (left != NO_CHUNK) {
+      save->entries[left].parent = index;
+      save->entries[left].mark = entry->marks++;
+    }
+    if (right != NO_CHUNK) {
+      save->entries[right].parent = index;
+      save->entries[right].mark = entry->marks++;
+    }
+
+    size_t room = chunk->capacity - used - RECORD_HEADER;
+    size_t size = save->serialize(node->data, chunk->request.buffer + used
+				  + RECORD_HEADER, room);
+    if (size > UINT32_MAX) {
+      errno = EOVERFLOW;
+      goto error_exit;
+    }
+    if (size > room) {
+      if (grow_chunk(chunk, used + RECORD_HEADER + size))
+	goto error_exit;
+      save->serialize(node->data, chunk->request.buffer + used
+		      + RECORD_HEADER, size);
+    }
+    uint32_t size32 = size;
+    chunk->request.buffer[used] = flags;
+    memcpy(chunk->request.buffer + used + 1, &size32, sizeof(uint32_t));
+    used += RECORD_HEADER + size;
+    entry->nodes++;
+    if (grow_chunk(chunk, used + RECORD_HEADER))
+      goto error_exit;
+
+    if ((flags & (HAS_RIGHT | RIGHT_CHUNK)) == HAS_RIGHT) {
+      if (top == depth) {
+	bitree ** grown = realloc(stack, 2 * depth * sizeof(bitree *));
+	if (grown == NULL)
+	  goto error_exit;
+	stack = grown;
+	depth *= 2;
+      }
+      stack[top++] = node->right;
+    }
+    if ((flags & (HAS_LEFT | LEFT_CHUNK)) == HAS_LEFT)
+      node = node->left;
+    else
+      node = top > 0 ? stack[--top] : NULL;
+  }
+
+  /* The buffer is zeroed when it grows, so the padding already is */
+  entry->bytes = used;
+  chunk->request.size = padded(used);
+  chunk->request.write = 1;
+  free(stack);
+  return 0;
+
+ error_exit: {
+    free(stack);
+    return -1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    grow_chunk
+ *
+ * DESCRIPTION:	    Makes sure that the buffer of a chunk holds at least
+ *		    `size' bytes, doubling it if needed.
+ *
+ * ARGUMENTS:	    chunk: (struct io_chunk *) -- the chunk.
+ *		    size: (size_t) -- the size needed.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    The new part of the buffer is zeroed.
+ ***/
+static int grow_chunk(struct io_chunk * chunk, size_t size)
+{
+  if (size <= chunk->capacity)
+    return 0;
+
+  size_t capacity = chunk->capacity > 0 ? chunk->capacity : BITREE_IO_BLOCK;
+  while (capacity < size)
+    capacity *= 2;
+  unsigned char * buffer = alloc_block(capacity);
+  if (buffer == NULL)
+    return -1;
+  if (chunk->request.buffer != NULL)
+    memcpy(buffer, chunk->request.buffer, chunk->capacity);
+  free(chunk->request.buffer);
+  chunk->request.buffer = buffer;
+  chunk->capacity = capacity;
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    save_thread
+ *
+ * DESCRIPTION:	    Serializes chunks, in the order they are claimed, until
+ *		    there are none left, and passes them to the writing thread.
+ *
+ * ARGUMENTS:	    arg: (void *) -- the state of the save.
+ *
+ * RETURN:	    void * -- NULL.
+ *
+ * NOTES:	    A chunk which can't be serialized is passed on all the
+ *		    same, with no buffer, so that the writer sees the error.
+ ***/
+static void * save_thread(void * arg)
+{
+  struct save * save = arg;
+  pthread_mutex_lock(&save->lock);
+  while (1) {
+    while (save->pending >= save->limit && !save->error)
+      pthread_cond_wait(&save->room, &save->lock);
+    if (save->error || save->next == save->count)
+      break;
+    size_t index = save->next++;
+    save->pending++;
+    pthread_mutex_unlock(&save->lock);
+
+    int error = serialize_chunk(save, index) ? errno : 0;
+
+    pthread_mutex_lock(&save->lock);
+    if (error) {
+      if (!save->error)
+	save->error = error;
+      pthread_cond_broadcast(&save->room);
+      free(save->chunks[index].request.buffer);
+      save->chunks[index].request.buffer = NULL;
+    }
+    save->queue[save->tail++] = index;
+    pthread_cond_signal(&save->ready);
+  }
+  save->active--;
+  pthread_cond_signal(&save->ready);
+  pthread_mutex_unlock(&save->lock);
+  return NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    write_chunks
+ *
+ * DESCRIPTION:	    Writes the chunks passed on by the serializing threads,
+ *		    keeping up to `depth' writes in flight, until the threads
+ *		    have all finished.
+ *
+ * ARGUMENTS:	    save: (struct save *) -- the state of the save.
+ *		    io: (struct io_queue *) -- the queue.
+ *
+ * RETURN:	    int -- 0 on success, -1 if anything failed, with the error
+ *		    in `save->error'.
+ *
+ * NOTES:	    Chunks are laid out in the order they are written, which
+ *		    is about the order they were claimed in. The loader only
+ *		    needs the table to be in order.
+ ***/
+static int write_chunks(struct save * save, struct io_queue * io)
+{
+  save->end = BITREE_IO_BLOCK;
+  size_t * batch = malloc(io->depth * sizeof(size_t));
+  if (batch == NULL) {
+    pthread_mutex_lock(&save->lock);
+    save->error = errno;
+    pthread_cond_broadcast(&save->room);
+    pthread_mutex_unlock(&save->lock);
+    return -1;
+  }
+
+  while (1) {
+    pthread_mutex_lock(&save->lock);
+    while (save->head == save->tail && save->active > 0 && io->inflight == 0)
+      pthread_cond_wait(&save->ready, &save->lock);
+    int count = 0;
+    while (save->head < save->tail && io->inflight + count < io->depth)
+      batch[count++] = save->queue[save->head++];
+    int finished = save->head == save->tail && save->active == 0;
+    int error = save->error;
+    pthread_mutex_unlock(&save->lock);
+
+    /* A chunk that isn't written is done with straight away */
+    int done = 0;
+    for (int i = 0; i < count; i++) {
+      struct io_chunk * chunk = &save->chunks[batch[i]];
+      if (error || chunk->request.buffer == NULL) {
+	free(chunk->request.buffer);
+	chunk->request.buffer = NULL;
+	done++;
+	continue;
+      }
+      chunk->request.offset = save->end;
+      save->entries[batch[i]].offset = save->end;
+      save->end += chunk->request.size;
+      io_submit(io, &chunk->request);
+    }
+
+    if (io->inflight > 0) {
+      struct io_request * request = NULL;
+      int failed = io_reap(io, &request) ? errno : 0;
+      if (request != NULL) {
+	free(request->buffer);
+	request->buffer = NULL;
+	done++;
+      }
+      if (failed) {
+	pthread_mutex_lock(&save->lock);
+	if (!save->error)
+	  save->error = failed;
+	pthread_cond_broadcast(&save->room);
+	pthread_mutex_unlock(&save->lock);
+	if (request == NULL)
+	  io->inflight = 0;
+      }
+    } else if (finished) {
+      break;
+    }
+
+    if (done > 0) {
+      pthread_mutex_lock(&save->lock);
+      save->pending -= done;
+      pthread_cond_broadcast(&save->room);
+      pthread_mutex_unlock(&save->lock);
+    }
+  }
+
+  free(batch);
+  return save->error ? -1 : 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    build_chunk
+ *
+ * DESCRIPTION:	    Builds the nodes of a chunk, from its mark in the chunk
+ *		    above it, or as the root of the tree.
+ *
+ * ARGUMENTS:	    entries: (const struct chunk_entry *) -- the table.
+ *		    chunk: (size_t) -- the chunk.
+ *		    buffer: (const unsigned char *) -- what was read of it.
+ *		    marks: (struct mark *) -- the marks of all the chunks.
+ *		    first: (const size_t *) -- the first mark of each chunk.
+ *		    root: (bitree **) -- the root of the tree, which is set
+ *			by the first chunk.
+ *		    deserialize: (void * (*)(const void *, size_t)) -- creates
+ *			a payload.
+ *		    destroy: (void (*)(void *)) -- destroy function of the
+ *			tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(m), m is the number of nodes in the chunk, plus the cost
+ *		    of the insertions.
+ ***/
+static int build_chunk(const struct chunk_entry * entries, size_t chunk,
+		       const unsigned char * buffer, struct mark * marks,
+		       const size_t * first, bitree ** root,
+		       void * (*deserialize)(const void *, size_t),
+		       void (*destroy)(void *))
+{
+  const struct chunk_entry * entry = &entries[chunk];
+  size_t used = 0, top = 0, depth = 64, mark = first[chunk];
+  bitree ** stack = malloc(depth * sizeof(bitree *));
+  if (stack == NULL)
+    return -1;
+
+  /* The node to insert under, and on which side */
+  bitree * parent = NULL;
+  int right = 0;
+  if (chunk > 0) {
+    parent = marks[first[entry->parent] + entry->mark].node;
+    right = marks[first[entry->parent] + entry->mark].right;
+  }
+
+  for (uint64_t i = 0; i < entry->nodes; i++) {
+    uint32_t size;
+    if ((chunk > 0 || i > 0) && parent == NULL)
+      goto corrupt;
+    if (entry->bytes - used < RECORD_HEADER)
+      goto corrupt;
+    unsigned char flags = buffer[used];
+    memcpy(&size, buffer + used + 1, sizeof(uint32_t));
+    used += RECORD_HEADER;
+    if (entry->bytes - used < size)
+      goto corrupt;
+
+    void * data = deserialize(buffer + used, size);
+    used += size;
+    if (data == NULL)
+      goto error_exit;
+    bitree * node = NULL;
+    if (parent == NULL) {
+      node = *root = bitree_create(destroy, data);
+    } else if (!(right ? bitree_insr(parent, data)
+		 : bitree_insl(parent, data))) {
+      node = right ? parent->right : parent->left;
+    }
+    if (node == NULL) {
+      if (destroy != NULL)
+	destroy(data);
+      goto error_exit;
+    }
+
+    /* Note the marks of this node, for the chunks which hang from them */
+    if ((flags & LEFT_CHUNK) || (flags & RIGHT_CHUNK)) {
+      if (mark + !!(flags & LEFT_CHUNK) + !!(flags & RIGHT_CHUNK)
+	  > first[chunk] + entry->marks)
+	goto corrupt;
+      if (flags & LEFT_CHUNK)
+	marks[mark++] = (struct mark){node, 0};
+      if (flags & RIGHT_CHUNK)
+	marks[mark++] = (struct mark){node, 1};
+    }
+
+    if ((flags & (HAS_RIGHT | RIGHT_CHUNK)) == HAS_RIGHT) {
+      if (top == depth) {
+	bitree ** grown = realloc(stack, 2 * depth * sizeof(bitree *));
+	if (grown == NULL)
+	  goto error_exit;
+	stack = grown;
+	depth *= 2;
+      }
+      stack[top++] = node;
+    }
+    if ((flags & (HAS_LEFT | LEFT_CHUNK)) == HAS_LEFT) {
+      parent = node;
+      right = 0;
+    } else if (top > 0) {
+      parent = stack[--top];
+      right = 1;
+    } else {
+      parent = NULL;
+    }
+  }
+
+  /* Every node which was promised a child must have got it */
+  if (parent != NULL || top > 0 || mark != first[chunk] + entry->marks)
+    goto corrupt;
+  free(stack);
+  return 0;
+
+ corrupt:
+  errno = EINVAL;
+ error_exit: {
+    free(stack);
+    return -1;
+  }
+}
+
+/*****************************************************************************/
@@ -0,0 +1,1152 @@
+/******************************************************************************
+ * NAME:	    bitree_paged.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the paged trees. Page 0 of the file is
+ *		    the header; every other page starts with a small header of
+ *		    its own, followed by an array of fixed-size slots, each
+ *		    holding the links and payload of one node. Pages are read
+ *		    into the frames of a buffer pool on demand, and the least
+ *		    recently used unpinned frame is reused when the pool is
+ *		    full, after its page is written back if it changed.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bitree_paged.h"
+#include "bitree_internal.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* "bitreepg", marks a file which holds a paged tree */
+#define PAGED_MAGIC	0x6269747265657067ULL
+
+#define page_of(tree, node)	((node) / (tree)->slots)
+#define slot_of(tree, node)	((node) % (tree)->slots)
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* Page 0 of the file. `open' is the page that new nodes go to when the page
+ * of their parent is full.
+ */
+struct file_header {
+  uint64_t magic;
+  uint64_t page_size;
+  uint64_t payload_size;
+  uint64_t pages;
+  bitree_pref root;
+  uint64_t size;
+  uint64_t open;
+};
+
+/* The start of every other page. Slots below `fresh' have been used; those
+ * which were freed since are on a list threaded through their `left' fields,
+ * starting at slot `free' - 1.
+ */
+struct page_header {
+  uint32_t count;
+  uint32_t free;
+  uint32_t fresh;
+  uint32_t unused;
+};
+
+/* A slot */
+struct paged_node {
+  bitree_pref parent;
+  bitree_pref left;
+  bitree_pref right;
+  unsigned char data[];
+};
+
+/* A frame of the buffer pool. Unpinned frames are kept on a list from the
+ * most to the least recently used. Page 0 is never cached, so a frame with
+ * `page' 0 is empty.
+ */
+struct frame {
+  uint64_t page;
+  int pins;
+  int dirty;
+  struct frame * prev;
+  struct frame * next;
+  unsigned char * data;
+};
+
+struct bitree_paged {
+  int fd;
+  struct file_header header;
+  size_t record;
+  size_t slots;
+
+  /* The pool, and the frame holding each page of the file, if any */
+  struct frame * frames;
+  unsigned char * memory;
+  struct frame ** table;
+  size_t table_size;
+  struct frame * head;
+  struct frame * tail;
+
+  struct bitree_paged_stats stats;
+  int failed;
+};
+
+/* The state of a bitree_paged_walk() */
+struct paged_walk {
+  bitree_paged * tree;
+  enum bitree_visit (*visit)(bitree_paged *, bitree_pref, void *);
+  void * ctx;
+};
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static bitree_paged * new_paged(int fd, const struct file_header * header,
+				size_t frames);
+static void free_paged(bitree_paged * tree);
+static void lru_remove(bitree_paged * tree, struct frame * frame);
+static void lru_push(bitree_paged * tree, struct frame * frame);
+static int write_frame(bitree_paged * tree, struct frame * frame);
+static struct frame * pin_page(bitree_paged * tree, uint64_t page);
+static void unpin_page(bitree_paged * tree, struct frame * frame, int dirty);
+static struct paged_node * pin_node(bitree_paged * tree, bitree_pref node,
+				    struct frame ** frame);
+static bitree_pref alloc_slot(bitree_paged * tree, uint64_t near);
+static int free_slot(bitree_paged * tree, bitree_pref node);
+static bitree_pref insert(bitree_paged * tree, bitree_pref node,
+			  const void * data, int right);
+
+/* Used by bitree_paged_walk() */
+static uint64_t walk_left(void * walk, uint64_t node);
+static uint64_t walk_right(void * walk, uint64_t node);
+static uint64_t walk_parent(void * walk, uint64_t node);
+static enum bitree_visit walk_visit(void * walk, uint64_t node);
+
+/******************************************************************************
+ * STATIC VARIABLES
+ ***/
+
+static const struct bitree_walker paged_walker = {
+  walk_left, walk_right, walk_parent, walk_visit, NULL
+};
+
+/******************************************************************************
+ * API FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_create
+ *
+ * DESCRIPTION:	    Creates a file holding an empty paged tree, and opens it.
+ *
+ * ARGUMENTS:	    path: (const char *) -- the file.
+ *		    page_size: (size_t) -- size of a page, in bytes.
+ *		    payload_size: (size_t) -- size of a payload, in bytes.
+ *		    frames: (size_t) -- number of pages in the buffer pool.
+ *
+ * RETURN:	    bitree_paged * -- the tree, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+bitree_paged * bitree_paged_create(const char * path, size_t page_size,
+				   size_t payload_size, size_t frames)
+{
+  struct file_header header = {
+    .magic = PAGED_MAGIC,
+    .page_size = page_size,
+    .payload_size = payload_size,
+    .pages = 1
+  };
+  if (path == NULL || page_size < sizeof(struct file_header)
+      || payload_size > page_size) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+    return NULL;
+
+  bitree_paged * tree = new_paged(fd, &header, frames);
+  if (tree == NULL || bitree_paged_flush(tree)) {
+    int error = errno;
+    free_paged(tree);
+    close(fd);
+    errno = error;
+    return NULL;
+  }
+  return tree;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_open
+ *
+ * DESCRIPTION:	    Opens a file holding a paged tree.
+ *
+ * ARGUMENTS:	    path: (const char *) -- the file.
+ *		    frames: (size_t) -- number of pages in the buffer pool.
+ *
+ * RETURN:	    bitree_paged * -- the tree, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+bitree_paged * bitree_paged_open(const char * path, size_t frames)
+{
+  if (path == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  int fd = open(path, O_RDWR);
+  if (fd < 0)
+    return NULL;
+
+  struct file_header header;
+  bitree_paged * tree = NULL;
+  if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+      || header.magic != PAGED_MAGIC) {
+    errno = EINVAL;
+  } else {
+    tree = new_paged(fd, &header, frames);
+  }
+
+  if (tree == NULL) {
+    int error = errno;
+    close(fd);
+    errno = error;
+  }
+  return tree;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_flush
+ *
+ * DESCRIPTION:	    Writes the changed pages and the header to the file.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(f), f is the number of frames in the pool.
+ ***/
+int bitree_paged_flush(bitree_paged * tree)
+{
+  if (tree == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int result = 0;
+  for (size_t i = 0; i < tree->header.pages && i < tree->table_size; i++)
+    if (tree->table[i] != NULL && tree->table[i]->dirty
+	&& write_frame(tree, tree->table[i]))
+      result = -1;
+
+  /* The header is written last, so the file never claims pages which were
+   * not written.
+   */
+  if (pwrite(tree->fd, &tree->header, sizeof(tree->header), 0)
+      != sizeof(tree->header))
+    result = -1;
+  return result;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_close
+ *
+ * DESCRIPTION:	    Flushes the tree, closes its file, and frees it.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged **) -- the tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 if the tree could not be flushed.
+ *
+ * NOTES:	    O(f), f is the number of frames in the pool.
+ ***/
+int bitree_paged_close(bitree_paged ** tree)
+{
+  if (tree == NULL || *tree == NULL)
+    return 0;
+
+  int result = bitree_paged_flush(*tree);
+  if (close((*tree)->fd))
+    result = -1;
+  free_paged(*tree);
+  *tree = NULL;
+  return result;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_store
+ *
+ * DESCRIPTION:	    Copies a subtree into an empty paged tree, in preorder.
+ *
+ * ARGUMENTS:	    paged: (bitree_paged *) -- the paged tree.
+ *		    tree: (bitree *) -- root of the subtree.
+ *		    serialize: (size_t (*)(const void *, void *, size_t)) --
+ *			writes a payload into a slot.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+int bitree_paged_store(bitree_paged * paged, bitree * tree,
+		       size_t (*serialize)(const void *, void *, size_t))
+{
+  if (paged == NULL || tree == NULL || serialize == NULL
+      || paged->header.root != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  size_t size = paged->header.payload_size;
+  unsigned char * buffer = calloc(1, size > 0 ? size : 1);
+  if (buffer == NULL)
+    return -1;
+
+  /* As in bitree_shm_store(), `last' and `copy' climb together to the
+   * parent of each node.
+   */
+  struct bitree_cursor cursor;
+  bitree * last = NULL;
+  bitree_pref copy = 0;
+  bitree_cursor_init(&cursor, tree, BITREE_PREORDER);
+  for (bitree * node; (node = bitree_cursor_next(&cursor)) != NULL;) {
+    bitree_pref parent = 0;
+    if (node != tree) {
+      while (last != node->parent) {
+	last = last->parent;
+	copy = bitree_paged_parent(paged, copy);
+      }
+      parent = copy;
+    }
+
+    if (serialize(node->data, buffer, size) > size) {
+      errno = EINVAL;
+      goto error_exit;
+    }
+    copy = insert(paged, parent, buffer,
+		  parent != 0 && node->parent->right == node);
+    if (copy == 0)
+      goto error_exit;
+    last = node;
+  }
+
+  free(buffer);
+  return 0;
+
+ error_exit: {
+    int error = errno;
+    if (paged->header.root != 0)
+      bitree_paged_rem(paged, paged->header.root);
+    free(buffer);
+    errno = error;
+    return -1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_insl
+ *
+ * DESCRIPTION:	    Inserts a node to the left of `node'.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the parent, or 0.
+ *		    data: (const void *) -- the payload.
+ *
+ * RETURN:	    bitree_pref -- the new node, or 0.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+bitree_pref bitree_paged_insl(bitree_paged * tree, bitree_pref node,
+			      const void * data)
+{
+  return insert(tree, node, data, 0);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_insr
+ *
+ * DESCRIPTION:	    Inserts a node to the right of `node'.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the parent, or 0.
+ *		    data: (const void *) -- the payload.
+ *
+ * RETURN:	    bitree_pref -- the new node, or 0.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+bitree_pref bitree_paged_insr(bitree_paged * tree, bitree_pref node,
+			      const void * data)
+{
+  return insert(tree, node, data, 1);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_rem
+ *
+ * DESCRIPTION:	    Removes the subtree rooted at `node', and frees its slots.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- root of the subtree.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+int bitree_paged_rem(bitree_paged * tree, bitree_pref node)
+{
+  struct frame * frame = NULL;
+  struct paged_node * slot = NULL;
+  if (tree == NULL || (slot = pin_node(tree, node, &frame)) == NULL)
+    return -1;
+
+  /* Cut the subtree from its parent first, then free it from the bottom up,
+   * cutting each node from its parent as it goes.
+   */
+  bitree_pref parent = slot->parent;
+  unpin_page(tree, frame, 0);
+  if (parent == 0) {
+    tree->header.root = 0;
+  } else {
+    struct paged_node * above = pin_node(tree, parent, &frame);
+    if (above == NULL)
+      return -1;
+    if (above->left == node)
+      above->left = 0;
+    else
+      above->right = 0;
+    unpin_page(tree, frame, 1);
+  }
+
+  bitree_pref current = node;
+  while (current != 0) {
+    if ((slot = pin_node(tree, current, &frame)) == NULL)
+      return -1;
+    bitree_pref child = slot->left != 0 ? slot->left : slot->right;
+    if (child != 0) {
+      unpin_page(tree, frame, 0);
+      current = child;
+      continue;
+    }
+
+    parent = current == node ? 0 : slot->parent;
+    unpin_page(tree, frame, 0);
+    if (parent != 0) {
+      struct paged_node * above = pin_node(tree, parent, &frame);
+      if (above == NULL)
+	return -1;
+      if (above->left == current)
+	above->left = 0;
+      else
+	above->right = 0;
+      unpin_page(tree, frame, 1);
+    }
+    if (free_slot(tree, current))
+      return -1;
+    tree->header.size--;
+    current = parent;
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_root
+ *
+ * DESCRIPTION:	    Returns the root of the tree.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *
+ * RETURN:	    bitree_pref -- the root, or 0.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree_pref bitree_paged_root(bitree_paged * tree)
+{
+  return tree == NULL ? 0 : tree->header.root;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_size
+ *
+ * DESCRIPTION:	    Returns the number of nodes in the tree.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *
+ * RETURN:	    uint64_t -- the size of the tree.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+uint64_t bitree_paged_size(bitree_paged * tree)
+{
+  return tree == NULL ? 0 : tree->header.size;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_parent
+ *
+ * DESCRIPTION:	    Returns the parent of `node'.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the node.
+ *
+ * RETURN:	    bitree_pref -- the parent, or 0.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+bitree_pref bitree_paged_parent(bitree_paged * tree, bitree_pref node)
+{
+  struct frame * frame = NULL;
+  struct paged_node * slot = pin_node(tree, node, &frame);
+  if (slot == NULL)
+    return 0;
+  bitree_pref parent = slot->parent;
+  unpin_page(tree, frame, 0);
+  return parent;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_left
+ *
+ * DESCRIPTION:	    Returns the left child of `node'.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the node.
+ *
+ * RETURN:	    bitree_pref -- the left child, or 0.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+bitree_pref bitree_paged_left(bitree_paged * tree, bitree_pref node)
+{
+  struct frame * frame = NULL;
+  struct paged_node * slot = pin_node(tree, node, &frame);
+  if (slot == NULL)
+    return 0;
+  bitree_pref left = slot->left;
+  unpin_page(tree, frame, 0);
+  return left;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_right
+ *
+ * DESCRIPTION:	    Returns the right child of `node'.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the node.
+ *
+ * RETURN:	    bitree_pref -- the right child, or 0.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+bitree_pref bitree_paged_right(bitree_paged * tree, bitree_pref node)
+{
+  struct frame * frame = NULL;
+  struct paged_node * slot = pin_node(tree, node, &frame);
+  if (slot == NULL)
+    return 0;
+  bitree_pref right = slot->right;
+  unpin_page(tree, frame, 0);
+  return right;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_pin
+ *
+ * DESCRIPTION:	    Pins the page of `node', and returns its payload.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the node.
+ *
+ * RETURN:	    void * -- the payload, or NULL.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+void * bitree_paged_pin(bitree_paged * tree, bitree_pref node)
+{
+  struct frame * frame = NULL;
+  struct paged_node * slot = pin_node(tree, node, &frame);
+  return slot == NULL ? NULL : slot->data;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_unpin
+ *
+ * DESCRIPTION:	    Unpins the page of `node'.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the node passed to
+ *			bitree_paged_pin().
+ *		    dirty: (int) -- nonzero if the payload was modified.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+void bitree_paged_unpin(bitree_paged * tree, bitree_pref node, int dirty)
+{
+  if (tree == NULL || page_of(tree, node) >= tree->table_size)
+    return;
+
+  struct frame * frame = tree->table[page_of(tree, node)];
+  if (frame != NULL && frame->pins > 0)
+    unpin_page(tree, frame, dirty);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_walk
+ *
+ * DESCRIPTION:	    Visits the subtree rooted at `node' in the order given,
+ *		    until the visitor asks it to stop.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- root of the subtree.
+ *		    order: (enum bitree_order) -- the order.
+ *		    visit: (enum bitree_visit (*)(bitree_paged *, bitree_pref,
+ *			void *)) -- the visitor.
+ *		    ctx: (void *) -- passed to the visitor.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 if it finished, -1 on
+ *		    error.
+ *
+ * NOTES:	    O(n), n is the size of the subtree. O(1) extra memory,
+ *		    except in level order.
+ ***/
+int bitree_paged_walk(bitree_paged * tree, bitree_pref node,
+		      enum bitree_order order,
+		      enum bitree_visit (*visit)(bitree_paged *, bitree_pref,
+						 void *),
+		      void * ctx)
+{
+  if (tree == NULL || visit == NULL || node == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct paged_walk walk = { tree, visit, ctx };
+  tree->failed = 0;
+  int result = bitree_walk_refs(&paged_walker, &walk, node, order);
+
+  /* A page which could not be read looks like a missing child, so the walk
+   * would have ended early.
+   */
+  if (result < 0 || tree->failed)
+    return -1;
+  return result;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_paged_stats
+ *
+ * DESCRIPTION:	    Copies the counters of the buffer pool.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    stats: (struct bitree_paged_stats *) -- where to copy them.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+void bitree_paged_stats(bitree_paged * tree, struct bitree_paged_stats * stats)
+{
+  if (tree != NULL && stats != NULL)
+    *stats = tree->stats;
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    new_paged
+ *
+ * DESCRIPTION:	    Allocates a tree and its buffer pool.
+ *
+ * ARGUMENTS:	    fd: (int) -- the file, which the tree takes over on
+ *			success.
+ *		    header: (const struct file_header *) -- its header.
+ *		    frames: (size_t) -- number of frames in the pool.
+ *
+ * RETURN:	    bitree_paged * -- the tree, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static bitree_paged * new_paged(int fd, const struct file_header * header,
+				size_t frames)
+{
+  size_t record = sizeof(struct paged_node)
+    + ((header->payload_size + sizeof(uint64_t) - 1)
+       & ~(sizeof(uint64_t) - 1));
+  if (frames == 0 || header->page_size < sizeof(struct page_header) + record) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  bitree_paged * tree = calloc(1, sizeof(bitree_paged));
+  if (tree == NULL)
+    return NULL;
+  tree->fd = fd;
+  tree->header = *header;
+  tree->record = record;
+  tree->slots = (header->page_size - sizeof(struct page_header)) / record;
+
+  tree->table_size = header->pages;
+  if ((tree->frames = calloc(frames, sizeof(struct frame))) == NULL
+      || (tree->memory = malloc(frames * header->page_size)) == NULL
+      || (tree->table = calloc(tree->table_size, sizeof(struct frame *)))
+      == NULL) {
+    free_paged(tree);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  for (size_t i = 0; i < frames; i++) {
+    tree->frames[i].data = tree->memory + i * header->page_size;
+    lru_push(tree, &tree->frames[i]);
+  }
+  return tree;
+}
+
+/******************************************************************************
+ * FUNCTION:	    free_paged
+ *
+ * DESCRIPTION:	    Frees a tree and its buffer pool, without writing anything.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree, or NULL.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void free_paged(bitree_paged * tree)
+{
+  if (tree == NULL)
+    return;
+  free(tree->frames);
+  free(tree->memory);
+  free(tree->table);
+  free(tree);
+}
+
+/******************************************************************************
+ * FUNCTION:	    lru_remove
+ *
+ * DESCRIPTION:	    Takes a frame off the list of unpinned frames.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    frame: (struct frame *) -- the frame.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void lru_remove(bitree_paged * tree, struct frame * frame)
+{
+  if (frame->prev != NULL)
+    frame->prev->next = frame->next;
+  else
+    tree->head = frame->next;
+  if (frame->next != NULL)
+    frame->next->prev = frame->prev;
+  else
+    tree->tail = frame->prev;
+  frame->prev = frame->next = NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    lru_push
+ *
+ * DESCRIPTION:	    Puts a frame at the most recently used end of the list of
+ *		    unpinned frames.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    frame: (struct frame *) -- the frame.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void lru_push(bitree_paged * tree, struct frame * frame)
+{
+  frame->prev = NULL;
+  frame->next = tree->head;
+  if (tree->head != NULL)
+    tree->head->prev = frame;
+  else
+    tree->tail = frame;
+  tree->head = frame;
+}
+
+/******************************************************************************
+ * FUNCTION:	    write_frame
+ *
+ * DESCRIPTION:	    Writes the page in a frame back to the file.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    frame: (struct frame *) -- the frame.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    One write.
+ ***/
+static int write_frame(bitree_paged * tree, struct frame * frame)
+{
+  size_t size = tree->header.page_size;
+  if (pwrite(tree->fd, frame->data, size, frame->page * size)
+      != (ssize_t)size)
+    return -1;
+  frame->dirty = 0;
+  tree->stats.writes++;
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    pin_page
+ *
+ * DESCRIPTION:	    Finds a page in the pool, or reads it into the least
+ *		    recently used unpinned frame, and pins it.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    page: (uint64_t) -- the page, which may be one past the
+ *			end of the file.
+ *
+ * RETURN:	    struct frame * -- the frame, or NULL if every frame is
+ *		    pinned (errno is EBUSY), or the page can't be read.
+ *
+ * NOTES:	    Theta(1), and at most one read and one write.
+ ***/
+static struct frame * pin_page(bitree_paged * tree, uint64_t page)
+{
+  struct frame * frame = page < tree->table_size ? tree->table[page] : NULL;
+  if (frame != NULL) {
+    tree->stats.hits++;
+    if (frame->pins++ == 0)
+      lru_remove(tree, frame);
+    return frame;
+  }
+
+  if (page >= tree->table_size) {
+    size_t size = 2 * tree->table_size > page ? 2 * tree->table_size
+      : page + 1;
+    struct frame ** table = realloc(tree->table, size * sizeof(*table));
+    if (table == NULL)
+      goto error_exit;
+    memset(table + tree->table_size, 0,
+	   (size - tree->table_size) * sizeof(*table));
+    tree->table = table;
+    tree->table_size = size;
+  }
+
+  if ((frame = tree->tail) == NULL) {
+    errno = EBUSY;
+    goto error_exit;
+  }
+  if (frame->page != 0) {
+    if (frame->dirty && write_frame(tree, frame))
+      goto error_exit;
+    tree->table[frame->page] = NULL;
+    frame->page = 0;
+  }
+
+  /* A page past the end of the file reads as zeroes */
+  size_t size = tree->header.page_size;
+  ssize_t got = pread(tree->fd, frame->data, size, page * size);
+  if (got < 0)
+    goto error_exit;
+  memset(frame->data + got, 0, size - got);
+
+  tree->stats.misses++;
+  lru_remove(tree, frame);
+  frame->page = page;
+  frame->pins = 1;
+  frame->dirty = 0;
+  tree->table[page] = frame;
+  return frame;
+
+ error_exit:
+  tree->failed = 1;
+  return NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    unpin_page
+ *
+ * DESCRIPTION:	    Unpins a frame, which can be reused once it has no more
+ *		    pins.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    frame: (struct frame *) -- the frame.
+ *		    dirty: (int) -- nonzero if the page was modified.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void unpin_page(bitree_paged * tree, struct frame * frame, int dirty)
+{
+  frame->dirty |= dirty;
+  if (--frame->pins == 0)
+    lru_push(tree, frame);
+}
+
+/******************************************************************************
+ * FUNCTION:	    pin_node
+ *
+ * DESCRIPTION:	    Pins the page of `node', and returns its slot.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the node.
+ *		    frame: (struct frame **) -- set to the frame to unpin.
+ *
+ * RETURN:	    struct paged_node * -- the slot, or NULL.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+static struct paged_node * pin_node(bitree_paged * tree, bitree_pref node,
+				    struct frame ** frame)
+{
+  if (tree == NULL || page_of(tree, node) == 0
+      || page_of(tree, node) >= tree->header.pages) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if ((*frame = pin_page(tree, page_of(tree, node))) == NULL)
+    return NULL;
+  return (struct paged_node *)((*frame)->data + sizeof(struct page_header)
+			       + slot_of(tree, node) * tree->record);
+}
+
+/******************************************************************************
+ * FUNCTION:	    alloc_slot
+ *
+ * DESCRIPTION:	    Allocates a slot, in the page `near' if it has room, then
+ *		    in the open page, and otherwise in a new page, which
+ *		    becomes the open page.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    near: (uint64_t) -- the page to try first, or 0.
+ *
+ * RETURN:	    bitree_pref -- the slot, or 0.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+static bitree_pref alloc_slot(bitree_paged * tree, uint64_t near)
+{
+  uint64_t pages[] = { near, tree->header.open, tree->header.pages };
+  for (int i = 0; i < 3; i++) {
+    if (pages[i] == 0 || (i == 1 && pages[i] == near))
+      continue;
+
+    struct frame * frame = pin_page(tree, pages[i]);
+    if (frame == NULL)
+      return 0;
+    if (i == 2)
+      tree->header.pages++;
+
+    struct page_header * header = (struct page_header *)frame->data;
+    if (header->count == tree->slots) {
+      unpin_page(tree, frame, 0);
+      continue;
+    }
+
+    uint64_t slot = header->fresh;
+    if (header->free != 0) {
+      slot = header->free - 1;
+      struct paged_node * node = (struct paged_node *)
+	(frame->data + sizeof(struct page_header) + slot * tree->record);
+      header->free = node->left;
+    } else {
+      header->fresh++;
+    }
+    header->count++;
+    unpin_page(tree, frame, 1);
+    if (i == 2)
+      tree->header.open = pages[i];
+    return pages[i] * tree->slots + slot;
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    free_slot
+ *
+ * DESCRIPTION:	    Puts a slot on the free list of its page, which becomes the
+ *		    open page.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the slot, which must be unlinked.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+static int free_slot(bitree_paged * tree, bitree_pref node)
+{
+  struct frame * frame = NULL;
+  struct paged_node * slot = pin_node(tree, node, &frame);
+  if (slot == NULL)
+    return -1;
+
+  struct page_header * header = (struct page_header *)frame->data;
+  slot->parent = slot->right = 0;
+  slot->left = header->free;
+  header->free = slot_of(tree, node) + 1;
+  header->count--;
+  unpin_page(tree, frame, 1);
+  tree->header.open = page_of(tree, node);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    insert
+ *
+ * DESCRIPTION:	    Does the work of bitree_paged_insl() and
+ *		    bitree_paged_insr().
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the parent, or 0.
+ *		    data: (const void *) -- the payload.
+ *		    right: (int) -- nonzero to insert a right child.
+ *
+ * RETURN:	    bitree_pref -- the new node, or 0.
+ *
+ * NOTES:	    Theta(1) pages.
+ ***/
+static bitree_pref insert(bitree_paged * tree, bitree_pref node,
+			  const void * data, int right)
+{
+  struct frame * frame = NULL;
+  struct paged_node * slot = NULL;
+  if (tree == NULL || (data == NULL && tree->header.payload_size > 0)
+      || (node == 0 && tree->header.root != 0)) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  /* Neither page stays pinned while the other is, so even a pool of one
+   * frame will do.
+   */
+  if (node != 0) {
+    if ((slot = pin_node(tree, node, &frame)) == NULL)
+      return 0;
+    int taken = (right ? slot->right : slot->left) != 0;
+    unpin_page(tree, frame, 0);
+    if (taken) {
+      errno = EINVAL;
+      return 0;
+    }
+  }
+
+  bitree_pref child = alloc_slot(tree, node == 0 ? 0 : page_of(tree, node));
+  if (child == 0 || (slot = pin_node(tree, child, &frame)) == NULL)
+    return 0;
+  slot->parent = node;
+  slot->left = slot->right = 0;
+  memcpy(slot->data, data, tree->header.payload_size);
+  unpin_page(tree, frame, 1);
+
+  if (node == 0) {
+    tree->header.root = child;
+  } else {
+    if ((slot = pin_node(tree, node, &frame)) == NULL) {
+      free_slot(tree, child);
+      return 0;
+    }
+    if (right)
+      slot->right = child;
+    else
+      slot->left = child;
+    unpin_page(tree, frame, 1);
+  }
+  tree->header.size++;
+  return child;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_left
+ *
+ * DESCRIPTION:	    Returns the left child of a node, for bitree_walk_refs().
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct paged_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    uint64_t -- its left child, or 0 if it has none.
+ *
+ * NOTES:	    Theta(1), besides reading the page of the node.
+ ***/
+static uint64_t walk_left(void * walk, uint64_t node)
+{
+  return bitree_paged_left(((struct paged_walk *)walk)->tree, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_right
+ *
+ * DESCRIPTION:	    Returns the right child of a node, for bitree_walk_refs().
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct paged_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    uint64_t -- its right child, or 0 if it has none.
+ *
+ * NOTES:	    Theta(1), besides reading the page of the node.
+ ***/
+static uint64_t walk_right(void * walk, uint64_t node)
+{
+  return bitree_paged_right(((struct paged_walk *)walk)->tree, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_parent
+ *
+ * DESCRIPTION:	    Returns the parent of a node, for bitree_walk_refs().
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct paged_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    uint64_t -- its parent, or 0 if it has none.
+ *
+ * NOTES:	    Theta(1), besides reading the page of the node.
+ ***/
+static uint64_t walk_parent(void * walk, uint64_t node)
+{
+  return bitree_paged_parent(((struct paged_walk *)walk)->tree, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_visit
+ *
+ * DESCRIPTION:	    Calls the visitor of a bitree_paged_walk() on a node.
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct paged_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    enum bitree_visit -- what the visitor returned.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit walk_visit(void * walk, uint64_t node)
+{
+  struct paged_walk * paged = (struct paged_walk *)walk;
+  return paged->visit(paged->tree, node, paged->ctx);
+}
+
+/*****************************************************************************/
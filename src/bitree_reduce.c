@@ -0,0 +1,361 @@
+/******************************************************************************
+ * NAME:	    bitree_reduce.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the numeric reductions. The kernels keep
+ *		    LANES independent accumulators, and update all of them for
+ *		    each LANES values, which the compiler turns into one or two
+ *		    vector instructions; being independent, they don't depend
+ *		    on the compiler reassociating floating point additions. On
+ *		    AArch64, NEON is part of the baseline, so the plain build
+ *		    of the kernels already uses it.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "bitree_reduce.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* Accumulators per kernel: one AVX-512 register of doubles, or two of AVX2 */
+#define LANES	8
+
+/* On x86-64, build the kernels for AVX-512, AVX2 and the baseline, and let the
+ * loader pick the one the CPU supports.
+ */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#  define SIMD_CLONES						\
+  __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#  define SIMD_CLONES
+#endif
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* The state of bitree_flatten() */
+struct flatten {
+  double * out;
+  size_t count;
+  double (*extractor)(const void *);
+};
+
+/* The state of bitree_reduce(): the values gathered since the last flush, and
+ * the reduction of those before.
+ */
+struct fused {
+  double block[BITREE_REDUCE_BLOCK];
+  size_t count;
+  double (*extractor)(const void *);
+  double lo;
+  double hi;
+  struct bitree_reduction * result;
+};
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static enum bitree_visit flatten_visit(bitree * node, void * ctx);
+static enum bitree_visit fused_visit(bitree * node, void * ctx);
+static void fused_flush(struct fused * fused);
+
+/******************************************************************************
+ * API FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_flatten
+ *
+ * DESCRIPTION:	    Gathers the values of the payloads of a subtree into an
+ *		    array.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the root of the subtree.
+ *		    order: (enum bitree_order) -- the order of the values.
+ *		    out_values: (double *) -- where to store them.
+ *		    extractor: (double (*)(const void *)) -- returns the value
+ *			of a payload.
+ *
+ * RETURN:	    size_t -- the number of values stored, or 0 on error.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+size_t bitree_flatten(bitree * tree, enum bitree_order order,
+		      double * out_values,
+		      double (*extractor)(const void * data))
+{
+  if (tree == NULL || out_values == NULL || extractor == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  struct flatten flatten = {out_values, 0, extractor};
+  if (bitree_walk(tree, order, flatten_visit, &flatten))
+    return 0;
+  return flatten.count;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_reduce_sum
+ *
+ * DESCRIPTION:	    Adds up an array of doubles.
+ *
+ * ARGUMENTS:	    values: (const double *) -- the values.
+ *		    n: (size_t) -- the number of values.
+ *
+ * RETURN:	    double -- their sum.
+ *
+ * NOTES:	    Theta(n). The values are added in LANES interleaved
+ *		    sums, so the result may differ in the last bits from
+ *		    adding them in turn.
+ ***/
+SIMD_CLONES
+double bitree_reduce_sum(const double * values, size_t n)
+{
+  double lanes[LANES] = {0};
+  size_t i = 0;
+  for (; i + LANES <= n; i += LANES)
+    for (int j = 0; j < LANES; j++)
+      lanes[j] += values[i + j];
+
+  double sum = 0;
+  for (int j = 0; j < LANES; j++)
+    sum += lanes[j];
+  for (; i < n; i++)
+    sum += values[i];
+  return sum;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_reduce_min
+ *
+ * DESCRIPTION:	    Finds the least of an array of doubles.
+ *
+ * ARGUMENTS:	    values: (const double *) -- the values.
+ *		    n: (size_t) -- the number of values.
+ *
+ * RETURN:	    double -- the least value, or INFINITY if there is none.
+ *
+ * NOTES:	    Theta(n). A NaN never compares less than the minimum so
+ *		    far, so it is skipped; this is also what the vector
+ *		    minimum instructions do, given the operands in that order.
+ ***/
+SIMD_CLONES
+double bitree_reduce_min(const double * values, size_t n)
+{
+  double lanes[LANES];
+  for (int j = 0; j < LANES; j++)
+    lanes[j] = INFINITY;
+  size_t i = 0;
+  for (; i + LANES <= n; i += LANES)
+    for (int j = 0; j < LANES; j++)
+      lanes[j] = values[i + j] < lanes[j] ? values[i + j] : lanes[j];
+
+  double min = INFINITY;
+  for (int j = 0; j < LANES; j++)
+    min = lanes[j] < min ? lanes[j] : min;
+  for (; i < n; i++)
+    min = values[i] < min ? values[i] : min;
+  return min;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_reduce_max
+ *
+ * DESCRIPTION:	    Finds the greatest of an array of doubles.
+ *
+ * ARGUMENTS:	    values: (const double *) -- the values.
+ *		    n: (size_t) -- the number of values.
+ *
+ * RETURN:	    double -- the greatest value, or -INFINITY if there is
+ *			none.
+ *
+ * NOTES:	    Theta(n). NaNs are skipped, as in bitree_reduce_min().
+ ***/
+SIMD_CLONES
+double bitree_reduce_max(const double * values, size_t n)
+{
+  double lanes[LANES];
+  for (int j = 0; j < LANES; j++)
+    lanes[j] = -INFINITY;
+  size_t i = 0;
+  for (; i + LANES <= n; i += LANES)
+    for (int j = 0; j < LANES; j++)
+      lanes[j] = values[i + j] > lanes[j] ? values[i + j] : lanes[j];
+
+  double max = -INFINITY;
+  for (int j = 0; j < LANES; j++)
+    max = lanes[j] > max ? lanes[j] : max;
+  for (; i < n; i++)
+    max = values[i] > max ? values[i] : max;
+  return max;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_reduce_count_if
+ *
+ * DESCRIPTION:	    Counts the doubles of an array which are in a range.
+ *
+ * ARGUMENTS:	    values: (const double *) -- the values.
+ *		    n: (size_t) -- the number of values.
+ *		    lo: (double) -- the least value counted.
+ *		    hi: (double) -- the least value above those counted.
+ *
+ * RETURN:	    size_t -- the number of values v with lo <= v < hi.
+ *
+ * NOTES:	    Theta(n). Calling it once per bucket, over a block small
+ *		    enough to stay in the cache, builds a histogram.
+ ***/
+SIMD_CLONES
+size_t bitree_reduce_count_if(const double * values, size_t n, double lo,
+			      double hi)
+{
+  uint64_t lanes[LANES] = {0};
+  size_t i = 0;
+  for (; i + LANES <= n; i += LANES)
+    for (int j = 0; j < LANES; j++)
+      lanes[j] += values[i + j] >= lo && values[i + j] < hi;
+
+  size_t count = 0;
+  for (int j = 0; j < LANES; j++)
+    count += lanes[j];
+  for (; i < n; i++)
+    count += values[i] >= lo && values[i] < hi;
+  return count;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_reduce
+ *
+ * DESCRIPTION:	    Computes the count, sum, minimum, maximum and range count
+ *		    of the values of the payloads of a subtree.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the root of the subtree.
+ *		    order: (enum bitree_order) -- the order of the values.
+ *		    extractor: (double (*)(const void *)) -- returns the value
+ *			of a payload.
+ *		    lo: (double) -- the least value counted in `in_range'.
+ *		    hi: (double) -- the least value above those.
+ *		    result: (struct bitree_reduction *) -- the result.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(n), n is the size of the subtree, in O(1) memory besides
+ *		    the queue of a level order walk. Each block is reduced by
+ *		    the same kernels as a flattened array, while it is still
+ *		    in the cache.
+ ***/
+int bitree_reduce(bitree * tree, enum bitree_order order,
+		  double (*extractor)(const void * data), double lo, double hi,
+		  struct bitree_reduction * result)
+{
+  if (tree == NULL || extractor == NULL || result == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct bitree_reduction reduction = {0, 0, INFINITY, -INFINITY, 0};
+  struct fused fused;
+  fused.count = 0;
+  fused.extractor = extractor;
+  fused.lo = lo;
+  fused.hi = hi;
+  fused.result = &reduction;
+  if (bitree_walk(tree, order, fused_visit, &fused))
+    return -1;
+  fused_flush(&fused);
+
+  *result = reduction;
+  return 0;
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    flatten_visit
+ *
+ * DESCRIPTION:	    Stores the value of a node's payload.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    ctx: (void *) -- the struct flatten.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_CONTINUE.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit flatten_visit(bitree * node, void * ctx)
+{
+  struct flatten * flatten = (struct flatten *)ctx;
+  flatten->out[flatten->count++] = flatten->extractor(node->data);
+  return BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    fused_visit
+ *
+ * DESCRIPTION:	    Adds the value of a node's payload to the block, and
+ *		    reduces the block once it is full.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    ctx: (void *) -- the struct fused.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_CONTINUE.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit fused_visit(bitree * node, void * ctx)
+{
+  struct fused * fused = (struct fused *)ctx;
+  fused->block[fused->count++] = fused->extractor(node->data);
+  if (fused->count == BITREE_REDUCE_BLOCK)
+    fused_flush(fused);
+  return BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    fused_flush
+ *
+ * DESCRIPTION:	    Reduces the values in the block into the result, and
+ *		    empties it.
+ *
+ * ARGUMENTS:	    fused: (struct fused *) -- the state of the reduction.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void fused_flush(struct fused * fused)
+{
+  struct bitree_reduction * result = fused->result;
+  size_t n = fused->count;
+  if (n == 0)
+    return;
+
+  double min = bitree_reduce_min(fused->block, n);
+  double max = bitree_reduce_max(fused->block, n);
+  result->count += n;
+  result->sum += bitree_reduce_sum(fused->block, n);
+  result->min = min < result->min ? min : result->min;
+  result->max = max > result->max ? max : result->max;
+  result->in_range += bitree_reduce_count_if(fused->block, n, fused->lo,
+					     fused->hi);
+  fused->count = 0;
+}
+
+/*****************************************************************************/
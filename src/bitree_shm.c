@@ -0,0 +1,1044 @@
+/******************************************************************************
+ * NAME:	    bitree_shm.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the shared memory trees. The region
+ *		    starts with a header, which holds the root, the sequence
+ *		    number of the lock, and the state of the allocator; the
+ *		    rest is carved into blocks of power-of-two sizes, one for
+ *		    each node and its payload. Freed blocks are kept on one
+ *		    free list per size, threaded through their `left' fields.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#define _GNU_SOURCE /* memfd_create() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bitree_shm.h"
+#include "bitree_internal.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* "bitreesh", marks a region which holds a tree */
+#define SHM_MAGIC	0x6269747265657368ULL
+
+/* Blocks are SHM_MIN_BLOCK << c bytes, c < SHM_CLASSES */
+#define SHM_MIN_BLOCK	64
+#define SHM_CLASSES	48
+
+/* The `size' of a block on a free list, which no node can have */
+#define SHM_FREE	UINT64_MAX
+
+#define header(shm)	((struct shm_header *)(shm)->base)
+#define snode(shm, ref)	((struct bitree_snode *)((shm)->base + (ref)))
+
+/* Offset of the first block */
+#define SHM_START	((sizeof(struct shm_header) + SHM_MIN_BLOCK - 1) \
+			 & ~(size_t)(SHM_MIN_BLOCK - 1))
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* Everything in the header, except `seq', is only changed by the writer
+ * while `seq' is odd.
+ */
+struct shm_header {
+  uint64_t magic;
+  uint64_t capacity;
+  atomic_uint seq;
+  bitree_shm_ref root;
+  uint64_t size;
+  uint64_t top;
+  bitree_shm_ref free[SHM_CLASSES];
+};
+
+/* The state of a bitree_shm_walk() */
+struct shm_walk {
+  bitree_shm * shm;
+  unsigned seq;
+  enum bitree_visit (*visit)(bitree_shm *, bitree_shm_ref, void *);
+  void * ctx;
+};
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static int anonymous_fd(void);
+static bitree_shm * map_region(int fd, size_t capacity, int writable);
+static int check_writer(bitree_shm * shm);
+static int valid(bitree_shm * shm, bitree_shm_ref node);
+static int live(bitree_shm * shm, bitree_shm_ref node);
+static void write_begin(struct shm_header * header);
+static void write_end(struct shm_header * header);
+static void reset(bitree_shm * shm);
+static int size_class(size_t size);
+static bitree_shm_ref alloc_node(bitree_shm * shm, size_t size);
+static void free_node(bitree_shm * shm, bitree_shm_ref node);
+static bitree_shm_ref insert(bitree_shm * shm, bitree_shm_ref node,
+			     const void * data, size_t size, int right);
+
+/* Used by bitree_shm_walk() */
+static uint64_t walk_left(void * walk, uint64_t node);
+static uint64_t walk_right(void * walk, uint64_t node);
+static uint64_t walk_parent(void * walk, uint64_t node);
+static enum bitree_visit walk_visit(void * walk, uint64_t node);
+static int walk_stale(void * walk);
+
+/******************************************************************************
+ * STATIC VARIABLES
+ ***/
+
+static const struct bitree_walker shm_walker = {
+  walk_left, walk_right, walk_parent, walk_visit, walk_stale
+};
+
+/******************************************************************************
+ * API FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_create
+ *
+ * DESCRIPTION:	    Creates a region of shared memory holding an empty tree.
+ *
+ * ARGUMENTS:	    name: (const char *) -- name for shm_open(), or NULL.
+ *		    capacity: (size_t) -- size of the region, in bytes.
+ *
+ * RETURN:	    bitree_shm * -- a handle for the writer, or NULL.
+ *
+ * NOTES:	    The pages of the region are not touched until they are
+ *		    used, so `capacity' may be generous.
+ ***/
+bitree_shm * bitree_shm_create(const char * name, size_t capacity)
+{
+  if (capacity < SHM_START + SHM_MIN_BLOCK) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  int fd = name == NULL ? anonymous_fd()
+    : shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    return NULL;
+
+  bitree_shm * shm = NULL;
+  if (ftruncate(fd, capacity) || (shm = map_region(fd, capacity, 1)) == NULL)
+    goto error_exit;
+
+  /* The pages are zero-filled, so the free lists start empty. The magic
+   * number goes in last, so that a reader can't open a region which is only
+   * half set up.
+   */
+  struct shm_header * header = header(shm);
+  header->capacity = capacity;
+  atomic_init(&header->seq, 0);
+  header->top = SHM_START;
+  atomic_thread_fence(memory_order_release);
+  header->magic = SHM_MAGIC;
+  return shm;
+
+ error_exit: {
+    int error = errno;
+    close(fd);
+    if (name != NULL)
+      shm_unlink(name);
+    errno = error;
+    return NULL;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_open
+ *
+ * DESCRIPTION:	    Maps a named region for reading.
+ *
+ * ARGUMENTS:	    name: (const char *) -- the name given to
+ *			bitree_shm_create().
+ *
+ * RETURN:	    bitree_shm * -- a handle for a reader, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+bitree_shm * bitree_shm_open(const char * name)
+{
+  if (name == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+
+  bitree_shm * shm = bitree_shm_map(fd);
+  int error = errno;
+  close(fd);
+  errno = error;
+  return shm;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_map
+ *
+ * DESCRIPTION:	    Maps the region behind a file descriptor for reading.
+ *
+ * ARGUMENTS:	    fd: (int) -- file descriptor of the region.
+ *
+ * RETURN:	    bitree_shm * -- a handle for a reader, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+bitree_shm * bitree_shm_map(int fd)
+{
+  struct stat st;
+  if (fstat(fd, &st))
+    return NULL;
+  if ((size_t)st.st_size < SHM_START + SHM_MIN_BLOCK) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (copy < 0)
+    return NULL;
+
+  bitree_shm * shm = map_region(copy, st.st_size, 0);
+  if (shm == NULL) {
+    close(copy);
+    return NULL;
+  }
+
+  struct shm_header * header = header(shm);
+  if (header->magic != SHM_MAGIC || header->capacity != shm->capacity) {
+    bitree_shm_close(&shm);
+    errno = EINVAL;
+    return NULL;
+  }
+  atomic_thread_fence(memory_order_acquire);
+  return shm;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_close
+ *
+ * DESCRIPTION:	    Unmaps a region, and frees the handle.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm **) -- the handle.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+void bitree_shm_close(bitree_shm ** shm)
+{
+  if (shm == NULL || *shm == NULL)
+    return;
+
+  munmap((*shm)->base, (*shm)->capacity);
+  close((*shm)->fd);
+  free(*shm);
+  *shm = NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_store
+ *
+ * DESCRIPTION:	    Replaces the tree in the region with a copy of a subtree.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the writer's handle.
+ *		    tree: (bitree *) -- root of the subtree, or NULL.
+ *		    serialize: (size_t (*)(const void *, void *, size_t)) --
+ *			copies a payload into the region.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+int bitree_shm_store(bitree_shm * shm, bitree * tree,
+		     size_t (*serialize)(const void *, void *, size_t))
+{
+  if (check_writer(shm))
+    return -1;
+  if (tree != NULL && serialize == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct shm_header * header = header(shm);
+  write_begin(header);
+  reset(shm);
+
+  /* The nodes are copied in preorder, so the parent of each one has already
+   * been copied, and is an ancestor of the last node copied. `last' and
+   * `copy' climb to it together.
+   */
+  struct bitree_cursor cursor;
+  bitree * last = NULL;
+  bitree_shm_ref copy = 0;
+  if (tree != NULL)
+    bitree_cursor_init(&cursor, tree, BITREE_PREORDER);
+  for (bitree * node; tree != NULL
+	 && (node = bitree_cursor_next(&cursor)) != NULL;) {
+    bitree_shm_ref parent = 0;
+    if (node != tree) {
+      while (last != node->parent) {
+	last = last->parent;
+	copy = snode(shm, copy)->parent;
+      }
+      parent = copy;
+    }
+
+    size_t size = serialize(node->data, NULL, 0);
+    if ((copy = alloc_node(shm, size)) == 0)
+      goto error_exit;
+    struct bitree_snode * snode = snode(shm, copy);
+    serialize(node->data, snode->data, size);
+    snode->parent = parent;
+    if (parent == 0)
+      header->root = copy;
+    else if (node->parent->left == node)
+      snode(shm, parent)->left = copy;
+    else
+      snode(shm, parent)->right = copy;
+    header->size++;
+    last = node;
+  }
+
+  write_end(header);
+  return 0;
+
+ error_exit: {
+    reset(shm);
+    write_end(header);
+    return -1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_insl
+ *
+ * DESCRIPTION:	    Inserts a node to the left of `node'.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the writer's handle.
+ *		    node: (bitree_shm_ref) -- the parent, or 0.
+ *		    data: (const void *) -- the payload.
+ *		    size: (size_t) -- the size of the payload.
+ *
+ * RETURN:	    bitree_shm_ref -- the new node, or 0.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree_shm_ref bitree_shm_insl(bitree_shm * shm, bitree_shm_ref node,
+			       const void * data, size_t size)
+{
+  return insert(shm, node, data, size, 0);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_insr
+ *
+ * DESCRIPTION:	    Inserts a node to the right of `node'.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the writer's handle.
+ *		    node: (bitree_shm_ref) -- the parent, or 0.
+ *		    data: (const void *) -- the payload.
+ *		    size: (size_t) -- the size of the payload.
+ *
+ * RETURN:	    bitree_shm_ref -- the new node, or 0.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree_shm_ref bitree_shm_insr(bitree_shm * shm, bitree_shm_ref node,
+			       const void * data, size_t size)
+{
+  return insert(shm, node, data, size, 1);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_rem
+ *
+ * DESCRIPTION:	    Removes the subtree rooted at `node', and frees its blocks.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the writer's handle.
+ *		    node: (bitree_shm_ref) -- root of the subtree.
+ *
+ * RETURN:	    int -- 0 on success, -1 otherwise.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+int bitree_shm_rem(bitree_shm * shm, bitree_shm_ref node)
+{
+  if (check_writer(shm))
+    return -1;
+  if (!live(shm, node)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct shm_header * header = header(shm);
+  write_begin(header);
+
+  /* Each node is cut from its parent as it is freed, so the parent becomes a
+   * leaf once both of its children are gone.
+   */
+  bitree_shm_ref current = node;
+  uint64_t removed = 0;
+  while (current != 0) {
+    struct bitree_snode * snode = snode(shm, current);
+    if (snode->left != 0) {
+      current = snode->left;
+      continue;
+    } else if (snode->right != 0) {
+      current = snode->right;
+      continue;
+    }
+
+    bitree_shm_ref parent = snode->parent;
+    if (parent == 0)
+      header->root = 0;
+    else if (snode(shm, parent)->left == current)
+      snode(shm, parent)->left = 0;
+    else
+      snode(shm, parent)->right = 0;
+
+    free_node(shm, current);
+    removed++;
+    current = current == node ? 0 : parent;
+  }
+
+  header->size -= removed;
+  write_end(header);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_read_begin
+ *
+ * DESCRIPTION:	    Starts a read section.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *
+ * RETURN:	    unsigned -- the sequence number, to pass to
+ *		    bitree_shm_read_retry().
+ *
+ * NOTES:	    Theta(1)
+ ***/
+unsigned bitree_shm_read_begin(bitree_shm * shm)
+{
+  return atomic_load_explicit(&header(shm)->seq, memory_order_acquire);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_read_retry
+ *
+ * DESCRIPTION:	    Ends a read section.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *		    seq: (unsigned) -- from bitree_shm_read_begin().
+ *
+ * RETURN:	    int -- nonzero if the tree changed during the section.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+int bitree_shm_read_retry(bitree_shm * shm, unsigned seq)
+{
+  /* An odd sequence number means that the writer was already busy when the
+   * section started.
+   */
+  atomic_thread_fence(memory_order_acquire);
+  return (seq & 1)
+    || atomic_load_explicit(&header(shm)->seq, memory_order_relaxed) != seq;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_root
+ *
+ * DESCRIPTION:	    Returns the root of the tree.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *
+ * RETURN:	    bitree_shm_ref -- the root, or 0.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree_shm_ref bitree_shm_root(bitree_shm * shm)
+{
+  bitree_shm_ref root = header(shm)->root;
+  return valid(shm, root) ? root : 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_size
+ *
+ * DESCRIPTION:	    Returns the number of nodes in the tree.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *
+ * RETURN:	    int -- the size of the tree.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+int bitree_shm_size(bitree_shm * shm)
+{
+  return header(shm)->size;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_parent
+ *
+ * DESCRIPTION:	    Returns the parent of `node'.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *		    node: (bitree_shm_ref) -- the node.
+ *
+ * RETURN:	    bitree_shm_ref -- the parent, or 0.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree_shm_ref bitree_shm_parent(bitree_shm * shm, bitree_shm_ref node)
+{
+  return valid(shm, node) ? snode(shm, node)->parent : 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_left
+ *
+ * DESCRIPTION:	    Returns the left child of `node'.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *		    node: (bitree_shm_ref) -- the node.
+ *
+ * RETURN:	    bitree_shm_ref -- the left child, or 0.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree_shm_ref bitree_shm_left(bitree_shm * shm, bitree_shm_ref node)
+{
+  return valid(shm, node) ? snode(shm, node)->left : 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_right
+ *
+ * DESCRIPTION:	    Returns the right child of `node'.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *		    node: (bitree_shm_ref) -- the node.
+ *
+ * RETURN:	    bitree_shm_ref -- the right child, or 0.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree_shm_ref bitree_shm_right(bitree_shm * shm, bitree_shm_ref node)
+{
+  return valid(shm, node) ? snode(shm, node)->right : 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_data
+ *
+ * DESCRIPTION:	    Returns the payload of `node', in place.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *		    node: (bitree_shm_ref) -- the node.
+ *		    size: (size_t *) -- set to the size of the payload, if it
+ *			is not NULL.
+ *
+ * RETURN:	    const void * -- the payload, or NULL.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+const void * bitree_shm_data(bitree_shm * shm, bitree_shm_ref node,
+			     size_t * size)
+{
+  if (!valid(shm, node))
+    return NULL;
+
+  /* The size is read once, since the writer may change it under us */
+  struct bitree_snode * snode = snode(shm, node);
+  uint64_t bytes = snode->size;
+  if (bytes > shm->capacity - node - sizeof(struct bitree_snode))
+    return NULL;
+  if (size != NULL)
+    *size = bytes;
+  return snode->data;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_shm_walk
+ *
+ * DESCRIPTION:	    Visits the subtree rooted at `node' in the order given,
+ *		    until the visitor asks it to stop.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *		    node: (bitree_shm_ref) -- root of the subtree.
+ *		    order: (enum bitree_order) -- the order.
+ *		    visit: (enum bitree_visit (*)(bitree_shm *, bitree_shm_ref,
+ *			void *)) -- the visitor.
+ *		    ctx: (void *) -- passed to the visitor.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 if it finished, -1 on
+ *		    error.
+ *
+ * NOTES:	    O(n), n is the size of the subtree. O(1) extra memory,
+ *		    except in level order.
+ ***/
+int bitree_shm_walk(bitree_shm * shm, bitree_shm_ref node,
+		    enum bitree_order order,
+		    enum bitree_visit (*visit)(bitree_shm *, bitree_shm_ref,
+					       void *),
+		    void * ctx)
+{
+  if (shm == NULL || visit == NULL || !valid(shm, node)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* The walk fails with EAGAIN if the writer changes the tree before it is
+   * over, since whatever the visitor saw may then be wrong.
+   */
+  struct shm_walk walk = { shm, bitree_shm_read_begin(shm), visit, ctx };
+  return bitree_walk_refs(&shm_walker, &walk, node, order);
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    anonymous_fd
+ *
+ * DESCRIPTION:	    Creates an anonymous region of shared memory.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- a file descriptor for the region, or -1.
+ *
+ * NOTES:	    Where memfd_create() is not available, a named region is
+ *		    created and unlinked at once.
+ ***/
+static int anonymous_fd(void)
+{
+#ifdef __linux__
+  return memfd_create("bitree", MFD_CLOEXEC);
+#else
+  static atomic_uint counter;
+  char name[64];
+  snprintf(name, sizeof(name), "/bitree-%ld-%u", (long)getpid(),
+	   atomic_fetch_add(&counter, 1));
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd >= 0)
+    shm_unlink(name);
+  return fd;
+#endif
+}
+
+/******************************************************************************
+ * FUNCTION:	    map_region
+ *
+ * DESCRIPTION:	    Maps a region, and makes a handle for it.
+ *
+ * ARGUMENTS:	    fd: (int) -- file descriptor of the region, which the
+ *			handle takes over on success.
+ *		    capacity: (size_t) -- size of the region.
+ *		    writable: (int) -- nonzero to map it for writing.
+ *
+ * RETURN:	    bitree_shm * -- the handle, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static bitree_shm * map_region(int fd, size_t capacity, int writable)
+{
+  bitree_shm * shm = malloc(sizeof(bitree_shm));
+  if (shm == NULL)
+    return NULL;
+
+  void * base = mmap(NULL, capacity, PROT_READ | (writable ? PROT_WRITE : 0),
+		     MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    free(shm);
+    return NULL;
+  }
+
+  *shm = (bitree_shm){
+    .base = base,
+    .capacity = capacity,
+    .fd = fd,
+    .writable = writable
+  };
+  return shm;
+}
+
+/******************************************************************************
+ * FUNCTION:	    check_writer
+ *
+ * DESCRIPTION:	    Checks that `shm' may be used to change the tree.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *
+ * RETURN:	    int -- 0 if it may, -1 (with errno set) otherwise.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static int check_writer(bitree_shm * shm)
+{
+  if (shm == NULL) {
+    errno = EINVAL;
+    return -1;
+  } else if (!shm->writable) {
+    errno = EPERM;
+    return -1;
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    valid
+ *
+ * DESCRIPTION:	    Checks that a node at offset `node' would lie inside the
+ *		    blocks of the region.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the handle.
+ *		    node: (bitree_shm_ref) -- the offset.
+ *
+ * RETURN:	    int -- nonzero if it would.
+ *
+ * NOTES:	    Only the size of the local mapping is trusted, since the
+ *		    header may be changing.
+ ***/
+static int valid(bitree_shm * shm, bitree_shm_ref node)
+{
+  return node >= SHM_START && node % sizeof(uint64_t) == 0
+    && node <= shm->capacity - sizeof(struct bitree_snode);
+}
+
+/******************************************************************************
+ * FUNCTION:	    live
+ *
+ * DESCRIPTION:	    Checks that `node' is a node of the tree, before the
+ *		    writer changes it: that its block is in use, has a size
+ *		    class, and lies below the unused end of the region, and
+ *		    that it is the root or a child of its parent. Since no two
+ *		    blocks overlap, an offset into the middle of a block can't
+ *		    be a child of any node.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the writer's handle.
+ *		    node: (bitree_shm_ref) -- the offset.
+ *
+ * RETURN:	    int -- nonzero if it is.
+ *
+ * NOTES:	    Theta(log(s)), s is the size of the payload.
+ ***/
+static int live(bitree_shm * shm, bitree_shm_ref node)
+{
+  struct shm_header * header = header(shm);
+  if (!valid(shm, node) || node >= header->top)
+    return 0;
+
+  struct bitree_snode * snode = snode(shm, node);
+  int class = snode->size == SHM_FREE || snode->size > shm->capacity ? -1
+    : size_class(sizeof(struct bitree_snode) + snode->size);
+  if (class < 0 || ((size_t)SHM_MIN_BLOCK << class) > header->top - node)
+    return 0;
+
+  bitree_shm_ref parent = snode->parent;
+  if (parent == 0)
+    return header->root == node;
+  return valid(shm, parent)
+    && (snode(shm, parent)->left == node || snode(shm, parent)->right == node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    write_begin
+ *
+ * DESCRIPTION:	    Starts a write section, by making the sequence number odd.
+ *
+ * ARGUMENTS:	    header: (struct shm_header *) -- header of the region.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void write_begin(struct shm_header * header)
+{
+  unsigned seq = atomic_load_explicit(&header->seq, memory_order_relaxed);
+  atomic_store_explicit(&header->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+/******************************************************************************
+ * FUNCTION:	    write_end
+ *
+ * DESCRIPTION:	    Ends a write section, by making the sequence number even.
+ *
+ * ARGUMENTS:	    header: (struct shm_header *) -- header of the region.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void write_end(struct shm_header * header)
+{
+  unsigned seq = atomic_load_explicit(&header->seq, memory_order_relaxed);
+  atomic_store_explicit(&header->seq, seq + 1, memory_order_release);
+}
+
+/******************************************************************************
+ * FUNCTION:	    reset
+ *
+ * DESCRIPTION:	    Empties the tree, and returns every block to the
+ *		    allocator.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the writer's handle.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1). Must be called in a write section.
+ ***/
+static void reset(bitree_shm * shm)
+{
+  struct shm_header * header = header(shm);
+  header->root = 0;
+  header->size = 0;
+  header->top = SHM_START;
+  memset(header->free, 0, sizeof(header->free));
+}
+
+/******************************************************************************
+ * FUNCTION:	    size_class
+ *
+ * DESCRIPTION:	    Returns the size class of a block holding `size' bytes.
+ *
+ * ARGUMENTS:	    size: (size_t) -- the size of the node and its payload.
+ *
+ * RETURN:	    int -- the class, or -1 if it is too large.
+ *
+ * NOTES:	    O(log(size))
+ ***/
+static int size_class(size_t size)
+{
+  int class = 0;
+  while (((size_t)SHM_MIN_BLOCK << class) < size)
+    if (++class == SHM_CLASSES)
+      return -1;
+  return class;
+}
+
+/******************************************************************************
+ * FUNCTION:	    alloc_node
+ *
+ * DESCRIPTION:	    Allocates an unlinked node with room for a payload of
+ *		    `size' bytes, from the free list of its class if it has a
+ *		    block, and from the unused end of the region otherwise.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the writer's handle.
+ *		    size: (size_t) -- the size of the payload.
+ *
+ * RETURN:	    bitree_shm_ref -- the node, or 0 (with errno set to ENOSPC).
+ *
+ * NOTES:	    Theta(1). Must be called in a write section.
+ ***/
+static bitree_shm_ref alloc_node(bitree_shm * shm, size_t size)
+{
+  struct shm_header * header = header(shm);
+  int class = size > shm->capacity ? -1
+    : size_class(sizeof(struct bitree_snode) + size);
+  if (class < 0) {
+    errno = ENOSPC;
+    return 0;
+  }
+
+  size_t block = (size_t)SHM_MIN_BLOCK << class;
+  bitree_shm_ref node = header->free[class];
+  if (node != 0) {
+    header->free[class] = snode(shm, node)->left;
+  } else if (block <= shm->capacity - header->top) {
+    node = header->top;
+    header->top += block;
+  } else {
+    errno = ENOSPC;
+    return 0;
+  }
+
+  struct bitree_snode * snode = snode(shm, node);
+  snode->parent = snode->left = snode->right = 0;
+  snode->size = size;
+  return node;
+}
+
+/******************************************************************************
+ * FUNCTION:	    free_node
+ *
+ * DESCRIPTION:	    Puts the block of `node' on the free list of its class.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the writer's handle.
+ *		    node: (bitree_shm_ref) -- the node, which must be unlinked.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(log(s)), s is the size of the payload. Must be called in
+ *		    a write section.
+ ***/
+static void free_node(bitree_shm * shm, bitree_shm_ref node)
+{
+  struct shm_header * header = header(shm);
+  struct bitree_snode * snode = snode(shm, node);
+  int class = size_class(sizeof(struct bitree_snode) + snode->size);
+  snode->parent = snode->right = 0;
+  snode->size = SHM_FREE;
+  snode->left = header->free[class];
+  header->free[class] = node;
+}
+
+/******************************************************************************
+ * FUNCTION:	    insert
+ *
+ * DESCRIPTION:	    Does the work of bitree_shm_insl() and bitree_shm_insr().
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the writer's handle.
+ *		    node: (bitree_shm_ref) -- the parent, or 0.
+ *		    data: (const void *) -- the payload.
+ *		    size: (size_t) -- the size of the payload.
+ *		    right: (int) -- nonzero to insert a right child.
+ *
+ * RETURN:	    bitree_shm_ref -- the new node, or 0.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static bitree_shm_ref insert(bitree_shm * shm, bitree_shm_ref node,
+			     const void * data, size_t size, int right)
+{
+  if (check_writer(shm))
+    return 0;
+
+  struct shm_header * header = header(shm);
+  bitree_shm_ref * link = node == 0 ? &header->root
+    : !live(shm, node) ? NULL
+    : right ? &snode(shm, node)->right : &snode(shm, node)->left;
+  if (link == NULL || *link != 0 || (data == NULL && size > 0)) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  write_begin(header);
+  bitree_shm_ref child = alloc_node(shm, size);
+  if (child != 0) {
+    memcpy(snode(shm, child)->data, data, size);
+    snode(shm, child)->parent = node;
+    *link = child;
+    header->size++;
+  }
+  write_end(header);
+  return child;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_left
+ *
+ * DESCRIPTION:	    Returns the left child of a node, for bitree_walk_refs().
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct shm_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    uint64_t -- its left child, or 0 if it has none.
+ *
+ * NOTES:	    Theta(1).
+ ***/
+static uint64_t walk_left(void * walk, uint64_t node)
+{
+  return bitree_shm_left(((struct shm_walk *)walk)->shm, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_right
+ *
+ * DESCRIPTION:	    Returns the right child of a node, for bitree_walk_refs().
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct shm_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    uint64_t -- its right child, or 0 if it has none.
+ *
+ * NOTES:	    Theta(1).
+ ***/
+static uint64_t walk_right(void * walk, uint64_t node)
+{
+  return bitree_shm_right(((struct shm_walk *)walk)->shm, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_parent
+ *
+ * DESCRIPTION:	    Returns the parent of a node, for bitree_walk_refs().
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct shm_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    uint64_t -- its parent, or 0 if it has none.
+ *
+ * NOTES:	    Theta(1).
+ ***/
+static uint64_t walk_parent(void * walk, uint64_t node)
+{
+  return bitree_shm_parent(((struct shm_walk *)walk)->shm, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_visit
+ *
+ * DESCRIPTION:	    Calls the visitor of a bitree_shm_walk() on a node.
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct shm_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    enum bitree_visit -- what the visitor returned.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit walk_visit(void * walk, uint64_t node)
+{
+  struct shm_walk * shm_walk = (struct shm_walk *)walk;
+  return shm_walk->visit(shm_walk->shm, node, shm_walk->ctx);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_stale
+ *
+ * DESCRIPTION:	    Checks whether the writer has changed the tree since a
+ *		    walk started.
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct shm_walk.
+ *
+ * RETURN:	    int -- nonzero if it has.
+ *
+ * NOTES:	    Theta(1). The walk checks this at every step, so that it
+ *		    can't go round in circles after a change.
+ ***/
+static int walk_stale(void * walk)
+{
+  struct shm_walk * shm_walk = (struct shm_walk *)walk;
+  return bitree_shm_read_retry(shm_walk->shm, shm_walk->seq);
+}
+
+/*****************************************************************************/
@@ -0,0 +1,275 @@
+/******************************************************************************
+ * NAME:	    bitree_splay.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the splay mode for keyed trees. It is a
+ *		    self-adjusting alternative to the ordered layer in
+ *		    bitree_avl.c, which suits workloads where a small number of
+ *		    keys receive most of the lookups. Since every rotation also
+ *		    updates the cached fields of the nodes it moves, a full
+ *		    splay on every access costs more than it saves; only deep
+ *		    accesses are splayed, and then only semi-splayed.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#include <stdlib.h>
+
+#include "bitree.h"
+#include "bitree_internal.h"
+#include "bitree_splay.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* Nodes no deeper than this, in a tree of about 2^log nodes, are not splayed:
+ * half as deep again as a balanced tree.
+ */
+#define splay_bound(log)	((log) + (log) / 2)
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static bitree * descend(bitree * node, const void * key,
+			int (*compare)(const void *, const void *),
+			int * depth);
+static int splay_depth(bitree * tree);
+
+/******************************************************************************
+ * API FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_splay
+ *
+ * DESCRIPTION:	    Semi-splays `node' towards the root. A zig-zag step moves
+ *		    `node' up two levels, as in a full splay, but a zig-zig
+ *		    step only rotates its grandparent, and then continues from
+ *		    its parent, so that each rotation at least halves the depth
+ *		    of the nodes below it on the path. The root node itself is
+ *		    never rotated, so no payloads are exchanged between nodes.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to splay.
+ *
+ * RETURN:	    bitree * -- `node', or NULL.
+ *
+ * NOTES:	    O(d), d is the distance of `node' from the root. Amortized
+ *		    O(log(n)) per access.
+ ***/
+bitree * bitree_splay(bitree * node)
+{
+  if (node == NULL)
+    return NULL;
+
+  bitree * splayed = node;
+  while (node->parent != NULL && node->parent->parent != NULL) {
+    bitree * parent = node->parent;
+    bitree * grand = parent->parent;
+    int left = parent->left == node;
+
+    if (grand->parent == NULL) {
+      /* Zig, below the root */
+      left ? bitree_rotr(parent) : bitree_rotl(parent);
+    } else if (left == (grand->left == parent)) {
+      /* Zig-zig: `parent' takes the place of `grand' */
+      left ? bitree_rotr(grand) : bitree_rotl(grand);
+      node = parent;
+    } else {
+      /* Zig-zag: `node' takes the place of `grand' */
+      left ? bitree_rotr(parent) : bitree_rotl(parent);
+      left ? bitree_rotl(grand) : bitree_rotr(grand);
+    }
+  }
+
+  return splayed;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_splay_find
+ *
+ * DESCRIPTION:	    Searches the tree for `key', and splays the node where the
+ *		    search ended if it was too deep.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
+ *		    key: (const void *) -- the key to look for.
+ *		    compare: (int (*)(const void *, const void *)) -- the
+ *			comparison function for the tree.
+ *
+ * RETURN:	    bitree * -- the node holding `key', or NULL if `key' was
+ *		    not found.
+ *
+ * NOTES:	    Amortized O(log(n))
+ ***/
+bitree * bitree_splay_find(bitree * tree, const void * key,
+			   int (*compare)(const void *, const void *))
+{
+  if (tree == NULL || key == NULL || compare == NULL)
+    return NULL;
+
+  int depth = 0;
+  bitree * node = descend(tree->root, key, compare, &depth);
+  int found = compare(key, node->data) == 0;
+  if (depth > splay_depth(tree))
+    bitree_splay(node);
+  return found ? node : NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_splay_insert
+ *
+ * DESCRIPTION:	    Inserts `data' into the tree, then splays it if it was
+ *		    inserted too deep.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
+ *		    data: (void *) -- the key to insert.
+ *		    compare: (int (*)(const void *, const void *)) -- the
+ *			comparison function for the tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 on failure or if the key is already
+ *		    in the tree.
+ *
+ * NOTES:	    Amortized O(log(n))
+ ***/
+int bitree_splay_insert(bitree * tree, void * data,
+			int (*compare)(const void *, const void *))
+{
+  if (tree == NULL || data == NULL || compare == NULL)
+    return -1;
+
+  int depth = 0;
+  bitree * node = descend(tree->root, data, compare, &depth);
+  int result = compare(data, node->data);
+  if (result == 0) {
+    if (depth > splay_depth(tree))
+      bitree_splay(node);
+    return -1;
+  }
+
+  if (result < 0 ? bitree_insl(node, data) : bitree_insr(node, data))
+    return -1;
+
+  if (depth + 1 > splay_depth(tree))
+    bitree_splay(result < 0 ? node->left : node->right);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_splay_erase
+ *
+ * DESCRIPTION:	    Removes `key' from the tree at `*tree'. As in
+ *		    bitree_avl_erase(), the payload is exchanged down to a leaf
+ *		    before it is removed, and the leaf's parent is then
+ *		    splayed.
+ *
+ * ARGUMENTS:	    tree: (bitree **) -- pointer to the root of the tree.
+ *		    key: (const void *) -- the key to remove.
+ *		    compare: (int (*)(const void *, const void *)) -- the
+ *			comparison function for the tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 if `key' was not found.
+ *
+ * NOTES:	    Amortized O(log(n))
+ ***/
+int bitree_splay_erase(bitree ** tree, const void * key,
+		       int (*compare)(const void *, const void *))
+{
+  if (tree == NULL || *tree == NULL || key == NULL || compare == NULL)
+    return -1;
+
+  int depth = 0;
+  bitree * node = descend((*tree)->root, key, compare, &depth);
+  if (compare(key, node->data) != 0) {
+    if (depth > splay_depth(*tree))
+      bitree_splay(node);
+    return -1;
+  }
+
+  if (*(node->size) == 1) {
+    bitree_rem(node);
+    *tree = NULL;
+    return 0;
+  }
+
+  while (!bitree_isleaf(node)) {
+    bitree * next = NULL;
+    if (node->right != NULL) {
+      for (next = node->right; next->left != NULL; next = next->left);
+    } else {
+      for (next = node->left; next->right != NULL; next = next->right);
+    }
+    bitree_swap_data(node, next);
+    node = next;
+  }
+
+  bitree * parent = node->parent;
+  bitree_rem(node);
+  if (bitree_distance(parent) > splay_depth(parent))
+    bitree_splay(parent);
+  return 0;
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    descend
+ *
+ * DESCRIPTION:	    Walks down from `node' towards `key', without changing the
+ *		    tree.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node to start at.
+ *		    key: (const void *) -- the key to look for.
+ *		    compare: (int (*)(const void *, const void *)) -- the
+ *			comparison function for the tree.
+ *		    depth: (int *) -- set to the distance walked.
+ *
+ * RETURN:	    bitree * -- the node holding `key', or the last node on the
+ *		    path if it is not in the tree.
+ *
+ * NOTES:	    O(h), h is the height of the tree.
+ ***/
+static bitree * descend(bitree * node, const void * key,
+			int (*compare)(const void *, const void *),
+			int * depth)
+{
+  while (1) {
+    int result = compare(key, node->data);
+    bitree * next = result < 0 ? node->left : node->right;
+    if (result == 0 || next == NULL)
+      return node;
+    node = next;
+    (*depth)++;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    splay_depth
+ *
+ * DESCRIPTION:	    Returns the deepest a node of the tree may be found without
+ *		    being splayed.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- any node in the tree.
+ *
+ * RETURN:	    int -- the depth.
+ *
+ * NOTES:	    O(log(n))
+ ***/
+static int splay_depth(bitree * tree)
+{
+  int log = 0;
+  for (int n = *(tree->size); n > 1; n >>= 1)
+    log++;
+  return splay_bound(log);
+}
+
+/*****************************************************************************/
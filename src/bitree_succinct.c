@@ -0,0 +1,545 @@
+/******************************************************************************
+ * NAME:	    bitree_succinct.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the succinct trees. The shape of a tree
+ *		    is stored as the level order bitmap of Jacobson: a set bit
+ *		    for the root, then two bits for each node in level order,
+ *		    set if it has a left and a right child. 2n + 1 bits in all.
+ *		    The children of node k are numbered by the count of set
+ *		    bits up to and including their own (rank), and its parent
+ *		    is found from the position of its own set bit (select). A
+ *		    cumulative count per block of 512 bits answers rank with at
+ *		    most eight popcounts, and a sample of every 512th set bit
+ *		    starts select near its answer.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitree_succinct.h"
+#include "bitree_internal.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* Words per block of the rank directory, and set bits per select sample */
+#define BLOCK_WORDS	8
+#define SAMPLE_ONES	512
+
+#define test_bit(tree, i)	(((tree)->bits[(i) / 64] >> ((i) % 64)) & 1)
+#define set_bit(bits, i)	((bits)[(i) / 64] |= 1ULL << ((i) % 64))
+
+/* On x86-64, build the rank and select kernels twice, with and without the
+ * popcnt instruction, and let the loader pick the one the CPU supports.
+ */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#  define POPCOUNT_CLONES __attribute__((target_clones("popcnt", "default")))
+#else
+#  define POPCOUNT_CLONES
+#endif
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* The state of a bitree_succinct_walk() */
+struct succinct_walk {
+  const bitree_succinct * tree;
+  enum bitree_visit (*visit)(const bitree_succinct *, bitree_sref, void *);
+  void * ctx;
+};
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static uint64_t rank1(const bitree_succinct * tree, size_t i);
+static size_t select1(const bitree_succinct * tree, uint64_t j);
+static int build_directories(bitree_succinct * tree);
+
+/* Used by bitree_succinct_walk() */
+static uint64_t walk_left(void * walk, uint64_t node);
+static uint64_t walk_right(void * walk, uint64_t node);
+static uint64_t walk_parent(void * walk, uint64_t node);
+static enum bitree_visit walk_visit(void * walk, uint64_t node);
+
+/******************************************************************************
+ * STATIC VARIABLES
+ ***/
+
+static const struct bitree_walker succinct_walker = {
+  walk_left, walk_right, walk_parent, walk_visit, NULL
+};
+
+/******************************************************************************
+ * API FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_freeze_succinct
+ *
+ * DESCRIPTION:	    Freezes a copy of the subtree rooted at `tree'.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- root of the subtree.
+ *		    payload_size: (size_t) -- size of a payload, in bytes.
+ *		    serialize: (size_t (*)(const void *, void *, size_t)) --
+ *			writes a payload into the payload array.
+ *
+ * RETURN:	    bitree_succinct * -- the frozen tree, or NULL.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+bitree_succinct * bitree_freeze_succinct(bitree * tree, size_t payload_size,
+					 size_t (*serialize)(const void *,
+							     void *, size_t))
+{
+  if (tree == NULL || (payload_size > 0 && serialize == NULL)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  bitree_succinct * frozen = NULL;
+  size_t capacity = 64, size = 0;
+  bitree ** nodes = malloc(capacity * sizeof(bitree *));
+  if (nodes == NULL)
+    goto error_exit;
+
+  /* Number the nodes in level order. The array is its own queue, and the end
+   * of each level is noted as the level before it is finished.
+   */
+  int height = 0;
+  nodes[size++] = tree;
+  for (size_t i = 0, level_end = 0; i < size; i++) {
+    if (i == level_end) {
+      height++;
+      level_end = size;
+    }
+    if (size + 2 > capacity) {
+      bitree ** grown = realloc(nodes, 2 * capacity * sizeof(bitree *));
+      if (grown == NULL)
+	goto error_exit;
+      nodes = grown;
+      capacity *= 2;
+    }
+    if (nodes[i]->left != NULL)
+      nodes[size++] = nodes[i]->left;
+    if (nodes[i]->right != NULL)
+      nodes[size++] = nodes[i]->right;
+  }
+
+  if ((frozen = calloc(1, sizeof(bitree_succinct))) == NULL)
+    goto error_exit;
+  frozen->size = size;
+  frozen->height = height;
+  frozen->payload_size = payload_size;
+  frozen->nbits = 2 * size + 1;
+  /* One word more than needed, so that rank1() can read the word holding
+   * bit `nbits'
+   */
+  if ((frozen->bits = calloc(frozen->nbits / 64 + 1, sizeof(uint64_t)))
+      == NULL)
+    goto error_exit;
+
+  set_bit(frozen->bits, 0);
+  for (size_t k = 1; k <= size; k++) {
+    if (nodes[k - 1]->left != NULL)
+      set_bit(frozen->bits, 2 * k - 1);
+    if (nodes[k - 1]->right != NULL)
+      set_bit(frozen->bits, 2 * k);
+  }
+  if (build_directories(frozen))
+    goto error_exit;
+
+  if (payload_size > 0) {
+    if ((frozen->data = calloc(size, payload_size)) == NULL)
+      goto error_exit;
+    for (size_t k = 0; k < size; k++) {
+      if (serialize(nodes[k]->data, frozen->data + k * payload_size,
+		    payload_size) > payload_size) {
+	errno = ENOSPC;
+	goto error_exit;
+      }
+    }
+  }
+
+  free(nodes);
+  return frozen;
+
+ error_exit: {
+    free(nodes);
+    bitree_succinct_destroy(&frozen);
+    return NULL;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_succinct_destroy
+ *
+ * DESCRIPTION:	    Frees a frozen tree.
+ *
+ * ARGUMENTS:	    tree: (bitree_succinct **) -- the tree.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+void bitree_succinct_destroy(bitree_succinct ** tree)
+{
+  if (tree == NULL || *tree == NULL)
+    return;
+
+  free((*tree)->bits);
+  free((*tree)->ranks);
+  free((*tree)->samples);
+  free((*tree)->data);
+  free(*tree);
+  *tree = NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_succinct_parent
+ *
+ * DESCRIPTION:	    Returns the parent of `node'.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    node: (bitree_sref) -- the node.
+ *
+ * RETURN:	    bitree_sref -- the parent, or 0.
+ *
+ * NOTES:	    O(1) expected; one select query.
+ ***/
+bitree_sref bitree_succinct_parent(const bitree_succinct * tree,
+				   bitree_sref node)
+{
+  if (tree == NULL || node <= 1 || node > tree->size)
+    return 0;
+  return (select1(tree, node) + 1) / 2;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_succinct_left
+ *
+ * DESCRIPTION:	    Returns the left child of `node'.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    node: (bitree_sref) -- the node.
+ *
+ * RETURN:	    bitree_sref -- the left child, or 0.
+ *
+ * NOTES:	    Theta(1); one rank query.
+ ***/
+bitree_sref bitree_succinct_left(const bitree_succinct * tree,
+				 bitree_sref node)
+{
+  if (tree == NULL || node == 0 || node > tree->size
+      || !test_bit(tree, 2 * node - 1))
+    return 0;
+  return rank1(tree, 2 * node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_succinct_right
+ *
+ * DESCRIPTION:	    Returns the right child of `node'.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    node: (bitree_sref) -- the node.
+ *
+ * RETURN:	    bitree_sref -- the right child, or 0.
+ *
+ * NOTES:	    Theta(1); one rank query.
+ ***/
+bitree_sref bitree_succinct_right(const bitree_succinct * tree,
+				  bitree_sref node)
+{
+  if (tree == NULL || node == 0 || node > tree->size
+      || !test_bit(tree, 2 * node))
+    return 0;
+  return rank1(tree, 2 * node + 1);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_succinct_data
+ *
+ * DESCRIPTION:	    Returns the payload of `node'.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    node: (bitree_sref) -- the node.
+ *
+ * RETURN:	    const void * -- the payload, or NULL.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+const void * bitree_succinct_data(const bitree_succinct * tree,
+				  bitree_sref node)
+{
+  if (tree == NULL || tree->data == NULL || node == 0 || node > tree->size)
+    return NULL;
+  return tree->data + (node - 1) * tree->payload_size;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_succinct_depth
+ *
+ * DESCRIPTION:	    Calculates the distance of `node' from the root.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    node: (bitree_sref) -- the node.
+ *
+ * RETURN:	    int -- the distance, or -1 if `node' is not a node.
+ *
+ * NOTES:	    O(d), d is the depth of `node'.
+ ***/
+int bitree_succinct_depth(const bitree_succinct * tree, bitree_sref node)
+{
+  if (tree == NULL || node == 0 || node > tree->size)
+    return -1;
+
+  int depth = 0;
+  for (; node > 1; node = bitree_succinct_parent(tree, node))
+    depth++;
+  return depth;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_succinct_bytes
+ *
+ * DESCRIPTION:	    Calculates the memory used by a frozen tree.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *
+ * RETURN:	    size_t -- the number of bytes, or 0 if `tree' is NULL.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+size_t bitree_succinct_bytes(const bitree_succinct * tree)
+{
+  if (tree == NULL)
+    return 0;
+
+  size_t words = tree->nbits / 64 + 1;
+  size_t blocks = (words + BLOCK_WORDS - 1) / BLOCK_WORDS + 1;
+  size_t samples = (tree->size + SAMPLE_ONES - 1) / SAMPLE_ONES;
+  return sizeof(bitree_succinct) + (words + blocks + samples)
+    * sizeof(uint64_t) + tree->size * tree->payload_size;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_succinct_walk
+ *
+ * DESCRIPTION:	    Visits the subtree rooted at `node' in the order given,
+ *		    until the visitor asks it to stop.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    node: (bitree_sref) -- root of the subtree.
+ *		    order: (enum bitree_order) -- the order.
+ *		    visit: (enum bitree_visit (*)(const bitree_succinct *,
+ *			bitree_sref, void *)) -- the visitor.
+ *		    ctx: (void *) -- passed to the visitor.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 if it finished, -1 on
+ *		    error.
+ *
+ * NOTES:	    O(n), n is the size of the subtree. O(1) extra memory,
+ *		    except in level order.
+ ***/
+int bitree_succinct_walk(const bitree_succinct * tree, bitree_sref node,
+			 enum bitree_order order,
+			 enum bitree_visit (*visit)(const bitree_succinct *,
+						    bitree_sref, void *),
+			 void * ctx)
+{
+  if (tree == NULL || visit == NULL || node == 0 || node > tree->size) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct succinct_walk walk = { tree, visit, ctx };
+  return bitree_walk_refs(&succinct_walker, &walk, node, order);
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    rank1
+ *
+ * DESCRIPTION:	    Counts the set bits before bit `i'.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    i: (size_t) -- the bit, at most `nbits'.
+ *
+ * RETURN:	    uint64_t -- the number of set bits in [0, i).
+ *
+ * NOTES:	    Theta(1); at most BLOCK_WORDS popcounts.
+ ***/
+POPCOUNT_CLONES
+static uint64_t rank1(const bitree_succinct * tree, size_t i)
+{
+  size_t word = i / 64;
+  size_t block = word / BLOCK_WORDS;
+  uint64_t rank = tree->ranks[block];
+  for (size_t w = block * BLOCK_WORDS; w < word; w++)
+    rank += __builtin_popcountll(tree->bits[w]);
+  if (i % 64 != 0)
+    rank += __builtin_popcountll(tree->bits[word]
+				 & ((1ULL << (i % 64)) - 1));
+  return rank;
+}
+
+/******************************************************************************
+ * FUNCTION:	    select1
+ *
+ * DESCRIPTION:	    Finds the position of the `j'th set bit.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    j: (uint64_t) -- the set bit, from 1 to `size'.
+ *
+ * RETURN:	    size_t -- its position.
+ *
+ * NOTES:	    Half of the bits are set, so the sample usually leaves a
+ *		    block or two to pass, and the scan is O(1). A long run of
+ *		    leaves in level order, which clears two bits per leaf,
+ *		    makes it longer.
+ ***/
+POPCOUNT_CLONES
+static size_t select1(const bitree_succinct * tree, uint64_t j)
+{
+  size_t block = tree->samples[(j - 1) / SAMPLE_ONES];
+  while (tree->ranks[block + 1] < j)
+    block++;
+
+  uint64_t left = j - tree->ranks[block];
+  size_t word = block * BLOCK_WORDS;
+  for (uint64_t ones; (ones = __builtin_popcountll(tree->bits[word])) < left;
+       word++)
+    left -= ones;
+
+  /* Clear the set bits below the one we want */
+  uint64_t bits = tree->bits[word];
+  while (--left > 0)
+    bits &= bits - 1;
+  return word * 64 + __builtin_ctzll(bits);
+}
+
+/******************************************************************************
+ * FUNCTION:	    build_directories
+ *
+ * DESCRIPTION:	    Builds the rank and select directories of a tree whose
+ *		    bitmap is filled in.
+ *
+ * ARGUMENTS:	    tree: (bitree_succinct *) -- the tree.
+ *
+ * RETURN:	    int -- 0 on success, -1 if memory could not be allocated.
+ *
+ * NOTES:	    O(n), n is the size of the tree.
+ ***/
+static int build_directories(bitree_succinct * tree)
+{
+  size_t words = tree->nbits / 64 + 1;
+  size_t blocks = (words + BLOCK_WORDS - 1) / BLOCK_WORDS;
+  size_t samples = (tree->size + SAMPLE_ONES - 1) / SAMPLE_ONES;
+  if ((tree->ranks = malloc((blocks + 1) * sizeof(uint64_t))) == NULL
+      || (tree->samples = malloc(samples * sizeof(uint64_t))) == NULL)
+    return -1;
+
+  /* ranks[b] counts the set bits before block b, and the last entry counts
+   * them all. Sample s is the block holding set bit s * SAMPLE_ONES + 1.
+   */
+  uint64_t rank = 0;
+  size_t sample = 0;
+  for (size_t block = 0; block < blocks; block++) {
+    tree->ranks[block] = rank;
+    for (size_t w = block * BLOCK_WORDS;
+	 w < words && w < (block + 1) * BLOCK_WORDS; w++)
+      rank += __builtin_popcountll(tree->bits[w]);
+    for (; sample < samples && sample * SAMPLE_ONES < rank; sample++)
+      tree->samples[sample] = block;
+  }
+  tree->ranks[blocks] = rank;
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_left
+ *
+ * DESCRIPTION:	    Returns the left child of a node, for bitree_walk_refs().
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct succinct_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    uint64_t -- its left child, or 0 if it has none.
+ *
+ * NOTES:	    Theta(1).
+ ***/
+static uint64_t walk_left(void * walk, uint64_t node)
+{
+  return bitree_succinct_left(((struct succinct_walk *)walk)->tree, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_right
+ *
+ * DESCRIPTION:	    Returns the right child of a node, for bitree_walk_refs().
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct succinct_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    uint64_t -- its right child, or 0 if it has none.
+ *
+ * NOTES:	    Theta(1).
+ ***/
+static uint64_t walk_right(void * walk, uint64_t node)
+{
+  return bitree_succinct_right(((struct succinct_walk *)walk)->tree, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_parent
+ *
+ * DESCRIPTION:	    Returns the parent of a node, for bitree_walk_refs().
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct succinct_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    uint64_t -- its parent, or 0 if it has none.
+ *
+ * NOTES:	    Theta(1).
+ ***/
+static uint64_t walk_parent(void * walk, uint64_t node)
+{
+  return bitree_succinct_parent(((struct succinct_walk *)walk)->tree, node);
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_visit
+ *
+ * DESCRIPTION:	    Calls the visitor of a bitree_succinct_walk() on a node.
+ *
+ * ARGUMENTS:	    walk: (void *) -- the struct succinct_walk.
+ *		    node: (uint64_t) -- the node.
+ *
+ * RETURN:	    enum bitree_visit -- what the visitor returned.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit walk_visit(void * walk, uint64_t node)
+{
+  struct succinct_walk * succinct = (struct succinct_walk *)walk;
+  return succinct->visit(succinct->tree, node, succinct->ctx);
+}
+
+/*****************************************************************************/
@@ -0,0 +1,904 @@
+/******************************************************************************
+ * NAME:	    bitree_version.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the persistent (copy-on-write) trees.
+ *		    Every operation builds a new version by copying the path
+ *		    from the root to the node it changes; the rest of the tree
+ *		    is shared with the old version through reference counts.
+ *		    Interned versions go further, and share every subtree that
+ *		    is identical to another one.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bitree_version.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+#define pnode_count(node)	((node) == NULL ? 0 : (node)->count)
+
+/* Initial number of buckets in an intern table. Always a power of two. */
+#define INTERN_BUCKETS		64
+
+/******************************************************************************
+ * TYPE DEFINITIONS
+ ***/
+
+/* The intern table is a chained hash table of every node in a family of
+ * interned versions, keyed on the payload and the addresses of the children.
+ * A node's reference count is only changed with the table locked, so a lookup
+ * can never return a node that another thread is about to free.
+ */
+struct bitree_intern {
+  pthread_mutex_t lock;
+  atomic_int refs;
+  size_t (*hash)(const void *);
+  int (*equal)(const void *, const void *);
+  struct bitree_pnode ** buckets;
+  size_t nbuckets;
+  size_t nodes;
+};
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static bitree_version * insert(bitree_version * version, const char * path,
+			       void * data, int right);
+static bitree_version * derive(bitree_version * version, const char * path,
+			       struct bitree_pnode * replacement);
+static int copy_path(struct bitree_intern * intern,
+		     struct bitree_pnode * node, const char * path,
+		     struct bitree_pnode * replacement,
+		     struct bitree_pnode ** copy);
+static int intern_subtree(struct bitree_intern * intern,
+			  struct bitree_pnode * node,
+			  struct bitree_pnode ** copy);
+
+static bitree_version * new_version(struct bitree_intern * intern,
+				    struct bitree_pnode * root, int size,
+				    void (*destroy)(void *));
+static struct bitree_pnode * new_node(struct bitree_intern * intern,
+				      struct bitree_payload * payload,
+				      struct bitree_pnode * left,
+				      struct bitree_pnode * right);
+static struct bitree_payload * new_payload(void * data);
+static void release_node(struct bitree_intern * intern,
+			 struct bitree_pnode * node, void (*destroy)(void *));
+static void release_payload(struct bitree_payload * payload,
+			    void (*destroy)(void *));
+
+/* Used by interned versions */
+static struct bitree_intern * new_intern(size_t (*hash)(const void *),
+					 int (*equal)(const void *,
+						      const void *));
+static void release_intern(struct bitree_intern * intern);
+static struct bitree_pnode * intern_find(struct bitree_intern * intern,
+					 size_t hash,
+					 struct bitree_payload * payload,
+					 struct bitree_pnode * left,
+					 struct bitree_pnode * right);
+static void intern_add(struct bitree_intern * intern,
+		       struct bitree_pnode * node);
+static int intern_unref(struct bitree_intern * intern,
+			struct bitree_pnode * node);
+
+/******************************************************************************
+ * API FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_create
+ *
+ * DESCRIPTION:	    Creates the first version of a persistent tree.
+ *
+ * ARGUMENTS:	    destroy: (void (*)(void *)) -- function to call on payloads
+ *			which are no longer in any version (can be NULL).
+ *		    data: (void *) -- data to initialize the root with.
+ *
+ * RETURN:	    bitree_version * -- the new version, or NULL.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree_version * bitree_version_create(void (*destroy)(void *), void * data)
+{
+  if (data == NULL)
+    return NULL;
+
+  struct bitree_payload * payload = new_payload(data);
+  if (payload == NULL)
+    return NULL;
+
+  struct bitree_pnode * root = new_node(NULL, payload, NULL, NULL);
+  release_payload(payload, NULL);
+  if (root == NULL)
+    return NULL;
+
+  bitree_version * version = new_version(NULL, root, 1, destroy);
+  if (version == NULL)
+    release_node(NULL, root, NULL);
+  return version;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_insl
+ *
+ * DESCRIPTION:	    Returns a version with a new left child at `path'.
+ *
+ * ARGUMENTS:	    version: (bitree_version *) -- the version to start from.
+ *		    path: (const char *) -- the path to the parent.
+ *		    data: (void *) -- data for the new node.
+ *
+ * RETURN:	    bitree_version * -- the new version, or NULL.
+ *
+ * NOTES:	    O(d), d is the length of `path'.
+ ***/
+bitree_version * bitree_version_insl(bitree_version * version,
+				     const char * path, void * data)
+{
+  return insert(version, path, data, 0);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_insr
+ *
+ * DESCRIPTION:	    Returns a version with a new right child at `path'.
+ *
+ * ARGUMENTS:	    version: (bitree_version *) -- the version to start from.
+ *		    path: (const char *) -- the path to the parent.
+ *		    data: (void *) -- data for the new node.
+ *
+ * RETURN:	    bitree_version * -- the new version, or NULL.
+ *
+ * NOTES:	    O(d), d is the length of `path'.
+ ***/
+bitree_version * bitree_version_insr(bitree_version * version,
+				     const char * path, void * data)
+{
+  return insert(version, path, data, 1);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_rem
+ *
+ * DESCRIPTION:	    Returns a version without the subtree at `path'.
+ *
+ * ARGUMENTS:	    version: (bitree_version *) -- the version to start from.
+ *		    path: (const char *) -- the path to the subtree.
+ *
+ * RETURN:	    bitree_version * -- the new version, or NULL.
+ *
+ * NOTES:	    O(d), d is the length of `path'.
+ ***/
+bitree_version * bitree_version_rem(bitree_version * version,
+				    const char * path)
+{
+  struct bitree_pnode * node = bitree_version_find(version, path);
+  if (node == NULL)
+    return NULL;
+
+  return derive(version, path, NULL);
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_merge
+ *
+ * DESCRIPTION:	    Returns a version in which `version2' is attached to
+ *		    `version1'. See bitree_version.h for the cases.
+ *
+ * ARGUMENTS:	    version1: (bitree_version *) -- the host version.
+ *		    path: (const char *) -- the path to the host node.
+ *		    version2: (bitree_version *) -- the version to attach.
+ *		    data: (void *) -- data for a new root, if one is needed.
+ *
+ * RETURN:	    bitree_version * -- the new version, or NULL.
+ *
+ * NOTES:	    O(d), d is the length of `path'.
+ ***/
+bitree_version * bitree_version_merge(bitree_version * version1,
+				      const char * path,
+				      bitree_version * version2,
+				      void * data)
+{
+  struct bitree_pnode * node = bitree_version_find(version1, path);
+  if (node == NULL || version2 == NULL || version2->root == NULL
+      || version1->destroy != version2->destroy
+      || version1->intern != version2->intern)
+    return NULL;
+
+  struct bitree_intern * intern = version1->intern;
+  struct bitree_pnode * root = NULL, * replacement = NULL;
+  int size = version1->size + version2->size;
+
+  if ((path == NULL || *path == '\0') && node->left != NULL
+      && node->right != NULL && data != NULL) {
+    struct bitree_payload * payload = new_payload(data);
+    if (payload == NULL)
+      return NULL;
+    root = new_node(intern, payload, version1->root, version2->root);
+    bitree_version * merged = root == NULL ? NULL
+      : new_version(intern, root, size + 1, version1->destroy);
+    if (root != NULL && merged == NULL)
+      release_node(intern, root, NULL);
+    release_payload(payload, merged != NULL ? version1->destroy : NULL);
+    return merged;
+  }
+
+  if (node->left == NULL)
+    replacement = new_node(intern, node->payload, version2->root, node->right);
+  else if (node->right == NULL)
+    replacement = new_node(intern, node->payload, node->left, version2->root);
+  if (replacement == NULL
+      || copy_path(intern, version1->root, path, replacement, &root))
+    return NULL;
+
+  bitree_version * merged = new_version(intern, root, size,
+					version1->destroy);
+  if (merged == NULL)
+    release_node(intern, root, NULL);
+  return merged;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_intern
+ *
+ * DESCRIPTION:	    Returns an interned copy of `version', in which identical
+ *		    subtrees are shared.
+ *
+ * ARGUMENTS:	    version: (bitree_version *) -- the version to copy.
+ *		    hash: (size_t (*)(const void *)) -- hash of a payload.
+ *		    equal: (int (*)(const void *, const void *)) -- returns
+ *			nonzero if two payloads are equal.
+ *
+ * RETURN:	    bitree_version * -- the new version, or NULL.
+ *
+ * NOTES:	    O(n). The payloads are shared with `version'.
+ ***/
+bitree_version * bitree_version_intern(bitree_version * version,
+				       size_t (*hash)(const void *),
+				       int (*equal)(const void *,
+						    const void *))
+{
+  if (version == NULL || hash == NULL || equal == NULL)
+    return NULL;
+
+  struct bitree_intern * intern = new_intern(hash, equal);
+  if (intern == NULL)
+    return NULL;
+
+  struct bitree_pnode * root = NULL;
+  bitree_version * interned = NULL;
+  if (!intern_subtree(intern, version->root, &root)) {
+    interned = new_version(intern, root, version->size, version->destroy);
+    if (interned == NULL)
+      release_node(intern, root, NULL);
+  }
+
+  release_intern(intern);
+  return interned;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_interned
+ *
+ * DESCRIPTION:	    Returns the number of distinct nodes in the intern table
+ *		    of `version'.
+ *
+ * ARGUMENTS:	    version: (bitree_version *) -- the version.
+ *
+ * RETURN:	    size_t -- the number of nodes, or 0.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+size_t bitree_version_interned(bitree_version * version)
+{
+  if (version == NULL || version->intern == NULL)
+    return 0;
+
+  pthread_mutex_lock(&version->intern->lock);
+  size_t nodes = version->intern->nodes;
+  pthread_mutex_unlock(&version->intern->lock);
+  return nodes;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_find
+ *
+ * DESCRIPTION:	    Follows `path' down from the root of `version'.
+ *
+ * ARGUMENTS:	    version: (bitree_version *) -- the version to search.
+ *		    path: (const char *) -- the path to follow.
+ *
+ * RETURN:	    struct bitree_pnode * -- the node at `path', or NULL.
+ *
+ * NOTES:	    O(d), d is the length of `path'.
+ ***/
+struct bitree_pnode * bitree_version_find(bitree_version * version,
+					  const char * path)
+{
+  if (version == NULL)
+    return NULL;
+
+  struct bitree_pnode * node = version->root;
+  for (; path != NULL && *path != '\0' && node != NULL; path++) {
+    if (*path == 'l')
+      node = node->left;
+    else if (*path == 'r')
+      node = node->right;
+    else
+      return NULL;
+  }
+
+  return node;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_retain
+ *
+ * DESCRIPTION:	    Takes another reference to `version'.
+ *
+ * ARGUMENTS:	    version: (bitree_version *) -- the version.
+ *
+ * RETURN:	    bitree_version * -- `version'.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+bitree_version * bitree_version_retain(bitree_version * version)
+{
+  if (version != NULL)
+    atomic_fetch_add_explicit(&version->refs, 1, memory_order_relaxed);
+  return version;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bitree_version_release
+ *
+ * DESCRIPTION:	    Drops a reference to `*version'. When the last reference is
+ *		    dropped, the nodes which are not shared with another
+ *		    version are freed, and their payloads are destroyed.
+ *
+ * ARGUMENTS:	    version: (bitree_version **) -- the version to release.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(m), m is the number of nodes freed.
+ ***/
+void bitree_version_release(bitree_version ** version)
+{
+  if (version == NULL || *version == NULL)
+    return;
+
+  if (atomic_fetch_sub_explicit(&(*version)->refs, 1,
+				memory_order_acq_rel) == 1) {
+    release_node((*version)->intern, (*version)->root, (*version)->destroy);
+    release_intern((*version)->intern);
+    free(*version);
+  }
+  *version = NULL;
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    insert
+ *
+ * DESCRIPTION:	    Does the work of bitree_version_insl() and
+ *		    bitree_version_insr().
+ *
+ * ARGUMENTS:	    version: (bitree_version *) -- the version to start from.
+ *		    path: (const char *) -- the path to the parent.
+ *		    data: (void *) -- data for the new node.
+ *		    right: (int) -- nonzero to insert a right child.
+ *
+ * RETURN:	    bitree_version * -- the new version, or NULL.
+ *
+ * NOTES:	    O(d), d is the length of `path'.
+ ***/
+static bitree_version * insert(bitree_version * version, const char * path,
+			       void * data, int right)
+{
+  struct bitree_pnode * parent = bitree_version_find(version, path);
+  if (parent == NULL || data == NULL
+      || (right ? parent->right : parent->left) != NULL)
+    return NULL;
+
+  struct bitree_intern * intern = version->intern;
+  struct bitree_payload * payload = new_payload(data);
+  if (payload == NULL)
+    return NULL;
+
+  bitree_version * inserted = NULL;
+  struct bitree_pnode * child = new_node(intern, payload, NULL, NULL);
+  if (child != NULL) {
+    struct bitree_pnode * replacement = right
+      ? new_node(intern, parent->payload, parent->left, child)
+      : new_node(intern, parent->payload, child, parent->right);
+    release_node(intern, child, NULL);
+    if (replacement != NULL)
+      inserted = derive(version, path, replacement);
+  }
+
+  /* If an interned node already held an equal payload, nothing refers to
+   * this one now, and `data' is destroyed on success. On failure, the caller
+   * still owns it.
+   */
+  release_payload(payload, inserted != NULL ? version->destroy : NULL);
+  return inserted;
+}
+
+/******************************************************************************
+ * FUNCTION:	    derive
+ *
+ * DESCRIPTION:	    Returns a version of the tree in which the subtree at
+ *		    `path' is replaced by `replacement'.
+ *
+ * ARGUMENTS:	    version: (bitree_version *) -- the version to start from.
+ *		    path: (const char *) -- a valid path in `version'.
+ *		    replacement: (struct bitree_pnode *) -- the new subtree,
+ *			or NULL. The new version takes over its reference.
+ *
+ * RETURN:	    bitree_version * -- the new version, or NULL. On failure,
+ *		    `replacement' is released.
+ *
+ * NOTES:	    O(d), d is the length of `path'.
+ ***/
+static bitree_version * derive(bitree_version * version, const char * path,
+			       struct bitree_pnode * replacement)
+{
+  int size = version->size - pnode_count(bitree_version_find(version, path))
+    + pnode_count(replacement);
+
+  struct bitree_pnode * root = NULL;
+  if (copy_path(version->intern, version->root, path, replacement, &root))
+    return NULL;
+
+  bitree_version * derived = new_version(version->intern, root, size,
+					 version->destroy);
+  if (derived == NULL)
+    release_node(version->intern, root, NULL);
+  return derived;
+}
+
+/******************************************************************************
+ * FUNCTION:	    copy_path
+ *
+ * DESCRIPTION:	    Copies the nodes on `path' below `node', replacing the
+ *		    subtree at the end of it with `replacement'. Every node off
+ *		    the path is shared with the original.
+ *
+ * ARGUMENTS:	    intern: (struct bitree_intern *) -- the intern table, or
+ *			NULL.
+ *		    node: (struct bitree_pnode *) -- the node to start at.
+ *		    path: (const char *) -- a valid path below `node'.
+ *		    replacement: (struct bitree_pnode *) -- the new subtree,
+ *			or NULL. The copy takes over its reference.
+ *		    copy: (struct bitree_pnode **) -- set to the copy of
+ *			`node'.
+ *
+ * RETURN:	    int -- 0 on success, -1 if memory could not be allocated.
+ *		    On failure, `replacement' is released.
+ *
+ * NOTES:	    O(d), d is the length of `path'.
+ ***/
+static int copy_path(struct bitree_intern * intern,
+		     struct bitree_pnode * node, const char * path,
+		     struct bitree_pnode * replacement,
+		     struct bitree_pnode ** copy)
+{
+  if (path == NULL || *path == '\0') {
+    *copy = replacement;
+    return 0;
+  }
+
+  int right = *path == 'r';
+  struct bitree_pnode * child = NULL;
+  if (copy_path(intern, right ? node->right : node->left, path + 1,
+		replacement, &child))
+    return -1;
+
+  *copy = right
+    ? new_node(intern, node->payload, node->left, child)
+    : new_node(intern, node->payload, child, node->right);
+  release_node(intern, child, NULL);
+  return *copy == NULL ? -1 : 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    intern_subtree
+ *
+ * DESCRIPTION:	    Copies the subtree at `node' into the intern table.
+ *
+ * ARGUMENTS:	    intern: (struct bitree_intern *) -- the intern table.
+ *		    node: (struct bitree_pnode *) -- the subtree, or NULL.
+ *		    copy: (struct bitree_pnode **) -- set to the copy.
+ *
+ * RETURN:	    int -- 0 on success, -1 if memory could not be allocated.
+ *
+ * NOTES:	    O(n), n is the number of nodes in the subtree.
+ ***/
+static int intern_subtree(struct bitree_intern * intern,
+			  struct bitree_pnode * node,
+			  struct bitree_pnode ** copy)
+{
+  *copy = NULL;
+  if (node == NULL)
+    return 0;
+
+  struct bitree_pnode * left = NULL, * right = NULL;
+  if (intern_subtree(intern, node->left, &left))
+    return -1;
+  if (intern_subtree(intern, node->right, &right)) {
+    release_node(intern, left, NULL);
+    return -1;
+  }
+
+  *copy = new_node(intern, node->payload, left, right);
+  release_node(intern, left, NULL);
+  release_node(intern, right, NULL);
+  return *copy == NULL ? -1 : 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    new_version
+ *
+ * DESCRIPTION:	    Allocates a version handle.
+ *
+ * ARGUMENTS:	    intern: (struct bitree_intern *) -- the intern table, or
+ *			NULL.
+ *		    root: (struct bitree_pnode *) -- the root. The version takes
+ *			over the caller's reference to it.
+ *		    size: (int) -- the number of nodes.
+ *		    destroy: (void (*)(void *)) -- the destroy function.
+ *
+ * RETURN:	    bitree_version * -- the new version, or NULL.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static bitree_version * new_version(struct bitree_intern * intern,
+				    struct bitree_pnode * root, int size,
+				    void (*destroy)(void *))
+{
+  bitree_version * version = malloc(sizeof(bitree_version));
+  if (version == NULL)
+    return NULL;
+
+  atomic_init(&version->refs, 1);
+  version->root = root;
+  version->size = size;
+  version->destroy = destroy;
+  version->intern = intern;
+  if (intern != NULL)
+    atomic_fetch_add_explicit(&intern->refs, 1, memory_order_relaxed);
+  return version;
+}
+
+/******************************************************************************
+ * FUNCTION:	    new_node
+ *
+ * DESCRIPTION:	    Returns a node with the payload and children given, and
+ *		    takes a reference to each of them. In an interned version,
+ *		    an identical node is returned instead if there is one.
+ *
+ * ARGUMENTS:	    intern: (struct bitree_intern *) -- the intern table, or
+ *			NULL.
+ *		    payload: (struct bitree_payload *) -- the payload.
+ *		    left: (struct bitree_pnode *) -- the left child, or NULL.
+ *		    right: (struct bitree_pnode *) -- the right child, or NULL.
+ *
+ * RETURN:	    struct bitree_pnode * -- a new reference to the node, or
+ *		    NULL. On failure, no references are taken.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static struct bitree_pnode * new_node(struct bitree_intern * intern,
+				      struct bitree_payload * payload,
+				      struct bitree_pnode * left,
+				      struct bitree_pnode * right)
+{
+  size_t hash = 0;
+  if (intern != NULL) {
+    /* Children are interned too, so their addresses identify them */
+    hash = intern->hash(payload->data);
+    hash = (hash ^ ((uintptr_t)left >> 4)) * 0x9e3779b97f4a7c15ULL;
+    hash = (hash ^ ((uintptr_t)right >> 4)) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 32;
+
+    pthread_mutex_lock(&intern->lock);
+    struct bitree_pnode * node = intern_find(intern, hash, payload, left,
+					     right);
+    if (node != NULL) {
+      atomic_fetch_add_explicit(&node->refs, 1, memory_order_relaxed);
+      pthread_mutex_unlock(&intern->lock);
+      return node;
+    }
+  }
+
+  struct bitree_pnode * node = malloc(sizeof(struct bitree_pnode));
+  if (node == NULL) {
+    if (intern != NULL)
+      pthread_mutex_unlock(&intern->lock);
+    return NULL;
+  }
+
+  atomic_init(&node->refs, 1);
+  node->left = left;
+  node->right = right;
+  node->payload = payload;
+  node->count = 1 + pnode_count(left) + pnode_count(right);
+  node->hash = hash;
+  node->next = NULL;
+
+  atomic_fetch_add_explicit(&payload->refs, 1, memory_order_relaxed);
+  if (left != NULL)
+    atomic_fetch_add_explicit(&left->refs, 1, memory_order_relaxed);
+  if (right != NULL)
+    atomic_fetch_add_explicit(&right->refs, 1, memory_order_relaxed);
+
+  if (intern != NULL) {
+    intern_add(intern, node);
+    pthread_mutex_unlock(&intern->lock);
+  }
+  return node;
+}
+
+/******************************************************************************
+ * FUNCTION:	    new_payload
+ *
+ * DESCRIPTION:	    Allocates a payload, with one reference, for the caller.
+ *
+ * ARGUMENTS:	    data: (void *) -- the data.
+ *
+ * RETURN:	    struct bitree_payload * -- the new payload, or NULL.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static struct bitree_payload * new_payload(void * data)
+{
+  struct bitree_payload * payload = malloc(sizeof(struct bitree_payload));
+  if (payload == NULL)
+    return NULL;
+
+  atomic_init(&payload->refs, 1);
+  payload->data = data;
+  return payload;
+}
+
+/******************************************************************************
+ * FUNCTION:	    release_node
+ *
+ * DESCRIPTION:	    Drops a reference to `node'. If it was the last, the node is
+ *		    freed, along with everything only it referred to.
+ *
+ * ARGUMENTS:	    intern: (struct bitree_intern *) -- the intern table, or
+ *			NULL.
+ *		    node: (struct bitree_pnode *) -- the node, or NULL.
+ *		    destroy: (void (*)(void *)) -- the destroy function.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(m), m is the number of nodes freed.
+ ***/
+static void release_node(struct bitree_intern * intern,
+			 struct bitree_pnode * node, void (*destroy)(void *))
+{
+  while (node != NULL
+	 && (intern != NULL ? intern_unref(intern, node)
+	     : atomic_fetch_sub_explicit(&node->refs, 1,
+					 memory_order_acq_rel) == 1)) {
+    release_payload(node->payload, destroy);
+
+    /* Recurse on one side only, and loop on the other */
+    struct bitree_pnode * right = node->right;
+    release_node(intern, node->left, destroy);
+    free(node);
+    node = right;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    release_payload
+ *
+ * DESCRIPTION:	    Drops a reference to `payload', and frees it if it was the
+ *		    last.
+ *
+ * ARGUMENTS:	    payload: (struct bitree_payload *) -- the payload.
+ *		    destroy: (void (*)(void *)) -- the destroy function.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void release_payload(struct bitree_payload * payload,
+			    void (*destroy)(void *))
+{
+  if (atomic_fetch_sub_explicit(&payload->refs, 1,
+				memory_order_acq_rel) == 1) {
+    if (destroy != NULL)
+      destroy(payload->data);
+    free(payload);
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    new_intern
+ *
+ * DESCRIPTION:	    Allocates an empty intern table, with one reference, for
+ *		    the caller.
+ *
+ * ARGUMENTS:	    hash: (size_t (*)(const void *)) -- hash of a payload.
+ *		    equal: (int (*)(const void *, const void *)) -- payload
+ *			equality.
+ *
+ * RETURN:	    struct bitree_intern * -- the table, or NULL.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static struct bitree_intern * new_intern(size_t (*hash)(const void *),
+					 int (*equal)(const void *,
+						      const void *))
+{
+  struct bitree_intern * intern = malloc(sizeof(struct bitree_intern));
+  if (intern == NULL)
+    return NULL;
+
+  intern->buckets = calloc(INTERN_BUCKETS, sizeof(struct bitree_pnode *));
+  if (intern->buckets == NULL || pthread_mutex_init(&intern->lock, NULL)) {
+    free(intern->buckets);
+    free(intern);
+    return NULL;
+  }
+
+  atomic_init(&intern->refs, 1);
+  intern->hash = hash;
+  intern->equal = equal;
+  intern->nbuckets = INTERN_BUCKETS;
+  intern->nodes = 0;
+  return intern;
+}
+
+/******************************************************************************
+ * FUNCTION:	    release_intern
+ *
+ * DESCRIPTION:	    Drops a reference to `intern', and frees it if it was the
+ *		    last. By then, every node in it has been freed.
+ *
+ * ARGUMENTS:	    intern: (struct bitree_intern *) -- the table, or NULL.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Theta(1)
+ ***/
+static void release_intern(struct bitree_intern * intern)
+{
+  if (intern != NULL
+      && atomic_fetch_sub_explicit(&intern->refs, 1,
+				   memory_order_acq_rel) == 1) {
+    pthread_mutex_destroy(&intern->lock);
+    free(intern->buckets);
+    free(intern);
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    intern_find
+ *
+ * DESCRIPTION:	    Looks for a node identical to the one described.
+ *
+ * ARGUMENTS:	    intern: (struct bitree_intern *) -- the locked table.
+ *		    hash: (size_t) -- the hash of the node.
+ *		    payload: (struct bitree_payload *) -- its payload.
+ *		    left: (struct bitree_pnode *) -- its left child.
+ *		    right: (struct bitree_pnode *) -- its right child.
+ *
+ * RETURN:	    struct bitree_pnode * -- the node, or NULL.
+ *
+ * NOTES:	    O(1) expected.
+ ***/
+static struct bitree_pnode * intern_find(struct bitree_intern * intern,
+					 size_t hash,
+					 struct bitree_payload * payload,
+					 struct bitree_pnode * left,
+					 struct bitree_pnode * right)
+{
+  struct bitree_pnode * node = intern->buckets[hash & (intern->nbuckets - 1)];
+  for (; node != NULL; node = node->next) {
+    if (node->hash == hash && node->left == left && node->right == right
+	&& (node->payload == payload
+	    || intern->equal(node->payload->data, payload->data)))
+      return node;
+  }
+  return NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    intern_add
+ *
+ * DESCRIPTION:	    Adds `node' to the table, doubling the number of buckets
+ *		    when the table is full.
+ *
+ * ARGUMENTS:	    intern: (struct bitree_intern *) -- the locked table.
+ *		    node: (struct bitree_pnode *) -- the new node.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    O(1) amortized.
+ ***/
+static void intern_add(struct bitree_intern * intern,
+		       struct bitree_pnode * node)
+{
+  if (intern->nodes >= intern->nbuckets) {
+    size_t nbuckets = intern->nbuckets * 2;
+    struct bitree_pnode ** buckets = calloc(nbuckets,
+					    sizeof(struct bitree_pnode *));
+    /* If there's no memory, the chains just get longer */
+    if (buckets != NULL) {
+      for (size_t i = 0; i < intern->nbuckets; i++) {
+	struct bitree_pnode * next = NULL;
+	for (struct bitree_pnode * old = intern->buckets[i]; old != NULL;
+	     old = next) {
+	  next = old->next;
+	  old->next = buckets[old->hash & (nbuckets - 1)];
+	  buckets[old->hash & (nbuckets - 1)] = old;
+	}
+      }
+      free(intern->buckets);
+      intern->buckets = buckets;
+      intern->nbuckets = nbuckets;
+    }
+  }
+
+  struct bitree_pnode ** bucket =
+    &intern->buckets[node->hash & (intern->nbuckets - 1)];
+  node->next = *bucket;
+  *bucket = node;
+  intern->nodes++;
+}
+
+/******************************************************************************
+ * FUNCTION:	    intern_unref
+ *
+ * DESCRIPTION:	    Drops a reference to an interned node, and removes it from
+ *		    the table if it was the last.
+ *
+ * ARGUMENTS:	    intern: (struct bitree_intern *) -- the table.
+ *		    node: (struct bitree_pnode *) -- the node.
+ *
+ * RETURN:	    int -- 1 if the node must now be freed, 0 otherwise.
+ *
+ * NOTES:	    O(1) expected.
+ ***/
+static int intern_unref(struct bitree_intern * intern,
+			struct bitree_pnode * node)
+{
+  pthread_mutex_lock(&intern->lock);
+  int last = atomic_fetch_sub_explicit(&node->refs, 1,
+				       memory_order_acq_rel) == 1;
+  if (last) {
+    struct bitree_pnode ** link =
+      &intern->buckets[node->hash & (intern->nbuckets - 1)];
+    while (*link != node)
+      link = &(*link)->next;
+    *link = node->next;
+    intern->nodes--;
+  }
+  pthread_mutex_unlock(&intern->lock);
+  return last;
+}
+
+/*****************************************************************************/
@@ -0,0 +1,336 @@
+/******************************************************************************
+ * NAME:	    bitree_walk.c
+ *
+ * AUTHOR:	    Ethan D. Twardy
+ *
+ * DESCRIPTION:	    This file contains the walker shared by the paged, succinct
+ *		    and shared memory trees. Their nodes are named by 64-bit
+ *		    references rather than pointers, so the walker reaches the
+ *		    children and the parent of a node through the functions of
+ *		    a struct bitree_walker. The depth-first orders follow the
+ *		    parent links, and need no memory besides; level order
+ *		    keeps a queue.
+ *
+ * CREATED:	    10/18/2026
+ *
+ * LAST EDITED:	    10/18/2026
+ ***/
+
+/******************************************************************************
+ * INCLUDES
+ ***/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitree_internal.h"
+
+/******************************************************************************
+ * MACRO DEFINITIONS
+ ***/
+
+/* Whether the writer has changed the tree since the walk started */
+#define stale(walker, walk)					\
+  ((walker)->stale != NULL && (walker)->stale(walk))
+
+/******************************************************************************
+ * STATIC FUNCTION PROTOTYPES
+ ***/
+
+static uint64_t preorder_next(const struct bitree_walker * walker, void * walk,
+			      uint64_t node, uint64_t top, int descend);
+static uint64_t inorder_first(const struct bitree_walker * walker, void * walk,
+			      uint64_t node);
+static uint64_t inorder_next(const struct bitree_walker * walker, void * walk,
+			     uint64_t node, uint64_t top, int descend);
+static uint64_t postorder_first(const struct bitree_walker * walker,
+				void * walk, uint64_t node);
+static uint64_t postorder_next(const struct bitree_walker * walker,
+			       void * walk, uint64_t node, uint64_t top);
+static int walk_levelorder(const struct bitree_walker * walker, void * walk,
+			   uint64_t top);
+
+/******************************************************************************
+ * INTERNAL FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    bitree_walk_refs
+ *
+ * DESCRIPTION:	    Visits the subtree rooted at `top' in the order given,
+ *		    until the visitor asks it to stop.
+ *
+ * ARGUMENTS:	    walker: (const struct bitree_walker *) -- how to move
+ *			around the tree, and the visitor.
+ *		    walk: (void *) -- passed to the functions of `walker'.
+ *		    top: (uint64_t) -- root of the subtree, not 0.
+ *		    order: (enum bitree_order) -- the order.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 if it finished, -1 on
+ *		    error.
+ *
+ * NOTES:	    O(n), n is the size of the subtree. O(1) extra memory,
+ *		    except in level order.
+ ***/
+int bitree_walk_refs(const struct bitree_walker * walker, void * walk,
+		     uint64_t top, enum bitree_order order)
+{
+  uint64_t node = top;
+  enum bitree_visit next = BITREE_CONTINUE;
+  int result = 0;
+  switch (order) {
+  case BITREE_PREORDER:
+    for (; node != 0 && !stale(walker, walk);
+	 node = preorder_next(walker, walk, node, top,
+			      next == BITREE_CONTINUE))
+      if ((next = walker->visit(walk, node)) == BITREE_STOP)
+	break;
+    break;
+  case BITREE_INORDER:
+    for (node = inorder_first(walker, walk, node);
+	 node != 0 && !stale(walker, walk);
+	 node = inorder_next(walker, walk, node, top,
+			     next == BITREE_CONTINUE))
+      if ((next = walker->visit(walk, node)) == BITREE_STOP)
+	break;
+    break;
+  case BITREE_POSTORDER:
+    for (node = postorder_first(walker, walk, node);
+	 node != 0 && !stale(walker, walk);
+	 node = postorder_next(walker, walk, node, top))
+      if ((next = walker->visit(walk, node)) == BITREE_STOP)
+	break;
+    break;
+  case BITREE_LEVELORDER:
+    if ((result = walk_levelorder(walker, walk, top)) == 1)
+      next = BITREE_STOP;
+    break;
+  default:
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* Whatever the visitor saw is only good if the tree did not change under
+   * it for the whole walk.
+   */
+  if (stale(walker, walk)) {
+    errno = EAGAIN;
+    return -1;
+  }
+  return result < 0 ? -1 : next == BITREE_STOP;
+}
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ ***/
+
+/******************************************************************************
+ * FUNCTION:	    preorder_next
+ *
+ * DESCRIPTION:	    Returns the node after `node' in a preorder traversal of
+ *		    the subtree rooted at `top'.
+ *
+ * ARGUMENTS:	    walker: (const struct bitree_walker *) -- the walker.
+ *		    walk: (void *) -- passed to its functions.
+ *		    node: (uint64_t) -- the current node.
+ *		    top: (uint64_t) -- root of the subtree.
+ *		    descend: (int) -- zero to skip the children of `node'.
+ *
+ * RETURN:	    uint64_t -- the next node, or 0 after the last one.
+ *
+ * NOTES:	    Amortized Theta(1) over a traversal.
+ ***/
+static uint64_t preorder_next(const struct bitree_walker * walker, void * walk,
+			      uint64_t node, uint64_t top, int descend)
+{
+  uint64_t child = 0;
+  if (descend && ((child = walker->left(walk, node)) != 0
+		  || (child = walker->right(walk, node)) != 0))
+    return child;
+
+  while (node != top && node != 0 && !stale(walker, walk)) {
+    uint64_t parent = walker->parent(walk, node);
+    uint64_t right = walker->right(walk, parent);
+    if (right != 0 && right != node)
+      return right;
+    node = parent;
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    inorder_first
+ *
+ * DESCRIPTION:	    Returns the first node of the subtree at `node' in inorder.
+ *
+ * ARGUMENTS:	    walker: (const struct bitree_walker *) -- the walker.
+ *		    walk: (void *) -- passed to its functions.
+ *		    node: (uint64_t) -- root of the subtree.
+ *
+ * RETURN:	    uint64_t -- the leftmost node of the subtree.
+ *
+ * NOTES:	    O(h), h is the height of the subtree.
+ ***/
+static uint64_t inorder_first(const struct bitree_walker * walker, void * walk,
+			      uint64_t node)
+{
+  for (uint64_t left; !stale(walker, walk)
+	 && (left = walker->left(walk, node)) != 0; node = left);
+  return node;
+}
+
+/******************************************************************************
+ * FUNCTION:	    inorder_next
+ *
+ * DESCRIPTION:	    Returns the node after `node' in an inorder traversal of
+ *		    the subtree rooted at `top'.
+ *
+ * ARGUMENTS:	    walker: (const struct bitree_walker *) -- the walker.
+ *		    walk: (void *) -- passed to its functions.
+ *		    node: (uint64_t) -- the current node.
+ *		    top: (uint64_t) -- root of the subtree.
+ *		    descend: (int) -- zero to skip the right subtree of `node'.
+ *
+ * RETURN:	    uint64_t -- the next node, or 0 after the last one.
+ *
+ * NOTES:	    Amortized Theta(1) over a traversal.
+ ***/
+static uint64_t inorder_next(const struct bitree_walker * walker, void * walk,
+			     uint64_t node, uint64_t top, int descend)
+{
+  uint64_t right = 0;
+  if (descend && (right = walker->right(walk, node)) != 0)
+    return inorder_first(walker, walk, right);
+
+  while (node != top && node != 0 && !stale(walker, walk)) {
+    uint64_t parent = walker->parent(walk, node);
+    if (walker->right(walk, parent) != node)
+      return parent;
+    node = parent;
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    postorder_first
+ *
+ * DESCRIPTION:	    Returns the first node of the subtree at `node' in
+ *		    postorder.
+ *
+ * ARGUMENTS:	    walker: (const struct bitree_walker *) -- the walker.
+ *		    walk: (void *) -- passed to its functions.
+ *		    node: (uint64_t) -- root of the subtree.
+ *
+ * RETURN:	    uint64_t -- the first leaf reached by going left where
+ *		    possible, and right otherwise.
+ *
+ * NOTES:	    O(h), h is the height of the subtree.
+ ***/
+static uint64_t postorder_first(const struct bitree_walker * walker,
+				void * walk, uint64_t node)
+{
+  while (!stale(walker, walk)) {
+    uint64_t left = walker->left(walk, node);
+    uint64_t right = walker->right(walk, node);
+    if (left == 0 && right == 0)
+      break;
+    node = left != 0 ? left : right;
+  }
+  return node;
+}
+
+/******************************************************************************
+ * FUNCTION:	    postorder_next
+ *
+ * DESCRIPTION:	    Returns the node after `node' in a postorder traversal of
+ *		    the subtree rooted at `top'.
+ *
+ * ARGUMENTS:	    walker: (const struct bitree_walker *) -- the walker.
+ *		    walk: (void *) -- passed to its functions.
+ *		    node: (uint64_t) -- the current node.
+ *		    top: (uint64_t) -- root of the subtree.
+ *
+ * RETURN:	    uint64_t -- the next node, or 0 after the last one.
+ *
+ * NOTES:	    Amortized Theta(1) over a traversal.
+ ***/
+static uint64_t postorder_next(const struct bitree_walker * walker,
+			       void * walk, uint64_t node, uint64_t top)
+{
+  if (node == top)
+    return 0;
+
+  uint64_t parent = walker->parent(walk, node);
+  uint64_t right = walker->right(walk, parent);
+  if (walker->left(walk, parent) == node && right != 0)
+    return postorder_first(walker, walk, right);
+  return parent;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_levelorder
+ *
+ * DESCRIPTION:	    Does the work of bitree_walk_refs() in level order, with a
+ *		    queue that grows as needed.
+ *
+ * ARGUMENTS:	    walker: (const struct bitree_walker *) -- the walker.
+ *		    walk: (void *) -- passed to its functions.
+ *		    top: (uint64_t) -- root of the subtree.
+ *
+ * RETURN:	    int -- 1 if the walk was stopped, 0 if it finished, -1 if
+ *		    memory could not be allocated.
+ *
+ * NOTES:	    O(n), n is the size of the subtree.
+ ***/
+static int walk_levelorder(const struct bitree_walker * walker, void * walk,
+			   uint64_t top)
+{
+  size_t capacity = 64, head = 0, tail = 0;
+  uint64_t * queue = malloc(capacity * sizeof(uint64_t));
+  if (queue == NULL)
+    return -1;
+
+  int result = 0;
+  queue[tail++] = top;
+  while (head < tail && !stale(walker, walk)) {
+    uint64_t node = queue[head++];
+    enum bitree_visit next = walker->visit(walk, node);
+    if (next == BITREE_STOP) {
+      result = 1;
+      break;
+    } else if (next == BITREE_SKIP_CHILDREN) {
+      continue;
+    }
+
+    /* Make room for two more, moving the live part to the front first */
+    if (tail + 2 > capacity) {
+      if (head > 0) {
+	memmove(queue, queue + head, (tail - head) * sizeof(uint64_t));
+	tail -= head;
+	head = 0;
+      }
+      if (tail + 2 > capacity) {
+	uint64_t * grown = realloc(queue, 2 * capacity * sizeof(uint64_t));
+	if (grown == NULL) {
+	  result = -1;
+	  break;
+	}
+	queue = grown;
+	capacity *= 2;
+      }
+    }
+
+    uint64_t left = walker->left(walk, node);
+    uint64_t right = walker->right(walk, node);
+    if (left != 0)
+      queue[tail++] = left;
+    if (right != 0)
+      queue[tail++] = right;
+  }
+
+  free(queue);
+  return result;
+}
+
+/*****************************************************************************/
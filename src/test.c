@@ -7,18 +7,34 @@
  *
  * CREATED:	    11/25/2017
  *
- * LAST EDITED:	    01/02/2018
+ * LAST EDITED:	    10/18/2026
  ***/
 
 /******************************************************************************
  * INCLUDES
  ***/
 
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "bitree.h"
+#include "bitree_avl.h"
+#include "bitree_bfs.h"
+#include "bitree_io.h"
+#include "bitree_paged.h"
+#include "bitree_reduce.h"
+#include "bitree_shm.h"
+#include "bitree_splay.h"
+#include "bitree_succinct.h"
+#include "bitree_version.h"
 
 /******************************************************************************
  * MACRO DEFINITIONS
@@ -42,6 +58,52 @@ DEFINE_POSTORDER_TRAVERSAL(postorder_test, {*(int *)(node->data) += 1;});
 DEFINE_INORDER_TRAVERSAL(inorder_test, {*(int *)(node->data) += 1;});
 DEFINE_LEVELORDER_TRAVERSAL(levelorder_test, {*(int *)(node->data) += 1;});
 
+/* These record the order in which the macros visit the nodes of a tree, to
+ * check other functions against.
+ */
+static bitree * recorded[1024];
+static int recorded_size;
+DEFINE_PREORDER_TRAVERSAL(preorder_record, {recorded[recorded_size++] = node;});
+DEFINE_POSTORDER_TRAVERSAL(postorder_record,
+			   {recorded[recorded_size++] = node;});
+DEFINE_INORDER_TRAVERSAL(inorder_record, {recorded[recorded_size++] = node;});
+DEFINE_LEVELORDER_TRAVERSAL(levelorder_record,
+			    {recorded[recorded_size++] = node;});
+
+/* These record the nodes visited by bitree_walk() and the walk macro. The
+ * walk skips the children of the node passed as `ctx'.
+ */
+static bitree * walked[1024];
+static int walked_size;
+/* The payloads visited by bitree_shm_walk(), bitree_paged_walk() and
+ * bitree_succinct_walk()
+ */
+static int walked_data[1024];
+static int walked_data_size;
+/* The nodes visited by each walk of bitree_walk_many(), which skip the
+ * children of `many_skip' and stop at `many_stop'
+ */
+static bitree * many_walked[8][256];
+static int many_walked_size[8];
+static bitree * many_skip;
+static bitree * many_stop;
+/* The depth of each payload and the number of times it was visited, seen by
+ * bfs_record(), and the nodes of each level passed to bfs_level(), which
+ * stops the traversal after level `bfs_stop'.
+ */
+static int bfs_depths[8191];
+static int bfs_visits[8191];
+static bitree * bfs_nodes[8191];
+static int bfs_nodes_size;
+static int bfs_levels;
+static int bfs_stop;
+
+DEFINE_PREORDER_WALK(preorder_walk, {
+    walked[walked_size++] = node;
+    if (node == ctx)
+      visit = BITREE_SKIP_CHILDREN;
+  });
+
 /******************************************************************************
  * STATIC FUNCTION PROTOTYPES
  ***/
@@ -50,18 +112,152 @@ static int test_create(void);
 static int test_destroy(void);
 static int test_insl(void);
 static int test_insr(void);
+static int test_ins_batch(void);
 static int test_rem(void);
+static int test_retain(void);
 static int test_merge(void);
+static int test_clone(void);
+static int test_map(void);
 static int test_npreorder(void);
 static int test_npostorder(void);
 static int test_ninorder(void);
 static int test_nlevelorder(void);
+static int test_walk(void);
+static int test_find_if(void);
+static int test_cursor(void);
+static int test_next_batch(void);
+static int test_walk_many(void);
+static int test_descend_many(void);
 static int test_height(void);
 static int test_distance(void);
+static int test_rotl(void);
+static int test_rotr(void);
+static int test_avl_insert(void);
+static int test_avl_find(void);
+static int test_avl_erase(void);
+static int test_splay_insert(void);
+static int test_splay_find(void);
+static int test_splay_erase(void);
+static int test_version_insl(void);
+static int test_version_insr(void);
+static int test_version_rem(void);
+static int test_version_merge(void);
+static int test_version_release(void);
+static int test_version_intern(void);
+static int test_shm_store(void);
+static int test_shm_insl(void);
+static int test_paged_insl(void);
+static int test_paged_store(void);
+static int test_freeze_succinct(void);
+static int test_succinct_walk(void);
+static int test_save(void);
+static int test_load(void);
+static int test_flatten(void);
+static int test_reduce(void);
+static int test_bfs(void);
+#ifdef CONFIG_ORDER_STATISTICS
+static int test_select(void);
+static int test_rank(void);
+static int test_sample(void);
+static int test_rem_async(void);
+static int test_rem_step(void);
+#endif
+#ifdef CONFIG_SUBTREE_AGGREGATE
+static int test_set_aggregate(void);
+static int test_update(void);
+#endif
+#ifdef CONFIG_DESTROY_BATCH
+static int test_set_destroy_batch(void);
+#endif
+#ifdef CONFIG_MERKLE_HASH
+static int test_equal(void);
+static int test_diff(void);
+#endif
+#ifdef CONFIG_JOURNAL
+static int test_journal_attach(void);
+static int test_journal_replay(void);
+#endif
 
 static void print_tree(bitree * bitree, size_t null);
 static void print_data(bitree * bitree);
 static bitree * prep_tree(void);
+static bitree * prep_complete(int size, void (*destroy)(void *));
+static int check_copy(bitree * tree, bitree * copy, int scale);
+static void * copy_int(const void * data);
+static void * double_int(const void * data);
+static void inorder_data(bitree * tree, void ** data);
+static bitree * prep_avl(int size);
+static bitree * prep_splay(int size);
+static int check_avl(bitree * tree);
+static int check_order(bitree * tree);
+#ifdef CONFIG_ORDER_STATISTICS
+static int check_counts(bitree * tree);
+#endif
+#ifdef CONFIG_SUBTREE_AGGREGATE
+static int check_summaries(bitree * tree);
+static double add(double one, double two);
+static double max(double one, double two);
+#endif
+static int compare_int(const void * one, const void * two);
+static bitree_version * prep_version(void);
+static int * new_int(int value);
+static void count_free(void * data);
+static size_t hash_int(const void * data);
+#ifdef CONFIG_DESTROY_BATCH
+static void batch_free(void ** data, size_t n);
+#endif
+static int equal_int(const void * one, const void * two);
+static enum bitree_visit walk_record(bitree * node, void * skip);
+static enum bitree_visit walk_stop(bitree * node, void * stop);
+static enum bitree_visit many_record(bitree * node, void * walk);
+static int steer_int(const void * data, void * key);
+static int steer_left(const void * data, void * ctx);
+static int is_int(const void * data, void * value);
+static int is_not_int(const void * data, void * value);
+static int is_below(const void * data, void * limit);
+static size_t serialize_int(const void * data, void * buffer, size_t size);
+static enum bitree_visit shm_record(bitree_shm * shm, bitree_shm_ref node,
+				    void * ctx);
+static enum bitree_visit shm_change(bitree_shm * shm, bitree_shm_ref node,
+				    void * ctx);
+static enum bitree_visit paged_record(bitree_paged * tree, bitree_pref node,
+				      void * ctx);
+static enum bitree_visit succinct_record(const bitree_succinct * tree,
+					 bitree_sref node, void * skip);
+static void * deserialize_int(const void * buffer, size_t size);
+static void * deserialize_small(const void * buffer, size_t size);
+static double int_value(const void * data);
+static void bfs_record(bitree * node, int depth, void * ctx);
+static int bfs_level(int depth, bitree ** nodes, size_t size, void * ctx);
+#ifdef CONFIG_MERKLE_HASH
+static size_t count_hash(const void * data);
+static void diff_record(bitree * one, bitree * two, void * ctx);
+#endif
+#ifdef CONFIG_JOURNAL
+static int fail_write(void * sink, const void * record, size_t size);
+static int check_replica(bitree * tree, bitree * replica);
+#endif
+
+/******************************************************************************
+ * STATIC VARIABLES
+ ***/
+
+/* The number of payloads freed by count_free() and batch_free(), and the
+ * number of calls to batch_free()
+ */
+static int freed;
+#ifdef CONFIG_DESTROY_BATCH
+static int batches;
+#endif
+
+#ifdef CONFIG_MERKLE_HASH
+/* The number of payloads hashed by count_hash(), and the differences
+ * reported to diff_record()
+ */
+static int hashed;
+static bitree * diffs[2][16];
+static int diffs_size;
+#endif
 
 /******************************************************************************
  * MAIN
@@ -77,27 +273,146 @@ int main(int argc, char * argv[])
 	  "Test (bitree_destroy):\t\t%s\n"
 	  "Test (bitree_insl):\t\t%s\n"
 	  "Test (bitree_insr):\t\t%s\n"
+	  "Test (bitree_ins_batch):\t%s\n"
 	  "Test (btiree_rem):\t\t%s\n"
+	  "Test (bitree_retain):\t\t%s\n"
 	  "Test (bitree_merge):\t\t%s\n"
+	  "Test (bitree_clone):\t\t%s\n"
+	  "Test (bitree_map):\t\t%s\n"
 	  "Test (bitree_npreorder):\t%s\n"
 	  "Test (bitree_npostorder):\t%s\n"
 	  "Test (bitree_ninorder):\t\t%s\n"
 	  "Test (bitree_nlevelorder):\t%s\n"
+	  "Test (bitree_walk):\t\t%s\n"
+	  "Test (bitree_find_if):\t\t%s\n"
+	  "Test (bitree_cursor_next):\t%s\n"
+	  "Test (bitree_next_batch):\t%s\n"
+	  "Test (bitree_walk_many):\t%s\n"
+	  "Test (bitree_descend_many):\t%s\n"
 	  "Test (bitree_height):\t\t%s\n"
-	  "Test (bitree_distance):\t\t%s\n",
+	  "Test (bitree_distance):\t\t%s\n"
+	  "Test (bitree_rotl):\t\t%s\n"
+	  "Test (bitree_rotr):\t\t%s\n"
+	  "Test (bitree_avl_insert):\t%s\n"
+	  "Test (bitree_avl_find):\t\t%s\n"
+	  "Test (bitree_avl_erase):\t%s\n"
+	  "Test (bitree_splay_insert):\t%s\n"
+	  "Test (bitree_splay_find):\t%s\n"
+	  "Test (bitree_splay_erase):\t%s\n"
+	  "Test (bitree_version_insl):\t%s\n"
+	  "Test (bitree_version_insr):\t%s\n"
+	  "Test (bitree_version_rem):\t%s\n"
+	  "Test (bitree_version_merge):\t%s\n"
+	  "Test (bitree_version_release):\t%s\n"
+	  "Test (bitree_version_intern):\t%s\n"
+	  "Test (bitree_shm_store):\t%s\n"
+	  "Test (bitree_shm_insl):\t\t%s\n"
+	  "Test (bitree_paged_insl):\t%s\n"
+	  "Test (bitree_paged_store):\t%s\n"
+	  "Test (bitree_freeze_succinct):\t%s\n"
+	  "Test (bitree_succinct_walk):\t%s\n"
+	  "Test (bitree_save):\t\t%s\n"
+	  "Test (bitree_load):\t\t%s\n"
+	  "Test (bitree_flatten):\t\t%s\n"
+	  "Test (bitree_reduce):\t\t%s\n"
+	  "Test (bitree_bfs):\t\t%s\n",
 
 	  test_create()	    	? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_destroy()	? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_insl()		? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_insr()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_ins_batch()	? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_rem()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_retain()		? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_merge()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_clone()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_map()		? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_npreorder()	? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_npostorder()	? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_ninorder()	? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_nlevelorder()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_walk()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_find_if()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_cursor()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_next_batch()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_walk_many()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_descend_many()	? FAIL"Fail"NC : PASS"Pass"NC,
 	  test_height()		? FAIL"Fail"NC : PASS"Pass"NC,
-	  test_distance()	? FAIL"Fail"NC : PASS"Pass"NC);
+	  test_distance()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_rotl()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_rotr()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_avl_insert()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_avl_find()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_avl_erase()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_splay_insert()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_splay_find()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_splay_erase()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_version_insl()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_version_insr()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_version_rem()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_version_merge()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_version_release() ? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_version_intern()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_shm_store()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_shm_insl()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_paged_insl()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_paged_store()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_freeze_succinct() ? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_succinct_walk()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_save()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_load()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_flatten()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_reduce()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_bfs()		? FAIL"Fail"NC : PASS"Pass"NC);
+
+#ifdef CONFIG_ORDER_STATISTICS
+  fprintf(stderr,
+	  "Test (bitree_select):\t\t%s\n"
+	  "Test (bitree_rank):\t\t%s\n"
+	  "Test (bitree_sample):\t\t%s\n"
+	  "Test (bitree_rem_async):\t%s\n"
+	  "Test (bitree_rem_step):\t\t%s\n",
+
+	  test_select()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_rank()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_sample()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_rem_async()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_rem_step()	? FAIL"Fail"NC : PASS"Pass"NC);
+#endif /* CONFIG_ORDER_STATISTICS */
+
+#ifdef CONFIG_SUBTREE_AGGREGATE
+  fprintf(stderr,
+	  "Test (bitree_set_aggregate):\t%s\n"
+	  "Test (bitree_update):\t\t%s\n",
+
+	  test_set_aggregate()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_update()		? FAIL"Fail"NC : PASS"Pass"NC);
+#endif /* CONFIG_SUBTREE_AGGREGATE */
+
+#ifdef CONFIG_DESTROY_BATCH
+  fprintf(stderr,
+	  "Test (bitree_set_destroy_batch):%s\n",
+
+	  test_set_destroy_batch() ? FAIL"Fail"NC : PASS"Pass"NC);
+#endif /* CONFIG_DESTROY_BATCH */
+
+#ifdef CONFIG_MERKLE_HASH
+  fprintf(stderr,
+	  "Test (bitree_equal):\t\t%s\n"
+	  "Test (bitree_diff):\t\t%s\n",
+
+	  test_equal()		? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_diff()		? FAIL"Fail"NC : PASS"Pass"NC);
+#endif /* CONFIG_MERKLE_HASH */
+
+#ifdef CONFIG_JOURNAL
+  fprintf(stderr,
+	  "Test (bitree_journal_attach):\t%s\n"
+	  "Test (bitree_journal_replay):\t%s\n",
+
+	  test_journal_attach()	? FAIL"Fail"NC : PASS"Pass"NC,
+	  test_journal_replay()	? FAIL"Fail"NC : PASS"Pass"NC);
+#endif /* CONFIG_JOURNAL */
 
 #ifdef CONFIG_EXTENDED_TRAVERSAL_TEST
 
@@ -410,6 +725,119 @@ static int test_insr()
   }
 }
 
+/******************************************************************************
+ * FUNCTION:	    test_ins_batch
+ *
+ * DESCRIPTION:	    Tests the bitree_ins_batch() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_ins_batch()
+{
+  /* Test cases:
+   *	NULL
+   *	Empty batch
+   *	Every insertion is valid
+   *	Insertion into a full node, with NULL data, into a node on another
+   *	tree, and twice into the same child: nothing is applied
+   *	Removal of some of the nodes in a block, then the rest
+   *	Insertions below deep leaves, whose ancestors outgrow the table of
+   *	nodes to refresh
+   */
+  int status[4];
+  int data[4] = {0};
+
+  if (!bitree_ins_batch(NULL, NULL, 0, NULL))
+    return 1;
+
+  bitree * test = prep_tree();
+  bitree * other = prep_tree();
+  if (test == NULL || other == NULL)
+    goto error_exit;
+  if (bitree_ins_batch(test, NULL, 0, NULL))
+    goto error_exit;
+
+  struct bitree_ins_op valid[] = {
+    { test->left->left, BITREE_LEFT, NULL },
+    { test->left->left, BITREE_RIGHT, NULL },
+    { test->left->right, BITREE_LEFT, NULL },
+    { test->right, BITREE_RIGHT, NULL }
+  };
+  for (int i = 0; i < 4; i++) {
+    if ((valid[i].data = malloc(sizeof(int))) == NULL)
+      goto error_exit;
+    *(int *)valid[i].data = i;
+  }
+  if (bitree_ins_batch(test, valid, 4, status) || bitree_size(test) != 9)
+    goto error_exit;
+  for (int i = 0; i < 4; i++)
+    if (status[i] != 0)
+      goto error_exit;
+  if (test->left->left->right->data != valid[1].data
+      || test->right->right->parent != test->right
+      || test->right->right->root != test)
+    goto error_exit;
+#ifdef CONFIG_ORDER_STATISTICS
+  if (check_counts(test))
+    goto error_exit;
+#endif
+
+  struct bitree_ins_op invalid[] = {
+    { test->left->right, BITREE_RIGHT, &data[0] },
+    { test->left, BITREE_LEFT, &data[1] },
+    { other, BITREE_LEFT, &data[2] },
+    { test->left->right, BITREE_RIGHT, &data[3] }
+  };
+  if (!bitree_ins_batch(test, invalid, 4, status) || bitree_size(test) != 9)
+    goto error_exit;
+  if (status[0] != 0 || status[1] != -1 || status[2] != -1 || status[3] != -1)
+    goto error_exit;
+  if (test->left->right->right != NULL)
+    goto error_exit;
+
+  invalid[0].data = NULL;
+  if (!bitree_ins_batch(test, invalid, 1, status) || status[0] != -1)
+    goto error_exit;
+
+  bitree_rem(test->left->left);
+  if (bitree_size(test) != 6)
+    goto error_exit;
+  bitree_destroy(&other);
+  bitree_destroy(&test);
+
+  if ((test = prep_complete(1000, free)) == NULL)
+    goto error_exit;
+  bitree * first = test, * last = test;
+  while (first->left != NULL)
+    first = first->left;
+  while (last->right != NULL)
+    last = last->right;
+  struct bitree_ins_op deep[] = {
+    { first, BITREE_LEFT, new_int(1000) },
+    { first, BITREE_RIGHT, new_int(1001) },
+    { last, BITREE_RIGHT, new_int(1002) },
+  };
+  if (bitree_ins_batch(test, deep, 3, NULL) || bitree_size(test) != 1003)
+    goto error_exit;
+#ifdef CONFIG_ORDER_STATISTICS
+  if (check_counts(test))
+    goto error_exit;
+#endif
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&other);
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
 /******************************************************************************
  * FUNCTION:	    test_rem
  *
@@ -467,6 +895,85 @@ static int test_rem()
   }
 }
 
+/******************************************************************************
+ * FUNCTION:	    test_retain
+ *
+ * DESCRIPTION:	    Tests the bitree_retain() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_retain()
+{
+  /* Test cases:
+   *	NULL
+   *	Removing many leaves and internal nodes
+   *	Removing one internal node, and its subtree
+   *	Removing a subtree which is not the whole tree
+   *	Removing the root
+   */
+  int value = 50;
+  bitree * test = NULL;
+  if (bitree_retain(NULL, is_below, &value) != -1
+      || bitree_retain(&test, is_below, &value) != -1)
+    return 1;
+
+  /* In a complete tree numbered in level order, the children of a node
+   * hold larger numbers than it does, so this keeps 0 to 49.
+   */
+  freed = 0;
+  if ((test = prep_complete(200, count_free)) == NULL
+      || bitree_retain(&test, NULL, &value) != -1
+      || bitree_retain(&test, is_below, &value) != 150
+      || test == NULL || bitree_size(test) != 50 || freed != 150)
+    goto error_exit;
+#ifdef CONFIG_ORDER_STATISTICS
+  if (check_counts(test))
+    goto error_exit;
+#endif
+
+  recorded_size = 0;
+  preorder_record(test->left);
+  int removed = recorded_size;
+  value = 1;
+  if (bitree_retain(&test, is_not_int, &value) != removed
+      || test->left != NULL || bitree_size(test) != 50 - removed
+      || freed != 150 + removed)
+    goto error_exit;
+#ifdef CONFIG_ORDER_STATISTICS
+  if (check_counts(test))
+    goto error_exit;
+#endif
+
+  bitree * sub = test->right;
+  recorded_size = 0;
+  preorder_record(sub);
+  removed = recorded_size;
+  value = 0;
+  if (bitree_retain(&sub, is_below, &value) != removed || sub != NULL
+      || test->right != NULL || bitree_size(test) != 1)
+    goto error_exit;
+#ifdef CONFIG_ORDER_STATISTICS
+  if (test->count != 1)
+    goto error_exit;
+#endif
+
+  freed = 0;
+  if (bitree_retain(&test, is_below, &value) != 1 || test != NULL
+      || freed != 1)
+    goto error_exit;
+
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
 /******************************************************************************
  * FUNCTION:	    test_merge
  *
@@ -596,6 +1103,110 @@ static int test_merge()
   return 0;
 }
 
+/******************************************************************************
+ * FUNCTION:	    test_clone
+ *
+ * DESCRIPTION:	    Tests the bitree_clone() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_clone()
+{
+  /* Test cases:
+   *	NULL
+   *	Shared payloads in a tree with a destroy function
+   *	Whole tree
+   *	Subtree
+   *	Tree larger than BITREE_CLONE_THRESHOLD
+   */
+  bitree * test = NULL, * copy = NULL;
+  if (bitree_clone(NULL, copy_int) != NULL)
+    return 1;
+
+  if ((test = prep_tree()) == NULL)
+    return 1;
+  if (bitree_clone(test, NULL) != NULL)
+    goto error_exit;
+
+  if ((copy = bitree_clone(test, copy_int)) == NULL
+      || bitree_size(copy) != 5 || check_copy(test, copy, 1))
+    goto error_exit;
+  bitree_destroy(&copy);
+
+  if ((copy = bitree_clone(test->left, copy_int)) == NULL
+      || bitree_size(copy) != 3 || check_copy(test->left, copy, 1))
+    goto error_exit;
+  bitree_rem(copy->right);
+  bitree_destroy(&copy);
+  bitree_destroy(&test);
+
+  if ((test = prep_complete(BITREE_CLONE_THRESHOLD * 2 + 1, free)) == NULL)
+    goto error_exit;
+  if ((copy = bitree_clone(test, copy_int)) == NULL
+      || bitree_size(copy) != bitree_size(test) || check_copy(test, copy, 1))
+    goto error_exit;
+
+  bitree_destroy(&copy);
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&copy);
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_map
+ *
+ * DESCRIPTION:	    Tests the bitree_map() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_map()
+{
+  /* Test cases:
+   *	NULL
+   *	Transformed payloads
+   *	The map function fails part of the way through
+   */
+  bitree * test = NULL, * copy = NULL;
+  if (bitree_map(NULL, double_int, free) != NULL)
+    return 1;
+
+  if ((test = prep_complete(100, free)) == NULL
+      || bitree_map(test, NULL, free) != NULL)
+    goto error_exit;
+
+  if ((copy = bitree_map(test, double_int, free)) == NULL
+      || check_copy(test, copy, 2))
+    goto error_exit;
+  bitree_destroy(&copy);
+
+  /* double_int() fails on negative payloads */
+  *(int *)test->right->left->data = -1;
+  if ((copy = bitree_map(test, double_int, free)) != NULL)
+    goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&copy);
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
 /******************************************************************************
  * FUNCTION:	    test_npreorder
  *
@@ -808,9 +1419,10 @@ static int test_nlevelorder()
 }
 
 /******************************************************************************
- * FUNCTION:	    test_height
+ * FUNCTION:	    test_walk
  *
- * DESCRIPTION:	    Test the bitree_height function.
+ * DESCRIPTION:	    Tests the bitree_walk() function and the
+ *		    DEFINE_PREORDER_WALK() macro.
  *
  * ARGUMENTS:	    none.
  *
@@ -818,41 +1430,90 @@ static int test_nlevelorder()
  *
  * NOTES:	    none.
  ***/
-static int test_height()
+static int test_walk()
 {
-  /* NULL input
-   * One node in tree
-   * Multiple nodes in tree
+  /* Test cases:
+   *	NULL, or a bad order
+   *	Every node, in each order, of the tree and of a subtree
+   *	BITREE_SKIP_CHILDREN, in preorder and level order
+   *	BITREE_STOP
+   *	The macro
    */
+  void (*record[])(bitree *) = {
+    preorder_record, inorder_record, postorder_record, levelorder_record
+  };
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER, BITREE_LEVELORDER
+  };
+
+  bitree * test = prep_splay(200);
+  if (test == NULL)
+    return 1;
+  if (bitree_walk(NULL, BITREE_PREORDER, walk_record, NULL) != -1
+      || bitree_walk(test, BITREE_PREORDER, NULL, NULL) != -1
+      || bitree_walk(test, (enum bitree_order)-1, walk_record, NULL) != -1)
+    goto error_exit;
 
-  int size = 0;
-  bitree * test = NULL;
+  bitree * sub = test->left != NULL ? test->left : test->right;
+  bitree * roots[] = { test, sub };
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 4; j++) {
+      recorded_size = walked_size = 0;
+      record[j](roots[i]);
+      if (bitree_walk(roots[i], orders[j], walk_record, NULL) != 0
+	  || walked_size != recorded_size)
+	goto error_exit;
+      for (int k = 0; k < walked_size; k++)
+	if (walked[k] != recorded[k])
+	  goto error_exit;
+    }
+  }
 
-  /* NULL input */
-  if (bitree_height(test))
-    return 1;
+  /* In preorder, the subtree at `sub' is the block after the root */
+  recorded_size = 0;
+  preorder_record(sub);
+  int skipped = recorded_size - 1;
+  recorded_size = walked_size = 0;
+  preorder_record(test);
+  if (bitree_walk(test, BITREE_PREORDER, walk_record, sub) != 0
+      || walked_size != recorded_size - skipped)
+    goto error_exit;
+  for (int k = 0; k < walked_size; k++)
+    if (walked[k] != recorded[k < 2 ? k : k + skipped])
+      goto error_exit;
 
-  /* One node in tree */
-  if ((test = bitree_create(NULL, (void *)&size)) == NULL)
-    return 1;
-  if (bitree_height(test) != 1)
-    return 1;
-  bitree_destroy(&test);
+  int total = walked_size;
+  walked_size = 0;
+  if (preorder_walk(test, sub) != 0 || walked_size != total)
+    goto error_exit;
+  for (int k = 0; k < walked_size; k++)
+    if (walked[k] != recorded[k < 2 ? k : k + skipped])
+      goto error_exit;
 
-  /* Multiple nodes in tree */
-  if ((test = prep_tree()) == NULL)
-    return 1;
-  if (bitree_height(test) != 3)
-    return 1;
+  walked_size = 0;
+  if (bitree_walk(test, BITREE_LEVELORDER, walk_record, test) != 0
+      || walked_size != 1)
+    goto error_exit;
+
+  recorded_size = walked_size = 0;
+  inorder_record(test);
+  if (bitree_walk(test, BITREE_INORDER, walk_stop, recorded[50]) != 1
+      || walked_size != 51 || walked[50] != recorded[50])
+    goto error_exit;
 
   bitree_destroy(&test);
   return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
 }
 
 /******************************************************************************
- * FUNCTION:	    test_distance
+ * FUNCTION:	    test_find_if
  *
- * DESCRIPTION:	    This function tests the bitree_distance() function.
+ * DESCRIPTION:	    Tests the bitree_find_if() function.
  *
  * ARGUMENTS:	    none.
  *
@@ -860,160 +1521,4120 @@ static int test_height()
  *
  * NOTES:	    none.
  ***/
-static int test_distance()
+static int test_find_if()
 {
-  /* NULL Input,
-   * Distance of 0,
-   * Distance of 1,
-   * Distance of >1
+  /* Test cases:
+   *	NULL
+   *	A payload in the tree, in each order
+   *	A payload not in the tree
+   *	A payload outside of the subtree searched
    */
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER, BITREE_LEVELORDER
+  };
+  int value = 42;
 
-  bitree * test = NULL;
-  int distance = 0;
-
-  /* NULL Input */
-  if (bitree_distance(test) != -1)
+  bitree * test = prep_splay(100);
+  if (test == NULL)
     return 1;
+  if (bitree_find_if(NULL, BITREE_PREORDER, is_int, &value) != NULL
+      || bitree_find_if(test, BITREE_PREORDER, NULL, &value) != NULL)
+    goto error_exit;
 
-  /* Distance of 0 */
-  if ((test = bitree_create(NULL, (void *)&distance)) == NULL)
-    return 1;
-  if (bitree_distance(test))
-    return 1;
-  bitree_destroy(&test);
+  for (int i = 0; i < 4; i++) {
+    bitree * found = bitree_find_if(test, orders[i], is_int, &value);
+    if (found == NULL || *(int *)found->data != 42)
+      goto error_exit;
+  }
 
-  /* Distance of 1 */
-  if ((test = prep_tree()) == NULL)
-    return 1;
-  if (bitree_distance(test->right) != 1)
+  value = 100;
+  if (bitree_find_if(test, BITREE_INORDER, is_int, &value) != NULL)
+    goto error_exit;
+
+  value = *(int *)test->data;
+  bitree * sub = test->left != NULL ? test->left : test->right;
+  if (bitree_find_if(test, BITREE_POSTORDER, is_int, &value) != test
+      || bitree_find_if(sub, BITREE_PREORDER, is_int, &value) != NULL)
+    goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
     return 1;
+  }
+}
 
-  /* Distance of >1 */
-  if (bitree_distance(test->left->right) != 2)
+/******************************************************************************
+ * FUNCTION:	    test_cursor
+ *
+ * DESCRIPTION:	    Tests the bitree_cursor_init() and bitree_cursor_next()
+ *		    functions.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_cursor()
+{
+  /* Test cases:
+   *	NULL, or level order
+   *	Every node, in each order, of the tree, of a subtree and of a leaf
+   *	Calling bitree_cursor_next() after the end
+   */
+  void (*record[])(bitree *) = {
+    preorder_record, inorder_record, postorder_record
+  };
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER
+  };
+  struct bitree_cursor cursor;
+
+  bitree * test = prep_splay(200);
+  if (test == NULL)
     return 1;
+  if (bitree_cursor_init(NULL, test, BITREE_INORDER) != -1
+      || bitree_cursor_init(&cursor, NULL, BITREE_INORDER) != -1
+      || bitree_cursor_init(&cursor, test, BITREE_LEVELORDER) != -1
+      || bitree_cursor_next(NULL) != NULL)
+    goto error_exit;
+
+  bitree * sub = test->left != NULL ? test->left : test->right;
+  bitree * leaf = sub;
+  while (!bitree_isleaf(leaf))
+    leaf = leaf->left != NULL ? leaf->left : leaf->right;
+  bitree * roots[] = { test, sub, leaf };
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      recorded_size = 0;
+      record[j](roots[i]);
+      if (bitree_cursor_init(&cursor, roots[i], orders[j]))
+	goto error_exit;
+      for (int k = 0; k < recorded_size; k++)
+	if (bitree_cursor_next(&cursor) != recorded[k])
+	  goto error_exit;
+      if (bitree_cursor_next(&cursor) != NULL
+	  || bitree_cursor_next(&cursor) != NULL)
+	goto error_exit;
+    }
+  }
 
   bitree_destroy(&test);
   return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
 }
 
 /******************************************************************************
- * FUNCTION:	    print_tree
+ * FUNCTION:	    test_next_batch
  *
- * DESCRIPTION:	    Prints a tree to STDOUT.
+ * DESCRIPTION:	    Tests the bitree_next_batch() function.
  *
- * ARGUMENTS:	    bitree: (bitree *) -- pointer to the tree to print.
- *		    null: (size_t) -- internal value. User should always pass
- *			0.
+ * ARGUMENTS:	    none.
  *
- * RETURN:	    void.
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
  *
  * NOTES:	    none.
  ***/
-void print_tree(bitree * bitree, size_t null)
+static int test_next_batch()
 {
-  if (bitree == NULL)
-    return;
-  printf("--->\n");
-  if (null != 0)
-    for (size_t i = 0; i < null; i++)
-      printf("\t");
-  printf("%s %p ",
-	 bitree->parent == NULL ? "|" :
-	 bitree->parent->left == bitree ? "L" : "R",
-	 bitree);
-  print_tree(bitree->left, ++null);
-  print_tree(bitree->right, null);
+  /* Test cases:
+   *	NULL cursor or array, and empty batches
+   *	Every node, in each order, of the tree and of a subtree, in batches of
+   *	    several sizes, including one larger than the tree
+   *	Calling bitree_next_batch() after the end
+   */
+  void (*record[])(bitree *) = {
+    preorder_record, inorder_record, postorder_record
+  };
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER
+  };
+  size_t sizes[] = { 1, 3, 64, 256 };
+  struct bitree_cursor cursor;
+  bitree * batch[256];
+
+  bitree * test = prep_splay(200);
+  if (test == NULL)
+    return 1;
+  bitree * first = test;
+  while (first->left != NULL)
+    first = first->left;
+  if (bitree_cursor_init(&cursor, test, BITREE_INORDER)
+      || bitree_next_batch(NULL, batch, 4) != 0
+      || bitree_next_batch(&cursor, NULL, 4) != 0
+      || bitree_next_batch(&cursor, batch, 0) != 0
+      || bitree_cursor_next(&cursor) != first)
+    goto error_exit;
+
+  bitree * sub = test->left != NULL ? test->left : test->right;
+  bitree * roots[] = { test, sub };
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 3; j++) {
+      recorded_size = 0;
+      record[j](roots[i]);
+      for (int k = 0; k < 4; k++) {
+	if (bitree_cursor_init(&cursor, roots[i], orders[j]))
+	  goto error_exit;
+	int seen = 0;
+	size_t count;
+	while ((count = bitree_next_batch(&cursor, batch, sizes[k])) > 0) {
+	  if (count != sizes[k] && seen + (int)count != recorded_size)
+	    goto error_exit;
+	  for (size_t l = 0; l < count; l++)
+	    if (seen >= recorded_size || batch[l] != recorded[seen++])
+	      goto error_exit;
+	}
+	if (seen != recorded_size
+	    || bitree_next_batch(&cursor, batch, sizes[k]) != 0
+	    || bitree_cursor_next(&cursor) != NULL)
+	  goto error_exit;
+      }
+    }
+  }
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
 }
 
 /******************************************************************************
- * FUNCTION:	    print_data
+ * FUNCTION:	    test_walk_many
  *
- * DESCRIPTION:	    This function prints all of the integer data in a tree to
- *		    STDOUT in the format of a C array.
+ * DESCRIPTION:	    Tests the bitree_walk_many() function.
  *
- * ARGUMENTS:	    bitree: (bitree *) -- the tree to print
+ * ARGUMENTS:	    none.
  *
- * RETURN:	    void.
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
  *
  * NOTES:	    none.
  ***/
-static void print_data(bitree * bitree)
+static int test_walk_many()
 {
-  if (bitree == NULL)
-    return;
-  if (bitree == bitree->root)
-    printf("{ %d", *(int *)bitree->data);
-  else
-    printf(", %d", *(int *)bitree->data);
+  /* Test cases:
+   *	NULL visitor, level order, and no walks
+   *	The tree, a subtree, an empty tree and a leaf, in each order, with
+   *	    several groups: each walk visits the nodes bitree_walk() does,
+   *	    skipping children and stopping alone
+   */
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER
+  };
+  size_t groups[] = { 1, 2, 3, 0, 100 };
+  int indices[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  void * ctxs[4] = { &indices[4], &indices[5], &indices[6], &indices[7] };
+
+  bitree * test = prep_splay(200);
+  if (test == NULL)
+    return 1;
+  if (bitree_walk_many(&test, 1, BITREE_INORDER, NULL, NULL, 0) != -1
+      || bitree_walk_many(&test, 1, BITREE_LEVELORDER, many_record, ctxs,
+			  0) != -1
+      || bitree_walk_many(NULL, 0, BITREE_INORDER, many_record, NULL, 0))
+    goto error_exit;
 
-  print_data(bitree->left);
-  print_data(bitree->right);
+  bitree * sub = test->left != NULL ? test->left : test->right;
+  bitree * leaf = sub;
+  while (!bitree_isleaf(leaf))
+    leaf = leaf->left != NULL ? leaf->left : leaf->right;
+  bitree * trees[] = { test, sub, NULL, leaf };
+  many_skip = sub;
+  many_stop = leaf;
+  for (int j = 0; j < 3; j++) {
+    for (int i = 0; i < 4; i++) {
+      many_walked_size[i] = 0;
+      if (trees[i] != NULL
+	  && bitree_walk(trees[i], orders[j], many_record, &indices[i]) < 0)
+	goto error_exit;
+    }
+    for (int k = 0; k < 5; k++) {
+      for (int i = 4; i < 8; i++)
+	many_walked_size[i] = 0;
+      if (bitree_walk_many(trees, 4, orders[j], many_record, ctxs,
+			   groups[k]))
+	goto error_exit;
+      for (int i = 0; i < 4; i++) {
+	if (many_walked_size[i + 4] != many_walked_size[i])
+	  goto error_exit;
+	for (int l = 0; l < many_walked_size[i]; l++)
+	  if (many_walked[i + 4][l] != many_walked[i][l])
+	    goto error_exit;
+      }
+    }
+  }
 
-  if (bitree == bitree->root)
-    printf(" };\n");
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
 }
 
 /******************************************************************************
- * FUNCTION:	    prep_tree
+ * FUNCTION:	    test_descend_many
  *
- * DESCRIPTION:	    This function prepares a bitree struct for testing. It's
- *		    purpose is to prevent code pasting.
+ * DESCRIPTION:	    Tests the bitree_descend_many() function.
  *
- * ARGUMENTS:	    
+ * ARGUMENTS:	    none.
  *
- * RETURN:	    
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
  *
- * NOTES:	    
+ * NOTES:	    none.
  ***/
-static bitree * prep_tree()
+static int test_descend_many()
 {
-  bitree * tree = NULL;
-  int * pTest = malloc(sizeof(int));
-  if (pTest == NULL)
-    return NULL;
-  *pTest = 1;
-  if ((tree = bitree_create(free, pTest)) == NULL)
+  /* Test cases:
+   *	NULL steer function or arrays, and no descents
+   *	Searches for keys present and absent, from the root, from a subtree
+   *	    and from NULL, with several groups
+   *	No contexts
+   */
+  size_t groups[] = { 1, 5, 0, 64 };
+  int keys[202];
+  void * ctxs[202];
+  bitree * starts[202];
+  bitree * found[202];
+
+  bitree * test = prep_splay(200);
+  if (test == NULL)
+    return 1;
+  if (bitree_descend_many(&test, 1, NULL, NULL, found, 0) != -1
+      || bitree_descend_many(&test, 1, steer_int, NULL, NULL, 0) != -1
+      || bitree_descend_many(NULL, 0, steer_int, NULL, NULL, 0))
     goto error_exit;
 
-  int test = 0;
-  while (1) {
-    if ((pTest = malloc(sizeof(int))) == NULL)
+  bitree * sub = test->left != NULL ? test->left : test->right;
+  for (int i = 0; i < 202; i++) {
+    keys[i] = i - 1;
+    ctxs[i] = &keys[i];
+    starts[i] = i % 7 == 0 ? NULL : i % 3 == 0 ? sub : test;
+  }
+
+  for (int k = 0; k < 4; k++) {
+    memset(found, 0xff, sizeof(found));
+    if (bitree_descend_many(starts, 202, steer_int, ctxs, found, groups[k]))
       goto error_exit;
-    *pTest = rand() % 20;
-    
-    switch((test++)) {
-    case 0:
-      if (bitree_insl(tree, (void *)pTest))
-	goto error_exit;
-      break;
-    case 1:
-      if (bitree_insl(tree->left, (void *)pTest))
-	goto error_exit;
-      break;
-    case 2:
-      if (bitree_insr(tree->left, (void *)pTest))
+    for (int i = 0; i < 202; i++) {
+      bitree * node = starts[i];
+      while (node != NULL && *(int *)node->data != keys[i])
+	node = keys[i] < *(int *)node->data ? node->left : node->right;
+      if (found[i] != node)
 	goto error_exit;
-      break;
-    case 3:
-      if (bitree_insr(tree, (void *)pTest))
-	goto error_exit;
-      break;
-    default:
-      goto break_loop;
     }
-    continue; /* Unconditional continue */
-  break_loop:
-    break;
   }
 
-  free(pTest);
-  return tree;
+  if (bitree_descend_many(starts, 202, steer_left, NULL, found, 0))
+    goto error_exit;
+  for (int i = 0; i < 202; i++)
+    if (found[i] != NULL)
+      goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
 
  error_exit: {
-    if (pTest != NULL)
-      free(pTest);
-    return NULL;
+    bitree_destroy(&test);
+    return 1;
   }
 }
 
+/******************************************************************************
+ * FUNCTION:	    test_height
+ *
+ * DESCRIPTION:	    Test the bitree_height function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_height()
+{
+  /* NULL input
+   * One node in tree
+   * Multiple nodes in tree
+   */
+
+  int size = 0;
+  bitree * test = NULL;
+
+  /* NULL input */
+  if (bitree_height(test))
+    return 1;
+
+  /* One node in tree */
+  if ((test = bitree_create(NULL, (void *)&size)) == NULL)
+    return 1;
+  if (bitree_height(test) != 1)
+    return 1;
+  bitree_destroy(&test);
+
+  /* Multiple nodes in tree */
+  if ((test = prep_tree()) == NULL)
+    return 1;
+  if (bitree_height(test) != 3)
+    return 1;
+
+  bitree_destroy(&test);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_distance
+ *
+ * DESCRIPTION:	    This function tests the bitree_distance() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_distance()
+{
+  /* NULL Input,
+   * Distance of 0,
+   * Distance of 1,
+   * Distance of >1
+   */
+
+  bitree * test = NULL;
+  int distance = 0;
+
+  /* NULL Input */
+  if (bitree_distance(test) != -1)
+    return 1;
+
+  /* Distance of 0 */
+  if ((test = bitree_create(NULL, (void *)&distance)) == NULL)
+    return 1;
+  if (bitree_distance(test))
+    return 1;
+  bitree_destroy(&test);
+
+  /* Distance of 1 */
+  if ((test = prep_tree()) == NULL)
+    return 1;
+  if (bitree_distance(test->right) != 1)
+    return 1;
+
+  /* Distance of >1 */
+  if (bitree_distance(test->left->right) != 2)
+    return 1;
+
+  bitree_destroy(&test);
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_rotl
+ *
+ * DESCRIPTION:	    Tests the bitree_rotl() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_rotl()
+{
+  /* Test cases:
+   *	NULL
+   *	No right child
+   *	Rotation of an inner node
+   *	Rotation of the root
+   */
+  void * before[5], * after[5];
+  if (bitree_rotl(NULL) != NULL)
+    return 1;
+
+  bitree * test = prep_tree();
+  if (test == NULL)
+    return 1;
+
+  /* No right child */
+  if (bitree_rotl(test->left->left) != NULL)
+    goto error_exit;
+
+  /* Rotation of an inner node */
+  bitree * pivot = test->left->right;
+  inorder_data(test, before);
+  if (bitree_rotl(test->left) != pivot || test->left != pivot
+      || pivot->parent != test || pivot->left->parent != pivot)
+    goto error_exit;
+  inorder_data(test, after);
+  for (int i = 0; i < 5; i++)
+    if (before[i] != after[i])
+      goto error_exit;
+
+  /* Rotation of the root */
+  void * data = test->right->data;
+  if (bitree_rotl(test) != test || test->data != data
+      || test->root != test || bitree_size(test) != 5
+      || test->right != NULL || bitree_height(test) != 5)
+    goto error_exit;
+  inorder_data(test, after);
+  for (int i = 0; i < 5; i++)
+    if (before[i] != after[i])
+      goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_rotr
+ *
+ * DESCRIPTION:	    Tests the bitree_rotr() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_rotr()
+{
+  /* Test cases:
+   *	NULL
+   *	No left child
+   *	Rotation of an inner node
+   *	Rotation of the root
+   */
+  void * before[5], * after[5];
+  if (bitree_rotr(NULL) != NULL)
+    return 1;
+
+  bitree * test = prep_tree();
+  if (test == NULL)
+    return 1;
+
+  /* No left child */
+  if (bitree_rotr(test->right) != NULL)
+    goto error_exit;
+
+  /* Rotation of an inner node */
+  bitree * pivot = test->left->left;
+  inorder_data(test, before);
+  if (bitree_rotr(test->left) != pivot || test->left != pivot
+      || pivot->parent != test || pivot->right->right == NULL)
+    goto error_exit;
+  inorder_data(test, after);
+  for (int i = 0; i < 5; i++)
+    if (before[i] != after[i])
+      goto error_exit;
+
+  /* Rotation of the root */
+  void * data = test->left->data;
+  if (bitree_rotr(test) != test || test->data != data
+      || test->root != test || bitree_size(test) != 5
+      || test->left != NULL)
+    goto error_exit;
+  inorder_data(test, after);
+  for (int i = 0; i < 5; i++)
+    if (before[i] != after[i])
+      goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_avl_insert
+ *
+ * DESCRIPTION:	    Tests the bitree_avl_insert() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_avl_insert()
+{
+  /* Test cases:
+   *	NULL, data
+   *	test, NULL
+   *	Duplicate key
+   *	Sorted insertion stays balanced and ordered
+   */
+  int key = 0;
+  if (!bitree_avl_insert(NULL, &key, compare_int))
+    return 1;
+
+  /* Keys are inserted in ascending order, the worst case for a plain tree */
+  bitree * test = prep_avl(1000);
+  if (test == NULL)
+    return 1;
+
+  if (!bitree_avl_insert(test, NULL, compare_int))
+    goto error_exit;
+  if (!bitree_avl_insert(test, &key, compare_int))
+    goto error_exit;
+  if (bitree_size(test) != 1000 || check_avl(test))
+    goto error_exit;
+  /* An AVL tree of 1000 nodes is never more than 14 levels deep */
+  if (bitree_height(test) > 14)
+    goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_avl_find
+ *
+ * DESCRIPTION:	    Tests the bitree_avl_find() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_avl_find()
+{
+  /* Test cases:
+   *	NULL, key
+   *	Key exists
+   *	Key does not exist
+   */
+  int key = 0;
+  if (bitree_avl_find(NULL, &key, compare_int) != NULL)
+    return 1;
+
+  bitree * test = prep_avl(100);
+  if (test == NULL)
+    return 1;
+
+  for (key = 0; key < 100; key++) {
+    bitree * node = bitree_avl_find(test, &key, compare_int);
+    if (node == NULL || *(int *)node->data != key)
+      goto error_exit;
+  }
+
+  key = 100;
+  if (bitree_avl_find(test, &key, compare_int) != NULL)
+    goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_avl_erase
+ *
+ * DESCRIPTION:	    Tests the bitree_avl_erase() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_avl_erase()
+{
+  /* Test cases:
+   *	NULL
+   *	Key does not exist
+   *	Remove half of the keys
+   *	Remove the last key
+   */
+  int key = 0;
+  if (!bitree_avl_erase(NULL, &key, compare_int))
+    return 1;
+
+  bitree * test = prep_avl(500);
+  if (test == NULL)
+    return 1;
+
+  key = 500;
+  if (!bitree_avl_erase(&test, &key, compare_int))
+    goto error_exit;
+
+  for (key = 0; key < 500; key += 2)
+    if (bitree_avl_erase(&test, &key, compare_int))
+      goto error_exit;
+  if (bitree_size(test) != 250 || check_avl(test))
+    goto error_exit;
+
+  key = 2;
+  if (bitree_avl_find(test, &key, compare_int) != NULL)
+    goto error_exit;
+
+  for (key = 1; key < 500; key += 2)
+    if (bitree_avl_erase(&test, &key, compare_int))
+      goto error_exit;
+  if (test != NULL)
+    goto error_exit;
+
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_splay_insert
+ *
+ * DESCRIPTION:	    Tests the bitree_splay_insert() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_splay_insert()
+{
+  /* Test cases:
+   *	NULL, data
+   *	test, NULL
+   *	Duplicate key
+   *	New key, which can be found, and the tree is ordered
+   */
+  int key = 0;
+  if (!bitree_splay_insert(NULL, &key, compare_int))
+    return 1;
+
+  bitree * test = prep_splay(200);
+  if (test == NULL)
+    return 1;
+
+  if (!bitree_splay_insert(test, NULL, compare_int))
+    goto error_exit;
+  key = 10;
+  if (!bitree_splay_insert(test, &key, compare_int))
+    goto error_exit;
+  int * data = new_int(200);
+  if (data == NULL)
+    goto error_exit;
+  if (bitree_splay_insert(test, data, compare_int)) {
+    free(data);
+    goto error_exit;
+  }
+  bitree * node = bitree_splay_find(test, data, compare_int);
+  if (node == NULL || node->data != data)
+    goto error_exit;
+  if (bitree_size(test) != 201 || check_order(test))
+    goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_splay_find
+ *
+ * DESCRIPTION:	    Tests the bitree_splay_find() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_splay_find()
+{
+  /* Test cases:
+   *	NULL, key
+   *	Key exists, and stays in the node it was found in
+   *	A deep node is splayed towards the root
+   *	Key does not exist
+   */
+  int key = 0;
+  if (bitree_splay_find(NULL, &key, compare_int) != NULL)
+    return 1;
+
+  bitree * test = prep_splay(200);
+  if (test == NULL)
+    return 1;
+
+  key = 100;
+  bitree * found = bitree_splay_find(test, &key, compare_int);
+  if (found == NULL || *(int *)found->data != 100)
+    goto error_exit;
+  for (int i = 0; i < 400; i++) {
+    key = rand() % 200;
+    bitree * node = bitree_splay_find(test, &key, compare_int);
+    if (node == NULL || *(int *)node->data != key)
+      goto error_exit;
+  }
+  if (*(int *)found->data != 100 || check_order(test))
+    goto error_exit;
+
+  bitree * deep = test;
+  while (!bitree_isleaf(deep))
+    deep = deep->left != NULL ? deep->left : deep->right;
+  int depth = bitree_distance(deep);
+  if (bitree_splay(deep) != deep
+      || (depth > 1 && bitree_distance(deep) >= depth)
+      || check_order(test))
+    goto error_exit;
+
+  key = 200;
+  if (bitree_splay_find(test, &key, compare_int) != NULL)
+    goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_splay_erase
+ *
+ * DESCRIPTION:	    Tests the bitree_splay_erase() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_splay_erase()
+{
+  /* Test cases:
+   *	NULL
+   *	Key does not exist
+   *	Remove half of the keys
+   *	Remove the last key
+   */
+  int key = 0;
+  if (!bitree_splay_erase(NULL, &key, compare_int))
+    return 1;
+
+  bitree * test = prep_splay(200);
+  if (test == NULL)
+    return 1;
+
+  key = 200;
+  if (!bitree_splay_erase(&test, &key, compare_int))
+    goto error_exit;
+
+  for (key = 0; key < 200; key += 2)
+    if (bitree_splay_erase(&test, &key, compare_int))
+      goto error_exit;
+  if (bitree_size(test) != 100 || check_order(test))
+    goto error_exit;
+
+  for (key = 1; key < 200; key += 2)
+    if (bitree_splay_erase(&test, &key, compare_int))
+      goto error_exit;
+  if (test != NULL)
+    goto error_exit;
+
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_version_insl
+ *
+ * DESCRIPTION:	    Tests the bitree_version_insl() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_version_insl()
+{
+  /* Test cases:
+   *	NULL
+   *	Invalid path
+   *	Occupied child
+   *	Normal insertion, leaving the old version as it was
+   */
+  bitree_version * old = NULL, * new = NULL;
+  int * data = new_int(5);
+  if (bitree_version_insl(NULL, "", data) != NULL
+      || (old = prep_version()) == NULL
+      || bitree_version_insl(old, "", NULL) != NULL
+      || bitree_version_insl(old, "x", data) != NULL
+      || bitree_version_insl(old, "rr", data) != NULL
+      || bitree_version_insl(old, "", data) != NULL)
+    goto error_exit;
+
+  /* Only the path from the root to "lr" is copied */
+  if ((new = bitree_version_insl(old, "lr", data)) == NULL)
+    goto error_exit;
+  data = NULL;
+  struct bitree_pnode * node = bitree_version_find(new, "lrl");
+  if (bitree_version_size(new) != 6 || bitree_version_size(old) != 5
+      || node == NULL || *(int *)bitree_pnode_data(node) != 5
+      || bitree_pnode_count(bitree_version_root(new)) != 6
+      || bitree_version_find(old, "lrl") != NULL
+      || bitree_version_root(new) == bitree_version_root(old)
+      || bitree_version_find(new, "l") == bitree_version_find(old, "l")
+      || bitree_version_find(new, "r") != bitree_version_find(old, "r")
+      || bitree_version_find(new, "ll") != bitree_version_find(old, "ll"))
+    goto error_exit;
+
+  bitree_version_release(&old);
+  bitree_version_release(&new);
+  return 0;
+
+ error_exit: {
+    free(data);
+    bitree_version_release(&old);
+    bitree_version_release(&new);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_version_insr
+ *
+ * DESCRIPTION:	    Tests the bitree_version_insr() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_version_insr()
+{
+  /* Test cases:
+   *	NULL
+   *	Occupied child
+   *	Normal insertion, leaving the old version as it was
+   */
+  bitree_version * old = NULL, * new = NULL;
+  int * data = new_int(5);
+  if (bitree_version_insr(NULL, "", data) != NULL
+      || (old = prep_version()) == NULL
+      || bitree_version_insr(old, "l", data) != NULL)
+    goto error_exit;
+
+  if ((new = bitree_version_insr(old, "r", data)) == NULL)
+    goto error_exit;
+  data = NULL;
+  struct bitree_pnode * node = bitree_version_find(new, "rr");
+  if (bitree_version_size(new) != 6 || node == NULL
+      || *(int *)bitree_pnode_data(node) != 5
+      || bitree_version_find(old, "rr") != NULL
+      || bitree_version_find(new, "l") != bitree_version_find(old, "l"))
+    goto error_exit;
+
+  bitree_version_release(&old);
+  bitree_version_release(&new);
+  return 0;
+
+ error_exit: {
+    free(data);
+    bitree_version_release(&old);
+    bitree_version_release(&new);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_version_rem
+ *
+ * DESCRIPTION:	    Tests the bitree_version_rem() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_version_rem()
+{
+  /* Test cases:
+   *	NULL
+   *	Invalid path
+   *	Subtree
+   *	Root
+   */
+  bitree_version * old = NULL, * new = NULL, * empty = NULL;
+  if (bitree_version_rem(NULL, "") != NULL
+      || (old = prep_version()) == NULL
+      || bitree_version_rem(old, "rl") != NULL)
+    goto error_exit;
+
+  if ((new = bitree_version_rem(old, "l")) == NULL
+      || bitree_version_size(new) != 2
+      || bitree_version_find(new, "l") != NULL
+      || bitree_version_find(old, "lr") == NULL
+      || bitree_version_find(new, "r") != bitree_version_find(old, "r"))
+    goto error_exit;
+
+  if ((empty = bitree_version_rem(new, NULL)) == NULL
+      || bitree_version_size(empty) != 0
+      || bitree_version_root(empty) != NULL
+      || bitree_version_rem(empty, "") != NULL)
+    goto error_exit;
+
+  bitree_version_release(&old);
+  bitree_version_release(&new);
+  bitree_version_release(&empty);
+  return 0;
+
+ error_exit: {
+    bitree_version_release(&old);
+    bitree_version_release(&new);
+    bitree_version_release(&empty);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_version_merge
+ *
+ * DESCRIPTION:	    Tests the bitree_version_merge() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_version_merge()
+{
+  /* Test cases:
+   *	NULL
+   *	Mismatched destroy functions
+   *	No free child
+   *	New root
+   *	Attach to a free child
+   */
+  bitree_version * one = NULL, * two = NULL, * other = NULL, * merged = NULL;
+  int * data = new_int(10);
+  if ((one = prep_version()) == NULL || (two = prep_version()) == NULL
+      || (other = bitree_version_create(NULL, data)) == NULL
+      || bitree_version_merge(NULL, "", two, data) != NULL
+      || bitree_version_merge(one, "", NULL, data) != NULL
+      || bitree_version_merge(one, "", other, data) != NULL
+      || bitree_version_merge(one, "l", two, data) != NULL)
+    goto error_exit;
+
+  if ((merged = bitree_version_merge(one, "", two, data)) == NULL)
+    goto error_exit;
+  data = NULL;
+  if (bitree_version_size(merged) != 11
+      || bitree_version_find(merged, "l") != bitree_version_root(one)
+      || bitree_version_find(merged, "r") != bitree_version_root(two))
+    goto error_exit;
+  bitree_version_release(&merged);
+
+  if ((merged = bitree_version_merge(one, "r", two, NULL)) == NULL
+      || bitree_version_size(merged) != 10
+      || bitree_version_find(merged, "rl") != bitree_version_root(two)
+      || bitree_version_find(merged, "l") != bitree_version_find(one, "l"))
+    goto error_exit;
+
+  bitree_version_release(&one);
+  bitree_version_release(&two);
+  bitree_version_release(&other);
+  bitree_version_release(&merged);
+  free(data);
+  return 0;
+
+ error_exit: {
+    bitree_version_release(&one);
+    bitree_version_release(&two);
+    bitree_version_release(&other);
+    bitree_version_release(&merged);
+    free(data);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_version_release
+ *
+ * DESCRIPTION:	    Tests the bitree_version_retain() and
+ *		    bitree_version_release() functions.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_version_release()
+{
+  /* Test cases:
+   *	NULL
+   *	A retained version survives one release
+   *	Payloads are destroyed only when no version contains them
+   */
+  bitree_version * old = NULL, * new = NULL, * reader = NULL;
+  bitree_version_release(NULL);
+  bitree_version_release(&old);
+
+  if ((old = prep_version()) == NULL
+      || (new = bitree_version_rem(old, "l")) == NULL)
+    goto error_exit;
+  reader = bitree_version_retain(old);
+
+  freed = 0;
+  bitree_version_release(&old);
+  if (old != NULL || freed != 0
+      || *(int *)bitree_pnode_data(bitree_version_find(reader, "lr")) != 4)
+    goto error_exit;
+
+  /* Only the payloads in the removed subtree go with `reader' */
+  bitree_version_release(&reader);
+  if (freed != 3)
+    goto error_exit;
+  bitree_version_release(&new);
+  if (freed != 5)
+    goto error_exit;
+
+  return 0;
+
+ error_exit: {
+    bitree_version_release(&old);
+    bitree_version_release(&new);
+    bitree_version_release(&reader);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_version_intern
+ *
+ * DESCRIPTION:	    Tests the bitree_version_intern() and
+ *		    bitree_version_interned() functions, and that versions
+ *		    derived from an interned version stay interned.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_version_intern()
+{
+  /* Test cases:
+   *	NULL
+   *	A tree with identical subtrees
+   *	Inserting a node identical to an existing one
+   *	Merging with an uninterned version
+   *	Releasing the interned versions
+   */
+  bitree_version * plain = NULL, * interned = NULL, * next = NULL;
+  if (bitree_version_intern(NULL, hash_int, equal_int) != NULL
+      || bitree_version_interned(NULL) != 0)
+    return 1;
+
+  /*	      0
+   *	   1     1
+   *	 2   2 2   2
+   */
+  static const char * paths[] = {"", "", "l", "l", "r", "r"};
+  plain = bitree_version_create(count_free, new_int(0));
+  for (int i = 0; i < 6 && plain != NULL; i++) {
+    int * data = new_int(i < 2 ? 1 : 2);
+    next = i % 2 ? bitree_version_insr(plain, paths[i], data)
+      : bitree_version_insl(plain, paths[i], data);
+    if (next == NULL)
+      free(data);
+    bitree_version_release(&plain);
+    plain = next;
+    next = NULL;
+  }
+  if (plain == NULL || bitree_version_interned(plain) != 0
+      || bitree_version_intern(plain, NULL, equal_int) != NULL)
+    goto error_exit;
+
+  if ((interned = bitree_version_intern(plain, hash_int, equal_int)) == NULL
+      || bitree_version_size(interned) != 7
+      || bitree_version_interned(interned) != 3
+      || bitree_version_find(interned, "l") != bitree_version_find(interned,
+								   "r")
+      || bitree_version_find(interned, "ll")
+      != bitree_version_find(interned, "rr"))
+    goto error_exit;
+
+  /* The new 1 under "ll" is identical to the one under "lr", so it is
+   * shared, and its payload destroyed. That also makes "l" and "r" distinct.
+   */
+  freed = 0;
+  if ((next = bitree_version_insl(interned, "ll", new_int(1))) == NULL
+      || freed != 0)
+    goto error_exit;
+  bitree_version * more = bitree_version_insl(next, "lr", new_int(1));
+  bitree_version_release(&next);
+  next = more;
+  if (next == NULL || freed != 1 || bitree_version_size(next) != 9
+      || bitree_version_find(next, "lll") != bitree_version_find(next, "lrl")
+      || bitree_version_find(next, "l") == bitree_version_find(next, "r")
+      || bitree_version_interned(next) != 7
+      || bitree_version_merge(next, "lll", plain, NULL) != NULL)
+    goto error_exit;
+
+  /* The interned versions share one payload for each distinct value with
+   * `plain', and the table is freed along with the last of them.
+   */
+  freed = 0;
+  bitree_version_release(&plain);
+  if (freed != 4)
+    goto error_exit;
+  bitree_version_release(&next);
+  bitree_version_release(&interned);
+  if (freed != 8)
+    goto error_exit;
+
+  return 0;
+
+ error_exit: {
+    bitree_version_release(&plain);
+    bitree_version_release(&interned);
+    bitree_version_release(&next);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_shm_store
+ *
+ * DESCRIPTION:	    Tests the bitree_shm_store() and bitree_shm_walk()
+ *		    functions, and reading a shared tree through another
+ *		    mapping, in another process.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_shm_store()
+{
+  /* Test cases:
+   *	NULL, or a bad order
+   *	Every node, in each order, of a tree and of a subtree
+   *	A reader in a child process, with its own mapping
+   *	A named region, which can't be written through a reader's handle
+   *	Storing an empty tree
+   */
+  void (*record[])(bitree *) = {
+    preorder_record, inorder_record, postorder_record, levelorder_record
+  };
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER, BITREE_LEVELORDER
+  };
+
+  char name[64];
+  snprintf(name, sizeof(name), "/bitree-test-%ld", (long)getpid());
+  bitree_shm * shm = NULL, * reader = NULL;
+  bitree * test = prep_splay(200);
+  if (test == NULL || bitree_shm_store(NULL, test, serialize_int) != -1
+      || (shm = bitree_shm_create(NULL, 1 << 16)) == NULL
+      || bitree_shm_store(shm, test, NULL) != -1
+      || bitree_shm_walk(shm, 0, BITREE_PREORDER, shm_record, NULL) != -1)
+    goto error_exit;
+
+  bitree * sub = test->left != NULL ? test->left : test->right;
+  bitree * roots[] = { test, sub };
+  for (int i = 0; i < 2; i++) {
+    if (bitree_shm_store(shm, roots[i], serialize_int))
+      goto error_exit;
+    bitree_shm_ref root = bitree_shm_root(shm);
+    if (bitree_shm_parent(shm, root) != 0
+	|| bitree_shm_walk(shm, root, (enum bitree_order)-1, shm_record, NULL)
+	!= -1)
+      goto error_exit;
+    for (int j = 0; j < 4; j++) {
+      recorded_size = walked_data_size = 0;
+      record[j](roots[i]);
+      if (bitree_shm_walk(shm, root, orders[j], shm_record, NULL) != 0
+	  || walked_data_size != recorded_size
+	  || bitree_shm_size(shm) != recorded_size)
+	goto error_exit;
+      for (int k = 0; k < walked_data_size; k++)
+	if (walked_data[k] != *(int *)recorded[k]->data)
+	  goto error_exit;
+    }
+  }
+
+  /* The child maps the region at an address of its own, and reports what it
+   * finds through its exit status.
+   */
+  recorded_size = 0;
+  preorder_record(test);
+  if (bitree_shm_store(shm, test, serialize_int))
+    goto error_exit;
+  pid_t child = fork();
+  if (child == 0) {
+    bitree_shm * mine = bitree_shm_map(bitree_shm_fd(shm));
+    walked_data_size = 0;
+    int result = mine == NULL || mine->base == shm->base
+      || bitree_shm_walk(mine, bitree_shm_root(mine), BITREE_PREORDER,
+			 shm_record, NULL) != 0
+      || walked_data_size != recorded_size;
+    for (int k = 0; !result && k < walked_data_size; k++)
+      result = walked_data[k] != *(int *)recorded[k]->data;
+    bitree_shm_close(&mine);
+    _exit(result);
+  }
+  int status = 0;
+  if (child < 0 || waitpid(child, &status, 0) != child
+      || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    goto error_exit;
+  bitree_shm_close(&shm);
+
+  if ((shm = bitree_shm_create(name, 1 << 16)) == NULL
+      || bitree_shm_create(name, 1 << 16) != NULL
+      || (reader = bitree_shm_open(name)) == NULL
+      || shm_unlink(name) || bitree_shm_open(name) != NULL)
+    goto error_exit;
+  if (bitree_shm_store(reader, test, serialize_int) != -1 || errno != EPERM
+      || bitree_shm_store(shm, sub, serialize_int))
+    goto error_exit;
+
+  recorded_size = walked_data_size = 0;
+  preorder_record(sub);
+  if (bitree_shm_size(reader) != recorded_size
+      || bitree_shm_walk(reader, bitree_shm_root(reader), BITREE_PREORDER,
+			 shm_record, NULL) != 0
+      || walked_data_size != recorded_size)
+    goto error_exit;
+  for (int k = 0; k < walked_data_size; k++)
+    if (walked_data[k] != *(int *)recorded[k]->data)
+      goto error_exit;
+
+  if (bitree_shm_store(shm, NULL, NULL) || bitree_shm_root(reader) != 0
+      || bitree_shm_size(reader) != 0)
+    goto error_exit;
+
+  bitree_shm_close(&reader);
+  bitree_shm_close(&shm);
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    shm_unlink(name);
+    bitree_shm_close(&reader);
+    bitree_shm_close(&shm);
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_shm_insl
+ *
+ * DESCRIPTION:	    Tests the bitree_shm_insl(), bitree_shm_insr() and
+ *		    bitree_shm_rem() functions, and the sequence lock.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_shm_insl()
+{
+  /* Test cases:
+   *	NULL, or a node which already has the child
+   *	The root of an empty tree
+   *	Offsets outside the region
+   *	A reader noticing a change, in a read section and during a walk
+   *	A reader's handle
+   *	Reusing the space of removed nodes
+   *	Removing a freed node, or an offset inside a node
+   *	A full region
+   */
+  int values[] = { 1, 2, 3, 4 };
+  size_t size = 0;
+  bitree_shm * shm = bitree_shm_create(NULL, 4096), * reader = NULL;
+  if (shm == NULL || bitree_shm_create(NULL, 16) != NULL
+      || bitree_shm_insl(NULL, 0, &values[0], sizeof(int)) != 0)
+    goto error_exit;
+
+  bitree_shm_ref root = bitree_shm_insl(shm, 0, &values[0], sizeof(int));
+  if (root == 0 || bitree_shm_insr(shm, 0, &values[1], sizeof(int)) != 0
+      || bitree_shm_root(shm) != root)
+    goto error_exit;
+
+  bitree_shm_ref left = bitree_shm_insl(shm, root, &values[1], sizeof(int));
+  bitree_shm_ref right = bitree_shm_insr(shm, root, &values[2], sizeof(int));
+  if (left == 0 || right == 0
+      || bitree_shm_insl(shm, root, &values[3], sizeof(int)) != 0
+      || bitree_shm_left(shm, root) != left
+      || bitree_shm_right(shm, root) != right
+      || bitree_shm_parent(shm, right) != root || bitree_shm_size(shm) != 3
+      || *(const int *)bitree_shm_data(shm, right, &size) != 3
+      || size != sizeof(int) || bitree_shm_data(shm, 1, NULL) != NULL
+      || bitree_shm_left(shm, 1 << 20) != 0)
+    goto error_exit;
+
+  unsigned seq = bitree_shm_read_begin(shm);
+  if (bitree_shm_read_retry(shm, seq)
+      || bitree_shm_insl(shm, left, &values[3], sizeof(int)) == 0
+      || !bitree_shm_read_retry(shm, seq))
+    goto error_exit;
+  if (bitree_shm_walk(shm, root, BITREE_PREORDER, shm_change, shm) != -1
+      || errno != EAGAIN || bitree_shm_size(shm) != 4)
+    goto error_exit;
+
+  if ((reader = bitree_shm_map(bitree_shm_fd(shm))) == NULL
+      || bitree_shm_insr(reader, left, &values[3], sizeof(int)) != 0
+      || errno != EPERM || bitree_shm_rem(reader, left) != -1)
+    goto error_exit;
+
+  /* The removed nodes are freed in postorder, so `left' is reused first */
+  if (bitree_shm_rem(shm, left) || bitree_shm_size(reader) != 2
+      || bitree_shm_left(reader, root) != 0
+      || bitree_shm_rem(shm, left) != -1 || errno != EINVAL
+      || bitree_shm_rem(shm, right + sizeof(uint64_t)) != -1
+      || errno != EINVAL || bitree_shm_size(shm) != 2
+      || bitree_shm_insl(shm, root, &values[3], sizeof(int)) != left)
+    goto error_exit;
+
+  bitree_shm_ref node = right, next = 0;
+  while ((next = bitree_shm_insr(shm, node, &values[0], sizeof(int))) != 0)
+    node = next;
+  if (errno != ENOSPC
+      || bitree_shm_insl(shm, right, NULL, 1 << 20) != 0 || errno != EINVAL
+      || bitree_shm_rem(shm, root) || bitree_shm_root(reader) != 0
+      || bitree_shm_size(reader) != 0
+      || bitree_shm_insl(shm, 0, &values[0], sizeof(int)) == 0)
+    goto error_exit;
+
+  bitree_shm_close(&reader);
+  bitree_shm_close(&shm);
+  return 0;
+
+ error_exit: {
+    bitree_shm_close(&reader);
+    bitree_shm_close(&shm);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_paged_insl
+ *
+ * DESCRIPTION:	    Tests the bitree_paged_insl(), bitree_paged_insr() and
+ *		    bitree_paged_rem() functions, and the buffer pool.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_paged_insl()
+{
+  /* Test cases:
+   *	NULL, a page too small for a node, or a node which already has the
+   *	    child
+   *	The root of an empty tree
+   *	A pool of one frame, so that most steps evict a page
+   *	Pinning more pages than there are frames
+   *	A modified payload, and reopening the file
+   *	Reusing the slots of removed nodes
+   */
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/bitree-test-%ld.pages", (long)getpid());
+  bitree_pref nodes[40];
+  struct bitree_paged_stats stats;
+  bitree_paged * tree = NULL;
+  if (bitree_paged_create(NULL, 4096, sizeof(int), 1) != NULL
+      || bitree_paged_create(path, 64, 48, 1) != NULL
+      || (tree = bitree_paged_create(path, 256, sizeof(int), 1)) == NULL
+      || bitree_paged_insl(NULL, 0, &nodes[0]) != 0)
+    goto error_exit;
+
+  /* Node i is at position i of a complete tree, in level order */
+  for (int i = 0; i < 40; i++) {
+    bitree_pref parent = i == 0 ? 0 : nodes[(i - 1) / 2];
+    nodes[i] = i % 2 ? bitree_paged_insl(tree, parent, &i)
+      : bitree_paged_insr(tree, parent, &i);
+    if (nodes[i] == 0)
+      goto error_exit;
+  }
+  if (bitree_paged_insl(tree, 0, &nodes[0]) != 0
+      || bitree_paged_insl(tree, nodes[0], &nodes[0]) != 0
+      || bitree_paged_size(tree) != 40 || bitree_paged_root(tree) != nodes[0]
+      || bitree_paged_parent(tree, nodes[0]) != 0)
+    goto error_exit;
+  for (int i = 1; i < 40; i++)
+    if (bitree_paged_parent(tree, nodes[i]) != nodes[(i - 1) / 2]
+	|| (i % 2 ? bitree_paged_left : bitree_paged_right)
+	(tree, nodes[(i - 1) / 2]) != nodes[i])
+      goto error_exit;
+
+  bitree_paged_stats(tree, &stats);
+  int * data = bitree_paged_pin(tree, nodes[39]);
+  if (stats.misses == 0 || stats.writes == 0 || data == NULL || *data != 39
+      || bitree_paged_pin(tree, nodes[0]) != NULL || errno != EBUSY)
+    goto error_exit;
+  *data = 100;
+  bitree_paged_unpin(tree, nodes[39], 1);
+
+  if (bitree_paged_close(&tree) || tree != NULL
+      || (tree = bitree_paged_open(path, 4)) == NULL
+      || bitree_paged_size(tree) != 40 || bitree_paged_root(tree) != nodes[0]
+      || bitree_paged_parent(tree, nodes[39]) != nodes[19]
+      || (data = bitree_paged_pin(tree, nodes[39])) == NULL || *data != 100)
+    goto error_exit;
+  bitree_paged_unpin(tree, nodes[39], 0);
+
+  /* Node 1 has 1, 3-4, 7-10, 15-22 and 31-39 below it */
+  if (bitree_paged_rem(tree, nodes[1]) || bitree_paged_size(tree) != 16
+      || bitree_paged_left(tree, nodes[0]) != 0)
+    goto error_exit;
+  bitree_pref reused = bitree_paged_insl(tree, nodes[0], &nodes[0]);
+  int found = 0;
+  for (int i = 1; i < 40; i++)
+    found |= nodes[i] == reused && (i == 1 || i == 3 || i == 4
+				    || (i >= 7 && i <= 10) || i >= 15);
+  if (!found || bitree_paged_rem(tree, nodes[0])
+      || bitree_paged_root(tree) != 0 || bitree_paged_size(tree) != 0)
+    goto error_exit;
+
+  bitree_paged_close(&tree);
+  unlink(path);
+  return 0;
+
+ error_exit: {
+    bitree_paged_close(&tree);
+    unlink(path);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_paged_store
+ *
+ * DESCRIPTION:	    Tests the bitree_paged_store() and bitree_paged_walk()
+ *		    functions.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_paged_store()
+{
+  /* Test cases:
+   *	NULL, a bad order, or a tree which isn't empty
+   *	Every node, in each order, of a tree which is larger than the pool
+   *	A payload which doesn't fit in a slot
+   */
+  void (*record[])(bitree *) = {
+    preorder_record, inorder_record, postorder_record, levelorder_record
+  };
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER, BITREE_LEVELORDER
+  };
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/bitree-test-%ld.pages", (long)getpid());
+  struct bitree_paged_stats stats;
+  bitree_paged * paged = NULL;
+  bitree * test = prep_splay(200);
+  if (test == NULL
+      || (paged = bitree_paged_create(path, 512, sizeof(int), 4)) == NULL
+      || bitree_paged_store(NULL, test, serialize_int) != -1
+      || bitree_paged_store(paged, test, NULL) != -1
+      || bitree_paged_walk(paged, 0, BITREE_PREORDER, paged_record, NULL)
+      != -1)
+    goto error_exit;
+
+  recorded_size = 0;
+  preorder_record(test);
+  if (bitree_paged_store(paged, test, serialize_int)
+      || bitree_paged_size(paged) != (uint64_t)recorded_size
+      || bitree_paged_store(paged, test, serialize_int) != -1
+      || bitree_paged_walk(paged, bitree_paged_root(paged),
+			   (enum bitree_order)-1, paged_record, NULL) != -1)
+    goto error_exit;
+
+  for (int j = 0; j < 4; j++) {
+    recorded_size = walked_data_size = 0;
+    record[j](test);
+    if (bitree_paged_walk(paged, bitree_paged_root(paged), orders[j],
+			  paged_record, NULL) != 0
+	|| walked_data_size != recorded_size)
+      goto error_exit;
+    for (int k = 0; k < walked_data_size; k++)
+      if (walked_data[k] != *(int *)recorded[k]->data)
+	goto error_exit;
+  }
+
+  /* Since the nodes were stored in preorder, most steps stay in a page */
+  bitree_paged_stats(paged, &stats);
+  if (stats.hits <= stats.misses)
+    goto error_exit;
+  bitree_paged_close(&paged);
+
+  if ((paged = bitree_paged_create(path, 512, 2, 4)) == NULL
+      || bitree_paged_store(paged, test, serialize_int) != -1
+      || bitree_paged_size(paged) != 0 || bitree_paged_root(paged) != 0)
+    goto error_exit;
+
+  bitree_paged_close(&paged);
+  bitree_destroy(&test);
+  unlink(path);
+  return 0;
+
+ error_exit: {
+    bitree_paged_close(&paged);
+    bitree_destroy(&test);
+    unlink(path);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_freeze_succinct
+ *
+ * DESCRIPTION:	    Tests the bitree_freeze_succinct() function, and the
+ *		    navigation of the trees it returns.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_freeze_succinct()
+{
+  /* Test cases:
+   *	NULL, or a payload size without a serialize function
+   *	The children, parent, depth and payload of every node of a random
+   *	    tree
+   *	A complete tree which spans many blocks of the rank directory
+   *	A payload which doesn't fit, and a tree with no payloads
+   */
+  bitree_succinct * frozen = NULL;
+  bitree * test = prep_splay(200);
+  if (test == NULL
+      || bitree_freeze_succinct(NULL, sizeof(int), serialize_int) != NULL
+      || bitree_freeze_succinct(test, sizeof(int), NULL) != NULL
+      || bitree_succinct_left(NULL, 1) != 0
+      || bitree_succinct_data(NULL, 1) != NULL)
+    goto error_exit;
+
+  /* Node k is recorded[k - 1] */
+  recorded_size = 0;
+  levelorder_record(test);
+  if ((frozen = bitree_freeze_succinct(test, sizeof(int), serialize_int))
+      == NULL || bitree_succinct_size(frozen) != (size_t)recorded_size
+      || bitree_succinct_root(frozen) != 1
+      || bitree_succinct_height(frozen) != bitree_height(test)
+      || bitree_succinct_parent(frozen, 1) != 0
+      || bitree_succinct_left(frozen, recorded_size + 1) != 0
+      || bitree_succinct_data(frozen, 0) != NULL
+      || bitree_succinct_depth(frozen, 0) != -1)
+    goto error_exit;
+  for (bitree_sref k = 1; k <= (bitree_sref)recorded_size; k++) {
+    bitree * node = recorded[k - 1];
+    bitree_sref left = bitree_succinct_left(frozen, k);
+    bitree_sref right = bitree_succinct_right(frozen, k);
+    bitree_sref parent = bitree_succinct_parent(frozen, k);
+    if ((left == 0 ? node->left != NULL : recorded[left - 1] != node->left)
+	|| (right == 0 ? node->right != NULL
+	    : recorded[right - 1] != node->right)
+	|| (parent == 0 ? k != 1 : recorded[parent - 1] != node->parent)
+	|| bitree_succinct_depth(frozen, k) != bitree_distance(node)
+	|| *(const int *)bitree_succinct_data(frozen, k) != *(int *)node->data)
+      goto error_exit;
+  }
+  bitree_succinct_destroy(&frozen);
+  if (frozen != NULL)
+    goto error_exit;
+  bitree_destroy(&test);
+
+  /* Node k of a complete tree has children 2k and 2k + 1 */
+  if ((test = prep_complete(3000, free)) == NULL
+      || (frozen = bitree_freeze_succinct(test, sizeof(int), serialize_int))
+      == NULL || bitree_succinct_height(frozen) != 12
+      || bitree_succinct_bytes(frozen) >= 3000 * (sizeof(int) + 1))
+    goto error_exit;
+  for (bitree_sref k = 1; k <= 3000; k++)
+    if (bitree_succinct_left(frozen, k) != (2 * k <= 3000 ? 2 * k : 0)
+	|| bitree_succinct_right(frozen, k) != (2 * k < 3000 ? 2 * k + 1 : 0)
+	|| bitree_succinct_parent(frozen, k) != k / 2
+	|| *(const int *)bitree_succinct_data(frozen, k) != (int)k - 1)
+      goto error_exit;
+  bitree_succinct_destroy(&frozen);
+
+  if (bitree_freeze_succinct(test, 2, serialize_int) != NULL
+      || (frozen = bitree_freeze_succinct(test, 0, NULL)) == NULL
+      || bitree_succinct_size(frozen) != 3000
+      || bitree_succinct_data(frozen, 1) != NULL
+      || bitree_succinct_parent(frozen, 3000) != 1500)
+    goto error_exit;
+
+  bitree_succinct_destroy(&frozen);
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_succinct_destroy(&frozen);
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_succinct_walk
+ *
+ * DESCRIPTION:	    Tests the bitree_succinct_walk() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_succinct_walk()
+{
+  /* Test cases:
+   *	NULL, a node which isn't in the tree, or a bad order
+   *	Every node, in each order
+   *	A subtree, skipping the children of one of its nodes, in each order
+   */
+  void (*record[])(bitree *) = {
+    preorder_record, inorder_record, postorder_record, levelorder_record
+  };
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER, BITREE_LEVELORDER
+  };
+
+  bitree_succinct * frozen = NULL;
+  bitree * test = prep_splay(200);
+  if (test == NULL || (frozen = bitree_freeze_succinct(test, sizeof(int),
+						       serialize_int)) == NULL
+      || bitree_succinct_walk(NULL, 1, BITREE_PREORDER, succinct_record, NULL)
+      != -1
+      || bitree_succinct_walk(frozen, 201, BITREE_PREORDER, succinct_record,
+			      NULL) != -1
+      || bitree_succinct_walk(frozen, 1, (enum bitree_order)-1,
+			      succinct_record, NULL) != -1)
+    goto error_exit;
+
+  for (int j = 0; j < 4; j++) {
+    recorded_size = walked_data_size = 0;
+    record[j](test);
+    if (bitree_succinct_walk(frozen, 1, orders[j], succinct_record, NULL)
+	|| walked_data_size != recorded_size)
+      goto error_exit;
+    for (int k = 0; k < walked_data_size; k++)
+      if (walked_data[k] != *(int *)recorded[k]->data)
+	goto error_exit;
+  }
+
+  /* Find the numbers of a subtree and of a node inside it */
+  bitree * sub = test->left != NULL ? test->left : test->right;
+  bitree * skip = sub->left != NULL ? sub->left : sub->right;
+  bitree_sref nodes[2] = {0, 0};
+  recorded_size = 0;
+  levelorder_record(test);
+  for (int k = 0; k < recorded_size; k++) {
+    if (recorded[k] == sub)
+      nodes[0] = k + 1;
+    else if (recorded[k] == skip)
+      nodes[1] = k + 1;
+  }
+
+  for (int j = 0; j < 4; j++) {
+    walked_size = walked_data_size = 0;
+    if (bitree_walk(sub, orders[j], walk_record, skip)
+	|| bitree_succinct_walk(frozen, nodes[0], orders[j], succinct_record,
+				&nodes[1])
+	|| walked_data_size != walked_size)
+      goto error_exit;
+    for (int k = 0; k < walked_size; k++)
+      if (walked_data[k] != *(int *)walked[k]->data)
+	goto error_exit;
+  }
+
+  bitree_succinct_destroy(&frozen);
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_succinct_destroy(&frozen);
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_save
+ *
+ * DESCRIPTION:	    Tests the bitree_save() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_save()
+{
+  /* Test cases:
+   *	NULL, or a file which can't be created
+   *	Many small chunks, serialized by several threads
+   *	A single chunk, with one thread
+   */
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/bitree-test-%ld.tree", (long)getpid());
+  struct bitree_io_options options = {
+    .threads = 3, .chunk_nodes = 8, .depth = 4
+  };
+  bitree * loaded = NULL;
+  bitree * test = prep_splay(200);
+  if (test == NULL || bitree_save(NULL, path, serialize_int, NULL) != -1
+      || bitree_save(test, NULL, serialize_int, NULL) != -1
+      || bitree_save(test, path, NULL, NULL) != -1
+      || bitree_save(test, "/nonexistent/bitree.tree", serialize_int, NULL)
+      != -1)
+    goto error_exit;
+
+  if (bitree_save(test, path, serialize_int, &options)
+      || (loaded = bitree_load(path, deserialize_int, free, NULL)) == NULL
+      || bitree_size(loaded) != bitree_size(test)
+      || check_copy(test, loaded, 1))
+    goto error_exit;
+  bitree_destroy(&loaded);
+
+  /* A subtree is saved on its own */
+  options = (struct bitree_io_options){
+    .threads = 1, .chunk_nodes = 1000, .flags = BITREE_IO_NO_URING
+  };
+  if (bitree_save(test->left, path, serialize_int, &options)
+      || (loaded = bitree_load(path, deserialize_int, free, NULL)) == NULL
+      || loaded->parent != NULL || check_copy(test->left, loaded, 1))
+    goto error_exit;
+
+  bitree_destroy(&loaded);
+  bitree_destroy(&test);
+  unlink(path);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&loaded);
+    bitree_destroy(&test);
+    unlink(path);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_load
+ *
+ * DESCRIPTION:	    Tests the bitree_load() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_load()
+{
+  /* Test cases:
+   *	NULL, or a file which doesn't exist
+   *	Each backend, with and without O_DIRECT, with one or more chunks in
+   *	    flight
+   *	A payload which can't be deserialized
+   *	A file which was cut short, or whose header is missing
+   */
+  struct bitree_io_options options[] = {
+    {.flags = BITREE_IO_NO_URING},
+    {.depth = 1, .flags = BITREE_IO_DIRECT},
+    {.chunk_nodes = 100, .flags = BITREE_IO_DIRECT | BITREE_IO_NO_URING},
+    {.chunk_nodes = 100},
+  };
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/bitree-test-%ld.tree", (long)getpid());
+  bitree * loaded = NULL;
+  int fd = -1;
+  bitree * test = prep_complete(3000, free);
+  if (test == NULL || bitree_load(NULL, deserialize_int, free, NULL) != NULL
+      || bitree_load(path, NULL, free, NULL) != NULL
+      || bitree_load("/nonexistent/bitree.tree", deserialize_int, free, NULL)
+      != NULL)
+    goto error_exit;
+
+  for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+    if (bitree_save(test, path, serialize_int, &options[i])
+	|| (loaded = bitree_load(path, deserialize_int, free, &options[i]))
+	== NULL || bitree_size(loaded) != 3000 || check_copy(test, loaded, 1))
+      goto error_exit;
+    bitree_destroy(&loaded);
+  }
+
+  /* The load fails part of the way through, at payload 2000 */
+  if (bitree_load(path, deserialize_small, free, NULL) != NULL)
+    goto error_exit;
+
+  if ((fd = open(path, O_WRONLY)) < 0 || ftruncate(fd, 2 * 4096))
+    goto error_exit;
+  close(fd);
+  fd = -1;
+  if (bitree_load(path, deserialize_int, free, NULL) != NULL
+      || errno != EINVAL)
+    goto error_exit;
+
+  /* Overwrite the first byte of the magic number */
+  if (bitree_save(test, path, serialize_int, NULL)
+      || (fd = open(path, O_WRONLY)) < 0 || pwrite(fd, "", 1, 0) != 1)
+    goto error_exit;
+  close(fd);
+  fd = -1;
+  if (bitree_load(path, deserialize_int, free, NULL) != NULL)
+    goto error_exit;
+
+  bitree_destroy(&test);
+  unlink(path);
+  return 0;
+
+ error_exit: {
+    if (fd >= 0)
+      close(fd);
+    bitree_destroy(&loaded);
+    bitree_destroy(&test);
+    unlink(path);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_flatten
+ *
+ * DESCRIPTION:	    Tests the bitree_flatten() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_flatten()
+{
+  /* Test cases:
+   *	NULL tree, array or extractor
+   *	Every order, of the tree and of a subtree
+   */
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER, BITREE_LEVELORDER
+  };
+  double values[200];
+
+  bitree * test = prep_splay(200);
+  if (test == NULL)
+    return 1;
+  if (bitree_flatten(NULL, BITREE_INORDER, values, int_value) != 0
+      || bitree_flatten(test, BITREE_INORDER, NULL, int_value) != 0
+      || bitree_flatten(test, BITREE_INORDER, values, NULL) != 0)
+    goto error_exit;
+
+  bitree * roots[] = { test, test->left != NULL ? test->left : test->right };
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 4; j++) {
+      walked_size = 0;
+      if (bitree_walk(roots[i], orders[j], walk_record, NULL)
+	  || bitree_flatten(roots[i], orders[j], values, int_value)
+	  != (size_t)walked_size)
+	goto error_exit;
+      for (int k = 0; k < walked_size; k++)
+	if (values[k] != *(int *)walked[k]->data)
+	  goto error_exit;
+    }
+  }
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_reduce
+ *
+ * DESCRIPTION:	    Tests the bitree_reduce() function, and the kernels
+ *		    bitree_reduce_sum(), bitree_reduce_min(),
+ *		    bitree_reduce_max() and bitree_reduce_count_if().
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_reduce()
+{
+  /* Test cases:
+   *	Kernels over every length up to a few times their width, including
+   *	    empty arrays, with the extremes and NaNs in every position
+   *	NULL tree, extractor or result
+   *	A tree of several blocks, in every order, against its flattened array
+   */
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER, BITREE_LEVELORDER
+  };
+  struct bitree_reduction result;
+  double values[1000];
+
+  for (int n = 0; n <= 40; n++) {
+    for (int i = 0; i < n; i++)
+      values[i] = (i * 7) % 11;
+    double sum = 0, min = INFINITY, max = -INFINITY;
+    size_t count = 0;
+    for (int i = 0; i < n; i++) {
+      sum += values[i];
+      min = values[i] < min ? values[i] : min;
+      max = values[i] > max ? values[i] : max;
+      count += values[i] >= 3 && values[i] < 8;
+    }
+    if (bitree_reduce_sum(values, n) != sum
+	|| bitree_reduce_min(values, n) != min
+	|| bitree_reduce_max(values, n) != max
+	|| bitree_reduce_count_if(values, n, 3, 8) != count)
+      return 1;
+
+    for (int i = 0; i < n; i++) {
+      double value = values[i];
+      values[i] = -1;
+      if (bitree_reduce_min(values, n) != -1)
+	return 1;
+      values[i] = 11;
+      if (bitree_reduce_max(values, n) != 11)
+	return 1;
+      values[i] = NAN;
+      if (!isnan(bitree_reduce_sum(values, n))
+	  || bitree_reduce_count_if(values, n, -INFINITY, INFINITY)
+	  != (size_t)(n - 1))
+	return 1;
+      if (n > 1 && (isnan(bitree_reduce_min(values, n))
+		    || isnan(bitree_reduce_max(values, n))))
+	return 1;
+      values[i] = value;
+    }
+  }
+
+  bitree * test = prep_splay(1000);
+  if (test == NULL)
+    return 1;
+  if (bitree_reduce(NULL, BITREE_INORDER, int_value, 0, 1, &result) != -1
+      || bitree_reduce(test, BITREE_INORDER, NULL, 0, 1, &result) != -1
+      || bitree_reduce(test, BITREE_INORDER, int_value, 0, 1, NULL) != -1)
+    goto error_exit;
+
+  /* The payloads are 0 to 999 */
+  for (int j = 0; j < 4; j++) {
+    if (bitree_reduce(test, orders[j], int_value, 100, 300, &result)
+	|| result.count != 1000 || result.sum != 499500 || result.min != 0
+	|| result.max != 999 || result.in_range != 200)
+      goto error_exit;
+    if (bitree_flatten(test, orders[j], values, int_value) != 1000
+	|| bitree_reduce_sum(values, 1000) != result.sum
+	|| bitree_reduce_min(values, 1000) != result.min
+	|| bitree_reduce_max(values, 1000) != result.max
+	|| bitree_reduce_count_if(values, 1000, 100, 300) != result.in_range)
+      goto error_exit;
+  }
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_bfs
+ *
+ * DESCRIPTION:	    Tests the bitree_bfs() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_bfs()
+{
+  /* Test cases:
+   *	NULL tree, and no action or hook
+   *	A random tree, with one thread and several: every node is visited
+   *	    once, at its depth, and the levels are those of a level order
+   *	    traversal
+   *	A complete tree whose last levels are shared between threads
+   *	Stopping after a level
+   */
+  bitree * complete = NULL;
+  bitree * test = prep_splay(200);
+  if (test == NULL)
+    return 1;
+  if (bitree_bfs(NULL, 1, bfs_record, bfs_level, NULL) != -1
+      || bitree_bfs(test, 2, NULL, NULL, NULL))
+    goto error_exit;
+
+  recorded_size = 0;
+  levelorder_record(test);
+  for (int threads = 1; threads <= 3; threads++) {
+    memset(bfs_visits, 0, sizeof(bfs_visits));
+    bfs_nodes_size = bfs_levels = 0;
+    bfs_stop = -1;
+    if (bitree_bfs(test, threads, bfs_record, bfs_level, NULL)
+	|| bfs_levels != bitree_height(test)
+	|| bfs_nodes_size != recorded_size)
+      goto error_exit;
+    for (int i = 0; i < recorded_size; i++)
+      if (bfs_nodes[i] != recorded[i])
+	goto error_exit;
+    for (int i = 0; i < recorded_size; i++) {
+      int depth = 0, value = *(int *)recorded[i]->data;
+      for (bitree * node = recorded[i]; node != test; node = node->parent)
+	depth++;
+      if (bfs_visits[value] != 1 || bfs_depths[value] != depth)
+	goto error_exit;
+    }
+  }
+
+  /* Node i of the complete tree holds i, and is i'th in level order */
+  if ((complete = prep_complete(8191, free)) == NULL)
+    goto error_exit;
+  for (int threads = 1; threads <= 4; threads += 3) {
+    memset(bfs_visits, 0, sizeof(bfs_visits));
+    bfs_nodes_size = bfs_levels = 0;
+    bfs_stop = -1;
+    if (bitree_bfs(complete, threads, bfs_record, bfs_level, NULL)
+	|| bfs_levels != 13 || bfs_nodes_size != 8191)
+      goto error_exit;
+    for (int i = 0; i < 8191; i++) {
+      int depth = 0;
+      while ((2 << depth) <= i + 1)
+	depth++;
+      if (*(int *)bfs_nodes[i]->data != i || bfs_visits[i] != 1
+	  || bfs_depths[i] != depth)
+	goto error_exit;
+    }
+  }
+
+  memset(bfs_visits, 0, sizeof(bfs_visits));
+  bfs_nodes_size = bfs_levels = 0;
+  bfs_stop = 2;
+  if (bitree_bfs(complete, 4, bfs_record, bfs_level, NULL) != 1
+      || bfs_levels != 3 || bfs_nodes_size != 7)
+    goto error_exit;
+  for (int i = 0; i < 8191; i++)
+    if (bfs_visits[i] != (i < 7))
+      goto error_exit;
+
+  bitree_destroy(&complete);
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&complete);
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+#ifdef CONFIG_ORDER_STATISTICS
+/******************************************************************************
+ * FUNCTION:	    test_select
+ *
+ * DESCRIPTION:	    Tests the bitree_select() function, and that the subtree
+ *		    counts survive insertion, removal and rotation.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_select()
+{
+  /* Test cases:
+   *	NULL
+   *	k out of range
+   *	Level order
+   *	Every node, in pre-, in- and post-order
+   *	A subtree
+   */
+  void (*record[])(bitree *) = {
+    preorder_record, inorder_record, postorder_record
+  };
+  enum bitree_order orders[] = {
+    BITREE_PREORDER, BITREE_INORDER, BITREE_POSTORDER
+  };
+
+  if (bitree_select(NULL, 0, BITREE_INORDER) != NULL)
+    return 1;
+
+  bitree * test = prep_avl(300);
+  if (test == NULL)
+    return 1;
+  for (int key = 0; key < 300; key += 3)
+    if (bitree_avl_erase(&test, &key, compare_int))
+      goto error_exit;
+  if (test->count != 200 || check_counts(test))
+    goto error_exit;
+
+  if (bitree_select(test, -1, BITREE_INORDER) != NULL
+      || bitree_select(test, 200, BITREE_INORDER) != NULL
+      || bitree_select(test, 0, BITREE_LEVELORDER) != NULL)
+    goto error_exit;
+
+  bitree * roots[] = { test, test->left->right };
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 3; j++) {
+      recorded_size = 0;
+      record[j](roots[i]);
+      if (recorded_size != roots[i]->count)
+	goto error_exit;
+      for (int k = 0; k < recorded_size; k++)
+	if (bitree_select(roots[i], k, orders[j]) != recorded[k])
+	  goto error_exit;
+    }
+  }
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_rank
+ *
+ * DESCRIPTION:	    Tests the bitree_rank() function, and that the subtree
+ *		    counts survive bitree_merge().
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_rank()
+{
+  /* Test cases:
+   *	NULL
+   *	Every node, after both kinds of merge
+   */
+  if (bitree_rank(NULL) != -1)
+    return 1;
+
+  int * pTest = malloc(sizeof(int));
+  if (pTest == NULL)
+    return 1;
+  *pTest = 1;
+
+  bitree * test = prep_tree();
+  bitree * other = prep_tree();
+  if (test == NULL || other == NULL || bitree_merge(test, other, pTest))
+    goto error_exit;
+  test = test->root;
+  if ((other = prep_tree()) == NULL
+      || bitree_merge(test->left->right, other, NULL))
+    goto error_exit;
+  if (test->count != 16 || check_counts(test))
+    goto error_exit;
+
+  for (int k = 0; k < test->count; k++)
+    if (bitree_rank(bitree_select(test, k, BITREE_INORDER)) != k)
+      goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_sample
+ *
+ * DESCRIPTION:	    Tests the bitree_sample() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_sample()
+{
+  /* Test cases:
+   *	NULL, state
+   *	tree, NULL
+   *	Every node is sampled about equally often
+   *	The same seed gives the same samples
+   */
+  int seen[10] = {0};
+  uint64_t state = 1;
+  if (bitree_sample(NULL, &state) != NULL)
+    return 1;
+
+  bitree * test = prep_avl(10);
+  if (test == NULL)
+    return 1;
+  if (bitree_sample(test, NULL) != NULL)
+    goto error_exit;
+
+  for (int i = 0; i < 10000; i++) {
+    bitree * node = bitree_sample(test, &state);
+    if (node == NULL)
+      goto error_exit;
+    seen[*(int *)node->data]++;
+  }
+  for (int i = 0; i < 10; i++)
+    if (seen[i] < 800 || seen[i] > 1200)
+      goto error_exit;
+
+  uint64_t one = 42, two = 42;
+  for (int i = 0; i < 100; i++)
+    if (bitree_sample(test, &one) != bitree_sample(test, &two))
+      goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_rem_async
+ *
+ * DESCRIPTION:	    Tests the bitree_rem_async() and bitree_reclaim_flush()
+ *		    functions.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_rem_async()
+{
+  /* Test cases:
+   *	NULL
+   *	Flush with nothing queued
+   *	Subtree
+   *	Whole tree
+   *	Nodes allocated in a block, some of them queued
+   */
+  bitree * test = NULL, * copy = NULL;
+  bitree_rem_async(NULL);
+  bitree_reclaim_flush();
+
+  freed = 0;
+  if ((test = prep_complete(100, count_free)) == NULL)
+    return 1;
+  /* The left subtree holds 63 of the 100 nodes */
+  bitree_rem_async(test->left);
+  if (test->left != NULL || bitree_size(test) != 37)
+    goto error_exit;
+  bitree_reclaim_flush();
+  if (freed != 63)
+    goto error_exit;
+
+  if ((copy = bitree_clone(test, copy_int)) == NULL)
+    goto error_exit;
+  bitree_rem_async(copy->right->left);
+  bitree_rem_async(test);
+  bitree_rem_async(copy);
+  test = copy = NULL;
+  bitree_reclaim_flush();
+  if (freed != 63 + 37 * 2)
+    goto error_exit;
+
+  return 0;
+
+ error_exit: {
+    bitree_reclaim_flush();
+    bitree_destroy(&test);
+    bitree_destroy(&copy);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_rem_step
+ *
+ * DESCRIPTION:	    Tests the bitree_rem_begin() and bitree_rem_step()
+ *		    functions.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_rem_step()
+{
+  /* Test cases:
+   *	NULL
+   *	Subtree, a few nodes at a time
+   *	Zero budget
+   *	Whole tree, in one step
+   */
+  bitree * test = NULL;
+  if (bitree_rem_begin(NULL) != NULL || bitree_rem_step(NULL, 1) != 0)
+    return 1;
+
+  freed = 0;
+  if ((test = prep_complete(100, count_free)) == NULL)
+    return 1;
+  struct bitree_rem_handle * handle = bitree_rem_begin(test->left);
+  if (handle == NULL || test->left != NULL || bitree_size(test) != 37)
+    goto error_exit;
+
+  int steps = 0;
+  while (bitree_rem_step(handle, 10)) {
+    if (freed != 10 * ++steps)
+      goto error_exit;
+  }
+  if (steps != 6 || freed != 63)
+    goto error_exit;
+
+  if ((handle = bitree_rem_begin(test)) == NULL
+      || bitree_rem_step(handle, 0) != 1 || freed != 63
+      || bitree_rem_step(handle, 37) != 0 || freed != 100)
+    goto error_exit;
+
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+#endif /* CONFIG_ORDER_STATISTICS */
+
+#ifdef CONFIG_SUBTREE_AGGREGATE
+/******************************************************************************
+ * FUNCTION:	    test_set_aggregate
+ *
+ * DESCRIPTION:	    Tests the bitree_set_aggregate() function, and that the
+ *		    summaries are maintained by insertion, removal, merging and
+ *		    rotation.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_set_aggregate()
+{
+  /* Test cases:
+   *	NULL
+   *	Incomplete aggregate
+   *	Registration on an existing tree
+   *	Insertion, removal and rotation
+   *	Merging with a tree with a different aggregate
+   *	Merging with a tree with the same aggregate
+   */
+  static const struct bitree_aggregate sum = { int_value, add, 0 };
+  static const struct bitree_aggregate incomplete = { int_value, NULL, 0 };
+
+  bitree * test = NULL, * other = NULL;
+  if (!bitree_set_aggregate(NULL, &sum))
+    return 1;
+
+  if ((test = prep_avl(100)) == NULL || (other = prep_tree()) == NULL)
+    goto error_exit;
+  if (!bitree_set_aggregate(test, &incomplete))
+    goto error_exit;
+
+  /* 0 + 1 + ... + 99 */
+  if (bitree_set_aggregate(test, &sum) || test->summary != 4950)
+    goto error_exit;
+
+  for (int key = 0; key < 100; key += 2)
+    if (bitree_avl_erase(&test, &key, compare_int))
+      goto error_exit;
+  /* 1 + 3 + ... + 99 */
+  if (test->summary != 2500 || check_summaries(test))
+    goto error_exit;
+
+  bitree * leftmost = test;
+  while (leftmost->left != NULL)
+    leftmost = leftmost->left;
+  if (!bitree_merge(leftmost, other, NULL))
+    goto error_exit;
+  bitree_set_aggregate(other, &sum);
+  double total = test->summary + other->summary;
+  if (bitree_merge(leftmost, other, NULL))
+    goto error_exit;
+  other = NULL;
+  if (test->summary != total || check_summaries(test))
+    goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    bitree_destroy(&other);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_update
+ *
+ * DESCRIPTION:	    Tests the bitree_update() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_update()
+{
+  /* Test cases:
+   *	NULL
+   *	Payload of a leaf is increased past the maximum
+   *	Payload of the root is changed
+   */
+  static const struct bitree_aggregate maximum = { int_value, max, -1 };
+
+  /* As long as we don't get a segfault, this will pass */
+  bitree_update(NULL);
+
+  bitree * test = prep_avl(50);
+  if (test == NULL || bitree_set_aggregate(test, &maximum))
+    goto error_exit;
+  if (test->summary != 49)
+    goto error_exit;
+
+  *(int *)test->left->left->data = 100;
+  bitree_update(test->left->left);
+  if (test->summary != 100 || test->right->summary != 49
+      || check_summaries(test))
+    goto error_exit;
+
+  *(int *)test->data = 200;
+  bitree_update(test);
+  if (test->summary != 200 || check_summaries(test))
+    goto error_exit;
+
+  bitree_destroy(&test);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    return 1;
+  }
+}
+#endif /* CONFIG_SUBTREE_AGGREGATE */
+
+#ifdef CONFIG_DESTROY_BATCH
+/******************************************************************************
+ * FUNCTION:	    test_set_destroy_batch
+ *
+ * DESCRIPTION:	    Tests the bitree_set_destroy_batch() function, and that
+ *		    every way of removing nodes uses it.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_set_destroy_batch()
+{
+  /* Test cases:
+   *	NULL
+   *	bitree_rem(), in batches of BITREE_DESTROY_BATCH
+   *	Inherited by new nodes
+   *	bitree_rem_step()
+   *	bitree_rem_async()
+   *	Merging with a tree that has none
+   *	Sharing the payloads with bitree_clone()
+   */
+  bitree * test = NULL, * other = NULL;
+  if (bitree_set_destroy_batch(NULL, batch_free) != -1)
+    return 1;
+
+  if ((test = prep_complete(3, NULL)) == NULL
+      || bitree_set_destroy_batch(test, batch_free)
+      || (other = bitree_clone(test, NULL)) != NULL)
+    goto error_exit;
+  bitree_destroy(&test);
+
+  freed = batches = 0;
+  if ((test = prep_complete(BITREE_DESTROY_BATCH * 4 - 1, count_free)) == NULL
+      || bitree_set_destroy_batch(test, batch_free))
+    goto error_exit;
+  /* The left subtree holds 2 * BITREE_DESTROY_BATCH - 1 nodes */
+  bitree_rem(test->left);
+  if (freed != 2 * BITREE_DESTROY_BATCH - 1 || batches != 2)
+    goto error_exit;
+
+  int * pTest = malloc(sizeof(int));
+  if (pTest == NULL || bitree_insl(test, pTest)) {
+    free(pTest);
+    goto error_exit;
+  }
+  freed = batches = 0;
+#ifdef CONFIG_ORDER_STATISTICS
+  struct bitree_rem_handle * handle = bitree_rem_begin(test->left);
+  if (bitree_rem_step(handle, 10) || freed != 1 || batches != 1)
+    goto error_exit;
+
+  freed = batches = 0;
+  bitree_rem_async(test->right->left);
+  bitree_reclaim_flush();
+#else
+  bitree_rem(test->left);
+  if (freed != 1 || batches != 1)
+    goto error_exit;
+
+  freed = batches = 0;
+  bitree_rem(test->right->left);
+#endif
+  if (freed != BITREE_DESTROY_BATCH - 1 || batches != 1)
+    goto error_exit;
+
+  if ((other = prep_complete(3, count_free)) == NULL
+      || bitree_merge(test, other, NULL) != -1
+      || bitree_set_destroy_batch(other, batch_free)
+      || bitree_merge(test, other, NULL))
+    goto error_exit;
+  other = NULL;
+
+  freed = batches = 0;
+  bitree_destroy(&test);
+  if (freed != BITREE_DESTROY_BATCH + 4 || batches != 2)
+    return 1;
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&test);
+    bitree_destroy(&other);
+    return 1;
+  }
+}
+#endif /* CONFIG_DESTROY_BATCH */
+
+#ifdef CONFIG_MERKLE_HASH
+/******************************************************************************
+ * FUNCTION:	    test_equal
+ *
+ * DESCRIPTION:	    Tests the bitree_equal() function, and that the hashes are
+ *		    only recomputed where the tree has changed.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_equal()
+{
+  /* Test cases:
+   *	NULL, or no hash function
+   *	Equal trees, hashed once
+   *	A payload changed, and changed back
+   *	A rotation, and its inverse
+   *	bitree_retain(), removing nothing, then a leaf
+   *	Different hash functions
+   */
+  bitree * one = prep_complete(100, free);
+  bitree * two = prep_complete(100, free);
+  if (one == NULL || two == NULL || bitree_equal(one, NULL) != -1
+      || bitree_equal(one, two) != -1)
+    goto error_exit;
+
+  hashed = 0;
+  if (bitree_set_hash(one, count_hash) || bitree_set_hash(two, count_hash)
+      || bitree_equal(one, two) != 1 || hashed != 200
+      || bitree_equal(one, two) != 1 || hashed != 200)
+    goto error_exit;
+
+  /* Only the changed node and its two ancestors are hashed again */
+  hashed = 0;
+  *(int *)two->left->left->data += 1000;
+  bitree_update(two->left->left);
+  if (bitree_equal(one, two) != 0 || hashed != 3
+      || bitree_equal(one->right, two->right) != 1)
+    goto error_exit;
+  *(int *)two->left->left->data -= 1000;
+  bitree_update(two->left->left);
+  if (bitree_equal(one, two) != 1)
+    goto error_exit;
+
+  if (bitree_rotl(one->right) == NULL || bitree_equal(one, two) != 0
+      || bitree_rotr(one->right) == NULL || bitree_equal(one, two) != 1)
+    goto error_exit;
+
+  /* bitree_retain() keeps every hash if it removes nothing, and otherwise
+   * only invalidates the ancestors of what it removes: here, the six above
+   * the leaf numbered 99 in each tree.
+   */
+  int limit = 100;
+  hashed = 0;
+  if (bitree_retain(&one, is_below, &limit) != 0
+      || bitree_equal(one, two) != 1 || hashed != 0)
+    goto error_exit;
+  limit = 99;
+  if (bitree_retain(&one, is_below, &limit) != 1
+      || bitree_retain(&two, is_below, &limit) != 1
+      || bitree_equal(one, two) != 1 || hashed != 12)
+    goto error_exit;
+
+  if (bitree_set_hash(two, NULL) || bitree_equal(one, two) != -1)
+    goto error_exit;
+
+  bitree_destroy(&one);
+  bitree_destroy(&two);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&one);
+    bitree_destroy(&two);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_diff
+ *
+ * DESCRIPTION:	    Tests the bitree_diff() function.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_diff()
+{
+  /* Test cases:
+   *	NULL
+   *	Equal trees
+   *	A changed payload, and a node in only one tree
+   *	Undoing the changes
+   */
+  bitree * one = prep_complete(100, free);
+  bitree * two = prep_complete(100, free);
+  if (one == NULL || two == NULL || bitree_set_hash(one, count_hash)
+      || bitree_set_hash(two, count_hash)
+      || bitree_diff(one, two, NULL, NULL) != -1
+      || bitree_diff(NULL, two, diff_record, NULL) != -1)
+    goto error_exit;
+
+  diffs_size = 0;
+  if (bitree_diff(one, two, diff_record, NULL) != 0 || diffs_size != 0)
+    goto error_exit;
+
+  /* Node 62 is a leaf */
+  bitree * leaf = two->right->right->right->right->right;
+  *(int *)two->left->left->data += 1000;
+  bitree_update(two->left->left);
+  if (bitree_insl(leaf, new_int(7)))
+    goto error_exit;
+  if (bitree_diff(one, two, diff_record, NULL) != 2 || diffs_size != 2
+      || diffs[0][0] != one->left->left || diffs[1][0] != two->left->left
+      || diffs[0][1] != NULL || diffs[1][1] != leaf->left)
+    goto error_exit;
+
+  *(int *)two->left->left->data -= 1000;
+  bitree_update(two->left->left);
+  bitree_rem(leaf->left);
+  diffs_size = 0;
+  if (bitree_diff(one, two, diff_record, NULL) != 0 || diffs_size != 0)
+    goto error_exit;
+
+  bitree_destroy(&one);
+  bitree_destroy(&two);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&one);
+    bitree_destroy(&two);
+    return 1;
+  }
+}
+#endif /* CONFIG_MERKLE_HASH */
+
+#ifdef CONFIG_JOURNAL
+/******************************************************************************
+ * FUNCTION:	    test_journal_attach
+ *
+ * DESCRIPTION:	    Tests the bitree_journal_attach() and
+ *		    bitree_journal_detach() functions, by building a replica
+ *		    from the records written to a pipe.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_journal_attach()
+{
+  /* Test cases:
+   *	NULL
+   *	A replica built from the first records
+   *	Attaching twice, and detaching twice
+   *	Merging a tree which has a journal
+   *	A sink which fails
+   *	Creating a replica twice
+   */
+  unsigned char records[4096];
+  int pipes[2] = {-1, -1};
+  size_t used = 0;
+  bitree * test = NULL, * replica = NULL, * other = NULL;
+  if (bitree_journal_attach(NULL, bitree_journal_fd, &pipes[1], serialize_int)
+      != -1 || pipe(pipes))
+    return 1;
+
+  if ((test = prep_complete(20, free)) == NULL
+      || bitree_journal_attach(test, bitree_journal_fd, &pipes[1], NULL) != -1
+      || bitree_journal_attach(test, bitree_journal_fd, &pipes[1],
+			       serialize_int)
+      || bitree_journal_attach(test, bitree_journal_fd, &pipes[1],
+			       serialize_int) != -1)
+    goto error_exit;
+
+  ssize_t size = read(pipes[0], records, sizeof(records));
+  if (size <= 0
+      || bitree_journal_replay(&replica, records, size, deserialize_int, free,
+			       &used)
+      || used != (size_t)size || check_replica(test, replica))
+    goto error_exit;
+
+  if ((other = bitree_create(free, new_int(5))) == NULL
+      || bitree_merge(other, test, NULL) != -1)
+    goto error_exit;
+
+  if (bitree_journal_detach(test) || bitree_journal_detach(test) != -1
+      || bitree_journal_attach(test, fail_write, NULL, serialize_int) != -1
+      || test->journal != NULL)
+    goto error_exit;
+
+  if (bitree_journal_replay(&replica, records, size, deserialize_int, free,
+			    &used) != -1 || used != 0)
+    goto error_exit;
+
+  bitree_destroy(&other);
+  bitree_destroy(&replica);
+  bitree_destroy(&test);
+  close(pipes[0]);
+  close(pipes[1]);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&other);
+    bitree_destroy(&replica);
+    bitree_destroy(&test);
+    close(pipes[0]);
+    close(pipes[1]);
+    return 1;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    test_journal_replay
+ *
+ * DESCRIPTION:	    Tests the bitree_journal_replay() function, by making every
+ *		    kind of change to a tree with a journal, and replaying the
+ *		    records from a ring buffer onto a replica.
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    int -- 0 if the test passes, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int test_journal_replay()
+{
+  /* Test cases:
+   *	Insertions, one at a time and in a batch
+   *	Removal, and bitree_retain()
+   *	A modified payload
+   *	Merging onto a node, and under a new root
+   *	Rotations, including one at the root
+   *	Records split between two calls
+   *	An insertion with an ID which is taken
+   *	Removing the whole tree
+   *	An AVL erase, which moves a payload between nodes
+   */
+  struct bitree_ring ring;
+  unsigned char * records = malloc(1 << 16), * memory = malloc(1 << 16);
+  bitree * test = NULL, * replica = NULL, * other = NULL;
+  size_t used = 0, more = 0;
+  if (records == NULL || memory == NULL
+      || bitree_ring_init(&ring, memory, 1 << 16)
+      || (test = prep_complete(20, free)) == NULL
+      || bitree_journal_attach(test, bitree_journal_ring, &ring,
+			       serialize_int))
+    goto error_exit;
+
+  size_t size = bitree_ring_read(&ring, records, 1 << 16);
+  if (bitree_journal_replay(&replica, records, size, deserialize_int, free,
+			    &used) || used != size)
+    goto error_exit;
+
+  /* Nodes 9, 13 and 14 are leaves */
+  bitree * node9 = test->left->right->left;
+  bitree * node13 = test->right->right->left;
+  bitree * node14 = test->right->right->right;
+  struct bitree_ins_op ops[] = {
+    { node13, BITREE_LEFT, new_int(102) },
+    { node13, BITREE_RIGHT, new_int(103) },
+  };
+  if (bitree_insr(node9, new_int(100)) || bitree_insl(node14, new_int(101))
+      || bitree_ins_batch(test, ops, 2, NULL))
+    goto error_exit;
+
+  bitree_rem(test->left->left);
+  *(int *)test->right->data = 200;
+  bitree_update(test->right);
+
+  if ((other = prep_complete(5, free)) == NULL
+      || bitree_merge(node14, other, NULL))
+    goto error_exit;
+  if ((other = prep_complete(3, free)) == NULL
+      || bitree_merge(test, other, new_int(300)))
+    goto error_exit;
+  other = NULL;
+  test = test->root;
+
+  int value = 103;
+  if (bitree_rotl(test->right) == NULL || bitree_rotr(test) == NULL
+      || bitree_retain(&test, is_not_int, &value) != 1)
+    goto error_exit;
+
+  size = bitree_ring_read(&ring, records, 1 << 16);
+  if (bitree_journal_replay(&replica, records, size / 2, deserialize_int,
+			    free, &used)
+      || used >= size / 2
+      || bitree_journal_replay(&replica, records + used, size - used,
+			       deserialize_int, free, &more)
+      || used + more != size || replica != replica->root
+      || check_replica(test, replica))
+    goto error_exit;
+
+  /* An insertion whose ID is already taken, here by its parent, is refused
+   * before the replica is changed. The ID follows the op and size.
+   */
+  bitree * leaf = test;
+  while (leaf->left != NULL)
+    leaf = leaf->left;
+  if (bitree_insl(leaf, new_int(104)))
+    goto error_exit;
+  size = bitree_ring_read(&ring, records, 1 << 16);
+  memcpy(records + 8, records + 16, sizeof(uint64_t));
+  int replicated = bitree_size(replica);
+  if (bitree_journal_replay(&replica, records, size, deserialize_int, free,
+			    &used) != -1
+      || bitree_size(replica) != replicated)
+    goto error_exit;
+
+  bitree_destroy(&test);
+  size = bitree_ring_read(&ring, records, 1 << 16);
+  if (bitree_journal_replay(&replica, records, size, deserialize_int, free,
+			    &used) || used != size || replica != NULL)
+    goto error_exit;
+
+  /* The root has two children, so its successor's payload is moved into it */
+  if ((test = prep_avl(15)) == NULL
+      || bitree_journal_attach(test, bitree_journal_ring, &ring,
+			       serialize_int))
+    goto error_exit;
+  value = *(int *)test->data;
+  if (bitree_avl_erase(&test, &value, compare_int))
+    goto error_exit;
+  size = bitree_ring_read(&ring, records, 1 << 16);
+  if (bitree_journal_replay(&replica, records, size, deserialize_int, free,
+			    &used) || used != size
+      || check_replica(test, replica))
+    goto error_exit;
+  bitree_destroy(&replica);
+  bitree_destroy(&test);
+
+  free(records);
+  free(memory);
+  return 0;
+
+ error_exit: {
+    bitree_destroy(&other);
+    bitree_destroy(&replica);
+    bitree_destroy(&test);
+    free(records);
+    free(memory);
+    return 1;
+  }
+}
+#endif /* CONFIG_JOURNAL */
+
+/******************************************************************************
+ * FUNCTION:	    print_tree
+ *
+ * DESCRIPTION:	    Prints a tree to STDOUT.
+ *
+ * ARGUMENTS:	    bitree: (bitree *) -- pointer to the tree to print.
+ *		    null: (size_t) -- internal value. User should always pass
+ *			0.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+void print_tree(bitree * bitree, size_t null)
+{
+  if (bitree == NULL)
+    return;
+  printf("--->\n");
+  if (null != 0)
+    for (size_t i = 0; i < null; i++)
+      printf("\t");
+  printf("%s %p ",
+	 bitree->parent == NULL ? "|" :
+	 bitree->parent->left == bitree ? "L" : "R",
+	 bitree);
+  print_tree(bitree->left, ++null);
+  print_tree(bitree->right, null);
+}
+
+/******************************************************************************
+ * FUNCTION:	    print_data
+ *
+ * DESCRIPTION:	    This function prints all of the integer data in a tree to
+ *		    STDOUT in the format of a C array.
+ *
+ * ARGUMENTS:	    bitree: (bitree *) -- the tree to print
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void print_data(bitree * bitree)
+{
+  if (bitree == NULL)
+    return;
+  if (bitree == bitree->root)
+    printf("{ %d", *(int *)bitree->data);
+  else
+    printf(", %d", *(int *)bitree->data);
+
+  print_data(bitree->left);
+  print_data(bitree->right);
+
+  if (bitree == bitree->root)
+    printf(" };\n");
+}
+
+/******************************************************************************
+ * FUNCTION:	    prep_tree
+ *
+ * DESCRIPTION:	    This function prepares a bitree struct for testing. It's
+ *		    purpose is to prevent code pasting.
+ *
+ * ARGUMENTS:	    
+ *
+ * RETURN:	    
+ *
+ * NOTES:	    
+ ***/
+static bitree * prep_tree()
+{
+  bitree * tree = NULL;
+  int * pTest = malloc(sizeof(int));
+  if (pTest == NULL)
+    return NULL;
+  *pTest = 1;
+  if ((tree = bitree_create(free, pTest)) == NULL)
+    goto error_exit;
+
+  int test = 0;
+  while (1) {
+    if ((pTest = malloc(sizeof(int))) == NULL)
+      goto error_exit;
+    *pTest = rand() % 20;
+    
+    switch((test++)) {
+    case 0:
+      if (bitree_insl(tree, (void *)pTest))
+	goto error_exit;
+      break;
+    case 1:
+      if (bitree_insl(tree->left, (void *)pTest))
+	goto error_exit;
+      break;
+    case 2:
+      if (bitree_insr(tree->left, (void *)pTest))
+	goto error_exit;
+      break;
+    case 3:
+      if (bitree_insr(tree, (void *)pTest))
+	goto error_exit;
+      break;
+    default:
+      goto break_loop;
+    }
+    continue; /* Unconditional continue */
+  break_loop:
+    break;
+  }
+
+  free(pTest);
+  return tree;
+
+ error_exit: {
+    if (pTest != NULL)
+      free(pTest);
+    return NULL;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    inorder_data
+ *
+ * DESCRIPTION:	    Copies the data pointers of a tree into `data', in the
+ *		    order they are visited by bitree_ninorder().
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the tree.
+ *		    data: (void **) -- array with room for every node.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void inorder_data(bitree * tree, void ** data)
+{
+  bitree * node = tree->root;
+  while (node->left != NULL)
+    node = node->left;
+
+  for (int i = 0; i < bitree_size(tree); i++) {
+    data[i] = node->data;
+    node = bitree_ninorder(node);
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    prep_complete
+ *
+ * DESCRIPTION:	    Prepares a complete tree holding the integers 0 to
+ *		    `size' - 1, in level order.
+ *
+ * ARGUMENTS:	    size: (int) -- the number of nodes.
+ *		    destroy: (void (*)(void *)) -- the destroy function, which
+ *			must free the payloads.
+ *
+ * RETURN:	    bitree * -- the new tree, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static bitree * prep_complete(int size, void (*destroy)(void *))
+{
+  bitree ** nodes = malloc(size * sizeof(bitree *));
+  int * pTest = malloc(sizeof(int));
+  bitree * tree = NULL;
+  if (nodes == NULL || pTest == NULL)
+    goto error_exit;
+  *pTest = 0;
+  if ((tree = nodes[0] = bitree_create(destroy, pTest)) == NULL)
+    goto error_exit;
+
+  for (int i = 1; i < size; i++) {
+    if ((pTest = malloc(sizeof(int))) == NULL)
+      goto error_exit;
+    *pTest = i;
+    bitree * parent = nodes[(i - 1) / 2];
+    if (i % 2 ? bitree_insl(parent, pTest) : bitree_insr(parent, pTest))
+      goto error_exit;
+    nodes[i] = i % 2 ? parent->left : parent->right;
+  }
+
+  free(nodes);
+  return tree;
+
+ error_exit: {
+    free(nodes);
+    free(pTest);
+    bitree_destroy(&tree);
+    return NULL;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    check_copy
+ *
+ * DESCRIPTION:	    Checks that `copy' has the same shape as `tree', with its
+ *		    own payloads holding `scale' times the original integers,
+ *		    and that its links are consistent.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the original.
+ *		    copy: (bitree *) -- the copy.
+ *		    scale: (int) -- the expected ratio of the payloads.
+ *
+ * RETURN:	    int -- 0 if `copy' is correct, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int check_copy(bitree * tree, bitree * copy, int scale)
+{
+  if (tree == NULL || copy == NULL)
+    return tree != copy;
+  if (copy->data == tree->data
+      || *(int *)copy->data != scale * *(int *)tree->data
+      || copy->root != copy->root->root || copy->size != copy->root->size)
+    return 1;
+  if ((copy->left != NULL && copy->left->parent != copy)
+      || (copy->right != NULL && copy->right->parent != copy))
+    return 1;
+  return check_copy(tree->left, copy->left, scale)
+    || check_copy(tree->right, copy->right, scale);
+}
+
+/******************************************************************************
+ * FUNCTION:	    copy_int
+ *
+ * DESCRIPTION:	    Copy function for integer payloads.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *
+ * RETURN:	    void * -- a new copy of the payload, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static void * copy_int(const void * data)
+{
+  int * copy = malloc(sizeof(int));
+  if (copy != NULL)
+    *copy = *(const int *)data;
+  return copy;
+}
+
+/******************************************************************************
+ * FUNCTION:	    double_int
+ *
+ * DESCRIPTION:	    Map function which doubles integer payloads. To test the
+ *		    handling of errors, it fails on negative payloads.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *
+ * RETURN:	    void * -- a new payload, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static void * double_int(const void * data)
+{
+  if (*(const int *)data < 0)
+    return NULL;
+  int * copy = malloc(sizeof(int));
+  if (copy != NULL)
+    *copy = *(const int *)data * 2;
+  return copy;
+}
+
+/******************************************************************************
+ * FUNCTION:	    prep_avl
+ *
+ * DESCRIPTION:	    Prepares a keyed tree containing the integers 0 to
+ *		    `size' - 1, inserted in ascending order.
+ *
+ * ARGUMENTS:	    size: (int) -- the number of keys to insert.
+ *
+ * RETURN:	    bitree * -- the new tree, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static bitree * prep_avl(int size)
+{
+  bitree * tree = NULL;
+  int * pTest = malloc(sizeof(int));
+  if (pTest == NULL)
+    return NULL;
+  *pTest = 0;
+  if ((tree = bitree_create(free, pTest)) == NULL)
+    goto error_exit;
+
+  for (int i = 1; i < size; i++) {
+    if ((pTest = malloc(sizeof(int))) == NULL)
+      goto error_exit;
+    *pTest = i;
+    if (bitree_avl_insert(tree, pTest, compare_int))
+      goto error_exit;
+  }
+
+  return tree;
+
+ error_exit: {
+    if (pTest != NULL)
+      free(pTest);
+    bitree_destroy(&tree);
+    return NULL;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    prep_splay
+ *
+ * DESCRIPTION:	    Prepares a splay tree containing the integers 0 to
+ *		    `size' - 1, inserted in a random order.
+ *
+ * ARGUMENTS:	    size: (int) -- the number of keys to insert.
+ *
+ * RETURN:	    bitree * -- the new tree, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static bitree * prep_splay(int size)
+{
+  bitree * tree = NULL;
+  int * pTest = malloc(sizeof(int));
+  if (pTest == NULL)
+    return NULL;
+  *pTest = rand() % size;
+  if ((tree = bitree_create(free, pTest)) == NULL)
+    goto error_exit;
+
+  while (bitree_size(tree) < size) {
+    if ((pTest = malloc(sizeof(int))) == NULL)
+      goto error_exit;
+    *pTest = rand() % size;
+    if (bitree_splay_insert(tree, pTest, compare_int))
+      free(pTest);
+  }
+
+  return tree;
+
+ error_exit: {
+    if (pTest != NULL)
+      free(pTest);
+    bitree_destroy(&tree);
+    return NULL;
+  }
+}
+
+/******************************************************************************
+ * FUNCTION:	    check_avl
+ *
+ * DESCRIPTION:	    Checks that the keys of a tree come out of bitree_ninorder()
+ *		    in ascending order, and that every node is balanced.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the tree to check.
+ *
+ * RETURN:	    int -- 0 if the tree is a valid AVL tree, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int check_avl(bitree * tree)
+{
+  bitree * node = tree->root;
+  while (node->left != NULL)
+    node = node->left;
+
+  for (int i = 0; i < bitree_size(tree); i++) {
+    int balance = bitree_height(node->left) - bitree_height(node->right);
+    if (balance > 1 || balance < -1)
+      return 1;
+
+    bitree * next = bitree_ninorder(node);
+    if (i + 1 < bitree_size(tree)
+	&& compare_int(node->data, next->data) >= 0)
+      return 1;
+    node = next;
+  }
+
+  return 0;
+}
+
+/******************************************************************************
+ * FUNCTION:	    check_order
+ *
+ * DESCRIPTION:	    Checks that the keys of a tree come out of bitree_ninorder()
+ *		    in ascending order.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the tree to check.
+ *
+ * RETURN:	    int -- 0 if the tree is ordered, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int check_order(bitree * tree)
+{
+  bitree * node = tree->root;
+  while (node->left != NULL)
+    node = node->left;
+
+  for (int i = 0; i + 1 < bitree_size(tree); i++) {
+    bitree * next = bitree_ninorder(node);
+    if (compare_int(node->data, next->data) >= 0)
+      return 1;
+    node = next;
+  }
+
+  return 0;
+}
+
+#ifdef CONFIG_ORDER_STATISTICS
+/******************************************************************************
+ * FUNCTION:	    check_counts
+ *
+ * DESCRIPTION:	    Checks that the subtree count of every node in a tree is
+ *		    correct.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the tree to check.
+ *
+ * RETURN:	    int -- 0 if every count is correct, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int check_counts(bitree * tree)
+{
+  if (tree == NULL)
+    return 0;
+  if (check_counts(tree->left) || check_counts(tree->right))
+    return 1;
+
+  int count = 1;
+  if (tree->left != NULL)
+    count += tree->left->count;
+  if (tree->right != NULL)
+    count += tree->right->count;
+  return tree->count != count;
+}
+#endif /* CONFIG_ORDER_STATISTICS */
+
+#ifdef CONFIG_SUBTREE_AGGREGATE
+/******************************************************************************
+ * FUNCTION:	    check_summaries
+ *
+ * DESCRIPTION:	    Checks that the summary of every node in a tree is the
+ *		    aggregate of its subtree.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the tree to check.
+ *
+ * RETURN:	    int -- 0 if every summary is correct, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int check_summaries(bitree * tree)
+{
+  if (tree == NULL)
+    return 0;
+  if (check_summaries(tree->left) || check_summaries(tree->right))
+    return 1;
+
+  const struct bitree_aggregate * aggregate = tree->aggregate;
+  double summary = aggregate->value(tree->data);
+  if (tree->left != NULL)
+    summary = aggregate->combine(summary, tree->left->summary);
+  if (tree->right != NULL)
+    summary = aggregate->combine(summary, tree->right->summary);
+  return tree->summary != summary;
+}
+
+/******************************************************************************
+ * FUNCTION:	    add
+ *
+ * DESCRIPTION:	    Combine function for sum aggregates.
+ *
+ * ARGUMENTS:	    one: (double) -- the first value.
+ *		    two: (double) -- the second value.
+ *
+ * RETURN:	    double -- the sum.
+ *
+ * NOTES:	    none.
+ ***/
+static double add(double one, double two)
+{
+  return one + two;
+}
+
+/******************************************************************************
+ * FUNCTION:	    max
+ *
+ * DESCRIPTION:	    Combine function for maximum aggregates.
+ *
+ * ARGUMENTS:	    one: (double) -- the first value.
+ *		    two: (double) -- the second value.
+ *
+ * RETURN:	    double -- the larger value.
+ *
+ * NOTES:	    none.
+ ***/
+static double max(double one, double two)
+{
+  return one > two ? one : two;
+}
+#endif /* CONFIG_SUBTREE_AGGREGATE */
+
+/******************************************************************************
+ * FUNCTION:	    compare_int
+ *
+ * DESCRIPTION:	    Comparison function for keyed trees of integers.
+ *
+ * ARGUMENTS:	    one: (const void *) -- the first key.
+ *		    two: (const void *) -- the second key.
+ *
+ * RETURN:	    int -- less than, equal to, or greater than zero.
+ *
+ * NOTES:	    none.
+ ***/
+static int compare_int(const void * one, const void * two)
+{
+  return *(const int *)one - *(const int *)two;
+}
+
+/******************************************************************************
+ * FUNCTION:	    prep_version
+ *
+ * DESCRIPTION:	    Prepares a persistent tree with the same shape and data as
+ *		    the one built by prep_tree(). Its payloads are freed by
+ *		    count_free().
+ *
+ * ARGUMENTS:	    none.
+ *
+ * RETURN:	    bitree_version * -- the tree, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static bitree_version * prep_version()
+{
+  /*	      1
+   *	   2     3
+   *	 5   4
+   */
+  static const char * paths[] = {"", "", "l", "l"};
+  static const int right[] = {0, 1, 0, 1};
+  static const int data[] = {2, 3, 5, 4};
+
+  bitree_version * version = bitree_version_create(count_free, new_int(1));
+  for (int i = 0; i < 4 && version != NULL; i++) {
+    int * pTest = new_int(data[i]);
+    bitree_version * next = right[i]
+      ? bitree_version_insr(version, paths[i], pTest)
+      : bitree_version_insl(version, paths[i], pTest);
+    if (next == NULL)
+      free(pTest);
+    bitree_version_release(&version);
+    version = next;
+  }
+  return version;
+}
+
+/******************************************************************************
+ * FUNCTION:	    new_int
+ *
+ * DESCRIPTION:	    Allocates an integer payload.
+ *
+ * ARGUMENTS:	    value: (int) -- the value.
+ *
+ * RETURN:	    int * -- the payload, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static int * new_int(int value)
+{
+  int * data = malloc(sizeof(int));
+  if (data != NULL)
+    *data = value;
+  return data;
+}
+
+/******************************************************************************
+ * FUNCTION:	    count_free
+ *
+ * DESCRIPTION:	    Destroy function which counts the payloads it frees.
+ *
+ * ARGUMENTS:	    data: (void *) -- the payload.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void count_free(void * data)
+{
+  freed++;
+  free(data);
+}
+
+/******************************************************************************
+ * FUNCTION:	    hash_int
+ *
+ * DESCRIPTION:	    Hash function for integer payloads.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *
+ * RETURN:	    size_t -- the hash.
+ *
+ * NOTES:	    none.
+ ***/
+static size_t hash_int(const void * data)
+{
+  return *(const int *)data;
+}
+
+/******************************************************************************
+ * FUNCTION:	    equal_int
+ *
+ * DESCRIPTION:	    Equality function for integer payloads.
+ *
+ * ARGUMENTS:	    one: (const void *) -- the first payload.
+ *		    two: (const void *) -- the second payload.
+ *
+ * RETURN:	    int -- nonzero if the payloads are equal.
+ *
+ * NOTES:	    none.
+ ***/
+static int equal_int(const void * one, const void * two)
+{
+  return *(const int *)one == *(const int *)two;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_record
+ *
+ * DESCRIPTION:	    Visitor for bitree_walk() which records the nodes it is
+ *		    called on.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    skip: (void *) -- the node whose children are skipped.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_SKIP_CHILDREN at `skip', and
+ *		    BITREE_CONTINUE otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit walk_record(bitree * node, void * skip)
+{
+  walked[walked_size++] = node;
+  return node == skip ? BITREE_SKIP_CHILDREN : BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    walk_stop
+ *
+ * DESCRIPTION:	    Visitor for bitree_walk() which records the nodes it is
+ *		    called on, until it reaches `stop'.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    stop: (void *) -- the last node to visit.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_STOP at `stop', and
+ *		    BITREE_CONTINUE otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit walk_stop(bitree * node, void * stop)
+{
+  walked[walked_size++] = node;
+  return node == stop ? BITREE_STOP : BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    many_record
+ *
+ * DESCRIPTION:	    Visitor for bitree_walk_many() which records the nodes it
+ *		    is called on, skips the children of `many_skip' and stops
+ *		    at `many_stop'.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the current node.
+ *		    walk: (void *) -- the int index of the walk in
+ *			`many_walked'.
+ *
+ * RETURN:	    enum bitree_visit -- what the walk does next.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit many_record(bitree * node, void * walk)
+{
+  int i = *(int *)walk;
+  many_walked[i][many_walked_size[i]++] = node;
+  if (node == many_stop)
+    return BITREE_STOP;
+  return node == many_skip ? BITREE_SKIP_CHILDREN : BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    steer_int
+ *
+ * DESCRIPTION:	    Steers bitree_descend_many() to an integer key, as in a
+ *		    search of a binary search tree.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *		    key: (void *) -- the int key.
+ *
+ * RETURN:	    int -- negative to go left, positive to go right, and 0 if
+ *		    the payload is the key.
+ *
+ * NOTES:	    none.
+ ***/
+static int steer_int(const void * data, void * key)
+{
+  return compare_int(key, data);
+}
+
+/******************************************************************************
+ * FUNCTION:	    steer_left
+ *
+ * DESCRIPTION:	    Steers bitree_descend_many() left until it falls off the
+ *		    tree.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *		    ctx: (void *) -- unused.
+ *
+ * RETURN:	    int -- -1.
+ *
+ * NOTES:	    none.
+ ***/
+static int steer_left(const void * data, void * ctx)
+{
+  return -1;
+}
+
+/******************************************************************************
+ * FUNCTION:	    is_int
+ *
+ * DESCRIPTION:	    Predicate for bitree_find_if() on integer payloads.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *		    value: (void *) -- the integer to look for.
+ *
+ * RETURN:	    int -- nonzero if the payload equals `value'.
+ *
+ * NOTES:	    none.
+ ***/
+static int is_int(const void * data, void * value)
+{
+  return *(const int *)data == *(int *)value;
+}
+
+/******************************************************************************
+ * FUNCTION:	    is_not_int
+ *
+ * DESCRIPTION:	    Predicate for bitree_retain() on integer payloads.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *		    value: (void *) -- the integer to remove.
+ *
+ * RETURN:	    int -- nonzero if the payload does not equal `value'.
+ *
+ * NOTES:	    none.
+ ***/
+static int is_not_int(const void * data, void * value)
+{
+  return !is_int(data, value);
+}
+
+/******************************************************************************
+ * FUNCTION:	    is_below
+ *
+ * DESCRIPTION:	    Predicate for bitree_retain() on integer payloads.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *		    limit: (void *) -- the integer to compare against.
+ *
+ * RETURN:	    int -- nonzero if the payload is less than `limit'.
+ *
+ * NOTES:	    none.
+ ***/
+static int is_below(const void * data, void * limit)
+{
+  return *(const int *)data < *(int *)limit;
+}
+
+#ifdef CONFIG_DESTROY_BATCH
+/******************************************************************************
+ * FUNCTION:	    batch_free
+ *
+ * DESCRIPTION:	    Batched destroy function which counts the payloads it
+ *		    frees, and the number of times it is called.
+ *
+ * ARGUMENTS:	    data: (void **) -- the payloads.
+ *		    n: (size_t) -- the number of payloads.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void batch_free(void ** data, size_t n)
+{
+  batches++;
+  for (size_t i = 0; i < n; i++) {
+    freed++;
+    free(data[i]);
+  }
+}
+#endif
+
+/******************************************************************************
+ * FUNCTION:	    serialize_int
+ *
+ * DESCRIPTION:	    Serializes an integer payload for a journal or a shared
+ *		    tree.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *		    buffer: (void *) -- where to write it.
+ *		    size: (size_t) -- the size of `buffer'.
+ *
+ * RETURN:	    size_t -- the size of the serialized payload.
+ *
+ * NOTES:	    none.
+ ***/
+static size_t serialize_int(const void * data, void * buffer, size_t size)
+{
+  if (size >= sizeof(int))
+    memcpy(buffer, data, sizeof(int));
+  return sizeof(int);
+}
+
+/******************************************************************************
+ * FUNCTION:	    shm_record
+ *
+ * DESCRIPTION:	    Visitor for bitree_shm_walk() which records the payloads
+ *		    of the nodes it is called on.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the region.
+ *		    node: (bitree_shm_ref) -- the current node.
+ *		    ctx: (void *) -- unused.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_CONTINUE.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit shm_record(bitree_shm * shm, bitree_shm_ref node,
+				    void * ctx)
+{
+  walked_data[walked_data_size++] = *(const int *)bitree_shm_data(shm, node,
+								NULL);
+  return BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    shm_change
+ *
+ * DESCRIPTION:	    Visitor for bitree_shm_walk() which changes the tree
+ *		    through the writer's handle, as another process might.
+ *
+ * ARGUMENTS:	    shm: (bitree_shm *) -- the region.
+ *		    node: (bitree_shm_ref) -- the current node.
+ *		    ctx: (void *) -- the writer's handle.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_CONTINUE.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit shm_change(bitree_shm * shm, bitree_shm_ref node,
+				    void * ctx)
+{
+  int value = 0;
+  while (bitree_shm_left(ctx, node) != 0)
+    node = bitree_shm_left(ctx, node);
+  bitree_shm_rem(ctx, bitree_shm_insl(ctx, node, &value, sizeof(int)));
+  return BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    paged_record
+ *
+ * DESCRIPTION:	    Visitor for bitree_paged_walk() which records the payloads
+ *		    of the nodes it is called on.
+ *
+ * ARGUMENTS:	    tree: (bitree_paged *) -- the tree.
+ *		    node: (bitree_pref) -- the current node.
+ *		    ctx: (void *) -- unused.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_CONTINUE, or BITREE_STOP if the
+ *		    payload can't be pinned.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit paged_record(bitree_paged * tree, bitree_pref node,
+				      void * ctx)
+{
+  int * data = bitree_paged_pin(tree, node);
+  if (data == NULL)
+    return BITREE_STOP;
+  walked_data[walked_data_size++] = *data;
+  bitree_paged_unpin(tree, node, 0);
+  return BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    succinct_record
+ *
+ * DESCRIPTION:	    Visitor for bitree_succinct_walk() which records the
+ *		    payloads of the nodes it is called on.
+ *
+ * ARGUMENTS:	    tree: (const bitree_succinct *) -- the tree.
+ *		    node: (bitree_sref) -- the current node.
+ *		    skip: (void *) -- points to the node whose children are
+ *			skipped, or NULL.
+ *
+ * RETURN:	    enum bitree_visit -- BITREE_SKIP_CHILDREN for that node,
+ *		    and BITREE_CONTINUE otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static enum bitree_visit succinct_record(const bitree_succinct * tree,
+					 bitree_sref node, void * skip)
+{
+  walked_data[walked_data_size++] = *(const int *)bitree_succinct_data(tree,
+								       node);
+  return skip != NULL && node == *(bitree_sref *)skip
+    ? BITREE_SKIP_CHILDREN : BITREE_CONTINUE;
+}
+
+/******************************************************************************
+ * FUNCTION:	    deserialize_int
+ *
+ * DESCRIPTION:	    Makes an integer payload from its serialized form.
+ *
+ * ARGUMENTS:	    buffer: (const void *) -- the serialized payload.
+ *		    size: (size_t) -- its size.
+ *
+ * RETURN:	    void * -- the payload, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static void * deserialize_int(const void * buffer, size_t size)
+{
+  int value;
+  if (size != sizeof(int))
+    return NULL;
+  memcpy(&value, buffer, sizeof(int));
+  return new_int(value);
+}
+
+/******************************************************************************
+ * FUNCTION:	    deserialize_small
+ *
+ * DESCRIPTION:	    Like deserialize_int(), but fails for integers of 2000 and
+ *		    more.
+ *
+ * ARGUMENTS:	    buffer: (const void *) -- the serialized payload.
+ *		    size: (size_t) -- its size.
+ *
+ * RETURN:	    void * -- the payload, or NULL.
+ *
+ * NOTES:	    none.
+ ***/
+static void * deserialize_small(const void * buffer, size_t size)
+{
+  int value;
+  if (size != sizeof(int))
+    return NULL;
+  memcpy(&value, buffer, sizeof(int));
+  return value < 2000 ? new_int(value) : NULL;
+}
+
+/******************************************************************************
+ * FUNCTION:	    int_value
+ *
+ * DESCRIPTION:	    Value extractor for aggregates and reductions over
+ *		    integer payloads.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *
+ * RETURN:	    double -- the integer.
+ *
+ * NOTES:	    none.
+ ***/
+static double int_value(const void * data)
+{
+  return *(const int *)data;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bfs_record
+ *
+ * DESCRIPTION:	    Action for bitree_bfs() which records the depth of an
+ *		    integer payload, and counts its visits.
+ *
+ * ARGUMENTS:	    node: (bitree *) -- the node.
+ *		    depth: (int) -- its depth.
+ *		    ctx: (void *) -- unused.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    Each payload has its own entries, so it is safe to call
+ *		    from several threads at once.
+ ***/
+static void bfs_record(bitree * node, int depth, void * ctx)
+{
+  int value = *(int *)node->data;
+  bfs_depths[value] = depth;
+  bfs_visits[value]++;
+}
+
+/******************************************************************************
+ * FUNCTION:	    bfs_level
+ *
+ * DESCRIPTION:	    Level hook for bitree_bfs() which records the nodes of
+ *		    each level, and stops after level `bfs_stop'.
+ *
+ * ARGUMENTS:	    depth: (int) -- the depth of the level.
+ *		    nodes: (bitree **) -- its nodes.
+ *		    size: (size_t) -- the number of nodes.
+ *		    ctx: (void *) -- unused.
+ *
+ * RETURN:	    int -- 1 if the traversal stops, 0 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int bfs_level(int depth, bitree ** nodes, size_t size, void * ctx)
+{
+  if (depth != bfs_levels++)
+    return 1;
+  memcpy(bfs_nodes + bfs_nodes_size, nodes, size * sizeof(bitree *));
+  bfs_nodes_size += size;
+  return depth == bfs_stop;
+}
+
+#ifdef CONFIG_MERKLE_HASH
+/******************************************************************************
+ * FUNCTION:	    count_hash
+ *
+ * DESCRIPTION:	    Hash function for integer payloads which counts the number
+ *		    of times it is called.
+ *
+ * ARGUMENTS:	    data: (const void *) -- the payload.
+ *
+ * RETURN:	    size_t -- the hash.
+ *
+ * NOTES:	    none.
+ ***/
+static size_t count_hash(const void * data)
+{
+  hashed++;
+  return *(const int *)data;
+}
+
+/******************************************************************************
+ * FUNCTION:	    diff_record
+ *
+ * DESCRIPTION:	    Records a difference reported by bitree_diff().
+ *
+ * ARGUMENTS:	    one: (bitree *) -- the node in the first tree, or NULL.
+ *		    two: (bitree *) -- the node in the second tree, or NULL.
+ *		    ctx: (void *) -- unused.
+ *
+ * RETURN:	    void.
+ *
+ * NOTES:	    none.
+ ***/
+static void diff_record(bitree * one, bitree * two, void * ctx)
+{
+  diffs[0][diffs_size] = one;
+  diffs[1][diffs_size++] = two;
+}
+#endif
+
+#ifdef CONFIG_JOURNAL
+/******************************************************************************
+ * FUNCTION:	    fail_write
+ *
+ * DESCRIPTION:	    Journal sink which always fails.
+ *
+ * ARGUMENTS:	    sink: (void *) -- unused.
+ *		    record: (const void *) -- unused.
+ *		    size: (size_t) -- unused.
+ *
+ * RETURN:	    int -- -1.
+ *
+ * NOTES:	    none.
+ ***/
+static int fail_write(void * sink, const void * record, size_t size)
+{
+  return -1;
+}
+
+/******************************************************************************
+ * FUNCTION:	    check_replica
+ *
+ * DESCRIPTION:	    Checks that two trees of integers have the same shape and
+ *		    payloads.
+ *
+ * ARGUMENTS:	    tree: (bitree *) -- the first tree.
+ *		    replica: (bitree *) -- the second tree.
+ *
+ * RETURN:	    int -- 0 if they are the same, 1 otherwise.
+ *
+ * NOTES:	    none.
+ ***/
+static int check_replica(bitree * tree, bitree * replica)
+{
+  if (tree == NULL || replica == NULL)
+    return tree != replica;
+  if (*(int *)tree->data != *(int *)replica->data)
+    return 1;
+  return check_replica(tree->left, replica->left)
+    || check_replica(tree->right, replica->right);
+}
+#endif
+
 /*****************************************************************************/